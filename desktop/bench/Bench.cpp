@@ -0,0 +1,319 @@
+#include "Bench.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <sstream>
+
+namespace
+{
+thread_local uint64_t threadAllocationCount = 0;
+
+void* allocate(std::size_t size)
+{
+    ++threadAllocationCount;
+    if (void* memory = std::malloc(size == 0 ? 1 : size))
+    {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void* allocateAligned(std::size_t size, std::align_val_t alignment)
+{
+    ++threadAllocationCount;
+    const auto align = static_cast<std::size_t>(alignment);
+    const std::size_t rounded = std::max<std::size_t>((size + align - 1) / align * align, align);
+#if defined(_MSC_VER)
+    void* memory = _aligned_malloc(rounded, align);
+#else
+    void* memory = std::aligned_alloc(align, rounded);
+#endif
+    if (memory == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+void releaseAligned(void* memory) noexcept
+{
+#if defined(_MSC_VER)
+    _aligned_free(memory);
+#else
+    std::free(memory);
+#endif
+}
+} // namespace
+
+void* operator new(std::size_t size) { return allocate(size); }
+void* operator new[](std::size_t size) { return allocate(size); }
+void* operator new(std::size_t size, std::align_val_t alignment) { return allocateAligned(size, alignment); }
+void* operator new[](std::size_t size, std::align_val_t alignment) { return allocateAligned(size, alignment); }
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+    try
+    {
+        return allocate(size);
+    }
+    catch (...)
+    {
+        return nullptr;
+    }
+}
+void* operator new[](std::size_t size, const std::nothrow_t& tag) noexcept { return operator new(size, tag); }
+void operator delete(void* memory) noexcept { std::free(memory); }
+void operator delete[](void* memory) noexcept { std::free(memory); }
+void operator delete(void* memory, std::size_t) noexcept { std::free(memory); }
+void operator delete[](void* memory, std::size_t) noexcept { std::free(memory); }
+void operator delete(void* memory, const std::nothrow_t&) noexcept { std::free(memory); }
+void operator delete[](void* memory, const std::nothrow_t&) noexcept { std::free(memory); }
+void operator delete(void* memory, std::align_val_t) noexcept { releaseAligned(memory); }
+void operator delete[](void* memory, std::align_val_t) noexcept { releaseAligned(memory); }
+void operator delete(void* memory, std::size_t, std::align_val_t) noexcept { releaseAligned(memory); }
+void operator delete[](void* memory, std::size_t, std::align_val_t) noexcept { releaseAligned(memory); }
+
+namespace singwithme::bench
+{
+namespace
+{
+constexpr int64_t kMaxIterations = 1'000'000'000;
+// Like Google Benchmark: overshoot the target a little and grow at most tenfold per round.
+constexpr double kOvershoot = 1.4;
+constexpr double kMaxGrowth = 10.0;
+
+std::string escape(const std::string& text)
+{
+    std::string escaped;
+    for (const char c : text)
+    {
+        switch (c)
+        {
+            case '"':
+                escaped += "\\\"";
+                break;
+            case '\\':
+                escaped += "\\\\";
+                break;
+            case '\n':
+                escaped += "\\n";
+                break;
+            default:
+                escaped += c;
+        }
+    }
+    return escaped;
+}
+
+std::string number(double value)
+{
+    char text[32];
+    std::snprintf(text, sizeof(text), "%.6g", value);
+    return text;
+}
+
+struct Result
+{
+    std::string name;
+    int64_t iterations{0};
+    double nanosecondsPerIteration{0.0};
+    double allocationsPerIteration{0.0};
+    double realTimeFactor{-1.0};
+    size_t audioSamples{0};
+    std::map<std::string, double> counters;
+    std::string error;
+};
+
+Result measure(const Benchmark& benchmark, double minSeconds)
+{
+    int64_t iterations = 1;
+    for (;;)
+    {
+        State state(iterations);
+        benchmark.run(state);
+
+        Result result;
+        result.name = benchmark.name;
+        result.iterations = state.iterations();
+        result.error = state.error();
+        if (!result.error.empty())
+        {
+            return result;
+        }
+
+        const double elapsed = state.elapsedSeconds();
+        if (elapsed >= minSeconds || iterations >= kMaxIterations)
+        {
+            const auto count = static_cast<double>(iterations);
+            result.nanosecondsPerIteration = elapsed * 1.0e9 / count;
+            result.allocationsPerIteration = static_cast<double>(state.allocations()) / count;
+            result.counters = state.counters();
+            result.audioSamples = state.audioSamples();
+            if (state.audioSamples() > 0 && state.audioSampleRate() > 0.0)
+            {
+                const double audioSeconds = static_cast<double>(state.audioSamples()) / state.audioSampleRate();
+                result.realTimeFactor = elapsed / count / audioSeconds;
+            }
+            return result;
+        }
+
+        const double growth = elapsed > 0.0 ? std::min(kMaxGrowth, minSeconds * kOvershoot / elapsed) : kMaxGrowth;
+        iterations = std::min(kMaxIterations, std::max(iterations + 1, static_cast<int64_t>(static_cast<double>(iterations) * growth)));
+    }
+}
+
+void writeJson(std::ostream& out, const std::map<std::string, std::string>& context, const std::vector<Result>& results)
+{
+    out << "{\n  \"context\": {\n";
+    const std::time_t now = std::time(nullptr);
+    char date[32];
+    std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", std::localtime(&now));
+    out << "    \"date\": \"" << date << "\"";
+    for (const auto& [key, value] : context)
+    {
+        out << ",\n    \"" << escape(key) << "\": \"" << escape(value) << "\"";
+    }
+    out << "\n  },\n  \"benchmarks\": [";
+
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        const auto& result = results[i];
+        out << (i == 0 ? "\n" : ",\n") << "    {\n";
+        out << "      \"name\": \"" << escape(result.name) << "\",\n";
+        out << "      \"run_type\": \"iteration\",\n";
+        out << "      \"iterations\": " << result.iterations;
+        if (!result.error.empty())
+        {
+            out << ",\n      \"error_occurred\": true,\n      \"error_message\": \"" << escape(result.error) << "\"\n    }";
+            continue;
+        }
+        out << ",\n      \"real_time\": " << number(result.nanosecondsPerIteration);
+        out << ",\n      \"time_unit\": \"ns\"";
+        out << ",\n      \"allocations_per_iteration\": " << number(result.allocationsPerIteration);
+        if (result.realTimeFactor >= 0.0)
+        {
+            out << ",\n      \"block_samples\": " << result.audioSamples;
+            out << ",\n      \"real_time_factor\": " << number(result.realTimeFactor);
+        }
+        for (const auto& [name, value] : result.counters)
+        {
+            out << ",\n      \"" << escape(name) << "\": " << number(value);
+        }
+        out << "\n    }";
+    }
+    out << "\n  ]\n}\n";
+}
+} // namespace
+
+uint64_t threadAllocations() noexcept
+{
+    return threadAllocationCount;
+}
+
+bool State::keepRunning()
+{
+    if (!error_.empty())
+    {
+        return false;
+    }
+    if (!started_)
+    {
+        started_ = true;
+        resumeTiming();
+    }
+    if (remaining_ > 0)
+    {
+        --remaining_;
+        return true;
+    }
+    pauseTiming();
+    return false;
+}
+
+void State::pauseTiming()
+{
+    if (!running_)
+    {
+        return;
+    }
+    elapsed_ += Clock::now() - since_;
+    allocations_ += threadAllocations() - allocationsSince_;
+    running_ = false;
+}
+
+void State::resumeTiming()
+{
+    if (running_)
+    {
+        return;
+    }
+    allocationsSince_ = threadAllocations();
+    running_ = true;
+    since_ = Clock::now();
+}
+
+void State::skipWithError(std::string message)
+{
+    pauseTiming();
+    error_ = std::move(message);
+}
+
+void State::setAudioPerIteration(size_t samples, double sampleRate)
+{
+    audioSamples_ = samples;
+    audioSampleRate_ = sampleRate;
+}
+
+int runBenchmarks(const std::vector<Benchmark>& benchmarks,
+                  const std::map<std::string, std::string>& context,
+                  const RunOptions& options)
+{
+    std::vector<Result> results;
+    bool failed = false;
+    for (const auto& benchmark : benchmarks)
+    {
+        if (!options.filter.empty() && benchmark.name.find(options.filter) == std::string::npos)
+        {
+            continue;
+        }
+
+        auto result = measure(benchmark, options.minSeconds);
+        if (result.error.empty())
+        {
+            std::fprintf(stderr, "%-48s %14.1f ns %10lld it %8.2f allocs", result.name.c_str(), result.nanosecondsPerIteration,
+                         static_cast<long long>(result.iterations), result.allocationsPerIteration);
+            if (result.realTimeFactor >= 0.0)
+            {
+                std::fprintf(stderr, "  rtf %.4g", result.realTimeFactor);
+            }
+            std::fprintf(stderr, "\n");
+        }
+        else
+        {
+            std::fprintf(stderr, "%-48s ERROR: %s\n", result.name.c_str(), result.error.c_str());
+            failed = true;
+        }
+        results.push_back(std::move(result));
+    }
+
+    if (options.outputPath.empty())
+    {
+        writeJson(std::cout, context, results);
+    }
+    else
+    {
+        std::ofstream file(options.outputPath);
+        if (!file)
+        {
+            std::fprintf(stderr, "Cannot write %s\n", options.outputPath.c_str());
+            return 1;
+        }
+        writeJson(file, context, results);
+    }
+    return failed ? 1 : 0;
+}
+} // namespace singwithme::bench
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace singwithme::bench
+{
+// Iteration state handed to a benchmark, in the style of Google Benchmark:
+//
+//     while (state.keepRunning()) { ...one iteration... }
+//
+// Time and heap allocations on the benchmark's thread are counted between the first and the
+// last keepRunning() call, minus any pauseTiming()/resumeTiming() spans.
+class State
+{
+public:
+    explicit State(int64_t iterations) : iterations_(iterations), remaining_(iterations) {}
+
+    bool keepRunning();
+    void pauseTiming();
+    void resumeTiming();
+    void skipWithError(std::string message);
+
+    // Audio processed per iteration; turns the time per iteration into a real-time factor.
+    void setAudioPerIteration(size_t samples, double sampleRate);
+    void setCounter(const std::string& name, double value) { counters_[name] = value; }
+
+    int64_t iterations() const noexcept { return iterations_; }
+    double elapsedSeconds() const noexcept { return elapsed_.count(); }
+    uint64_t allocations() const noexcept { return allocations_; }
+    size_t audioSamples() const noexcept { return audioSamples_; }
+    double audioSampleRate() const noexcept { return audioSampleRate_; }
+    const std::map<std::string, double>& counters() const noexcept { return counters_; }
+    const std::string& error() const noexcept { return error_; }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    int64_t iterations_;
+    int64_t remaining_;
+    bool started_{false};
+    bool running_{false};
+    Clock::time_point since_{};
+    uint64_t allocationsSince_{0};
+    std::chrono::duration<double> elapsed_{0.0};
+    uint64_t allocations_{0};
+    size_t audioSamples_{0};
+    double audioSampleRate_{0.0};
+    std::map<std::string, double> counters_;
+    std::string error_;
+};
+
+struct Benchmark
+{
+    std::string name;
+    std::function<void(State&)> run;
+};
+
+struct RunOptions
+{
+    double minSeconds{0.5};
+    std::string filter;
+    std::string outputPath; // empty: stdout
+};
+
+// Heap allocations made by the calling thread so far (counted by the bench's operator new).
+uint64_t threadAllocations() noexcept;
+
+// Keeps the compiler from discarding a result the benchmark otherwise ignores.
+template <typename T>
+inline void doNotOptimize(const T& value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static volatile const T* sink;
+    sink = &value;
+#endif
+}
+
+// Runs every benchmark whose name contains options.filter, growing the iteration count
+// until a run lasts at least options.minSeconds, and writes Google Benchmark-shaped JSON.
+int runBenchmarks(const std::vector<Benchmark>& benchmarks,
+                  const std::map<std::string, std::string>& context,
+                  const RunOptions& options);
+
+std::vector<Benchmark> dspBenchmarks();
+std::vector<Benchmark> pipelineBenchmarks();
+} // namespace singwithme::bench
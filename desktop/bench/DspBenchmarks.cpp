@@ -0,0 +1,926 @@
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Bench.h"
+#include "Fixtures.h"
+#include "GateSweep.h"
+#include "calibration/Calibrator.h"
+#include "dsp/AsrcBridge.h"
+#include "dsp/BleedCanceller.h"
+#include "dsp/ConfidenceGate.h"
+#include "dsp/FdnReverb.h"
+#include "dsp/FeatureExtractor.h"
+#include "dsp/PhraseTracker.h"
+#include "dsp/PitchProcessor.h"
+#include "dsp/PitchShifter.h"
+#include "dsp/Resampler.h"
+#include "dsp/RoutingMatrix.h"
+#include "dsp/TimbreMatcher.h"
+#include "dsp/VadProcessor.h"
+#include "dsp/WaveformPyramid.h"
+
+namespace singwithme::bench
+{
+namespace
+{
+constexpr double kDeviceRate = 48000.0;
+constexpr double kModelRate = 16000.0;
+constexpr size_t kBlock = 128;
+constexpr size_t kVadFrame = 160;
+constexpr size_t kPitchHop = 1024;
+constexpr double kPi = 3.14159265358979323846;
+constexpr double kStemRate = 44100.0;
+// Reference tones for the resampler quality counters: inside the model feed's passband, and
+// high in the stems' band where the cheaper tiers lose accuracy.
+constexpr double kToneHz = 997.0;
+constexpr double kStemToneHz = 9973.0;
+
+// Walks through a signal one block at a time, wrapping at the end.
+class BlockCursor
+{
+public:
+    BlockCursor(const std::vector<float>& signal, size_t blockSize) : signal_(signal), blockSize_(blockSize) {}
+
+    const float* next()
+    {
+        if (position_ + blockSize_ > signal_.size())
+        {
+            position_ = 0;
+        }
+        const float* block = signal_.data() + position_;
+        position_ += blockSize_;
+        return block;
+    }
+
+    size_t position() const noexcept { return position_; }
+
+private:
+    const std::vector<float>& signal_;
+    size_t blockSize_;
+    size_t position_{0};
+};
+
+bool haveAudio(State& state, const std::vector<float>& signal, size_t blockSize)
+{
+    if (signal.size() < blockSize)
+    {
+        state.skipWithError("demo audio not found; run from the repository root or pass --root");
+        return false;
+    }
+    return true;
+}
+
+void confidenceGateUpdate(State& state)
+{
+    dsp::ConfidenceGate gate;
+    gate.configure(static_cast<float>(kDeviceRate), kBlock, dsp::GateConfig{});
+    // A slow sweep through the thresholds so the gate keeps opening and closing.
+    std::vector<float> confidence(1024);
+    for (size_t i = 0; i < confidence.size(); ++i)
+    {
+        confidence[i] = 0.5f + 0.5f * std::sin(static_cast<float>(i) * 0.05f);
+    }
+    size_t index = 0;
+    while (state.keepRunning())
+    {
+        const float c = confidence[index++ & 1023];
+        doNotOptimize(gate.update(c, c, c));
+    }
+}
+
+void vadProcessFrame(State& state)
+{
+    const auto& voice = demoAudio(kDemoGuide, kModelRate);
+    if (!haveAudio(state, voice, kVadFrame))
+    {
+        return;
+    }
+    dsp::VadProcessor vad(ortEnvironment());
+    vad.loadModel(benchConfig().vadModelPath);
+    vad.setModelSampleRate(static_cast<int64_t>(kModelRate));
+    BlockCursor cursor(voice, kVadFrame);
+    state.setAudioPerIteration(kVadFrame, kModelRate);
+    while (state.keepRunning())
+    {
+        doNotOptimize(vad.processFrame(cursor.next(), kVadFrame));
+    }
+    state.setCounter("inference_skipped_percent", vad.inferenceSkippedPercent());
+}
+
+void pitchProcessHop(State& state)
+{
+    const auto& voice = demoAudio(kDemoGuide, kModelRate);
+    if (!haveAudio(state, voice, kPitchHop))
+    {
+        return;
+    }
+    dsp::PitchProcessor pitch(ortEnvironment());
+    pitch.loadModel(benchConfig().pitchModelPath);
+    BlockCursor cursor(voice, kPitchHop);
+    state.setAudioPerIteration(kPitchHop, kModelRate);
+    while (state.keepRunning())
+    {
+        doNotOptimize(pitch.processHop(cursor.next(), kPitchHop));
+    }
+    state.setCounter("inference_skipped_percent", pitch.inferenceSkippedPercent());
+}
+
+// Mean time from a sung entry to the first pitch estimate of at least kDetectConfidence,
+// streaming 10 ms chunks as the audio thread would: silence, then a voiced 220 Hz tone, eight
+// times over. Returns a negative value if an entry is never detected.
+double pitchDetectLatencyMs(size_t hopSamples)
+{
+    constexpr size_t kSegment = static_cast<size_t>(kModelRate / 2.0);
+    constexpr int kEntries = 8;
+    constexpr float kDetectConfidence = 0.5f;
+
+    std::vector<float> signal(2 * kSegment * kEntries, 0.0f);
+    for (int entry = 0; entry < kEntries; ++entry)
+    {
+        const size_t onset = (2 * static_cast<size_t>(entry) + 1) * kSegment;
+        for (size_t i = 0; i < kSegment; ++i)
+        {
+            const double phase = 2.0 * 3.14159265358979 * 220.0 * static_cast<double>(i) / kModelRate;
+            signal[onset + i] = static_cast<float>(0.2 * std::sin(phase) + 0.1 * std::sin(2.0 * phase) + 0.05 * std::sin(3.0 * phase));
+        }
+    }
+
+    dsp::PitchProcessor pitch(ortEnvironment());
+    pitch.loadModel(benchConfig().pitchModelPath);
+    pitch.setHopSamples(hopSamples);
+    double totalMs = 0.0;
+    int detected = 0;
+    size_t position = 0;
+    while (position < signal.size())
+    {
+        pitch.push(signal.data() + position, kVadFrame);
+        position += kVadFrame;
+        const size_t entry = position / (2 * kSegment);
+        const size_t onset = (2 * entry + 1) * kSegment;
+        if (position > onset && static_cast<int>(entry) == detected && pitch.latestEstimate().confidence >= kDetectConfidence)
+        {
+            totalMs += 1000.0 * static_cast<double>(position - onset) / kModelRate;
+            ++detected;
+        }
+    }
+    return detected == kEntries ? totalMs / kEntries : -1.0;
+}
+
+// CPU per 10 ms of audio for a hop setting, with its latency-to-detect alongside.
+void pitchSlidingWindow(State& state, double hopMs)
+{
+    const auto& voice = demoAudio(kDemoGuide, kModelRate);
+    if (!haveAudio(state, voice, kPitchHop))
+    {
+        return;
+    }
+    const auto hopSamples = static_cast<size_t>(hopMs * kModelRate / 1000.0);
+    dsp::PitchProcessor pitch(ortEnvironment());
+    pitch.loadModel(benchConfig().pitchModelPath);
+    pitch.setHopSamples(hopSamples);
+    BlockCursor cursor(voice, kVadFrame);
+    size_t windows = 0;
+    state.setAudioPerIteration(kVadFrame, kModelRate);
+    while (state.keepRunning())
+    {
+        windows += pitch.push(cursor.next(), kVadFrame);
+        doNotOptimize(pitch.latestEstimate().confidence);
+    }
+    state.setCounter("windows_per_second", static_cast<double>(windows) * kModelRate / (static_cast<double>(state.iterations()) * kVadFrame));
+    state.setCounter("detect_latency_ms", pitchDetectLatencyMs(hopSamples));
+    state.setCounter("inference_skipped_percent", pitch.inferenceSkippedPercent());
+}
+
+// Session start-up through dsp::ModelStore. Sessions are kept open, so the counters show the
+// resident memory of the first session against each one after it, which shares the mapped
+// model and the prepacked weights.
+template <typename Processor>
+void openSession(State& state, const std::string& modelPath)
+{
+#if TUNETRIX_ONNX_RUNTIME
+    std::vector<std::unique_ptr<Processor>> sessions;
+    const double before = residentBytes();
+    double afterFirst = before;
+    while (state.keepRunning())
+    {
+        sessions.push_back(std::make_unique<Processor>(ortEnvironment()));
+        sessions.back()->loadModel(modelPath);
+        if (sessions.size() == 1)
+        {
+            state.pauseTiming();
+            afterFirst = residentBytes();
+            state.resumeTiming();
+        }
+    }
+    const double after = residentBytes();
+    state.setCounter("sessions", static_cast<double>(sessions.size()));
+    state.setCounter("rss_first_session_kb", (afterFirst - before) / 1024.0);
+    if (sessions.size() > 1)
+    {
+        state.setCounter("rss_per_extra_session_kb", (after - afterFirst) / 1024.0 / static_cast<double>(sessions.size() - 1));
+    }
+#else
+    (void)modelPath;
+    state.skipWithError("built without ONNX Runtime");
+#endif
+}
+
+void calibratorProcessBlock(State& state)
+{
+    const auto& voice = demoAudio(kDemoGuide, kDeviceRate);
+    if (!haveAudio(state, voice, kBlock))
+    {
+        return;
+    }
+    calibration::Calibrator calibrator;
+    // Long enough that the pass never completes inside a run.
+    calibrator.start(kDeviceRate, 3600.0f);
+    BlockCursor cursor(voice, kBlock);
+    state.setAudioPerIteration(kBlock, kDeviceRate);
+    while (state.keepRunning())
+    {
+        calibrator.processBlock(cursor.next(), kBlock);
+    }
+}
+
+std::vector<float> sine(double hz, double sampleRate, size_t length)
+{
+    std::vector<float> signal(length);
+    for (size_t i = 0; i < length; ++i)
+    {
+        signal[i] = static_cast<float>(0.5 * std::sin(2.0 * kPi * hz * static_cast<double>(i) / sampleRate));
+    }
+    return signal;
+}
+
+double rms(const float* samples, size_t count)
+{
+    double sum = 0.0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        sum += static_cast<double>(samples[i]) * samples[i];
+    }
+    return std::sqrt(sum / static_cast<double>(std::max<size_t>(count, 1)));
+}
+
+// Residual against the best-fitting sine at hz, in dB below it, so gain and delay don't count.
+double toneSnrDb(const float* samples, size_t count, double hz, double sampleRate)
+{
+    double ss = 0.0, sc = 0.0, cc = 0.0, ys = 0.0, yc = 0.0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        const double phase = 2.0 * kPi * hz * static_cast<double>(i) / sampleRate;
+        const double s = std::sin(phase);
+        const double c = std::cos(phase);
+        ss += s * s;
+        sc += s * c;
+        cc += c * c;
+        ys += s * samples[i];
+        yc += c * samples[i];
+    }
+    const double det = ss * cc - sc * sc;
+    const double a = (ys * cc - yc * sc) / det;
+    const double b = (ss * yc - sc * ys) / det;
+
+    double signal = 0.0;
+    double error = 0.0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        const double phase = 2.0 * kPi * hz * static_cast<double>(i) / sampleRate;
+        const double model = a * std::sin(phase) + b * std::cos(phase);
+        signal += model * model;
+        error += (samples[i] - model) * (samples[i] - model);
+    }
+    return 10.0 * std::log10(signal / std::max(error, 1.0e-20));
+}
+
+// One second of a tone streamed through the model feed in blocks; returns the output after
+// the filter has settled.
+std::vector<float> streamTone(dsp::ResamplerQuality quality, double hz)
+{
+    const auto input = sine(hz, kDeviceRate, static_cast<size_t>(kDeviceRate));
+    dsp::Resampler resampler;
+    resampler.prepare(kDeviceRate, kModelRate, quality, kBlock);
+    std::vector<float> output(dsp::Resampler::outputLength(input.size(), kDeviceRate, kModelRate) + kBlock);
+    size_t produced = 0;
+    for (size_t position = 0; position + kBlock <= input.size(); position += kBlock)
+    {
+        produced += resampler.process(input.data() + position, kBlock, output.data() + produced, output.size() - produced);
+    }
+    const size_t settle = std::min(produced, resampler.latencySamples() + static_cast<size_t>(kModelRate / 10.0));
+    return {output.begin() + static_cast<std::ptrdiff_t>(settle), output.begin() + static_cast<std::ptrdiff_t>(produced)};
+}
+
+void resamplerProcess(State& state, dsp::ResamplerQuality quality)
+{
+    const auto& voice = demoAudio(kDemoGuide, kDeviceRate);
+    if (!haveAudio(state, voice, kBlock))
+    {
+        return;
+    }
+    dsp::Resampler resampler;
+    resampler.prepare(kDeviceRate, kModelRate, quality, kBlock);
+    std::vector<float> output(kBlock);
+    BlockCursor cursor(voice, kBlock);
+    state.setAudioPerIteration(kBlock, kDeviceRate);
+    while (state.keepRunning())
+    {
+        doNotOptimize(resampler.process(cursor.next(), kBlock, output.data(), output.size()));
+    }
+
+    // Quality alongside the cost: a tone in the passband, and one above the 8 kHz output
+    // Nyquist that should not fold back down (11 kHz would alias to 5 kHz).
+    const auto passband = streamTone(quality, kToneHz);
+    const auto stopband = streamTone(quality, 11000.0);
+    state.setCounter("snr_db", toneSnrDb(passband.data(), passband.size(), kToneHz, kModelRate));
+    state.setCounter("alias_rejection_db", 20.0 * std::log10(0.5 / std::sqrt(2.0) / std::max(rms(stopband.data(), stopband.size()), 1.0e-10)));
+}
+
+// A whole stem converted from 44.1 kHz to the device rate, as the stem loader does at load.
+void resamplerRender(State& state, dsp::ResamplerQuality quality)
+{
+    const auto& stem = demoAudio(kDemoGuide, kStemRate);
+    if (!haveAudio(state, stem, kBlock))
+    {
+        return;
+    }
+    dsp::Resampler resampler;
+    resampler.prepare(kStemRate, kDeviceRate, quality, 0);
+    std::vector<float> output(dsp::Resampler::outputLength(stem.size(), kStemRate, kDeviceRate));
+    state.setAudioPerIteration(stem.size(), kStemRate);
+    while (state.keepRunning())
+    {
+        resampler.render(stem.data(), stem.size(), output.data(), 0, output.size());
+        doNotOptimize(output[0]);
+    }
+
+    // The same conversion of a one-second tone, with the filter's edges left out.
+    const auto tone = sine(kStemToneHz, kStemRate, static_cast<size_t>(kStemRate));
+    std::vector<float> converted(dsp::Resampler::outputLength(tone.size(), kStemRate, kDeviceRate));
+    resampler.render(tone.data(), tone.size(), converted.data(), 0, converted.size());
+    const size_t edge = static_cast<size_t>(kDeviceRate / 10.0);
+    state.setCounter("snr_db", toneSnrDb(converted.data() + edge, converted.size() - 2 * edge, kStemToneHz, kDeviceRate));
+}
+
+void phraseTrackerProcess(State& state)
+{
+    const auto& guide16k = demoAudio(kDemoGuide, kModelRate);
+    const auto& voice = demoAudio(kDemoGuide, kDeviceRate);
+    if (!haveAudio(state, voice, kBlock))
+    {
+        return;
+    }
+    dsp::FeatureExtractor extractor;
+    extractor.prepare(kModelRate);
+    const auto track = extractor.analyseGuide(guide16k.data(), guide16k.size());
+
+    // Sung against itself, so the aligner follows the diagonal as it would with a good singer.
+    // Timed with the pipeline's model feed in front of it.
+    dsp::Resampler feed;
+    feed.prepare(kDeviceRate, kModelRate, dsp::ResamplerQuality::SincFast, kBlock);
+    std::vector<float> decimated(dsp::Resampler::outputLength(kBlock, kDeviceRate, kModelRate) + 1);
+    dsp::PhraseTracker tracker;
+    tracker.prepare(kDeviceRate, kModelRate, feed.latencySamples());
+    tracker.setReference(&track);
+    BlockCursor cursor(voice, kBlock);
+    state.setAudioPerIteration(kBlock, kDeviceRate);
+    while (state.keepRunning())
+    {
+        const size_t produced = feed.process(cursor.next(), kBlock, decimated.data(), decimated.size());
+        tracker.push(decimated.data(), produced);
+        doNotOptimize(tracker.process(true, static_cast<int64_t>(cursor.position())));
+    }
+}
+
+// The stage mic with nobody singing: instrument and guide bleed in through a short room path
+// (direct sound at 2.5 ms, one reflection at 11 ms) over a little seeded noise. The reference
+// is the mix the outputs played.
+struct BleedSet
+{
+    std::vector<float> mic;
+    std::vector<float> reference;
+};
+
+BleedSet makeBleedSet(const std::vector<float>& backing, const std::vector<float>& guide, double seconds)
+{
+    const auto direct = static_cast<size_t>(0.0025 * kDeviceRate);
+    const auto reflection = static_cast<size_t>(0.011 * kDeviceRate);
+    const size_t length = std::min({backing.size(), guide.size(), static_cast<size_t>(seconds * kDeviceRate)});
+    BleedSet set;
+    set.reference.resize(length);
+    set.mic.resize(length);
+    for (size_t i = 0; i < length; ++i)
+    {
+        set.reference[i] = backing[i] + guide[i];
+    }
+    uint32_t seed = 0x2545f491u;
+    for (size_t i = 0; i < length; ++i)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        const float noise = 0.001f * (static_cast<float>(seed >> 8) / 8388608.0f - 1.0f);
+        const float early = i >= direct ? set.reference[i - direct] : 0.0f;
+        const float late = i >= reflection ? set.reference[i - reflection] : 0.0f;
+        set.mic[i] = 0.3f * early + 0.12f * late + noise;
+    }
+    return set;
+}
+
+// Share of blocks, after the first kBleedSettleSeconds, in which the gate is open (the guide
+// within kOpenDb of full level) on a mic that only carries bleed. The models and the gate
+// run as configured, through the same trace the GateTuner replays.
+double falseOpenPercent(const BleedSet& set, bool cancel)
+{
+    constexpr float kOpenDb = -12.0f;
+    constexpr double kBleedSettleSeconds = 2.0;
+
+    std::vector<float> mic = set.mic;
+    if (cancel)
+    {
+        dsp::BleedCanceller canceller;
+        canceller.prepare(64, static_cast<size_t>(0.1 * kDeviceRate), kBlock);
+        for (size_t position = 0; position + kBlock <= mic.size(); position += kBlock)
+        {
+            canceller.process(set.mic.data() + position, mic.data() + position, kBlock);
+            canceller.pushReference(set.reference.data() + position, kBlock);
+        }
+    }
+
+    const auto& config = benchConfig();
+    dsp::VadProcessor vad(ortEnvironment());
+    vad.loadModel(config.vadModelPath);
+    vad.setModelSampleRate(static_cast<int64_t>(kModelRate));
+    dsp::PitchProcessor pitch(ortEnvironment());
+    pitch.loadModel(config.pitchModelPath);
+    pitch.setHopSamples(config.pitchHopSamples());
+    const auto trace = tools::buildTrace(mic.data(), mic.size(), kDeviceRate, kBlock, kModelRate, vad, pitch, {});
+
+    dsp::GateConfig gateConfig;
+    gateConfig.lookAheadMs = config.gate.lookAheadMs;
+    gateConfig.attackMs = config.gate.attackMs;
+    gateConfig.releaseMs = config.gate.releaseMs;
+    gateConfig.holdMs = config.gate.holdMs;
+    gateConfig.thresholdOn = config.gate.thresholdOn;
+    gateConfig.thresholdOff = config.gate.thresholdOff;
+    gateConfig.framesOn = config.gate.framesOn;
+    gateConfig.framesOff = config.gate.framesOff;
+    gateConfig.duckDb = config.gate.duckDb;
+    dsp::ConfidenceGate gate;
+    gate.configure(static_cast<float>(kDeviceRate), kBlock, gateConfig);
+    gate.setPitchFrames(true, config.weights.vad, config.weights.pitch);
+
+    const auto settleBlocks = static_cast<size_t>(kBleedSettleSeconds / trace.blockSeconds);
+    size_t counted = 0;
+    size_t open = 0;
+    for (size_t b = 0; b < trace.vad.size(); ++b)
+    {
+        const float confidence = std::clamp(config.weights.vad * trace.vad[b] + config.weights.pitch * trace.pitch[b], 0.0f, 1.0f);
+        if (trace.pitchFrameEnd[b] != 0)
+        {
+            gate.pushPitchFrame(trace.pitch[b], trace.pitchFrameEnd[b]);
+        }
+        const float gainDb = gate.update(confidence, trace.vad[b], trace.pitch[b]);
+        if (b >= settleBlocks)
+        {
+            ++counted;
+            open += gainDb >= kOpenDb ? 1 : 0;
+        }
+    }
+    return counted > 0 ? 100.0 * static_cast<double>(open) / static_cast<double>(counted) : 0.0;
+}
+
+void bleedCancellerProcess(State& state)
+{
+    const auto& voice = demoAudio(kDemoGuide, kDeviceRate);
+    const auto& backing = demoAudio(kDemoInstrument, kDeviceRate);
+    if (!haveAudio(state, voice, kBlock) || !haveAudio(state, backing, kBlock))
+    {
+        return;
+    }
+    dsp::BleedCanceller canceller;
+    // 100 ms of echo path in 64-sample partitions, as configured for the stage preset.
+    canceller.prepare(64, static_cast<size_t>(0.1 * kDeviceRate), kBlock);
+    std::vector<float> mic(kBlock);
+    std::vector<float> output(kBlock);
+    BlockCursor voiceCursor(voice, kBlock);
+    BlockCursor backingCursor(backing, kBlock);
+    state.setAudioPerIteration(kBlock, kDeviceRate);
+    while (state.keepRunning())
+    {
+        const float* singer = voiceCursor.next();
+        const float* reference = backingCursor.next();
+        for (size_t i = 0; i < kBlock; ++i)
+        {
+            mic[i] = singer[i] + 0.3f * reference[i];
+        }
+        canceller.process(mic.data(), output.data(), kBlock);
+        canceller.pushReference(reference, kBlock);
+        doNotOptimize(output[0]);
+    }
+    state.setCounter("erle_db", canceller.erleDb());
+
+    const auto bleed = makeBleedSet(backing, voice, 30.0);
+    state.setCounter("false_open_percent_off", falseOpenPercent(bleed, false));
+    state.setCounter("false_open_percent_on", falseOpenPercent(bleed, true));
+}
+
+// A harmonic tone whose partials up to 4 kHz follow one vocal-like resonance, so a shifter
+// that keeps the formants leaves each shifted partial on the same curve.
+constexpr double kShiftToneHz = 220.0;
+constexpr double kFormantHz = 900.0;
+constexpr double kFormantQ = 3.0;
+constexpr double kMaxPartialHz = 4000.0;
+
+double formantGain(double hz)
+{
+    const double x = hz / kFormantHz;
+    return 1.0 / std::sqrt((1.0 - x * x) * (1.0 - x * x) + (x / kFormantQ) * (x / kFormantQ));
+}
+
+std::vector<float> formantTone(size_t silence, size_t length)
+{
+    std::vector<float> signal(length, 0.0f);
+    for (double partial = kShiftToneHz; partial < kMaxPartialHz; partial += kShiftToneHz)
+    {
+        const double gain = 0.05 * formantGain(partial);
+        for (size_t i = silence; i < length; ++i)
+        {
+            signal[i] += static_cast<float>(gain * std::sin(2.0 * kPi * partial * static_cast<double>(i - silence) / kDeviceRate));
+        }
+    }
+    return signal;
+}
+
+// Runs a signal through the shifter as the guide bus does, with the period known from the
+// first voiced sample on.
+std::vector<float> shifted(const std::vector<float>& input, size_t voicedFrom, double ratio)
+{
+    dsp::PitchShifter shifter;
+    shifter.prepare(kDeviceRate, kBlock);
+    shifter.setRatio(ratio);
+    std::vector<float> output(input.size(), 0.0f);
+    for (size_t position = 0; position + kBlock <= input.size(); position += kBlock)
+    {
+        shifter.setPeriod(position + kBlock > voicedFrom ? kDeviceRate / kShiftToneHz : 0.0);
+        shifter.process(input.data() + position, output.data() + position, kBlock);
+    }
+    return output;
+}
+
+// Hann-windowed amplitude of the component at hz.
+double amplitudeAt(const float* samples, size_t count, double hz)
+{
+    double re = 0.0;
+    double im = 0.0;
+    double windowSum = 0.0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        const double window = 0.5 - 0.5 * std::cos(2.0 * kPi * static_cast<double>(i) / static_cast<double>(count));
+        const double phase = 2.0 * kPi * hz * static_cast<double>(i) / kDeviceRate;
+        re += window * samples[i] * std::cos(phase);
+        im -= window * samples[i] * std::sin(phase);
+        windowSum += window;
+    }
+    return 2.0 * std::sqrt(re * re + im * im) / windowSum;
+}
+
+// Fundamental from the autocorrelation peak within a quarter of the expected period,
+// refined by a parabola through the peak.
+double measuredPitchHz(const float* samples, size_t count, double expectedHz)
+{
+    const double expected = kDeviceRate / expectedHz;
+    const auto minLag = static_cast<size_t>(expected * 0.8);
+    const auto maxLag = static_cast<size_t>(expected * 1.25) + 1;
+    std::vector<double> correlation(maxLag + 2, 0.0);
+    for (size_t lag = minLag - 1; lag <= maxLag + 1; ++lag)
+    {
+        for (size_t i = 0; i + maxLag + 1 < count; ++i)
+        {
+            correlation[lag] += static_cast<double>(samples[i]) * samples[i + lag];
+        }
+    }
+    size_t best = minLag;
+    for (size_t lag = minLag; lag <= maxLag; ++lag)
+    {
+        best = correlation[lag] > correlation[best] ? lag : best;
+    }
+    const double left = correlation[best - 1];
+    const double centre = correlation[best];
+    const double right = correlation[best + 1];
+    const double curvature = left - 2.0 * centre + right;
+    const double offset = curvature < 0.0 ? 0.5 * (left - right) / curvature : 0.0;
+    return kDeviceRate / (static_cast<double>(best) + offset);
+}
+
+// Time after from at which a sliding 1 ms RMS first reaches fraction of the steady level.
+double riseMs(const std::vector<float>& signal, size_t from, double steady, double fraction)
+{
+    const auto window = static_cast<size_t>(kDeviceRate / 1000.0);
+    for (size_t end = from; end <= signal.size(); end += window / 8)
+    {
+        if (rms(signal.data() + end - window, window) >= fraction * steady)
+        {
+            return 1000.0 * static_cast<double>(end - from) / kDeviceRate;
+        }
+    }
+    return -1.0;
+}
+
+// Artefacts of a shift by ratio on the formant tone, measured once the ratio has settled:
+// pitch error in cents, the partials' worst departure from the formant curve (after the
+// overall level change is taken out) and the level change, both in dB.
+struct ShiftArtefacts
+{
+    double pitchErrorCents;
+    double formantErrorDb;
+    double levelChangeDb;
+};
+
+ShiftArtefacts shiftArtefacts(double ratio)
+{
+    const auto length = static_cast<size_t>(1.5 * kDeviceRate);
+    const auto settled = static_cast<size_t>(kDeviceRate);
+    const auto input = formantTone(0, length);
+    const auto output = shifted(input, 0, ratio);
+    const float* tail = output.data() + settled;
+    const size_t count = length - settled;
+
+    ShiftArtefacts artefacts{};
+    const double targetHz = kShiftToneHz * ratio;
+    artefacts.pitchErrorCents = 1200.0 * std::log2(measuredPitchHz(tail, count, targetHz) / targetHz);
+    artefacts.levelChangeDb = 20.0 * std::log10(rms(tail, count) / rms(input.data() + settled, count));
+
+    std::vector<double> deviations;
+    for (double partial = targetHz; partial < kMaxPartialHz; partial += targetHz)
+    {
+        const double level = 20.0 * std::log10(std::max(amplitudeAt(tail, count, partial), 1.0e-9));
+        deviations.push_back(level - 20.0 * std::log10(0.05 * formantGain(partial)));
+    }
+    double mean = 0.0;
+    for (const double deviation : deviations)
+    {
+        mean += deviation / static_cast<double>(deviations.size());
+    }
+    for (const double deviation : deviations)
+    {
+        artefacts.formantErrorDb = std::max(artefacts.formantErrorDb, std::abs(deviation - mean));
+    }
+    return artefacts;
+}
+
+// How much longer the shifted tone takes than the input to rise from 10% to 90% of its
+// steady level after an abrupt entry out of silence.
+double transientSmearMs(double ratio)
+{
+    const auto silence = static_cast<size_t>(0.25 * kDeviceRate);
+    const auto length = static_cast<size_t>(kDeviceRate);
+    const auto input = formantTone(silence, length);
+    const auto output = shifted(input, silence, ratio);
+    const auto steadyFrom = length - static_cast<size_t>(0.25 * kDeviceRate);
+    const double inputSteady = rms(input.data() + steadyFrom, length - steadyFrom);
+    const double outputSteady = rms(output.data() + steadyFrom, length - steadyFrom);
+    const double inputRise = riseMs(input, silence, inputSteady, 0.9) - riseMs(input, silence, inputSteady, 0.1);
+    const double outputRise = riseMs(output, silence, outputSteady, 0.9) - riseMs(output, silence, outputSteady, 0.1);
+    return outputRise - inputRise;
+}
+
+void pitchShifterProcess(State& state)
+{
+    const auto& voice = demoAudio(kDemoGuide, kDeviceRate);
+    if (!haveAudio(state, voice, kBlock))
+    {
+        return;
+    }
+    dsp::PitchShifter shifter;
+    shifter.prepare(kDeviceRate, kBlock);
+    shifter.setPeriod(kDeviceRate / 220.0);
+    std::vector<float> output(kBlock);
+    BlockCursor cursor(voice, kBlock);
+    state.setAudioPerIteration(kBlock, kDeviceRate);
+    size_t block = 0;
+    while (state.keepRunning())
+    {
+        // Keep the ratio moving so grain spacing and smoothing are exercised.
+        shifter.setRatio((block++ & 256) != 0 ? 1.26 : 0.84);
+        shifter.process(cursor.next(), output.data(), kBlock);
+        doNotOptimize(output[0]);
+    }
+
+    // Worst case over shifts down and up by up to an octave.
+    double pitchErrorCents = 0.0;
+    double formantErrorDb = 0.0;
+    double levelChangeDb = 0.0;
+    double transientMs = 0.0;
+    for (const double ratio : {0.5, 0.84, 1.26, 2.0})
+    {
+        const auto artefacts = shiftArtefacts(ratio);
+        pitchErrorCents = std::max(pitchErrorCents, std::abs(artefacts.pitchErrorCents));
+        formantErrorDb = std::max(formantErrorDb, artefacts.formantErrorDb);
+        levelChangeDb = std::abs(artefacts.levelChangeDb) > std::abs(levelChangeDb) ? artefacts.levelChangeDb : levelChangeDb;
+        transientMs = std::max(transientMs, transientSmearMs(ratio));
+    }
+    state.setCounter("pitch_error_cents", pitchErrorCents);
+    state.setCounter("formant_error_db", formantErrorDb);
+    state.setCounter("level_change_db", levelChangeDb);
+    state.setCounter("transient_smear_ms", transientMs);
+}
+
+void fdnReverbProcess(State& state)
+{
+    const auto& voice = demoAudio(kDemoGuide, kDeviceRate);
+    if (!haveAudio(state, voice, kBlock))
+    {
+        return;
+    }
+    dsp::FdnReverb reverb;
+    reverb.setTail(0.1f, 2.0f);
+    reverb.prepare(kDeviceRate);
+    std::vector<float> left(kBlock);
+    std::vector<float> right(kBlock);
+    BlockCursor cursor(voice, kBlock);
+    state.setAudioPerIteration(kBlock, kDeviceRate);
+    while (state.keepRunning())
+    {
+        std::fill(left.begin(), left.end(), 0.0f);
+        std::fill(right.begin(), right.end(), 0.0f);
+        reverb.process(cursor.next(), left.data(), right.data(), kBlock);
+        doNotOptimize(left[0]);
+    }
+}
+
+void timbreMatcherProcess(State& state)
+{
+    const auto& voice = demoAudio(kDemoGuide, kDeviceRate);
+    const auto& backing = demoAudio(kDemoInstrument, kDeviceRate);
+    if (!haveAudio(state, voice, kBlock) || !haveAudio(state, backing, kBlock))
+    {
+        return;
+    }
+    dsp::TimbreMatcher matcher;
+    matcher.prepare(kDeviceRate);
+    std::vector<float> output(kBlock);
+    BlockCursor voiceCursor(voice, kBlock);
+    BlockCursor micCursor(backing, kBlock);
+    state.setAudioPerIteration(kBlock, kDeviceRate);
+    while (state.keepRunning())
+    {
+        matcher.pushMic(micCursor.next(), kBlock);
+        matcher.process(voiceCursor.next(), output.data(), kBlock);
+        doNotOptimize(output[0]);
+    }
+}
+
+void asrcBridgePushPull(State& state)
+{
+    const auto& voice = demoAudio(kDemoGuide, kDeviceRate);
+    if (!haveAudio(state, voice, kBlock))
+    {
+        return;
+    }
+    // A 44.1 kHz input on its own clock feeding the 48 kHz output, timestamps simulated.
+    constexpr double kInputRate = 44100.0;
+    constexpr size_t kInputBlock = 118;
+    dsp::AsrcBridge bridge;
+    bridge.prepare(kInputRate, kDeviceRate, kInputBlock, kBlock, 480);
+    std::vector<float> output(kBlock);
+    BlockCursor cursor(voice, kInputBlock);
+    double inputTime = 0.0;
+    double outputTime = 0.0;
+    state.setAudioPerIteration(kBlock, kDeviceRate);
+    while (state.keepRunning())
+    {
+        while (inputTime <= outputTime)
+        {
+            inputTime += static_cast<double>(kInputBlock) / kInputRate;
+            bridge.push(cursor.next(), kInputBlock, inputTime);
+        }
+        outputTime += static_cast<double>(kBlock) / kDeviceRate;
+        bridge.pull(output.data(), kBlock, outputTime);
+        doNotOptimize(output[0]);
+    }
+    state.setCounter("underruns", bridge.underruns());
+}
+
+// Eight stereo buses across sixteen outputs, each taking the mix, guide, instrument and mic
+// the way PipelineProcessor routes them, with the guide gains moving as they do under the gate.
+void routingMatrixProcess(State& state)
+{
+    constexpr size_t kSources = 7;
+    constexpr size_t kOutputs = dsp::RoutingMatrix::kMaxOutputs;
+    const auto& voice = demoAudio(kDemoGuide, kDeviceRate);
+    if (!haveAudio(state, voice, kBlock))
+    {
+        return;
+    }
+    dsp::RoutingMatrix matrix;
+    std::vector<size_t> guideRoutes;
+    for (size_t output = 0; output < kOutputs; ++output)
+    {
+        const size_t side = output % 2;
+        matrix.addRoute(side, output, 1.0f);
+        matrix.addRoute(2, output, 0.7f);
+        guideRoutes.push_back(matrix.addRoute(3 + side, output, 0.5f));
+        matrix.addRoute(5 + side, output, 0.5f);
+    }
+    std::vector<std::vector<float>> outputs(kOutputs, std::vector<float>(kBlock));
+    std::vector<float*> outputPointers;
+    for (auto& output : outputs)
+    {
+        outputPointers.push_back(output.data());
+    }
+    const float* sources[kSources] = {};
+    BlockCursor cursor(voice, kBlock);
+    size_t block = 0;
+    state.setAudioPerIteration(kBlock, kDeviceRate);
+    while (state.keepRunning())
+    {
+        std::fill(std::begin(sources), std::end(sources), cursor.next());
+        const float gain = (block++ & 64) != 0 ? 0.5f : 0.1f;
+        for (const size_t route : guideRoutes)
+        {
+            matrix.setGain(route, gain);
+        }
+        matrix.process(sources, kSources, outputPointers.data(), kOutputs, kBlock);
+        doNotOptimize(outputs[kOutputs - 1][0]);
+    }
+    state.setCounter("routes", static_cast<double>(matrix.numRoutes()));
+}
+
+// One level-0 bin per 32 samples, as the stem loader builds it.
+constexpr size_t kOverviewBaseBin = 32;
+constexpr size_t kOverviewPixels = 1920;
+
+void waveformPyramidBuild(State& state)
+{
+    const auto& voice = demoAudio(kDemoGuide, kDeviceRate);
+    if (!haveAudio(state, voice, kBlock))
+    {
+        return;
+    }
+    dsp::WaveformPyramid pyramid;
+    state.setAudioPerIteration(voice.size(), kDeviceRate);
+    while (state.keepRunning())
+    {
+        pyramid.build(voice.data(), voice.size(), kDeviceRate, kOverviewBaseBin);
+        doNotOptimize(pyramid.numLevels());
+    }
+    state.setCounter("levels", static_cast<double>(pyramid.numLevels()));
+    state.setCounter("memory_percent_of_audio",
+                     100.0 * static_cast<double>(pyramid.memoryBytes()) / static_cast<double>(voice.size() * sizeof(float)));
+}
+
+// One repaint of a full-width lane, cycling from the whole stem down to a few milliseconds.
+void waveformPyramidRender(State& state)
+{
+    const auto& voice = demoAudio(kDemoGuide, kDeviceRate);
+    if (!haveAudio(state, voice, kBlock))
+    {
+        return;
+    }
+    dsp::WaveformPyramid pyramid;
+    pyramid.build(voice.data(), voice.size(), kDeviceRate, kOverviewBaseBin);
+    const double duration = static_cast<double>(voice.size()) / kDeviceRate;
+    std::vector<dsp::PyramidBin> pixels(kOverviewPixels);
+    double span = duration;
+    while (state.keepRunning())
+    {
+        pyramid.render(0.0, span, pixels.data(), pixels.size(), voice.data());
+        doNotOptimize(pixels[0]);
+        span = span > 0.005 ? span * 0.5 : duration;
+    }
+}
+} // namespace
+
+std::vector<Benchmark> dspBenchmarks()
+{
+    return {
+        {"ConfidenceGate/update", confidenceGateUpdate},
+        {"VadProcessor/processFrame/160", vadProcessFrame},
+        {"PitchProcessor/processHop/1024", pitchProcessHop},
+        {"VadProcessor/loadModel", [](State& state) { openSession<dsp::VadProcessor>(state, benchConfig().vadModelPath); }},
+        {"PitchProcessor/push/10ms", [](State& state) { pitchSlidingWindow(state, 10.0); }},
+        {"PitchProcessor/push/16ms", [](State& state) { pitchSlidingWindow(state, 16.0); }},
+        {"PitchProcessor/push/32ms", [](State& state) { pitchSlidingWindow(state, 32.0); }},
+        {"PitchProcessor/push/64ms", [](State& state) { pitchSlidingWindow(state, 64.0); }},
+        {"PitchProcessor/loadModel", [](State& state) { openSession<dsp::PitchProcessor>(state, benchConfig().pitchModelPath); }},
+        {"Calibrator/processBlock/128", calibratorProcessBlock},
+        {"Resampler/process/lagrange/128", [](State& state) { resamplerProcess(state, dsp::ResamplerQuality::Lagrange); }},
+        {"Resampler/process/sinc-fast/128", [](State& state) { resamplerProcess(state, dsp::ResamplerQuality::SincFast); }},
+        {"Resampler/process/sinc-best/128", [](State& state) { resamplerProcess(state, dsp::ResamplerQuality::SincBest); }},
+        {"Resampler/render/44.1k-48k/lagrange", [](State& state) { resamplerRender(state, dsp::ResamplerQuality::Lagrange); }},
+        {"Resampler/render/44.1k-48k/sinc-fast", [](State& state) { resamplerRender(state, dsp::ResamplerQuality::SincFast); }},
+        {"Resampler/render/44.1k-48k/sinc-best", [](State& state) { resamplerRender(state, dsp::ResamplerQuality::SincBest); }},
+        {"PhraseTracker/process/128", phraseTrackerProcess},
+        {"BleedCanceller/process/128", bleedCancellerProcess},
+        {"PitchShifter/process/128", pitchShifterProcess},
+        {"FdnReverb/process/128", fdnReverbProcess},
+        {"TimbreMatcher/process/128", timbreMatcherProcess},
+        {"AsrcBridge/pushPull/128", asrcBridgePushPull},
+        {"RoutingMatrix/process/16ch/128", routingMatrixProcess},
+        {"WaveformPyramid/build", waveformPyramidBuild},
+        {"WaveformPyramid/render/1920", waveformPyramidRender},
+    };
+}
+} // namespace singwithme::bench
@@ -0,0 +1,88 @@
+#include "Fixtures.h"
+
+#include <map>
+#include <mutex>
+#include <utility>
+
+#include <juce_audio_formats/juce_audio_formats.h>
+
+#if defined(_WIN32)
+ #include <windows.h>
+ #include <psapi.h>
+#elif defined(__APPLE__)
+ #include <mach/mach.h>
+#else
+ #include <fstream>
+ #include <unistd.h>
+#endif
+
+#include "dsp/ModelStore.h"
+#include "dsp/Resampler.h"
+
+namespace singwithme::bench
+{
+const config::RuntimeConfig& benchConfig()
+{
+    static const config::RuntimeConfig config = []
+    {
+        const auto path = juce::SystemStats::getEnvironmentVariable("TUNETRIX_CONFIG", "configs/defaults.json");
+        return config::ConfigLoader{}.loadFromFile(path.toStdString());
+    }();
+    return config;
+}
+
+Ort::Env& ortEnvironment()
+{
+    return dsp::sharedOrtEnvironment();
+}
+
+const std::vector<float>& demoAudio(const std::string& path, double sampleRate)
+{
+    static std::mutex mutex;
+    static std::map<std::pair<std::string, int>, std::vector<float>> cache;
+
+    const std::lock_guard<std::mutex> lock(mutex);
+    auto& samples = cache[{path, static_cast<int>(sampleRate)}];
+    if (!samples.empty())
+    {
+        return samples;
+    }
+
+    juce::AudioFormatManager formats;
+    formats.registerBasicFormats();
+    const std::unique_ptr<juce::AudioFormatReader> reader(formats.createReaderFor(juce::File::getCurrentWorkingDirectory().getChildFile(path)));
+    if (reader == nullptr || reader->lengthInSamples <= 0)
+    {
+        return samples;
+    }
+
+    const auto length = static_cast<int>(reader->lengthInSamples);
+    juce::AudioBuffer<float> buffer(1, length);
+    reader->read(&buffer, 0, length, 0, true, false);
+
+    dsp::Resampler resampler;
+    resampler.prepare(reader->sampleRate, sampleRate, dsp::ResamplerQuality::SincFast, 0);
+    samples.resize(dsp::Resampler::outputLength(static_cast<size_t>(length), reader->sampleRate, sampleRate));
+    resampler.render(buffer.getReadPointer(0), static_cast<size_t>(length), samples.data(), 0, samples.size());
+    return samples;
+}
+
+double residentBytes()
+{
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS counters{};
+    return GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)) ? static_cast<double>(counters.WorkingSetSize) : 0.0;
+#elif defined(__APPLE__)
+    mach_task_basic_info info{};
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+    const auto status = task_info(mach_task_self(), MACH_TASK_BASIC_INFO, reinterpret_cast<task_info_t>(&info), &count);
+    return status == KERN_SUCCESS ? static_cast<double>(info.resident_size) : 0.0;
+#else
+    std::ifstream statm("/proc/self/statm");
+    double pages = 0.0;
+    double resident = 0.0;
+    statm >> pages >> resident;
+    return resident * static_cast<double>(sysconf(_SC_PAGESIZE));
+#endif
+}
+} // namespace singwithme::bench
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "config/RuntimeConfig.h"
+#include "dsp/VadProcessor.h"
+
+namespace singwithme::bench
+{
+// Paths are relative to the repository root, which main() makes the working directory.
+const config::RuntimeConfig& benchConfig();
+Ort::Env& ortEnvironment();
+// Channel 0 of a bundled WAV at the given rate, decoded and resampled once per rate.
+const std::vector<float>& demoAudio(const std::string& path, double sampleRate);
+// The process's resident set size in bytes, or 0 where it cannot be read.
+double residentBytes();
+
+inline constexpr const char* kDemoGuide = "assets/audio/demo-guide.wav";
+inline constexpr const char* kDemoInstrument = "assets/audio/demo-instrument.wav";
+} // namespace singwithme::bench
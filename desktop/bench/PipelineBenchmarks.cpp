@@ -0,0 +1,188 @@
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include <juce_audio_devices/juce_audio_devices.h>
+
+#include "Bench.h"
+#include "Fixtures.h"
+#include "audio/PipelineProcessor.h"
+#include "trace/Tracer.h"
+
+namespace singwithme::bench
+{
+// Reaches the processor's private file helper, which has no public equivalent that does
+// not also make the result the current stem.
+struct PipelineProcessorAccess
+{
+    static bool loadAudioFile(audio::PipelineProcessor& processor,
+                              const std::string& path,
+                              juce::AudioBuffer<float>& destination,
+                              double targetSampleRate)
+    {
+        return processor.loadAudioFile(path, destination, targetSampleRate);
+    }
+};
+
+namespace
+{
+constexpr double kDeviceRate = 48000.0;
+// Region for the looped callback: 8192 samples one second in.
+constexpr int64_t kLoopStart = 48000;
+constexpr int64_t kLoopLength = 8192;
+
+dsp::GateConfig makeGateConfig(const config::GateParams& params)
+{
+    dsp::GateConfig gateConfig;
+    gateConfig.lookAheadMs = params.lookAheadMs;
+    gateConfig.attackMs = params.attackMs;
+    gateConfig.releaseMs = params.releaseMs;
+    gateConfig.holdMs = params.holdMs;
+    gateConfig.thresholdOn = params.thresholdOn;
+    gateConfig.thresholdOff = params.thresholdOff;
+    gateConfig.framesOn = params.framesOn;
+    gateConfig.framesOff = params.framesOff;
+    gateConfig.duckDb = params.duckDb;
+    gateConfig.predictiveOpen = params.predictiveOpen;
+    return gateConfig;
+}
+
+// What main() wires up, without a device: the processor is driven by hand at a fixed rate.
+struct PipelineFixture
+{
+    explicit PipelineFixture(size_t blockSize)
+        : vad(ortEnvironment()),
+          pitch(ortEnvironment())
+    {
+        runtimeConfig = benchConfig();
+        runtimeConfig.sampleRate = kDeviceRate;
+        runtimeConfig.bufferSamples = static_cast<int>(blockSize);
+        runtimeConfig.media.instrumentPath = kDemoInstrument;
+        runtimeConfig.media.guidePath = kDemoGuide;
+        runtimeConfig.setlist.songs.clear();
+
+        gate.configure(static_cast<float>(kDeviceRate), blockSize, makeGateConfig(runtimeConfig.gate));
+        vad.loadModel(runtimeConfig.vadModelPath);
+        pitch.loadModel(runtimeConfig.pitchModelPath);
+        processor.setOrtEnvironment(ortEnvironment());
+        processor.configure(runtimeConfig, gate, vad, pitch, calibrator);
+        processor.audioDeviceAboutToStart(nullptr);
+    }
+
+    ~PipelineFixture() { processor.audioDeviceStopped(); }
+
+    config::RuntimeConfig runtimeConfig;
+    dsp::ConfidenceGate gate;
+    dsp::VadProcessor vad;
+    dsp::PitchProcessor pitch;
+    calibration::Calibrator calibrator;
+    audio::PipelineProcessor processor;
+};
+
+void loadAudioFile(State& state)
+{
+    audio::PipelineProcessor processor;
+    juce::AudioBuffer<float> buffer;
+    while (state.keepRunning())
+    {
+        if (!PipelineProcessorAccess::loadAudioFile(processor, kDemoGuide, buffer, kDeviceRate))
+        {
+            state.skipWithError("cannot decode " + std::string(kDemoGuide));
+            return;
+        }
+        doNotOptimize(buffer.getNumSamples());
+    }
+    state.setCounter("decoded_samples", static_cast<double>(buffer.getNumSamples()));
+}
+
+enum class CallbackVariant
+{
+    Plain,
+    Traced,
+    Looped
+};
+
+// One device callback: the demo guide stands in for the singer, the demo stems play back.
+// The traced variant records to a Perfetto trace in the temp directory throughout; the
+// looped one rehearses a short region of the song and crosses its loop point every 64 blocks.
+void deviceCallback(State& state, size_t blockSize, CallbackVariant variant)
+{
+    const auto& voice = demoAudio(kDemoGuide, kDeviceRate);
+    if (voice.size() < blockSize)
+    {
+        state.skipWithError("demo audio not found; run from the repository root or pass --root");
+        return;
+    }
+
+    PipelineFixture fixture(blockSize);
+    std::vector<float> left(blockSize);
+    std::vector<float> right(blockSize);
+    float* outputs[] = {left.data(), right.data()};
+    const juce::AudioIODeviceCallbackContext context{};
+    size_t position = 0;
+
+    if (variant == CallbackVariant::Looped && !fixture.processor.setLoopRegion(kLoopStart, kLoopStart + kLoopLength))
+    {
+        state.skipWithError("demo song too short for the loop region");
+        return;
+    }
+    if (variant == CallbackVariant::Traced)
+    {
+#if TUNETRIX_TRACING
+        const auto path = std::filesystem::temp_directory_path() / "TuneTrixBench.pftrace";
+        if (!trace::Tracer::instance().start(path.string(), config::TraceConfig{}.eventsPerThread))
+        {
+            state.skipWithError("cannot write " + path.string());
+            return;
+        }
+#else
+        state.skipWithError("built without ENABLE_TRACING");
+        return;
+#endif
+    }
+
+    state.setAudioPerIteration(blockSize, kDeviceRate);
+    while (state.keepRunning())
+    {
+        if (position + blockSize > voice.size())
+        {
+            position = 0;
+        }
+        const float* inputs[] = {voice.data() + position};
+        position += blockSize;
+        fixture.processor.audioDeviceIOCallbackWithContext(inputs, 1, outputs, 2, static_cast<int>(blockSize), context);
+        doNotOptimize(left[0]);
+    }
+
+#if TUNETRIX_TRACING
+    if (variant == CallbackVariant::Traced)
+    {
+        auto& tracer = trace::Tracer::instance();
+        tracer.stop();
+        state.setCounter("dropped_events", static_cast<double>(tracer.droppedEvents()));
+    }
+#endif
+
+    const auto metrics = fixture.processor.getMetrics();
+    state.setCounter("vad_skipped_percent", metrics.vadSkippedPercent);
+    state.setCounter("pitch_skipped_percent", metrics.pitchSkippedPercent);
+}
+} // namespace
+
+std::vector<Benchmark> pipelineBenchmarks()
+{
+    std::vector<Benchmark> benchmarks{
+        {"PipelineProcessor/loadAudioFile", loadAudioFile},
+    };
+    for (const size_t blockSize : {64u, 128u, 256u, 512u})
+    {
+        benchmarks.push_back({"PipelineProcessor/audioDeviceIOCallback/" + std::to_string(blockSize),
+                              [blockSize](State& state) { deviceCallback(state, blockSize, CallbackVariant::Plain); }});
+    }
+    benchmarks.push_back({"PipelineProcessor/audioDeviceIOCallback/128/traced",
+                          [](State& state) { deviceCallback(state, 128, CallbackVariant::Traced); }});
+    benchmarks.push_back({"PipelineProcessor/audioDeviceIOCallback/128/looped",
+                          [](State& state) { deviceCallback(state, 128, CallbackVariant::Looped); }});
+    return benchmarks;
+}
+} // namespace singwithme::bench
@@ -0,0 +1,110 @@
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <juce_events/juce_events.h>
+
+#include "Bench.h"
+#include "dsp/Simd.h"
+
+#ifndef TUNETRIX_BENCH_ROOT
+ #define TUNETRIX_BENCH_ROOT "."
+#endif
+
+namespace
+{
+void printUsage()
+{
+    std::fprintf(stderr,
+                 "Usage: TuneTrixBench [--filter=<substring>] [--min-time=<seconds>] [--out=<file.json>] [--root=<repo>]\n"
+                 "Runs without an audio device; JSON goes to stdout unless --out is given.\n");
+}
+
+bool startsWith(const std::string& text, const char* prefix, std::string& rest)
+{
+    const std::string head(prefix);
+    if (text.rfind(head, 0) != 0)
+    {
+        return false;
+    }
+    rest = text.substr(head.size());
+    return true;
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+    singwithme::bench::RunOptions options;
+    std::string root = TUNETRIX_BENCH_ROOT;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg(argv[i]);
+        std::string value;
+        if (startsWith(arg, "--filter=", value))
+        {
+            options.filter = value;
+        }
+        else if (startsWith(arg, "--min-time=", value))
+        {
+            options.minSeconds = std::atof(value.c_str());
+        }
+        else if (startsWith(arg, "--out=", value))
+        {
+            options.outputPath = value;
+        }
+        else if (startsWith(arg, "--root=", value))
+        {
+            root = value;
+        }
+        else
+        {
+            printUsage();
+            return arg == "--help" ? 0 : 2;
+        }
+    }
+
+    // Config, model and demo paths are all relative to the repository root.
+    if (!options.outputPath.empty())
+    {
+        options.outputPath = std::filesystem::absolute(options.outputPath).string();
+    }
+    std::error_code error;
+    std::filesystem::current_path(root, error);
+    if (error)
+    {
+        std::fprintf(stderr, "Cannot enter %s: %s\n", root.c_str(), error.message().c_str());
+        return 2;
+    }
+
+    const juce::ScopedJuceInitialiser_GUI juce;
+
+    const std::map<std::string, std::string> context{
+#if TUNETRIX_ONNX_RUNTIME
+        {"inference", "onnx"},
+#else
+        {"inference", "stub"},
+#endif
+#if TUNETRIX_SIMD_AVX2
+        {"simd", "avx2"},
+#elif TUNETRIX_SIMD_NEON
+        {"simd", "neon"},
+#else
+        {"simd", "scalar"},
+#endif
+#ifdef NDEBUG
+        {"library_build_type", "release"},
+#else
+        {"library_build_type", "debug"},
+#endif
+    };
+
+    auto benchmarks = singwithme::bench::dspBenchmarks();
+    for (auto& benchmark : singwithme::bench::pipelineBenchmarks())
+    {
+        benchmarks.push_back(std::move(benchmark));
+    }
+    return singwithme::bench::runBenchmarks(benchmarks, context, options);
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+namespace singwithme::audio
+{
+// Fixed-capacity single-producer, single-consumer ring for handing small commands to and
+// from the audio thread. Neither side locks or allocates; several producers must serialise
+// among themselves.
+template <typename T, size_t Capacity>
+class CommandQueue
+{
+public:
+    // Producer side; false when the ring is full.
+    bool push(const T& item) noexcept
+    {
+        const size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_.load(std::memory_order_acquire) == Capacity)
+        {
+            return false;
+        }
+        items_[tail % Capacity] = item;
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side: the oldest item, valid until pop(); null when empty.
+    const T* front() const noexcept
+    {
+        const size_t head = head_.load(std::memory_order_relaxed);
+        return head == tail_.load(std::memory_order_acquire) ? nullptr : &items_[head % Capacity];
+    }
+
+    void pop() noexcept
+    {
+        head_.store(head_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+private:
+    std::array<T, Capacity> items_{};
+    alignas(64) std::atomic<size_t> head_{0};
+    alignas(64) std::atomic<size_t> tail_{0};
+};
+} // namespace singwithme::audio
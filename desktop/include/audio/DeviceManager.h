@@ -2,6 +2,8 @@
 
 #include <juce_audio_devices/juce_audio_devices.h>
 
+#include "audio/InputBridge.h"
+
 #include <vector>
 
 namespace singwithme::audio
@@ -12,7 +14,8 @@ public:
     DeviceManager();
     ~DeviceManager();
 
-    void initialise(double sampleRate, int bufferSize);
+    // Opens the default input and the first outputChannels outputs of the default device.
+    void initialise(double sampleRate, int bufferSize, int outputChannels);
     void shutdown();
 
     std::vector<juce::String> availableOutputDevices();
@@ -20,17 +23,31 @@ public:
     juce::String currentOutputDevice() const;
     juce::String currentInputDevice() const;
     bool setOutputDevice(const juce::String& deviceName);
+    // With bridging on, an input device other than the output device is opened on its own
+    // and drift-corrected through inputBridge(); otherwise JUCE combines the two.
     bool setInputDevice(const juce::String& deviceName);
+    void setInputBridging(bool enabled, float targetLatencyMs);
+    InputBridge& inputBridge() noexcept { return inputBridge_; }
     bool setBufferSize(int newBufferSize);
     double sampleRate() const noexcept { return sampleRate_; }
     int bufferSize() const noexcept { return bufferSize_; }
+    // Driver-reported input + output latency plus one block; a fallback until a loopback
+    // measurement exists for this device pair.
+    int reportedRoundTripSamples() const;
 
     juce::AudioDeviceManager& manager() noexcept { return deviceManager_; }
 
 private:
     void applyCurrentSettings();
+    // Re-reads the device's rate and block size and reopens the bridge for them, or closes
+    // it once the mic and the outputs are on the same device.
+    void followOutputDevice();
+    bool openBridgedInput(const juce::String& deviceName);
 
     juce::AudioDeviceManager deviceManager_;
+    InputBridge inputBridge_;
+    bool bridgeInput_{false};
+    float bridgeLatencyMs_{10.0f};
     double sampleRate_{48000.0};
     int bufferSize_{512};
 };
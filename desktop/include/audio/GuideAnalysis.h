@@ -0,0 +1,38 @@
+#pragma once
+
+#include <juce_audio_basics/juce_audio_basics.h>
+
+#include <memory>
+#include <string>
+
+#include "dsp/FeatureExtractor.h"
+#include "dsp/OnsetMap.h"
+#include "dsp/VadProcessor.h"
+#include "dsp/WaveformPyramid.h"
+
+namespace singwithme::audio
+{
+// Offline analysis of a guide stem, computed once when the stem is loaded and shared
+// read-only with the audio thread.
+struct GuideAnalysis
+{
+    dsp::GuideFeatureTrack features;
+    dsp::OnsetMap onsets;
+    // Overview lanes for the UI, one value per feature hop: the guide's pitch in semitones
+    // (NaN where unvoiced) and the voice activity the onset map and gate work from.
+    dsp::WaveformPyramid pitchLane;
+    dsp::WaveformPyramid activityLane;
+};
+
+struct GuideAnalysisSettings
+{
+    double sampleRate{48000.0};
+    double modelSampleRate{16000.0};
+    // Runs a private VAD instance over the stem when set; otherwise onsets come from energy alone.
+    Ort::Env* env{nullptr};
+    std::string vadModelPath;
+};
+
+std::shared_ptr<const GuideAnalysis> analyseGuide(const juce::AudioBuffer<float>& guide,
+                                                  const GuideAnalysisSettings& settings);
+} // namespace singwithme::audio
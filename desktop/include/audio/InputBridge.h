@@ -0,0 +1,52 @@
+#pragma once
+
+#include <juce_audio_devices/juce_audio_devices.h>
+
+#include "dsp/AsrcBridge.h"
+
+#include <atomic>
+#include <memory>
+
+namespace singwithme::audio
+{
+// Runs the mic on its own input-only device when it does not share a clock with the output
+// device. The input callback feeds a dsp::AsrcBridge; the output device's callback reads
+// drift-corrected samples at its own rate through read().
+class InputBridge : private juce::AudioIODeviceCallback
+{
+public:
+    ~InputBridge() override;
+
+    bool open(juce::AudioIODeviceType& type,
+              const juce::String& deviceName,
+              double outputSampleRate,
+              int outputBufferSize,
+              float targetLatencyMs);
+    void close();
+    bool isOpen() const noexcept { return open_.load(std::memory_order_acquire); }
+    juce::String deviceName() const { return deviceName_; }
+
+    // Output device thread. Returns false (and leaves destination alone) while closed.
+    bool read(float* destination, int numSamples) noexcept;
+
+    double ratioCorrection() const noexcept { return bridge_.ratioCorrection(); }
+    double latencySamples() const noexcept { return bridge_.latencySamples(); }
+    uint32_t dropouts() const noexcept { return bridge_.underruns() + bridge_.overruns(); }
+
+private:
+    void audioDeviceIOCallbackWithContext(const float* const* inputChannelData,
+                                          int numInputChannels,
+                                          float* const* outputChannelData,
+                                          int numOutputChannels,
+                                          int numSamples,
+                                          const juce::AudioIODeviceCallbackContext& context) override;
+    void audioDeviceAboutToStart(juce::AudioIODevice* device) override;
+    void audioDeviceStopped() override;
+
+    std::unique_ptr<juce::AudioIODevice> device_;
+    juce::String deviceName_;
+    dsp::AsrcBridge bridge_;
+    std::atomic<bool> open_{false};
+    std::atomic<int> readers_{0};
+};
+} // namespace singwithme::audio
@@ -8,28 +8,59 @@
 #include <juce_audio_formats/juce_audio_formats.h>
 #include <juce_core/juce_core.h>
 
+#include <array>
 #include <atomic>
+#include <future>
+#include <map>
+#include <mutex>
 #include <vector>
 
+#include "audio/CommandQueue.h"
+#include "audio/GuideAnalysis.h"
+#include "audio/InputBridge.h"
+#include "audio/SetlistEngine.h"
+#include "audio/StemLoader.h"
 #include "calibration/Calibrator.h"
+#include "calibration/LatencyProbe.h"
 #include "config/RuntimeConfig.h"
+#include "dsp/BleedCanceller.h"
 #include "dsp/ConfidenceGate.h"
+#include "dsp/DelayLine.h"
+#include "dsp/FdnReverb.h"
+#include "dsp/GuideEnvelope.h"
+#include "dsp/LoopLayout.h"
+#include "dsp/PhraseTracker.h"
 #include "dsp/PitchProcessor.h"
+#include "dsp/PitchShifter.h"
+#include "dsp/Resampler.h"
+#include "dsp/RoutingMatrix.h"
+#include "dsp/TimbreMatcher.h"
 #include "dsp/VadProcessor.h"
 
+namespace singwithme::bench
+{
+struct PipelineProcessorAccess;
+} // namespace singwithme::bench
+
 namespace singwithme::audio
 {
 class PipelineProcessor : public juce::AudioIODeviceCallback
 {
 public:
     PipelineProcessor();
-    ~PipelineProcessor() override = default;
+    ~PipelineProcessor() override;
 
+    // Lets guide analysis run its own VAD instance; call before configure().
+    void setOrtEnvironment(Ort::Env& env);
     void configure(const config::RuntimeConfig& runtimeConfig,
                    dsp::ConfidenceGate& gate,
                    dsp::VadProcessor& vad,
                    dsp::PitchProcessor& pitch,
                    calibration::Calibrator& calibrator);
+    // Stops the setlist worker and drains the loader pool, after which no background job
+    // touches the config, gate, models or calibrator handed to configure(). Call it once the
+    // processor is off the device, before those are destroyed; the destructor calls it too.
+    void shutdown();
     struct Metrics
     {
         float inputRms{0.0f};
@@ -39,12 +70,34 @@ public:
         float confidence{0.0f};
         float strength{0.0f};
         float gateDb{-80.0f};
+        float vadSkippedPercent{0.0f};
+        float pitchSkippedPercent{0.0f};
+        float guidePitchRatio{1.0f};
     };
 
     Metrics getMetrics() const;
     void setManualMode(dsp::ManualMode mode);
     dsp::ManualMode manualMode() const;
 
+    // Gate settings that may change while running, e.g. under plugin automation. Safe from
+    // any thread: the next block applies them without resetting the gate, they outlive core
+    // reconfigures, and calibration's threshold boost still adds to them.
+    struct GateTuning
+    {
+        float thresholdOn{0.7f};
+        float thresholdOff{0.4f};
+        float attackMs{20.0f};
+        float releaseMs{180.0f};
+        float holdMs{150.0f};
+        float duckDb{-80.0f};
+    };
+    void setGateTuning(const GateTuning& tuning);
+    // Delay the core puts on the outputs for the gate's look-ahead, at the given rate.
+    int outputLatencySamples(double sampleRate) const;
+    // While set, a block waits for a core reconfiguration instead of coming out silent, so an
+    // offline render never drops audio.
+    void setOffline(bool offline);
+
     enum class TransportState
     {
         Playing,
@@ -54,10 +107,23 @@ public:
 
     bool loadInstrumentFile(const juce::File& file);
     bool loadGuideFile(const juce::File& file);
+    std::future<bool> loadInstrumentFileAsync(const juce::File& file);
+    std::future<bool> loadGuideFileAsync(const juce::File& file);
+    void setSetlist(std::vector<SetlistEntry> songs);
+    int setlistSize() const;
+    int currentSongIndex() const;
+    void jumpToSong(int index);
+    void nextSong();
     std::string instrumentPath() const;
     std::string guidePath() const;
     double instrumentDurationSeconds() const;
     double guideDurationSeconds() const;
+    // Waveform pyramids of the current stems and the guide's pitch/activity lanes, for
+    // drawing at any zoom in O(pixels); null until the stem is loaded. Positions are in
+    // seconds and survive a device rate change.
+    std::shared_ptr<const dsp::StemOverview> instrumentOverview() const;
+    std::shared_ptr<const dsp::StemOverview> guideOverview() const;
+    std::shared_ptr<const GuideAnalysis> guideAnalysis() const;
     void setNoiseFloorAmplitude(float amp);
     float noiseFloorAmplitude() const;
     void setMicMonitorGainDb(float gainDb);
@@ -73,9 +139,73 @@ public:
     void setGuideMute(bool shouldMute);
     bool guideMuted() const;
     void updateBufferSize(int bufferSamples);
+    // Follows the device rate. The stems are resampled on the loader pool, or taken from the
+    // per-rate cache, while the current configuration keeps playing; the core is then
+    // reconfigured and the new stems swapped in between two blocks. The future turns true once
+    // the pipeline runs at the rate (false if a conversion failed) for callers that must wait.
+    std::shared_future<bool> adaptToSampleRate(double sampleRate);
+    double sampleRate() const;
+
+    // Loopback mode: while it runs the outputs play only the probe sequence and the song
+    // holds. The result is analysed on the calling thread once isMeasuringLatency() is false.
+    bool startLatencyMeasurement();
+    bool isMeasuringLatency() const;
+    calibration::LatencyMeasurement latencyMeasurement() const;
+    // Mic-behind-output offset used to align the bleed reference and the phrase tracker.
+    void setRoundTripLatency(int samples);
+    int roundTripLatency() const;
+    // While set and open, the mic comes from the bridge instead of this device's input.
+    void setInputBridge(InputBridge* bridge);
+    // With media.guidePitchFollow the guide is played here instead of by the core, which
+    // cannot shift it, and these three replace the core's own guide processing.
+    // Moves the guide into the singer's key. Runs on the mono guide before it is levelled;
+    // the ratio and period are steered per block.
+    dsp::PitchShifter& guidePitchShifter() { return guideShifter_; }
+    // Stereo tail on the guide, set by setReverbTail() and sent more of the guide as the
+    // guide's envelope opens.
+    dsp::FdnReverb& guideReverb() { return guideReverb_; }
+    // Pulls the guide's spectral envelope towards the singer's by setTimbreMatchStrength();
+    // fed the mic every block and run on the mono guide after the pitch shifter.
+    dsp::TimbreMatcher& guideTimbreMatcher() { return guideTimbre_; }
+    // Transport changes are queued to the audio thread and take effect at an exact sample of
+    // a block: at, a deviceClock() sample, or the next block when it is -1. Positions are song
+    // samples at the current rate. Seeks and loop regions lay the stems out again on the
+    // calling thread so the core can keep playing one buffer; a loop's end is crossfaded
+    // into the material leading up to its start, so every pass through it is seamless.
+    enum class TransportAction
+    {
+        Play,
+        Pause,
+        Stop,
+        Seek,
+        SetLoop,
+        ClearLoop
+    };
+    struct TransportCommand
+    {
+        TransportAction action{TransportAction::Play};
+        int64_t position{0}; // Seek's target or SetLoop's start
+        int64_t end{0};      // SetLoop's end, exclusive
+        int64_t at{-1};
+    };
+    // False if the queue is full or the command does not fit the current song. SetLoop and
+    // ClearLoop without a time wait for the playhead to reach the loop's crossfade, so the
+    // region is entered or left without a jump; if it never will, or with a time, they jump
+    // into the crossfade. A seek outside the region clears it; stop returns to the last seek
+    // or, in a loop, to the crossfade into its start.
+    bool scheduleTransport(const TransportCommand& command);
     void playTransport();
     void pauseTransport();
     void stopTransport();
+    bool seekTransport(int64_t position);
+    bool setLoopRegion(int64_t start, int64_t end);
+    bool clearLoopRegion();
+    // The region the audio thread is playing; {0, 0} without one.
+    std::pair<int64_t, int64_t> loopRegion() const;
+    // Song sample at the end of the last block.
+    int64_t transportPosition() const;
+    // Samples the device has asked for since the processor was created, skipped blocks included.
+    int64_t deviceClock() const;
     bool isTransportPlaying() const;
     TransportState transportState() const;
 
@@ -89,6 +219,143 @@ public:
                                           const juce::AudioIODeviceCallbackContext& context) override;
 
 private:
+    friend struct bench::PipelineProcessorAccess;
+
+    using StemBuffer = std::shared_ptr<const juce::AudioBuffer<float>>;
+
+    // The stems the audio thread plays, read-only once published; a missing stem is null.
+    // Setlist songs share their PreparedSong's buffers.
+    struct SongStems
+    {
+        StemBuffer backing;
+        StemBuffer guide;
+        int64_t length{0};
+        bool cached{false}; // a setlist song's buffers, counted by the setlist
+
+        size_t memoryBytes() const;
+    };
+
+    // What mixStems() read for the block, for the routed buses.
+    struct StemBlock
+    {
+        const float* instrumentLeft{nullptr};
+        const float* instrumentRight{nullptr};
+        const float* guide{nullptr};
+    };
+
+    // A bus's guide routes, re-gained every block to follow the gate down to the bus's depth.
+    struct RoutedGuide
+    {
+        size_t left{0};
+        size_t right{0};
+        float gain{0.0f};
+        float depth{0.0f};
+    };
+
+    // Stems laid out along a span for the core, which plays them from their first sample and
+    // loops the whole buffer. Built off the audio thread; the audio thread moves the buffers
+    // into the core.
+    struct CoreTracks
+    {
+        std::vector<std::vector<float>> backing;
+        std::vector<std::vector<float>> guide; // empty while the guide is played here
+    };
+
+    // A setlist song handed to the audio thread through pendingSong_ and back to the setlist
+    // thread via startedSong_, which frees the stems it replaced.
+    struct ArmedSong
+    {
+        std::shared_ptr<PreparedSong> song;
+        std::shared_ptr<const SongStems> stems;
+        CoreTracks tracks; // the song from its start, laid out on the setlist thread
+        double sampleRate{0.0};
+        bool immediate{false};
+    };
+
+    struct QueuedTransport
+    {
+        TransportCommand command;
+        bool moves{false};       // a seek or loop change, played along span from its start
+        dsp::PlaybackSpan span{};
+        CoreTracks* tracks{nullptr}; // span laid out for the core; retired once loaded
+        int64_t atPosition{-1};  // song sample to wait for instead of a time
+        int64_t loopStart{0};    // region once applied
+        int64_t loopEnd{0};
+        uint64_t generation{0};  // of the stems the span was planned on
+    };
+
+    // A stretch of a block the core played without a transport change.
+    struct TransportSegment
+    {
+        int start{0};
+        int count{0};
+        int64_t layoutOffset{0};
+        dsp::PlaybackSpan span;
+        bool playing{false};
+        const SongStems* stems{nullptr};
+    };
+
+    struct RateConversion
+    {
+        double sampleRate{0.0};
+        uint64_t generation{0};
+        juce::AudioBuffer<float> backing;
+        juce::AudioBuffer<float> guide;
+        std::atomic<int> pending{0};
+        std::atomic<bool> failed{false};
+    };
+
+    void serviceSetlist();
+    bool armSongLocked(int index, bool immediately);
+    void dropArmedSongLocked();
+    void adoptStartedSong(const ArmedSong& started);
+    void swapArmedSong();
+    int64_t samplesUntilSongEnd() const;
+    void advancePlayhead(int numSamples);
+    bool planSpanLocked(QueuedTransport& queued);
+    void syncTransportLayout();
+    void homeTransport(int64_t songLength, int64_t origin);
+    void retireTracks(CoreTracks* tracks);
+    void freeRetiredTracksLocked();
+    void loadCoreTracks(CoreTracks& tracks, int sampleRate);
+    CoreTracks layOutTracks(const dsp::LoopLayout& layout, const SongStems& stems, const dsp::PlaybackSpan& span) const;
+    static std::vector<std::vector<float>> layOutStem(const dsp::LoopLayout& layout,
+                                                      const juce::AudioBuffer<float>* stem,
+                                                      const dsp::PlaybackSpan& span,
+                                                      int64_t songLength);
+    void applyDueTransport(int64_t now, int window);
+    int samplesUntilTransport(int64_t now, int remaining) const;
+    int64_t armedDistance() const;
+    void applyTransport(const QueuedTransport& queued);
+    void processCore(const float* micInput, float* const* outputs, int numOutputs, int numSamples, int64_t blockClock);
+    dsp::PlaybackSpan homeSpan(int64_t songLength, int64_t origin = 0) const;
+    void publishGuideAnalysisLocked(std::shared_ptr<const GuideAnalysis> analysis);
+    static std::shared_ptr<SongStems> makeStems(StemBuffer backing, StemBuffer guide);
+    void reportHeldStemsLocked();
+    void publishStemsLocked(StemBuffer backing, StemBuffer guide);
+    void configureRouting(const config::RoutingConfig& routing);
+    void routeOutputs(const float* micInput, float* const* outputs, int numOutputs, int numSamples);
+    void mixStems(const float* micInput, float* const* outputs, int numOutputs, int numSamples);
+    const float* readStem(bool guide, int channel, int numSamples, int64_t lead, float* scratch) const;
+    void configureSetlist();
+    void prepareForSampleRate(double sampleRate);
+    void startRateConversionLocked();
+    void finishRateConversion(const std::shared_ptr<RateConversion>& conversion);
+    void settleRateSwitchLocked(bool switched);
+    void switchStemsLocked(double sampleRate, std::shared_ptr<const SongStems> stems);
+    // stems: those at sampleRate when the rate changes, null otherwise.
+    void reconfigureCoreLocked(double sampleRate, int bufferSamples, std::shared_ptr<const SongStems> stems);
+    const float* cancelBleed(const float* micInput, int numSamples);
+    void runLatencyProbe(const float* micInput, float* const* outputs, int numOutputs, int numSamples);
+    void pushBleedReference(const float* micInput, const float* const* outputs, int numOutputs, int numSamples);
+    void feedModels(const float* micInput, int numSamples);
+    void updateGateContext(const float* micInput, int numSamples);
+    void steerGuideShifter(const GuideAnalysis* analysis, const dsp::PhraseEstimate& estimate);
+    void applyCalibration();
+    void applyGateTuning();
+    void writeCalibration(const calibration::CalibrationResult& calibration);
+    GuideAnalysisSettings guideAnalysisSettings() const;
+
     juce::File resolveFile(const std::string& path) const;
     bool loadAudioFile(const juce::File& file,
                        juce::AudioBuffer<float>& destination,
@@ -96,19 +363,25 @@ private:
     bool loadAudioFile(const std::string& path,
                        juce::AudioBuffer<float>& destination,
                        double targetSampleRate);
-    void pushBackingToCore(const juce::AudioBuffer<float>& buffer, double sampleRate);
-    void pushGuideToCore(const juce::AudioBuffer<float>& buffer, double sampleRate);
-    static std::vector<std::vector<float>> convertBuffer(const juce::AudioBuffer<float>& buffer);
+    bool applyInstrument(const juce::File& file,
+                         bool decoded,
+                         juce::AudioBuffer<float>& buffer,
+                         std::shared_ptr<const dsp::StemOverview> overview,
+                         double sampleRate);
+    bool applyGuide(const juce::File& file,
+                    bool decoded,
+                    juce::AudioBuffer<float>& buffer,
+                    std::shared_ptr<const dsp::StemOverview> overview,
+                    double sampleRate);
 
     const config::RuntimeConfig* runtimeConfig_{nullptr};
     dsp::ConfidenceGate* gate_{nullptr};
     dsp::VadProcessor* vad_{nullptr};
     dsp::PitchProcessor* pitch_{nullptr};
     calibration::Calibrator* calibrator_{nullptr};
+    Ort::Env* ortEnv_{nullptr};
 
     juce::AudioFormatManager formatManager_;
-    juce::AudioBuffer<float> backingBuffer_;
-    juce::AudioBuffer<float> vocalBuffer_;
     core::PipelineCore corePipeline_;
     core::PipelineConfig coreConfig_;
 
@@ -116,5 +389,125 @@ private:
     std::string guidePath_;
     double backingDurationSeconds_{0.0};
     double vocalDurationSeconds_{0.0};
+    std::shared_ptr<const dsp::StemOverview> backingOverview_;
+    std::shared_ptr<const dsp::StemOverview> guideOverview_;
+    mutable std::mutex stemMutex_;
+
+    // Rate of the core and of stems_; written with both stemMutex_ and coreMutex_ held. The
+    // other members below are guarded by stemMutex_.
+    std::atomic<double> sampleRate_{48000.0};
+    // Owns what liveStems_ points to; only replaced with coreMutex_ held or, after a song
+    // swap, once the audio thread has moved on, so the old stems are freed off the audio thread.
+    std::shared_ptr<const SongStems> stems_;
+    double targetSampleRate_{48000.0};
+    // Earlier rates of the current song's stems, keyed by rate in Hz; cleared on a new song.
+    std::map<int, std::shared_ptr<const SongStems>> stemsByRate_;
+    // Bumped by a new song or a new target rate so a conversion still in flight is dropped.
+    uint64_t stemGeneration_{0};
+    // The conversion still in flight, and the promise behind rateSwitch_ that the last one to
+    // finish (or a conversion found unnecessary) settles.
+    std::shared_ptr<RateConversion> rateConversion_;
+    std::shared_ptr<std::promise<bool>> rateSwitchPromise_;
+    std::shared_future<bool> rateSwitch_;
+    // Held by the audio callback for each block (try_lock unless offline) and by a core
+    // reconfiguration, so no block ever runs on a half-switched pipeline. A block that finds
+    // it taken is silent.
+    std::mutex coreMutex_;
+
+    // The audio thread reads the guide analysis through liveGuideAnalysis_; the previous
+    // owner is kept alive for one more swap so a block in flight never sees it freed.
+    std::shared_ptr<const GuideAnalysis> guideAnalysis_;
+    std::shared_ptr<const GuideAnalysis> retiredGuideAnalysis_;
+    std::atomic<const GuideAnalysis*> liveGuideAnalysis_{nullptr};
+    // The core plays laid-out copies of the stems. The stems themselves are read here along
+    // the transport's spans for the routed buses and, with media.guidePitchFollow, for the
+    // guide, which is then levelled by guideEnvelope_ and added to the core's output.
+    // stemScratch_ holds reads that wrap at a loop point and the guide being processed.
+    std::atomic<const SongStems*> liveStems_{nullptr};
+    std::vector<float> stemScratch_;
+    StemBlock stemBlock_;
+    int64_t stemDelay_{0}; // the gate's look-ahead, by which the core's output trails
+    int64_t guideLead_{0}; // latency of the guide's effects
+    dsp::GuideEnvelope guideEnvelope_;
+    float guideGain_{1.0f};
+    float guideLevel_{0.0f};
+    float guideDuckDb_{-80.0f};
+    std::atomic<float> envelopeHoldMs_{70.0f};
+    std::atomic<float> envelopeReleaseMs_{236.0f};
+    std::atomic<float> envelopeReleaseMod_{0.29f};
+    std::atomic<float> reverbTailMix_{0.0f};
+    std::atomic<float> reverbTailSeconds_{0.5f};
+    std::atomic<float> outputRms_{0.0f};
+    // Output buses. Without routes the core and the stems write the device outputs directly;
+    // with them they mix into routingScratch_.
+    dsp::RoutingMatrix routing_;
+    std::vector<RoutedGuide> routedGuides_;
+    std::vector<float> routingScratch_;
+    dsp::Resampler modelFeed_; // the mic at the model rate
+    std::vector<float> modelBlock_;
+    dsp::PhraseTracker phraseTracker_;
+    dsp::BleedCanceller bleedCanceller_;
+    std::vector<float> cleanedMic_;
+    std::vector<float> bleedReference_;
+    dsp::DelayLine bleedDelay_;
+    bool bleedCancellation_{false};
+    calibration::LatencyProbe latencyProbe_;
+    std::atomic<bool> measuringLatency_{false};
+    std::atomic<bool> offline_{false};
+    // GateTuning's fields in declaration order, applied on the audio thread while pending.
+    std::array<std::atomic<float>, 6> gateTuning_{};
+    std::atomic<bool> gateTuned_{false};
+    std::atomic<bool> gateTuningPending_{false};
+    float thresholdBoost_{0.0f}; // last calibration's; guarded by coreMutex_
+    std::atomic<int> roundTripSamples_{0};
+    std::atomic<InputBridge*> inputBridge_{nullptr};
+    std::vector<float> bridgedMic_;
+    dsp::PitchShifter guideShifter_;
+    dsp::FdnReverb guideReverb_;
+    dsp::TimbreMatcher guideTimbre_;
+    float timbreMatchStrength_{0.0f};
+    bool guidePitchFollow_{false};
+    std::atomic<float> guidePitchRatio_{1.0f};
+
+    std::atomic<ArmedSong*> pendingSong_{nullptr};
+    std::atomic<ArmedSong*> startedSong_{nullptr};
+    int64_t playheadSamples_{0};
+
+    // Transport. Producers hold transportMutex_ (then setlistMutex_ and stemMutex_ to lay
+    // out the song along a span); the audio thread owns span_, layoutOffset_ and the armed
+    // command, and hands the emptied CoreTracks back through retiredTracks_.
+    std::mutex transportMutex_;
+    CommandQueue<QueuedTransport, 32> transportQueue_;
+    CommandQueue<CoreTracks*, 64> retiredTracks_;
+    dsp::LoopLayout loopLayout_; // sized per rate; read under stemMutex_ or coreMutex_
+    // Bumped whenever the core is handed its tracks outside a queued span (new stems, a new
+    // rate or a reconfigure); spans planned on an older generation are dropped.
+    std::atomic<uint64_t> layoutGeneration_{0};
+    int64_t homeOrigin_{0}; // song sample those tracks start at; written under coreMutex_
+    uint64_t plannedGeneration_{0};
+    int64_t plannedLoopStart_{0}; // region after the last queued command
+    int64_t plannedLoopEnd_{0};
+    uint64_t appliedGeneration_{0};
+    QueuedTransport armedTransport_;
+    dsp::PlaybackSpan span_;
+    int64_t layoutOffset_{0}; // samples the core has played along span_
+    std::array<TransportSegment, 4> segments_{};
+    int segmentCount_{0};
+    bool songEnded_{false}; // the last stretch ended on the song's last sample
+    std::atomic<int64_t> loopStart_{0};
+    std::atomic<int64_t> loopEnd_{0};
+    std::atomic<int64_t> transportPosition_{0};
+    std::atomic<int64_t> deviceClock_{0};
+    uint64_t traceBlock_{0}; // flow id linking each mic block to its inference
+    std::atomic<bool> calibrationApplied_{false};
+    mutable std::mutex setlistMutex_;
+    int activeSongIndex_{-1};
+    int cuedSongIndex_{-1};
+    bool autoAdvance_{true};
+
+    // Declared last so in-flight loads finish before the buffers they write to go away;
+    // the setlist thread is stopped before the loader it schedules work on.
+    StemLoader stemLoader_{formatManager_};
+    SetlistEngine setlist_{stemLoader_};
 };
 } // namespace singwithme::audio
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <juce_core/juce_core.h>
+
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "audio/GuideAnalysis.h"
+#include "audio/StemLoader.h"
+
+namespace singwithme::audio
+{
+struct SetlistEntry
+{
+    std::string instrumentPath;
+    std::string guidePath;
+};
+
+struct PreparedSong
+{
+    int index{-1};
+    SetlistEntry entry;
+    juce::AudioBuffer<float> backing;
+    juce::AudioBuffer<float> guide;
+    std::shared_ptr<const GuideAnalysis> guideAnalysis;
+    std::shared_ptr<const dsp::StemOverview> backingOverview;
+    std::shared_ptr<const dsp::StemOverview> guideOverview;
+    int64_t lengthSamples{0};
+    double sampleRate{0.0};
+
+    size_t memoryBytes() const;
+};
+
+// Keeps the current song and the next preloadDepth songs decoded in the background so the
+// pipeline can switch to them without touching the disk. The cache is bounded by a memory
+// budget; least-recently-used songs outside the preload window are evicted first. Entries
+// are kept per sample rate, so a device that goes back to an earlier rate finds its songs
+// still cached; songs at other rates than the current one are never in the window.
+class SetlistEngine : private juce::Thread
+{
+public:
+    explicit SetlistEngine(StemLoader& loader);
+    ~SetlistEngine() override;
+
+    // Stems are decoded at analysis.sampleRate; guides are analysed with the same settings.
+    // prepared() only returns songs at that rate.
+    void configure(const GuideAnalysisSettings& analysis, int preloadDepth, size_t memoryBudgetBytes);
+    void shutdown();
+    void setSongs(std::vector<SetlistEntry> songs);
+    void setServiceCallback(std::function<void()> callback);
+
+    int size() const;
+    int current() const;
+    void setCurrent(int index);
+    std::shared_ptr<PreparedSong> prepared(int index);
+    size_t cachedBytes() const;
+    // Stems the caller holds outside the cache (loaded from files, or copies at other
+    // rates); they count against the memory budget too.
+    void setHeldBytes(size_t bytes);
+
+private:
+    // (song index, sample rate in Hz)
+    using CacheKey = std::pair<int, int>;
+
+    struct CacheEntry
+    {
+        std::shared_ptr<PreparedSong> song;
+        uint64_t lastUsed{0};
+    };
+
+    struct PendingLoad
+    {
+        std::shared_ptr<PreparedSong> song;
+        std::future<bool> instrument;
+        std::future<bool> guide;
+    };
+
+    void run() override;
+    void collectFinishedLoads();
+    void scheduleLoads();
+    void evictToBudget();
+    bool inWindow(const CacheKey& key) const;
+    CacheKey keyFor(int index) const;
+    size_t cachedBytesLocked() const;
+    size_t usedBytesLocked() const;
+
+    StemLoader& loader_;
+    mutable std::mutex mutex_;
+    std::vector<SetlistEntry> songs_;
+    std::map<CacheKey, CacheEntry> cache_;
+    std::vector<PendingLoad> pending_;
+    std::function<void()> serviceCallback_;
+    GuideAnalysisSettings analysis_;
+    int preloadDepth_{2};
+    size_t memoryBudgetBytes_{1024u * 1024u * 1024u};
+    size_t heldBytes_{0};
+    int current_{0};
+    uint64_t useCounter_{0};
+};
+} // namespace singwithme::audio
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <juce_audio_formats/juce_audio_formats.h>
+#include <juce_core/juce_core.h>
+
+#include "dsp/Resampler.h"
+#include "dsp/WaveformPyramid.h"
+
+#include <atomic>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace singwithme::audio
+{
+// Decodes and resamples stems on a shared thread pool. Each load is a small task graph:
+// open -> decode chunks -> per-channel/per-chunk resample -> per-channel/per-chunk overview
+// -> completion. Loads for different files run concurrently and never block the calling thread.
+class StemLoader
+{
+public:
+    // Runs on a pool thread once the stem is ready (or has failed); the return value
+    // resolves the future handed back by load(). overview is the stem's waveform pyramid,
+    // built by load() only and null otherwise.
+    using Completion = std::function<bool(bool decoded,
+                                          juce::AudioBuffer<float>& buffer,
+                                          std::shared_ptr<const dsp::StemOverview> overview)>;
+
+    explicit StemLoader(juce::AudioFormatManager& formatManager,
+                        int numThreads = juce::SystemStats::getNumCpus());
+    ~StemLoader();
+
+    // Drops queued work and waits for running tasks; no completion runs after it returns.
+    // The futures of loads it cut short resolve to false, as do those of later loads.
+    void shutdown();
+
+    void setResamplerQuality(dsp::ResamplerQuality quality);
+    std::future<bool> load(const juce::File& file, double targetSampleRate, Completion onComplete);
+    // Same resample graph for a stem that is already in memory, e.g. when the device rate
+    // changes. No overview is built: the one from load() is in seconds and still applies.
+    std::future<bool> resample(juce::AudioBuffer<float> source,
+                               double sourceSampleRate,
+                               double targetSampleRate,
+                               Completion onComplete);
+
+private:
+    struct Job;
+
+    void start(const std::shared_ptr<Job>& job, std::function<void()> task);
+    void enqueue(std::function<void()> task);
+    void open(const std::shared_ptr<Job>& job);
+    void decodeChunk(const std::shared_ptr<Job>& job, int64_t startSample, int numSamples);
+    void onDecoded(const std::shared_ptr<Job>& job);
+    void resampleChunk(const std::shared_ptr<Job>& job, int channel, int outputStart, int outputCount);
+    void onResampled(const std::shared_ptr<Job>& job);
+    void overviewChunk(const std::shared_ptr<Job>& job, int channel, size_t chunk);
+    void finish(const std::shared_ptr<Job>& job, bool ok);
+
+    juce::AudioFormatManager& formatManager_;
+    std::atomic<dsp::ResamplerQuality> quality_{dsp::ResamplerQuality::Lagrange};
+    std::atomic<bool> stopped_{false};
+    std::mutex jobsMutex_;
+    std::vector<std::shared_ptr<Job>> jobs_;
+    juce::ThreadPool pool_;
+};
+} // namespace singwithme::audio
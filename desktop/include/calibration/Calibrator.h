@@ -1,17 +1,34 @@
 #pragma once
 
+#include <array>
+#include <complex>
 #include <cstddef>
 #include <vector>
 
+#include "calibration/QuantileSketch.h"
+#include "dsp/Fft.h"
+
 namespace singwithme::calibration
 {
+constexpr size_t kNumNoiseBands = 16;
+
 struct CalibrationResult
 {
-    float noiseFloorDb{-80.0f};
-    float vocalPeakDb{-6.0f};
+    float noiseFloorDb{-80.0f}; // 10th percentile of 10 ms RMS
+    float medianDb{-80.0f};
+    float p95Db{-80.0f};
+    float vocalPeakDb{-6.0f};   // sample peak
+    std::array<float, kNumNoiseBands> noiseBandCentreHz{};
+    std::array<float, kNumNoiseBands> noiseBandDb{};
+    // Amplitude for PipelineCore's noise gate: above the noise peaks, below the voice.
+    float noiseGateAmplitude{0.13f};
+    // Added to both confidence thresholds when the voice sits close to the room noise.
+    float thresholdBoost{0.0f};
     bool isValid{false};
 };
 
+// Measures the room and the singer during a fixed-length pass. start() sizes every
+// buffer; processBlock() is allocation-free.
 class Calibrator
 {
 public:
@@ -21,9 +38,35 @@ public:
     CalibrationResult result() const noexcept;
 
 private:
+    struct Band
+    {
+        size_t firstBin{0};
+        size_t lastBin{0};
+    };
+
+    void analyseSpectrum();
+
     double sampleRate_{48000.0};
     float targetDuration_{10.0f};
     size_t processedSamples_{0};
     float maxAmplitude_{0.0f};
+
+    size_t hopSamples_{480};
+    size_t hopFill_{0};
+    float hopSumSquares_{0.0f};
+    QuantileSketch levels_;
+
+    dsp::Fft fft_;
+    std::vector<float> window_;
+    std::vector<float> frame_;
+    std::vector<float> windowed_;
+    std::vector<std::complex<float>> spectrum_;
+    size_t frameFill_{0};
+    float windowPower_{1.0f};
+    std::array<Band, kNumNoiseBands> bands_{};
+    std::array<float, kNumNoiseBands> bandCentreHz_{};
+    std::array<float, kNumNoiseBands> bandSmoothed_{};
+    std::array<float, kNumNoiseBands> bandMinimum_{};
+    bool spectrumPrimed_{false};
 };
 } // namespace singwithme::calibration
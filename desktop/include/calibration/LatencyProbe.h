@@ -0,0 +1,41 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+namespace singwithme::calibration
+{
+struct LatencyMeasurement
+{
+    int roundTripSamples{-1}; // median over the repeats
+    int spreadSamples{0};     // max - min over the repeats
+    float peakToNoiseDb{0.0f}; // weakest repeat
+    bool isValid{false};
+};
+
+// Loopback round-trip measurement: plays a maximum-length sequence through the output a few
+// times, records the input, and finds the delay of each repeat by FFT cross-correlation.
+// start() allocates the stimulus and the recording; processBlock() is allocation-free and
+// runs on the audio thread; result() does the analysis on the calling thread once done.
+class LatencyProbe
+{
+public:
+    static constexpr int kSequenceOrder = 15;
+    static constexpr double kMaxLatencySeconds = 0.5;
+
+    void start(double sampleRate, int repeats = 3, float level = 0.25f);
+    void processBlock(const float* input, float* output, size_t numSamples);
+    bool isComplete() const noexcept { return complete_.load(std::memory_order_acquire); }
+    LatencyMeasurement result() const;
+
+private:
+    std::vector<float> sequence_;
+    std::vector<float> recording_;
+    size_t segmentSamples_{0};
+    size_t maxLagSamples_{0};
+    size_t position_{0};
+    int repeats_{0};
+    std::atomic<bool> complete_{true};
+};
+} // namespace singwithme::calibration
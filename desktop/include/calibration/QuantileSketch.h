@@ -0,0 +1,29 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace singwithme::calibration
+{
+// Fixed-memory quantile estimator for levels in dBFS: a histogram of 0.25 dB bins from
+// -120 to 0 dB. add() and quantile() are O(1) / O(bins) and never allocate; the rank
+// error is bounded by the bin width rather than by the number of samples seen.
+class QuantileSketch
+{
+public:
+    static constexpr float kMinDb = -120.0f;
+    static constexpr float kMaxDb = 0.0f;
+    static constexpr float kBinDb = 0.25f;
+    static constexpr size_t kNumBins = static_cast<size_t>((kMaxDb - kMinDb) / kBinDb);
+
+    void reset() noexcept;
+    void add(float levelDb) noexcept;
+    uint64_t count() const noexcept { return count_; }
+    float quantile(float q) const noexcept;
+
+private:
+    std::array<uint32_t, kNumBins> bins_{};
+    uint64_t count_{0};
+};
+} // namespace singwithme::calibration
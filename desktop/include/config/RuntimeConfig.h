@@ -1,6 +1,8 @@
 #pragma once
 
+#include <cstddef>
 #include <string>
+#include <vector>
 
 namespace juce
 {
@@ -21,6 +23,7 @@ struct GateParams
     int framesOn{3};
     int framesOff{6};
     float duckDb{-18.0f};
+    bool predictiveOpen{true};
 };
 
 struct ConfidenceWeights
@@ -35,6 +38,7 @@ struct MediaConfig
     std::string instrumentPath{"assets/audio/braykit-instrument.mp3"};
     std::string guidePath{"assets/audio/braykit-guide.mp3"};
     bool loop{true};
+    float loopCrossfadeMs{10.0f};
     float instrumentGainDb{0.0f};
     float guideGainDb{0.0f};
     float micMonitorGainDb{-60.0f};
@@ -48,6 +52,86 @@ struct MediaConfig
     float envelopeHoldMs{70.0f};
     float envelopeReleaseMs{236.0f};
     float envelopeReleaseMod{0.29f};
+    std::string resamplerQuality{"lagrange"};
+    bool bleedCancellation{false};
+    float bleedFilterMs{100.0f};
+    float bleedStepSize{0.3f};
+    bool guidePitchFollow{false};
+};
+
+struct SetlistSong
+{
+    std::string instrumentPath;
+    std::string guidePath;
+};
+
+struct SetlistConfig
+{
+    std::vector<SetlistSong> songs;
+    int preloadDepth{2};
+    float memoryBudgetMb{1024.0f};
+    bool autoAdvance{true};
+};
+
+// Measured loopback round trip for one input/output pairing at one rate and buffer size.
+struct DeviceLatency
+{
+    std::string inputDevice;
+    std::string outputDevice;
+    double sampleRate{48000.0};
+    int bufferSamples{128};
+    int roundTripSamples{0};
+};
+
+struct LatencyConfig
+{
+    bool measureWhenUnknown{false};
+    std::vector<DeviceLatency> devices;
+
+    const DeviceLatency* find(const std::string& inputDevice,
+                              const std::string& outputDevice,
+                              double sampleRate,
+                              int bufferSamples) const;
+};
+
+// Runs a mic on a different device than the outputs through a drift-correcting resampler.
+struct InputBridgeConfig
+{
+    bool enabled{false};
+    float targetLatencyMs{10.0f};
+};
+
+// One output bus and the device channels it plays on: one channel for a mono bus (stereo
+// sources are folded down), two for stereo. Gains at or below -80 dB leave that source off
+// the bus.
+struct RoutingBus
+{
+    std::string name;
+    std::vector<int> outputs;
+    float mixGainDb{-80.0f}; // the core's processed mix, without its mic monitor
+    float guideGainDb{-80.0f};
+    float instrumentGainDb{-80.0f};
+    float micGainDb{-80.0f};
+    float gateDepthDb{-80.0f}; // the bus's guide follows the gate down to this and no lower
+};
+
+// Splits the outputs into buses, e.g. front-of-house, in-ear monitor and click/cue, each
+// with its own levels. Without buses the core's stereo mix goes to the first two outputs.
+struct RoutingConfig
+{
+    std::vector<RoutingBus> buses;
+
+    // Device output channels to open: enough for every bus, and never fewer than two.
+    int outputChannels() const;
+};
+
+// Records pipeline events to a Chrome trace (.json) or Perfetto trace (other extensions)
+// from startup; needs a build with ENABLE_TRACING. TUNETRIX_TRACE=<path> does the same.
+struct TraceConfig
+{
+    bool enabled{false};
+    std::string path{"tunetrix-trace.json"};
+    int eventsPerThread{8192};
 };
 
 struct RuntimeConfig
@@ -57,9 +141,17 @@ struct RuntimeConfig
     double modelSampleRate{16000.0};
     std::string vadModelPath{"models/vad.onnx"};
     std::string pitchModelPath{"models/crepe_tiny.onnx"};
+    double pitchHopMs{64.0}; // CREPE window spacing; below 64 ms the 1024-sample windows overlap
     ConfidenceWeights weights{};
     GateParams gate{};
     MediaConfig media{};
+    SetlistConfig setlist{};
+    LatencyConfig latency{};
+    InputBridgeConfig inputBridge{};
+    RoutingConfig routing{};
+    TraceConfig trace{};
+
+    size_t pitchHopSamples() const;
 };
 
 class ConfigLoader
@@ -68,6 +160,15 @@ public:
     RuntimeConfig loadFromFile(const std::string& path) const;
     RuntimeConfig loadDefaults() const;
 
+    // Measured round trips are kept per user rather than in the tracked configs, as a
+    // devices array in the latency.devices format.
+    static std::string latencyStorePath();
+    // Adds the measurements stored at path, replacing config entries for the same setup.
+    void loadDeviceLatencies(const std::string& path, LatencyConfig& latency) const;
+    // Adds or replaces the entry for the same device pair, rate and buffer size in the store
+    // at path and rewrites it.
+    bool storeDeviceLatency(const std::string& path, const DeviceLatency& entry) const;
+
 private:
     RuntimeConfig loadFromFile(const juce::File& file) const;
     RuntimeConfig applyOverrides(const RuntimeConfig& baseConfig, const juce::var& overrides, const juce::File& parentDirectory) const;
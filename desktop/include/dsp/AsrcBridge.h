@@ -0,0 +1,84 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace singwithme::dsp
+{
+// Asynchronous sample-rate converter between two free-running device clocks. The input
+// device's thread push()es into a lock-free single-producer ring; the output device's thread
+// pull()s exactly as many samples as it needs through a windowed-sinc variable-ratio
+// interpolator. A second-order loop on the ring fill steers the ratio, so the latency
+// settles on the target however far the clocks drift apart. The fill is extrapolated from
+// the time of the last push, which keeps the input block size from aliasing into the
+// estimate. Everything is allocated in prepare(); push() and pull() never allocate or lock.
+class AsrcBridge
+{
+public:
+    static constexpr size_t kTaps = 32;
+    static constexpr size_t kPhases = 256;
+
+    void prepare(double inputRate,
+                 double outputRate,
+                 size_t maxInputBlock,
+                 size_t maxOutputBlock,
+                 size_t targetFillSamples);
+    void reset();
+
+    // Producer side (input device thread). Timestamps are seconds on a clock shared with
+    // pull(); the overloads without one use std::chrono::steady_clock.
+    void push(const float* input, size_t numSamples) noexcept;
+    void push(const float* input, size_t numSamples, double timeSeconds) noexcept;
+    // Consumer side (output device thread). Writes silence until the ring first reaches the
+    // target fill, and again after an underrun.
+    void pull(float* output, size_t numSamples) noexcept;
+    void pull(float* output, size_t numSamples, double timeSeconds) noexcept;
+
+    // Input samples consumed per output sample, relative to the nominal rate ratio.
+    double ratioCorrection() const noexcept { return correction_.load(std::memory_order_relaxed); }
+    double fillSamples() const noexcept { return smoothedFill_.load(std::memory_order_relaxed); }
+    size_t targetFillSamples() const noexcept { return targetFill_; }
+    // Latency through the bridge in output samples once locked.
+    double latencySamples() const noexcept { return static_cast<double>(targetFill_) / nominalStep_; }
+    uint32_t underruns() const noexcept { return underruns_.load(std::memory_order_relaxed); }
+    uint32_t overruns() const noexcept { return overruns_.load(std::memory_order_relaxed); }
+
+private:
+    void buildKernel(double cutoff);
+    float interpolate(uint64_t position, double fraction) const noexcept;
+    double extrapolatedWritten(uint64_t written, double timeSeconds) const noexcept;
+    void steer(double fill, size_t numSamples) noexcept;
+    static double now() noexcept;
+
+    std::vector<float> kernel_; // (kPhases + 1) rows of kTaps
+    std::vector<float> ring_;   // mirrored: 2 * capacity_
+    size_t capacity_{0};
+    size_t mask_{0};
+    size_t maxInputBlock_{0};
+    size_t targetFill_{0};
+    double inputRate_{48000.0};
+    double outputRate_{48000.0};
+    double nominalStep_{1.0};
+
+    std::atomic<uint64_t> written_{0};
+    std::atomic<uint64_t> consumed_{0};
+    // Sequence-locked (written, time) of the most recent push.
+    std::atomic<uint32_t> stampSequence_{0};
+    std::atomic<uint64_t> stampWritten_{0};
+    std::atomic<double> stampTime_{0.0};
+
+    // Consumer state.
+    uint64_t readIndex_{0};
+    double readFraction_{0.0};
+    double integrator_{0.0};
+    double fillEstimate_{0.0};
+    bool locked_{false};
+
+    std::atomic<double> correction_{0.0};
+    std::atomic<double> smoothedFill_{0.0};
+    std::atomic<uint32_t> underruns_{0};
+    std::atomic<uint32_t> overruns_{0};
+};
+} // namespace singwithme::dsp
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <complex>
+#include <cstddef>
+#include <vector>
+
+#include "dsp/Fft.h"
+
+namespace singwithme::dsp
+{
+// Partitioned-block frequency-domain NLMS echo canceller. The reference is what was sent to
+// the speakers; its estimated bleed is subtracted from the mic before VAD and pitch see it.
+// The filter is split into partitions of partitionSize taps, each updated per bin with a
+// step normalised by the smoothed reference power. One partition per block is constrained
+// back to a linear (non-circular) filter, so the cost per block stays bounded. Everything
+// is allocated in prepare(); output lags the input by partitionSize samples.
+class BleedCanceller
+{
+public:
+    static constexpr size_t kMaxPartitions = 256;
+
+    void prepare(size_t partitionSize, size_t filterLength, size_t maxBlockSize);
+    void reset();
+    void setStepSize(float stepSize) noexcept { stepSize_ = stepSize; }
+
+    // Feed the reference for the block just rendered, after process() was called for it.
+    // The one-block offset this introduces stays inside the modelled echo path.
+    void pushReference(const float* reference, size_t numSamples);
+    void process(const float* mic, float* output, size_t numSamples);
+
+    size_t latencySamples() const noexcept { return partitionSize_; }
+    size_t numPartitions() const noexcept { return numPartitions_; }
+    // Echo return loss enhancement over the last partitions, in dB (0 while idle).
+    float erleDb() const noexcept { return erleDb_; }
+
+private:
+    void processPartition();
+    void constrainPartition(size_t partition);
+
+    static void pushFifo(std::vector<float>& fifo, size_t& count, const float* samples, size_t numSamples);
+    static void popFifo(std::vector<float>& fifo, size_t& count, size_t numSamples);
+
+    Fft fft_;
+    size_t partitionSize_{0};
+    size_t numPartitions_{0};
+    size_t numBins_{0};
+    size_t maxBlockSize_{0};
+    float stepSize_{0.3f};
+
+    // Reference spectra, newest at spectraHead_, each numBins_ long.
+    std::vector<std::complex<float>> referenceSpectra_;
+    std::vector<std::complex<float>> weights_;
+    size_t spectraHead_{0};
+    size_t constrainNext_{0};
+
+    std::vector<float> binPower_;
+    std::vector<std::complex<float>> echoSpectrum_;
+    std::vector<std::complex<float>> errorSpectrum_;
+    std::vector<float> frame_;
+    std::vector<float> previousReference_;
+
+    std::vector<float> referenceFifo_;
+    std::vector<float> micFifo_;
+    std::vector<float> outputFifo_;
+    size_t referenceCount_{0};
+    size_t micCount_{0};
+    size_t outputCount_{0};
+    size_t outputRead_{0};
+
+    float micEnergy_{0.0f};
+    float errorEnergy_{0.0f};
+    float erleDb_{0.0f};
+};
+} // namespace singwithme::dsp
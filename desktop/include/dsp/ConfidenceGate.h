@@ -1,6 +1,9 @@
 #pragma once
 
 #include <cstddef>
+#include <cstdint>
+
+#include "dsp/OnsetMap.h"
 
 namespace singwithme::dsp
 {
@@ -22,6 +25,7 @@ struct GateConfig
     int framesOn{3};
     int framesOff{6};
     float duckDb{-80.0f};
+    bool predictiveOpen{true};
 };
 
 class ConfidenceGate
@@ -29,11 +33,31 @@ class ConfidenceGate
 public:
     void configure(float sampleRate, size_t blockSize, GateConfig config);
     void setManualMode(ManualMode mode);
+    void setThresholds(float thresholdOn, float thresholdOff);
+    // Retunes the envelope without resetting the gate's state, e.g. under host automation.
+    void setResponse(float attackMs, float releaseMs, float holdMs, float duckDb);
     ManualMode manualMode() const noexcept { return manualMode_; }
+    // Phrase context from guide alignment: phraseAware is blended into the confidence with
+    // the given weight, and an entry expected within lookAhead + attack opens on one frame.
+    void setPhraseContext(float phraseAware, float weight, float msUntilOnset);
+    // Guide onsets and the transport position of the next block. With predictiveOpen the gate
+    // starts its attack early enough to be open at each onset and holds through the entry.
+    void setGuideOnsets(const OnsetMap* onsets, double transportSeconds);
+    // Decides on pitch windows instead of audio blocks: each pushPitchFrame() is one frame for
+    // framesOn/framesOff, weighing the window's confidence with the VAD update() last saw, so
+    // the decision cadence follows models.pitchHopMs. update() then only runs the hold,
+    // predictive open and envelope. Kept across configure().
+    void setPitchFrames(bool enabled, float vadWeight, float pitchWeight);
+    // A pitch window's confidence, stamped with the model-rate sample the window ended on. A
+    // stamp equal to the last one is the same window again and is ignored.
+    void pushPitchFrame(float pitch, uint64_t endSample);
+    uint64_t pitchFrameCount() const noexcept { return pitchFrameCount_; }
     float update(float confidence, float vad, float pitch);
     float currentGainDb() const noexcept { return gainDb_; }
 
 private:
+    void decide(float confidence);
+
     GateConfig config_{};
     float sampleRate_{48000.0f};
     size_t blockSize_{128};
@@ -42,6 +66,17 @@ private:
     float holdTimerMs_{0.0f};
     int consecutiveOn_{0};
     int consecutiveOff_{0};
+    float phraseAware_{0.0f};
+    float phraseWeight_{0.0f};
+    float msUntilOnset_{-1.0f};
+    const OnsetMap* onsets_{nullptr};
+    double transportSeconds_{0.0};
     ManualMode manualMode_{ManualMode::Auto};
+    bool pitchFramed_{false};
+    float frameVadWeight_{0.0f};
+    float framePitchWeight_{1.0f};
+    float lastVad_{0.0f};
+    uint64_t lastFrameEnd_{0};
+    uint64_t pitchFrameCount_{0};
 };
 } // namespace singwithme::dsp
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace singwithme::dsp
+{
+// Integer-sample delay over a ring buffer sized once in prepare(). setDelay() takes effect
+// on the next process() call and is clamped to the prepared maximum.
+class DelayLine
+{
+public:
+    void prepare(size_t maxDelaySamples);
+    void reset();
+    void setDelay(size_t delaySamples) noexcept;
+    size_t delay() const noexcept { return delay_; }
+    void process(const float* input, float* output, size_t numSamples) noexcept;
+
+private:
+    std::vector<float> buffer_;
+    size_t mask_{0};
+    size_t writeIndex_{0};
+    size_t delay_{0};
+};
+} // namespace singwithme::dsp
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+namespace singwithme::dsp
+{
+// Stereo tail for the guide stem: an 8-line feedback delay network with an orthonormal
+// Hadamard feedback matrix and a one-pole absorption filter per line, so highs die away
+// faster than lows. The line lengths are fixed and mutually prime; the tail time only sets
+// the loop gains, which glide towards new targets block by block, and the wet level ramps
+// per sample, so parameter changes never click. The work per sample does not depend on the
+// settings. Everything is allocated in prepare().
+class FdnReverb
+{
+public:
+    static constexpr size_t kLines = 8;
+    static constexpr float kMinTailSeconds = 0.05f;
+    static constexpr float kMaxTailSeconds = 10.0f;
+
+    void prepare(double sampleRate);
+    void reset();
+
+    // Safe to call from any thread; picked up at the next process().
+    void setTail(float mix, float tailSeconds) noexcept;
+    // Adds mix times the wet signal of the mono input to left and right. input may alias
+    // either output.
+    void process(const float* input, float* left, float* right, size_t numSamples) noexcept;
+
+private:
+    void updateTargets(float tailSeconds) noexcept;
+
+    std::vector<float> lines_; // kLines rings of capacity_
+    size_t capacity_{0};
+    size_t mask_{0};
+    size_t writeIndex_{0};
+    double sampleRate_{48000.0};
+    std::array<size_t, kLines> lengths_{};
+
+    alignas(32) std::array<float, kLines> state_{};
+    alignas(32) std::array<float, kLines> gain_{};
+    alignas(32) std::array<float, kLines> pole_{};
+    alignas(32) std::array<float, kLines> targetGain_{};
+    alignas(32) std::array<float, kLines> targetPole_{};
+    float mix_{0.0f};
+    float appliedTail_{-1.0f};
+
+    std::atomic<float> targetMix_{0.0f};
+    std::atomic<float> targetTail_{0.5f};
+};
+} // namespace singwithme::dsp
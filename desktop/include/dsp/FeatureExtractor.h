@@ -0,0 +1,77 @@
+#pragma once
+
+#include <array>
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "dsp/Fft.h"
+
+namespace singwithme::dsp
+{
+constexpr size_t kNumMfcc = 4;
+
+struct FeatureFrame
+{
+    float energyDb{-100.0f};
+    float pitchSemitones{0.0f}; // relative to 100 Hz, 0 when unvoiced
+    float voicing{0.0f};        // normalised autocorrelation peak
+    std::array<float, kNumMfcc> mfcc{};
+};
+
+// Per-hop features of the guide stem, computed once per load. nextOnset[i] is the first
+// phrase onset at or after frame i (or -1), so "time to next entry" is a single lookup.
+struct GuideFeatureTrack
+{
+    double hopSeconds{0.01};
+    std::vector<FeatureFrame> frames;
+    std::vector<uint8_t> active;
+    std::vector<int32_t> nextOnset;
+};
+
+// 32 ms frames every 10 ms at 16 kHz: energy, autocorrelation pitch and a few MFCCs from a
+// shared 1024-point FFT. push()/nextFrame() are allocation-free once prepared.
+class FeatureExtractor
+{
+public:
+    static constexpr size_t kFrameSamples = 512;
+    static constexpr size_t kHopSamples = 160;
+
+    void prepare(double sampleRate);
+    void reset();
+
+    void push(const float* samples, size_t count);
+    size_t pendingFrames() const noexcept;
+    void discardBacklog(size_t keepFrames);
+    bool nextFrame(FeatureFrame& frame);
+
+    FeatureFrame analyse(const float* window);
+    GuideFeatureTrack analyseGuide(const float* samples, size_t count);
+
+    double hopSeconds() const noexcept { return static_cast<double>(kHopSamples) / sampleRate_; }
+
+private:
+    struct MelBand
+    {
+        size_t firstBin{0};
+        size_t weightOffset{0};
+        size_t numWeights{0};
+    };
+
+    double sampleRate_{16000.0};
+    Fft fft_;
+    std::vector<float> hann_;
+    std::vector<float> fftInput_;
+    std::vector<std::complex<float>> spectrum_;
+    std::vector<float> autocorrelation_;
+    std::vector<MelBand> melBands_;
+    std::vector<float> melWeights_;
+    std::vector<float> logMel_;
+    std::vector<float> dctTable_;
+
+    std::vector<float> buffer_;
+    size_t readPos_{0};
+    size_t fill_{0};
+};
+} // namespace singwithme::dsp
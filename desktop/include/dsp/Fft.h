@@ -0,0 +1,40 @@
+#pragma once
+
+#include <complex>
+#include <cstddef>
+#include <vector>
+
+namespace singwithme::dsp
+{
+// Radix-2 FFT with twiddles and bit-reversal tables built in prepare(); the transforms
+// themselves never allocate. Real transforms run through a half-size complex FFT.
+class Fft
+{
+public:
+    void prepare(size_t size);
+    size_t size() const noexcept { return size_; }
+    size_t numBins() const noexcept { return size_ / 2 + 1; }
+
+    void forward(std::complex<float>* data) const;
+    void inverse(std::complex<float>* data) const;
+
+    // spectrum holds numBins() values. inverseReal() scales by 1/size.
+    void forwardReal(const float* input, std::complex<float>* spectrum);
+    void inverseReal(const std::complex<float>* spectrum, float* output);
+
+private:
+    static void transform(std::complex<float>* data,
+                          size_t size,
+                          const std::vector<size_t>& bitReverse,
+                          const std::vector<std::complex<float>>& twiddles,
+                          bool inverse);
+
+    size_t size_{0};
+    std::vector<size_t> bitReverse_;
+    std::vector<std::complex<float>> twiddles_;
+    std::vector<size_t> halfBitReverse_;
+    std::vector<std::complex<float>> halfTwiddles_;
+    std::vector<std::complex<float>> realTwiddles_;
+    std::vector<std::complex<float>> scratch_;
+};
+} // namespace singwithme::dsp
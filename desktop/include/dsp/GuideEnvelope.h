@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+
+namespace singwithme::dsp
+{
+struct GuideEnvelopeConfig
+{
+    float holdMs{70.0f};
+    float releaseMs{236.0f};
+    float releaseMod{0.29f};  // release slows by this fraction at full confidence
+    float tailMix{0.02f};
+    float tailSeconds{0.32f};
+    float duckDb{-18.0f};     // the gate's floor, mapped to an envelope of 0
+    float noiseFloor{0.22f};  // detection peak that counts as the singer on its own
+};
+
+// Turns the gate's gain into the guide's mix and reverb-send levels. A noise gate with a
+// short hold keeps the guide down while only the room is heard, the envelope attacks in
+// 20 ms and releases after holdMs at a rate that slows with confidence, and the tail send
+// follows the envelope slowly so the reverb rings out instead of cutting. Called once per
+// block; every time constant is in milliseconds, so the result does not depend on the
+// block size.
+class GuideEnvelope
+{
+public:
+    struct Levels
+    {
+        float guideMix{0.0f};
+        float tailMix{0.0f};
+    };
+
+    void configure(double sampleRate, GuideEnvelopeConfig config);
+    // Keeps the current envelope; for settings that change while playing.
+    void setConfig(GuideEnvelopeConfig config) noexcept { config_ = config; }
+    void reset() noexcept;
+
+    // peak: the block's largest detection sample. vocalStrength: 0..1 from the caller's
+    // level follower, which blends the mix between a floor and full.
+    Levels update(size_t numSamples, float peak, float gainDb, float confidence, float vocalStrength, bool playing) noexcept;
+
+private:
+    GuideEnvelopeConfig config_{};
+    double sampleRate_{48000.0};
+    float noiseGate_{0.0f};
+    float noiseGateHoldMs_{0.0f};
+    float envelope_{0.0f};
+    float releaseHoldMs_{0.0f};
+    float tailFollower_{0.0f};
+};
+} // namespace singwithme::dsp
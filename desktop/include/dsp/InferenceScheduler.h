@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace singwithme::dsp
+{
+enum class InferenceDecision
+{
+    Run,
+    ResetAndRun, // first run after a long skip; recurrent models start from a clean state
+    Skip
+};
+
+// Energy / zero-crossing pre-detector in front of a model. Frames clearly below the
+// calibrated noise floor are skipped after a short hangover, borderline frames can be
+// thinned to every Nth run, and the first frame above the floor always runs, so full-rate
+// inference resumes within one frame of an onset.
+class InferenceScheduler
+{
+public:
+    struct Settings
+    {
+        int hangoverFrames{0};   // silent frames still sent to the model after activity
+        int thinInterval{1};     // run every Nth borderline frame (1 = never thin)
+        int stateResetFrames{0}; // skips after which the next run starts from reset state (0 = never)
+    };
+
+    void prepare(Settings settings);
+    void reset() noexcept;
+    void setNoiseFloorDb(float noiseFloorDb) noexcept;
+
+    InferenceDecision next(const float* samples, size_t count) noexcept;
+    float lastMeanSquare() const noexcept { return lastMeanSquare_; }
+
+    uint64_t framesSeen() const noexcept { return framesSeen_.load(std::memory_order_relaxed); }
+    uint64_t framesSkipped() const noexcept { return framesSkipped_.load(std::memory_order_relaxed); }
+    float skippedPercent() const noexcept;
+
+private:
+    enum class Activity
+    {
+        Silent,
+        Borderline,
+        Active
+    };
+
+    Activity classify(const float* samples, size_t count) noexcept;
+
+    Settings settings_{};
+    std::atomic<float> noiseFloorDb_{-70.0f};
+    float lastMeanSquare_{0.0f};
+    int silentRun_{0};
+    int skippedRun_{0};
+    int thinCounter_{0};
+    std::atomic<uint64_t> framesSeen_{0};
+    std::atomic<uint64_t> framesSkipped_{0};
+};
+} // namespace singwithme::dsp
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace singwithme::dsp
+{
+// How a buffer handed to a player that starts at its first sample, and wraps at its end when
+// looping, maps onto song positions. Positions and offsets are in samples.
+struct PlaybackSpan
+{
+    int64_t origin{0}; // song sample at buffer sample 0; inside the loop when looping
+    int64_t loopStart{0};
+    int64_t loopEnd{0}; // not after loopStart: plays on to the song's end
+
+    bool looping() const noexcept { return loopEnd > loopStart; }
+    // Song sample played offset samples into the buffer; negative before it starts.
+    int64_t position(int64_t offset) const noexcept;
+    // Samples from offset until the song sample target plays; -1 if it never does.
+    int64_t distanceTo(int64_t offset, int64_t target) const noexcept;
+    // Buffer length for a song of songLength samples: one loop period, or the rest of the song.
+    int64_t bufferLength(int64_t songLength) const noexcept;
+};
+
+// Lays stems out along a PlaybackSpan with the loop boundary crossfaded. The loop's last
+// samples fade out (equal power) while the material leading up to loopStart fades in, so
+// the wrap from loopEnd back to loopStart continues exactly where the fade-in left off. Each
+// crossfaded sample is computed as it is read: once per layout for the core's tracks, and on
+// every pass for a stem read in place. A loop with no material before loopStart (a whole-song
+// loop) has nothing to fade in and wraps without a crossfade.
+class LoopLayout
+{
+public:
+    void prepare(size_t crossfadeSamples);
+    // The fade for one span: at most half its loop and no longer than the pre-roll before it.
+    int64_t crossfadeLength(const PlaybackSpan& span) const noexcept;
+    // First song sample where the span's crossfade starts; loopEnd when it does not loop.
+    int64_t crossfadeStart(const PlaybackSpan& span) const noexcept;
+
+    // Writes count buffer samples of one channel from offset on. Song samples past the stem's
+    // end, or before the span starts, are silent.
+    void render(const float* stem,
+                int64_t stemLength,
+                const PlaybackSpan& span,
+                int64_t offset,
+                float* out,
+                int64_t count) const noexcept;
+    // Where render() would be a plain copy: the song sample the range starts at, or -1 if it
+    // wraps, crossfades or leaves the stem.
+    int64_t directRead(const PlaybackSpan& span, int64_t offset, int64_t count, int64_t stemLength) const noexcept;
+
+private:
+    float crossfaded(const float* stem, int64_t stemLength, const PlaybackSpan& span, int64_t position) const noexcept;
+
+    std::vector<float> fadeIn_; // sin over the quarter period; the fade-out reads it backwards
+};
+} // namespace singwithme::dsp
@@ -0,0 +1,84 @@
+#pragma once
+
+#if TUNETRIX_ONNX_RUNTIME
+ #include <onnxruntime_cxx_api.h>
+#else
+#ifndef TUNETRIX_ORT_ENV_STUB
+ #define TUNETRIX_ORT_ENV_STUB
+  namespace Ort
+  {
+  struct Env {};
+  }
+ #endif
+#endif
+
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace singwithme::dsp
+{
+// The process's one Env. It is created with ORT's global thread pools, so sessions opened
+// against it share those pools instead of each starting its own.
+Ort::Env& sharedOrtEnvironment();
+
+#if TUNETRIX_ONNX_RUNTIME
+// A model file mapped read-only. Every session and every app instance that maps the same
+// file shares its pages through the OS page cache.
+class MappedModel
+{
+public:
+    static std::shared_ptr<const MappedModel> open(const std::string& path);
+    ~MappedModel();
+
+    MappedModel(const MappedModel&) = delete;
+    MappedModel& operator=(const MappedModel&) = delete;
+
+    const void* data() const noexcept { return data_; }
+    size_t size() const noexcept { return size_; }
+    const std::string& path() const noexcept { return path_; }
+
+private:
+    MappedModel() = default;
+
+    std::string path_;
+    const void* data_{nullptr};
+    size_t size_{0};
+#ifdef _WIN32
+    void* file_{nullptr};
+    void* mapping_{nullptr};
+#endif
+};
+
+struct ModelSession
+{
+    std::shared_ptr<const MappedModel> model; // declared first so it outlives the session
+    std::unique_ptr<Ort::Session> session;
+
+    explicit operator bool() const noexcept { return session != nullptr; }
+    Ort::Session* operator->() const noexcept { return session.get(); }
+};
+
+// Opens sessions from memory-mapped models. A model is mapped once while any session uses
+// it, and weights prepacked for one session are reused by the next through a shared
+// container. An ORT-format sibling (model.ort next to model.onnx) is preferred when present:
+// its initializers are used in place from the mapping, so they are shared physically across
+// sessions and processes, whereas an .onnx file is parsed into private copies.
+class ModelStore
+{
+public:
+    static ModelStore& instance();
+
+    ModelSession openSession(Ort::Env& env, const std::string& modelPath, Ort::SessionOptions& options);
+
+private:
+    ModelStore() = default;
+
+    std::mutex mutex_;
+    std::map<std::string, std::weak_ptr<const MappedModel>> models_;
+    Ort::PrepackedWeightsContainer prepackedWeights_;
+};
+#endif
+} // namespace singwithme::dsp
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "dsp/FeatureExtractor.h"
+
+namespace singwithme::dsp
+{
+// Streaming DTW of live feature frames against a precomputed guide track. Only a band of
+// 2 * bandRadius + 1 reference frames around the expected position is evaluated per
+// step, and only the previous column is kept, so time and memory are O(band).
+class OnlineDtwAligner
+{
+public:
+    struct Step
+    {
+        int64_t alignedFrame{-1};
+        float localCost{1.0f};
+    };
+
+    void prepare(int bandRadius);
+    void reset();
+    Step step(const FeatureFrame& live, const GuideFeatureTrack& reference, int64_t expectedFrame);
+
+    int bandRadius() const noexcept { return bandRadius_; }
+    static float distance(const FeatureFrame& live, const FeatureFrame& reference);
+
+private:
+    int bandRadius_{50};
+    std::vector<float> previous_;
+    std::vector<float> current_;
+    int64_t previousCentre_{0};
+    bool primed_{false};
+};
+} // namespace singwithme::dsp
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace singwithme::dsp
+{
+// Guide-stem entry points, built offline from per-hop VAD probabilities and frame energies.
+// nextOnset_ holds, for every hop, the first onset at or after it, so the time to the next
+// entry from any transport position is a single table lookup.
+class OnsetMap
+{
+public:
+    static OnsetMap build(const float* vadProbability, const float* energyDb, size_t numHops, double hopSeconds);
+
+    bool empty() const noexcept { return onsets_.empty(); }
+    const std::vector<int32_t>& onsets() const noexcept { return onsets_; }
+    double hopSeconds() const noexcept { return hopSeconds_; }
+
+    // Milliseconds from positionSeconds to the next onset, or -1 if there is none.
+    float msUntilOnset(double positionSeconds) const noexcept;
+
+private:
+    double hopSeconds_{0.01};
+    std::vector<int32_t> onsets_;
+    std::vector<int32_t> nextOnset_;
+};
+} // namespace singwithme::dsp
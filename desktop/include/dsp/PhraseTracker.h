@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "dsp/FeatureExtractor.h"
+#include "dsp/OnlineDtwAligner.h"
+
+namespace singwithme::dsp
+{
+struct PhraseEstimate
+{
+    float phraseAware{0.0f};
+    float msUntilOnset{-1.0f};
+    int64_t alignedFrame{-1};
+    // Semitones above 100 Hz of the live frame and of the guide frame it aligned to; 0 while
+    // either is unvoiced.
+    float micPitchSemitones{0.0f};
+    float guidePitchSemitones{0.0f};
+};
+
+// Aligns the live mic against the guide feature track on the audio thread. Work per
+// callback is capped at kMaxStepsPerBlock feature frames (older backlog is dropped), so
+// the cost is at most two FFT frames and two DTW columns.
+class PhraseTracker
+{
+public:
+    static constexpr size_t kMaxStepsPerBlock = 2;
+
+    // The mic arrives at modelSampleRate through a feed that delays it by feedLatencySamples
+    // at sampleRate, the transport's rate.
+    void prepare(double sampleRate, double modelSampleRate, size_t feedLatencySamples, int bandRadiusFrames = 50);
+    void reset();
+    void setReference(const GuideFeatureTrack* track);
+    void push(const float* modelSamples, size_t numSamples);
+    // Aligns what push() delivered, the block ending at transportSample. While not listening
+    // the estimate decays.
+    PhraseEstimate process(bool listening, int64_t transportSample);
+    const PhraseEstimate& latest() const noexcept { return latest_; }
+
+private:
+    double sampleRate_{48000.0};
+    double modelSampleRate_{16000.0};
+    size_t feedLatencySamples_{0};
+    FeatureExtractor features_;
+    OnlineDtwAligner aligner_;
+    const GuideFeatureTrack* reference_{nullptr};
+    PhraseEstimate latest_{};
+};
+} // namespace singwithme::dsp
@@ -12,12 +12,25 @@
  #endif
 #endif
 
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <vector>
 
+#include "dsp/InferenceScheduler.h"
+#include "dsp/ModelStore.h"
+#include "dsp/SlidingWindow.h"
+
 namespace singwithme::dsp
 {
+// A pitch confidence stamped with where its window ended, in model-rate samples since the
+// processor was created or its hop last changed.
+struct PitchEstimate
+{
+    float confidence{0.0f};
+    uint64_t endSample{0};
+};
+
 #if TUNETRIX_ONNX_RUNTIME
 class PitchProcessor
 {
@@ -25,27 +38,72 @@ public:
     explicit PitchProcessor(Ort::Env& env);
 
     void loadModel(const std::string& modelPath);
+    void setNoiseFloorDb(float noiseFloorDb);
+    float inferenceSkippedPercent() const noexcept { return scheduler_.skippedPercent(); }
     float processHop(const float* samples, size_t sampleCount);
 
+    // Sliding-window tracking: a 1024-sample window every hopSamples of the 16 kHz stream
+    // (1024, the default, is the non-overlapping hop processHop() runs on). Not real-time safe.
+    void setHopSamples(size_t hopSamples);
+    size_t hopSamples() const noexcept { return window_.hopSamples(); }
+    // Appends 16 kHz samples and runs every window that became due, in one batched model run
+    // when the model has a dynamic batch dimension. Returns the number of new estimates.
+    size_t push(const float* samples, size_t sampleCount);
+    // The estimates of the last push(), index < the count it returned, oldest first.
+    PitchEstimate pushedEstimate(size_t index) const noexcept { return pushed_[index]; }
+    PitchEstimate latestEstimate() const noexcept { return latest_; }
+    // While streamed, the model only runs on what push() is fed; processHop() returns the
+    // latest estimate instead.
+    void setStreamed(bool streamed) noexcept { streamed_ = streamed; }
+
 private:
+    void runBatch(size_t rows);
+
     Ort::Env& env_;
-    std::unique_ptr<Ort::Session> session_;
+    ModelSession session_;
     Ort::SessionOptions options_;
     std::vector<float> inputBuffer_;
     std::vector<float> probabilities_;
+    InferenceScheduler scheduler_;
+    float lastConfidence_{0.0f};
+    SlidingWindow window_;
+    std::vector<float> batchInput_;
+    std::vector<float> batchConfidence_;
+    std::vector<uint8_t> runWindow_;
+    bool batchedModel_{false};
+    bool streamed_{false};
+    std::vector<PitchEstimate> pushed_;
+    PitchEstimate latest_;
 };
 #else
 class PitchProcessor
 {
 public:
-    explicit PitchProcessor(Ort::Env&) {}
+    explicit PitchProcessor(Ort::Env&);
     void loadModel(const std::string&) {}
+    void setNoiseFloorDb(float noiseFloorDb);
+    float inferenceSkippedPercent() const noexcept { return scheduler_.skippedPercent(); }
     float processHop(const float* samples, size_t sampleCount);
 
+    void setHopSamples(size_t hopSamples);
+    size_t hopSamples() const noexcept { return window_.hopSamples(); }
+    size_t push(const float* samples, size_t sampleCount);
+    PitchEstimate pushedEstimate(size_t index) const noexcept { return pushed_[index]; }
+    PitchEstimate latestEstimate() const noexcept { return latest_; }
+    void setStreamed(bool streamed) noexcept { streamed_ = streamed; }
+
 private:
+    float estimate(const float* samples, size_t sampleCount, float smoothing);
     static float estimateAutocorrelation(const float* samples, size_t sampleCount, int lag);
 
+    InferenceScheduler scheduler_;
+    SlidingWindow window_;
+    std::vector<PitchEstimate> pushed_;
+    PitchEstimate latest_;
+    bool streamed_{false};
+
     float smoothedConfidence_{0.0f};
+    float windowSmoothing_{0.4f};
 };
 #endif
 } // namespace singwithme::dsp
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace singwithme::dsp
+{
+// Pitch-synchronous overlap-add (TD-PSOLA) shifter for the guide stem. Grains two pitch
+// periods long are cut at pitch marks one period apart and overlap-added at marks spaced
+// period / ratio, which moves the pitch but keeps the formants. The period comes from the
+// guide's precomputed pitch track; marks are snapped to the waveform peak near it. Latency
+// is fixed at two maximum half-grains; everything is allocated in prepare() and process()
+// never allocates.
+class PitchShifter
+{
+public:
+    static constexpr double kMaxHalfGrainSeconds = 0.009;
+    static constexpr double kMinRatio = 0.5;
+    static constexpr double kMaxRatio = 2.5;
+
+    void prepare(double sampleRate, size_t maxBlockSize);
+    void reset();
+
+    // Reached gradually, one grain at a time, so ratio changes never click.
+    void setRatio(double ratio) noexcept;
+    // Pitch period of the input in samples; 0 while unvoiced.
+    void setPeriod(double periodSamples) noexcept;
+    // In-place safe.
+    void process(const float* input, float* output, size_t numSamples) noexcept;
+
+    size_t latencySamples() const noexcept { return latency_; }
+    double ratio() const noexcept { return ratio_; }
+
+private:
+    void processChunk(const float* input, float* output, size_t numSamples) noexcept;
+    void placeGrain(int64_t emittedUpTo) noexcept;
+    int64_t findPitchMark(int64_t predicted, double period) const noexcept;
+    void buildWindow(size_t halfGrain);
+
+    std::vector<float> input_;  // mirrored: 2 * capacity_
+    std::vector<float> output_; // overlap-add accumulator
+    std::vector<float> weight_; // window sum per output sample
+    std::vector<float> window_;
+    size_t windowHalf_{0};
+    size_t capacity_{0};
+    size_t mask_{0};
+    size_t maxBlock_{0};
+    size_t maxHalfGrain_{0};
+    size_t latency_{0};
+    double sampleRate_{48000.0};
+
+    int64_t written_{0};
+    int64_t analysisMark_{0};
+    int64_t nextAnalysisMark_{0};
+    double synthesisMark_{0.0};
+    double period_{0.0};
+    double unvoicedPeriod_{240.0};
+    double targetRatio_{1.0};
+    double ratio_{1.0};
+};
+} // namespace singwithme::dsp
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace singwithme::dsp
+{
+enum class ResamplerQuality
+{
+    Lagrange,
+    SincFast,
+    SincBest
+};
+
+// Rational-ratio resampler shared by stem loading (offline, render()) and the model feed
+// (streaming, process()). Sinc tiers use windowed-sinc polyphase banks; the common
+// 44.1 <-> 48 kHz and 48 -> 16 kHz banks are built at compile time.
+class Resampler
+{
+public:
+    void prepare(double sourceRate, double targetRate, ResamplerQuality quality, size_t maxBlockSize);
+    void reset();
+
+    // Streaming: consumes every input sample and returns how many outputs were written.
+    // Never allocates; maxOutput must cover numInput * targetRate / sourceRate + 1, or input
+    // past what it has room for is dropped.
+    size_t process(const float* input, size_t numInput, float* output, size_t maxOutput);
+
+    // Offline: renders outputs [outputStart, outputStart + outputCount) of the whole signal.
+    // Stateless, so disjoint ranges can be rendered concurrently from one prepared instance.
+    void render(const float* input,
+                size_t inputLength,
+                float* output,
+                size_t outputStart,
+                size_t outputCount) const;
+
+    static size_t outputLength(size_t inputLength, double sourceRate, double targetRate);
+
+    ResamplerQuality quality() const noexcept { return quality_; }
+    size_t latencySamples() const noexcept { return polyphase_ ? taps_ / 2 : 2; }
+
+private:
+    float renderPolyphase(const float* input, size_t inputLength, uint64_t outputIndex) const;
+    float renderLagrange(const float* input, size_t inputLength, double position) const;
+    bool isPassthrough() const noexcept { return upFactor_ == downFactor_; }
+
+    ResamplerQuality quality_{ResamplerQuality::Lagrange};
+    double ratio_{1.0};
+    bool rational_{false};
+    bool polyphase_{false};
+    uint64_t upFactor_{1};
+    uint64_t downFactor_{1};
+    size_t taps_{0};
+    const float* bank_{nullptr};
+    std::vector<float> runtimeBank_;
+
+    std::vector<float> history_;
+    size_t historyFill_{0};
+    uint64_t streamPhase_{0};
+    double streamPosition_{0.0};
+};
+} // namespace singwithme::dsp
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace singwithme::dsp
+{
+// Sparse gain matrix from planar sources to device output channels: each route adds one
+// source to one output at its own gain. process() makes a single pass over the block in
+// short tiles; for every routed output it clears the tile and accumulates that output's
+// routes into it, so the work is one SIMD multiply-add per route and sample however many
+// outputs there are, and the tile stays in cache while its routes are summed. Outputs no
+// route writes are left untouched.
+class RoutingMatrix
+{
+public:
+    // Channel counts the routing config accepts; process() itself takes any.
+    static constexpr size_t kMaxSources = 8;
+    static constexpr size_t kMaxOutputs = 16;
+
+    // Not real-time safe. Returns the route's index for setGain().
+    size_t addRoute(size_t source, size_t output, float gain);
+    void clearRoutes();
+    size_t numRoutes() const noexcept { return routes_.size(); }
+    // One past the highest output any route writes; zero without routes.
+    size_t outputsUsed() const noexcept;
+
+    // Call from the thread that runs process(). The gain ramps linearly to the new value
+    // over the next block.
+    void setGain(size_t route, float gain) noexcept;
+
+    // Sources that are null or beyond numSources count as silence; outputs that are null or
+    // beyond numOutputs are skipped.
+    void process(const float* const* sources,
+                 size_t numSources,
+                 float* const* outputs,
+                 size_t numOutputs,
+                 size_t numSamples) noexcept;
+
+private:
+    struct Route
+    {
+        size_t source{0};
+        size_t output{0};
+        float gain{0.0f};
+        float target{0.0f};
+        float step{0.0f};
+    };
+
+    std::vector<Route> routes_;
+    // Route indices ordered by output, so each output's routes are adjacent.
+    std::vector<size_t> order_;
+};
+} // namespace singwithme::dsp
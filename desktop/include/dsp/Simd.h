@@ -0,0 +1,342 @@
+#pragma once
+
+#include <bit>
+#include <cmath>
+#include <complex>
+#include <cstddef>
+
+#if defined(__AVX2__) && defined(__FMA__)
+ #include <immintrin.h>
+ #define TUNETRIX_SIMD_AVX2 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+ #include <arm_neon.h>
+ #define TUNETRIX_SIMD_NEON 1
+#elif defined(__wasm_simd128__)
+ // The web worklet build (emcc -msimd128). Baseline SIMD128 has no FMA.
+ #include <wasm_simd128.h>
+ #define TUNETRIX_SIMD_WASM 1
+#endif
+
+namespace singwithme::dsp::simd
+{
+inline float dotProduct(const float* a, const float* b, size_t count) noexcept
+{
+    size_t i = 0;
+    float sum = 0.0f;
+#if TUNETRIX_SIMD_AVX2
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    for (; i + 16 <= count; i += 16)
+    {
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+        acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8), acc1);
+    }
+    for (; i + 8 <= count; i += 8)
+    {
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+    }
+    const __m256 acc = _mm256_add_ps(acc0, acc1);
+    const __m128 folded = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+    const __m128 pairs = _mm_add_ps(folded, _mm_movehl_ps(folded, folded));
+    sum = _mm_cvtss_f32(_mm_add_ss(pairs, _mm_shuffle_ps(pairs, pairs, 0x55)));
+#elif TUNETRIX_SIMD_NEON
+    float32x4_t acc0 = vdupq_n_f32(0.0f);
+    float32x4_t acc1 = vdupq_n_f32(0.0f);
+    for (; i + 8 <= count; i += 8)
+    {
+        acc0 = vfmaq_f32(acc0, vld1q_f32(a + i), vld1q_f32(b + i));
+        acc1 = vfmaq_f32(acc1, vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+    }
+    sum = vaddvq_f32(vaddq_f32(acc0, acc1));
+#elif TUNETRIX_SIMD_WASM
+    v128_t acc0 = wasm_f32x4_splat(0.0f);
+    v128_t acc1 = wasm_f32x4_splat(0.0f);
+    for (; i + 8 <= count; i += 8)
+    {
+        acc0 = wasm_f32x4_add(acc0, wasm_f32x4_mul(wasm_v128_load(a + i), wasm_v128_load(b + i)));
+        acc1 = wasm_f32x4_add(acc1, wasm_f32x4_mul(wasm_v128_load(a + i + 4), wasm_v128_load(b + i + 4)));
+    }
+    const v128_t acc = wasm_f32x4_add(acc0, acc1);
+    sum = (wasm_f32x4_extract_lane(acc, 0) + wasm_f32x4_extract_lane(acc, 1))
+          + (wasm_f32x4_extract_lane(acc, 2) + wasm_f32x4_extract_lane(acc, 3));
+#endif
+    for (; i < count; ++i)
+    {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+inline float sumOfSquares(const float* x, size_t count) noexcept
+{
+    return dotProduct(x, x, count);
+}
+
+// Number of sign changes between neighbouring samples of x[0..count).
+inline size_t zeroCrossings(const float* x, size_t count) noexcept
+{
+    if (count < 2)
+    {
+        return 0;
+    }
+
+    size_t i = 0;
+    size_t crossings = 0;
+    const size_t pairs = count - 1;
+#if TUNETRIX_SIMD_AVX2
+    for (; i + 8 <= pairs; i += 8)
+    {
+        const __m256 signs = _mm256_xor_ps(_mm256_loadu_ps(x + i), _mm256_loadu_ps(x + i + 1));
+        crossings += static_cast<size_t>(std::popcount(static_cast<unsigned>(_mm256_movemask_ps(signs))));
+    }
+#elif TUNETRIX_SIMD_NEON
+    uint32x4_t acc = vdupq_n_u32(0);
+    for (; i + 4 <= pairs; i += 4)
+    {
+        const uint32x4_t a = vreinterpretq_u32_f32(vld1q_f32(x + i));
+        const uint32x4_t b = vreinterpretq_u32_f32(vld1q_f32(x + i + 1));
+        acc = vaddq_u32(acc, vshrq_n_u32(veorq_u32(a, b), 31));
+    }
+    crossings = vaddvq_u32(acc);
+#elif TUNETRIX_SIMD_WASM
+    v128_t acc = wasm_i32x4_splat(0);
+    for (; i + 4 <= pairs; i += 4)
+    {
+        const v128_t signs = wasm_v128_xor(wasm_v128_load(x + i), wasm_v128_load(x + i + 1));
+        acc = wasm_i32x4_add(acc, wasm_u32x4_shr(signs, 31));
+    }
+    crossings = static_cast<size_t>(wasm_i32x4_extract_lane(acc, 0) + wasm_i32x4_extract_lane(acc, 1)
+                                    + wasm_i32x4_extract_lane(acc, 2) + wasm_i32x4_extract_lane(acc, 3));
+#endif
+    for (; i < pairs; ++i)
+    {
+        crossings += std::signbit(x[i]) != std::signbit(x[i + 1]) ? 1 : 0;
+    }
+    return crossings;
+}
+
+// acc[k] += a[k] * b[k].
+inline void multiplyAccumulate(const float* a, const float* b, float* acc, size_t count) noexcept
+{
+    size_t i = 0;
+#if TUNETRIX_SIMD_AVX2
+    for (; i + 8 <= count; i += 8)
+    {
+        _mm256_storeu_ps(acc + i, _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), _mm256_loadu_ps(acc + i)));
+    }
+#elif TUNETRIX_SIMD_NEON
+    for (; i + 4 <= count; i += 4)
+    {
+        vst1q_f32(acc + i, vfmaq_f32(vld1q_f32(acc + i), vld1q_f32(a + i), vld1q_f32(b + i)));
+    }
+#elif TUNETRIX_SIMD_WASM
+    for (; i + 4 <= count; i += 4)
+    {
+        wasm_v128_store(acc + i, wasm_f32x4_add(wasm_v128_load(acc + i), wasm_f32x4_mul(wasm_v128_load(a + i), wasm_v128_load(b + i))));
+    }
+#endif
+    for (; i < count; ++i)
+    {
+        acc[i] += a[i] * b[i];
+    }
+}
+
+// acc[k] += a[k].
+inline void accumulate(const float* a, float* acc, size_t count) noexcept
+{
+    size_t i = 0;
+#if TUNETRIX_SIMD_AVX2
+    for (; i + 8 <= count; i += 8)
+    {
+        _mm256_storeu_ps(acc + i, _mm256_add_ps(_mm256_loadu_ps(acc + i), _mm256_loadu_ps(a + i)));
+    }
+#elif TUNETRIX_SIMD_NEON
+    for (; i + 4 <= count; i += 4)
+    {
+        vst1q_f32(acc + i, vaddq_f32(vld1q_f32(acc + i), vld1q_f32(a + i)));
+    }
+#elif TUNETRIX_SIMD_WASM
+    for (; i + 4 <= count; i += 4)
+    {
+        wasm_v128_store(acc + i, wasm_f32x4_add(wasm_v128_load(acc + i), wasm_v128_load(a + i)));
+    }
+#endif
+    for (; i < count; ++i)
+    {
+        acc[i] += a[i];
+    }
+}
+
+// acc[k] += a[k] * (gain + step * k): a gain ramp, or a constant gain when step is zero.
+inline void rampMultiplyAccumulate(const float* a, float gain, float step, float* acc, size_t count) noexcept
+{
+    size_t i = 0;
+#if TUNETRIX_SIMD_AVX2
+    const __m256 lanes = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+    const __m256 steps = _mm256_set1_ps(step);
+    for (; i + 8 <= count; i += 8)
+    {
+        const __m256 gains = _mm256_fmadd_ps(lanes, steps, _mm256_set1_ps(gain + step * static_cast<float>(i)));
+        _mm256_storeu_ps(acc + i, _mm256_fmadd_ps(_mm256_loadu_ps(a + i), gains, _mm256_loadu_ps(acc + i)));
+    }
+#elif TUNETRIX_SIMD_NEON
+    const float laneValues[4] = {0.0f, 1.0f, 2.0f, 3.0f};
+    const float32x4_t lanes = vld1q_f32(laneValues);
+    for (; i + 4 <= count; i += 4)
+    {
+        const float32x4_t gains = vmlaq_n_f32(vdupq_n_f32(gain + step * static_cast<float>(i)), lanes, step);
+        vst1q_f32(acc + i, vfmaq_f32(vld1q_f32(acc + i), vld1q_f32(a + i), gains));
+    }
+#elif TUNETRIX_SIMD_WASM
+    const v128_t lanes = wasm_f32x4_make(0.0f, 1.0f, 2.0f, 3.0f);
+    const v128_t steps = wasm_f32x4_splat(step);
+    for (; i + 4 <= count; i += 4)
+    {
+        const v128_t gains = wasm_f32x4_add(wasm_f32x4_splat(gain + step * static_cast<float>(i)), wasm_f32x4_mul(lanes, steps));
+        wasm_v128_store(acc + i, wasm_f32x4_add(wasm_v128_load(acc + i), wasm_f32x4_mul(wasm_v128_load(a + i), gains)));
+    }
+#endif
+    for (; i < count; ++i)
+    {
+        acc[i] += a[i] * (gain + step * static_cast<float>(i));
+    }
+}
+
+// x = H x / sqrt(8), with H the 8x8 Sylvester-Hadamard matrix; orthonormal, so it is its
+// own inverse and preserves energy.
+inline void hadamard8(float* x) noexcept
+{
+    constexpr float kScale = 0.35355339059327373f;
+#if TUNETRIX_SIMD_AVX2
+    const __m256 pairs = _mm256_setr_ps(1.0f, -1.0f, 1.0f, -1.0f, 1.0f, -1.0f, 1.0f, -1.0f);
+    const __m256 quads = _mm256_setr_ps(1.0f, 1.0f, -1.0f, -1.0f, 1.0f, 1.0f, -1.0f, -1.0f);
+    const __m256 halves = _mm256_setr_ps(kScale, kScale, kScale, kScale, -kScale, -kScale, -kScale, -kScale);
+    __m256 v = _mm256_loadu_ps(x);
+    v = _mm256_fmadd_ps(v, pairs, _mm256_permute_ps(v, 0xB1));
+    v = _mm256_fmadd_ps(v, quads, _mm256_permute_ps(v, 0x4E));
+    v = _mm256_fmadd_ps(v, halves, _mm256_mul_ps(_mm256_permute2f128_ps(v, v, 0x01), _mm256_set1_ps(kScale)));
+    _mm256_storeu_ps(x, v);
+#elif TUNETRIX_SIMD_NEON
+    const float32x4_t pairs = {1.0f, -1.0f, 1.0f, -1.0f};
+    const float32x4_t quads = {1.0f, 1.0f, -1.0f, -1.0f};
+    float32x4_t lo = vld1q_f32(x);
+    float32x4_t hi = vld1q_f32(x + 4);
+    lo = vfmaq_f32(vrev64q_f32(lo), lo, pairs);
+    hi = vfmaq_f32(vrev64q_f32(hi), hi, pairs);
+    lo = vfmaq_f32(vextq_f32(lo, lo, 2), lo, quads);
+    hi = vfmaq_f32(vextq_f32(hi, hi, 2), hi, quads);
+    vst1q_f32(x, vmulq_n_f32(vaddq_f32(lo, hi), kScale));
+    vst1q_f32(x + 4, vmulq_n_f32(vsubq_f32(lo, hi), kScale));
+#elif TUNETRIX_SIMD_WASM
+    const v128_t pairs = wasm_f32x4_make(1.0f, -1.0f, 1.0f, -1.0f);
+    const v128_t quads = wasm_f32x4_make(1.0f, 1.0f, -1.0f, -1.0f);
+    const v128_t scale = wasm_f32x4_splat(kScale);
+    v128_t lo = wasm_v128_load(x);
+    v128_t hi = wasm_v128_load(x + 4);
+    lo = wasm_f32x4_add(wasm_i32x4_shuffle(lo, lo, 1, 0, 3, 2), wasm_f32x4_mul(lo, pairs));
+    hi = wasm_f32x4_add(wasm_i32x4_shuffle(hi, hi, 1, 0, 3, 2), wasm_f32x4_mul(hi, pairs));
+    lo = wasm_f32x4_add(wasm_i32x4_shuffle(lo, lo, 2, 3, 0, 1), wasm_f32x4_mul(lo, quads));
+    hi = wasm_f32x4_add(wasm_i32x4_shuffle(hi, hi, 2, 3, 0, 1), wasm_f32x4_mul(hi, quads));
+    wasm_v128_store(x, wasm_f32x4_mul(wasm_f32x4_add(lo, hi), scale));
+    wasm_v128_store(x + 4, wasm_f32x4_mul(wasm_f32x4_sub(lo, hi), scale));
+#else
+    for (size_t span = 1; span < 8; span <<= 1)
+    {
+        for (size_t i = 0; i < 8; i += 2 * span)
+        {
+            for (size_t k = i; k < i + span; ++k)
+            {
+                const float a = x[k];
+                const float b = x[k + span];
+                x[k] = a + b;
+                x[k + span] = a - b;
+            }
+        }
+    }
+    for (size_t k = 0; k < 8; ++k)
+    {
+        x[k] *= kScale;
+    }
+#endif
+}
+
+// acc[k] += a[k] * b[k] over interleaved complex arrays.
+inline void complexMultiplyAccumulate(const std::complex<float>* a,
+                                      const std::complex<float>* b,
+                                      std::complex<float>* acc,
+                                      size_t count) noexcept
+{
+    size_t i = 0;
+    const auto* pa = reinterpret_cast<const float*>(a);
+    const auto* pb = reinterpret_cast<const float*>(b);
+    auto* pacc = reinterpret_cast<float*>(acc);
+#if TUNETRIX_SIMD_AVX2
+    for (; i + 4 <= count; i += 4)
+    {
+        const __m256 va = _mm256_loadu_ps(pa + 2 * i);
+        const __m256 vb = _mm256_loadu_ps(pb + 2 * i);
+        const __m256 swapped = _mm256_permute_ps(va, 0xB1);
+        const __m256 cross = _mm256_mul_ps(swapped, _mm256_movehdup_ps(vb));
+        const __m256 product = _mm256_fmaddsub_ps(va, _mm256_moveldup_ps(vb), cross);
+        _mm256_storeu_ps(pacc + 2 * i, _mm256_add_ps(_mm256_loadu_ps(pacc + 2 * i), product));
+    }
+#elif TUNETRIX_SIMD_NEON
+    for (; i + 4 <= count; i += 4)
+    {
+        const float32x4x2_t va = vld2q_f32(pa + 2 * i);
+        const float32x4x2_t vb = vld2q_f32(pb + 2 * i);
+        float32x4x2_t vacc = vld2q_f32(pacc + 2 * i);
+        vacc.val[0] = vfmsq_f32(vfmaq_f32(vacc.val[0], va.val[0], vb.val[0]), va.val[1], vb.val[1]);
+        vacc.val[1] = vfmaq_f32(vfmaq_f32(vacc.val[1], va.val[0], vb.val[1]), va.val[1], vb.val[0]);
+        vst2q_f32(pacc + 2 * i, vacc);
+    }
+#endif
+    for (; i < count; ++i)
+    {
+        const float ar = pa[2 * i], ai = pa[2 * i + 1];
+        const float br = pb[2 * i], bi = pb[2 * i + 1];
+        pacc[2 * i] += ar * br - ai * bi;
+        pacc[2 * i + 1] += ar * bi + ai * br;
+    }
+}
+
+// acc[k] += conj(a[k]) * b[k] over interleaved complex arrays.
+inline void conjugateMultiplyAccumulate(const std::complex<float>* a,
+                                        const std::complex<float>* b,
+                                        std::complex<float>* acc,
+                                        size_t count) noexcept
+{
+    size_t i = 0;
+    const auto* pa = reinterpret_cast<const float*>(a);
+    const auto* pb = reinterpret_cast<const float*>(b);
+    auto* pacc = reinterpret_cast<float*>(acc);
+#if TUNETRIX_SIMD_AVX2
+    for (; i + 4 <= count; i += 4)
+    {
+        const __m256 va = _mm256_loadu_ps(pa + 2 * i);
+        const __m256 vb = _mm256_loadu_ps(pb + 2 * i);
+        const __m256 swapped = _mm256_permute_ps(vb, 0xB1);
+        const __m256 cross = _mm256_mul_ps(swapped, _mm256_movehdup_ps(va));
+        const __m256 product = _mm256_fmsubadd_ps(vb, _mm256_moveldup_ps(va), cross);
+        _mm256_storeu_ps(pacc + 2 * i, _mm256_add_ps(_mm256_loadu_ps(pacc + 2 * i), product));
+    }
+#elif TUNETRIX_SIMD_NEON
+    for (; i + 4 <= count; i += 4)
+    {
+        const float32x4x2_t va = vld2q_f32(pa + 2 * i);
+        const float32x4x2_t vb = vld2q_f32(pb + 2 * i);
+        float32x4x2_t vacc = vld2q_f32(pacc + 2 * i);
+        vacc.val[0] = vfmaq_f32(vfmaq_f32(vacc.val[0], va.val[0], vb.val[0]), va.val[1], vb.val[1]);
+        vacc.val[1] = vfmsq_f32(vfmaq_f32(vacc.val[1], va.val[0], vb.val[1]), va.val[1], vb.val[0]);
+        vst2q_f32(pacc + 2 * i, vacc);
+    }
+#endif
+    for (; i < count; ++i)
+    {
+        const float ar = pa[2 * i], ai = pa[2 * i + 1];
+        const float br = pb[2 * i], bi = pb[2 * i + 1];
+        pacc[2 * i] += ar * br + ai * bi;
+        pacc[2 * i + 1] += ar * bi - ai * br;
+    }
+}
+} // namespace singwithme::dsp::simd
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace singwithme::dsp
+{
+// Overlapping fixed-length windows over a sample stream, one every hop samples. push()
+// appends samples and reports how many windows became due; they stay readable through
+// window()/windowEnd() until the next push(). When more than maxDue are due at once only the
+// newest are kept, since a late result for an old window is of no use to the gate.
+class SlidingWindow
+{
+public:
+    void prepare(size_t windowSamples, size_t hopSamples, size_t maxDue);
+    void reset() noexcept;
+
+    size_t push(const float* samples, size_t count) noexcept;
+
+    // index < the count push() returned, oldest first.
+    const float* window(size_t index) const noexcept;
+    // Stream position one past the window's last sample, counted from the last reset().
+    uint64_t windowEnd(size_t index) const noexcept;
+
+    size_t windowSamples() const noexcept { return windowSamples_; }
+    size_t hopSamples() const noexcept { return hopSamples_; }
+
+private:
+    std::vector<float> buffer_;
+    size_t windowSamples_{0};
+    size_t hopSamples_{0};
+    size_t maxDue_{1};
+    size_t fill_{0};
+    uint64_t bufferStart_{0}; // stream position of buffer_[0]
+    uint64_t nextEnd_{0};     // end of the next window not yet reported
+    uint64_t firstDueEnd_{0};
+};
+} // namespace singwithme::dsp
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <complex>
+#include <cstddef>
+#include <vector>
+
+#include "dsp/Fft.h"
+
+namespace singwithme::dsp
+{
+// Nudges the guide's spectral envelope towards the singer's. The live mic and the guide are
+// framed at the same instant, and each gets a cepstrally smoothed log envelope, so the
+// harmonics of either pitch drop out. The per-band difference, with the overall level
+// removed and bounded to +-kMaxGainDb, sets the gains of a cascade of kBands peaking
+// biquads. The cascade is pipelined one sample per stage so all bands run side by side in
+// one SIMD register, which delays the guide by kBands - 1 samples. The analysis is split
+// into FFT-sized steps, one per process() call, so the cost per callback is bounded
+// whatever the block size. Everything is allocated in prepare().
+class TimbreMatcher
+{
+public:
+    static constexpr size_t kBands = 8;
+    static constexpr float kMaxGainDb = 9.0f;
+
+    void prepare(double sampleRate);
+    void reset();
+
+    // 0 leaves the guide untouched, 1 applies the full bounded difference. Any thread.
+    void setStrength(float strength) noexcept;
+    // The mic as the pipeline sees it, once per callback before process().
+    void pushMic(const float* mic, size_t numSamples) noexcept;
+    // In-place safe.
+    void process(const float* guide, float* output, size_t numSamples) noexcept;
+
+    float bandGainDb(size_t band) const noexcept { return band < kBands ? appliedDb_[band] : 0.0f; }
+    static constexpr size_t latencySamples() noexcept { return kBands - 1; }
+
+private:
+    enum class Step
+    {
+        Capture,
+        MicSpectrum,
+        MicCepstrum,
+        MicEnvelope,
+        GuideSpectrum,
+        GuideCepstrum,
+        GuideEnvelope,
+        Compare
+    };
+
+    void advanceAnalysis() noexcept;
+    void updateCoefficients(float strength, size_t numSamples) noexcept;
+    void toLogSpectrum(const std::vector<float>& frame) noexcept;
+    void toCepstrum() noexcept;
+    void toEnvelope(std::vector<float>& envelopeDb) noexcept;
+    static void writeRing(std::vector<float>& ring, size_t mask, size_t& head, const float* samples, size_t numSamples) noexcept;
+    void readRing(const std::vector<float>& ring, size_t head, std::vector<float>& frame) const noexcept;
+
+    Fft fft_;
+    double sampleRate_{48000.0};
+    size_t frameSize_{0};
+    size_t lifterLength_{0};
+    std::vector<float> window_;
+    std::vector<float> micRing_;
+    std::vector<float> guideRing_;
+    size_t ringMask_{0};
+    size_t micHead_{0};
+    size_t guideHead_{0};
+
+    std::vector<float> micFrame_;
+    std::vector<float> guideFrame_;
+    std::vector<float> cepstrum_;
+    std::vector<std::complex<float>> spectrum_;
+    std::vector<float> micEnvelopeDb_;
+    std::vector<float> guideEnvelopeDb_;
+    std::array<size_t, kBands + 1> bandEdges_{};
+    size_t activeBands_{0};
+    Step step_{Step::Capture};
+
+    // Per-band sin(w0) / (2Q) and cos(w0); zero alpha marks a band above the device's range.
+    std::array<float, kBands> alpha_{};
+    std::array<float, kBands> cosine_{};
+    alignas(32) std::array<float, kBands> b0_{};
+    alignas(32) std::array<float, kBands> b1_{};
+    alignas(32) std::array<float, kBands> b2_{};
+    alignas(32) std::array<float, kBands> a1_{};
+    alignas(32) std::array<float, kBands> a2_{};
+    alignas(32) std::array<float, kBands> state1_{};
+    alignas(32) std::array<float, kBands> state2_{};
+    // Stage k's input: the guide sample for stage 0, stage k - 1's previous output otherwise.
+    alignas(32) std::array<float, kBands> stageInput_{};
+    std::array<float, kBands> targetDb_{};
+    std::array<float, kBands> appliedDb_{};
+
+    std::atomic<float> strength_{1.0f};
+};
+} // namespace singwithme::dsp
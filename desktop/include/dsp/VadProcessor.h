@@ -16,6 +16,9 @@
 #include <string>
 #include <vector>
 
+#include "dsp/InferenceScheduler.h"
+#include "dsp/ModelStore.h"
+
 namespace singwithme::dsp
 {
 #if TUNETRIX_ONNX_RUNTIME
@@ -27,6 +30,8 @@ public:
     void loadModel(const std::string& modelPath);
     void setModelSampleRate(int64_t sampleRate);
     void resetState();
+    void setNoiseFloorDb(float noiseFloorDb);
+    float inferenceSkippedPercent() const noexcept { return scheduler_.skippedPercent(); }
     float processFrame(const float* samples, size_t sampleCount);
 
 private:
@@ -34,25 +39,31 @@ private:
 
     int64_t modelSampleRate_{16000};
     Ort::Env& env_;
-    std::unique_ptr<Ort::Session> session_;
+    ModelSession session_;
     Ort::SessionOptions options_;
     std::vector<float> inputBuffer_;
     std::vector<float> stateBuffer_;
+    InferenceScheduler scheduler_;
+    float lastProbability_{0.0f};
 };
 #else
 class VadProcessor
 {
 public:
-    explicit VadProcessor(Ort::Env&) {}
+    explicit VadProcessor(Ort::Env&);
 
     void loadModel(const std::string&) {}
     void setModelSampleRate(int64_t sampleRate);
     void resetState();
+    void setNoiseFloorDb(float noiseFloorDb);
+    float inferenceSkippedPercent() const noexcept { return scheduler_.skippedPercent(); }
     float processFrame(const float* samples, size_t sampleCount);
 
 private:
     static float computeEnergy(const float* samples, size_t sampleCount);
 
+    InferenceScheduler scheduler_;
+
     float noiseFloor_{1.0e-4f};
     float smoothedProbability_{0.0f};
     int64_t modelSampleRate_{16000};
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace singwithme::dsp
+{
+// min/max/RMS of a span of the input. A span with no values (past the end, or only NaN
+// gaps in an analysis lane) has min and max NaN.
+struct PyramidBin
+{
+    float min{0.0f};
+    float max{0.0f};
+    float rms{0.0f};
+};
+
+// min/max/RMS mipmap of a signal or per-frame analysis track, for drawing it at any zoom
+// in O(pixels). Level 0 has one bin per baseBinUnits input values and every level above
+// is 4x coarser, up to a single bin. The input is split into chunks whose bins, at every
+// level up to the chunk size, depend on that chunk alone: buildChunk() can run for all
+// chunks in parallel, then finish() fills the few levels above.
+class WaveformPyramid
+{
+public:
+    static constexpr size_t kLevelFactor = 4;
+    static constexpr size_t kChunkLevels = 6;
+
+    // unitsPerSecond is the input rate: the sample rate, or 1 / hopSeconds for a track.
+    void prepare(size_t length, double unitsPerSecond, size_t baseBinUnits);
+    size_t numChunks() const noexcept;
+    // Safe to run concurrently for different chunks; input is the whole signal.
+    void buildChunk(const float* input, size_t chunk) noexcept;
+    void finish() noexcept;
+    // prepare(), every chunk and finish() on the calling thread.
+    void build(const float* input, size_t length, double unitsPerSecond, size_t baseBinUnits);
+
+    // One bin per pixel for [startSeconds, endSeconds), read from the coarsest level whose
+    // bins are no wider than a pixel. Zoomed in past level 0 the bins come from input when it
+    // is given (the signal the pyramid was built from), else the level-0 bins are repeated.
+    void render(double startSeconds, double endSeconds, PyramidBin* out, size_t pixels, const float* input = nullptr) const noexcept;
+
+    size_t length() const noexcept { return length_; }
+    size_t numLevels() const noexcept { return levels_.size(); }
+    double unitsPerSecond() const noexcept { return unitsPerSecond_; }
+    size_t memoryBytes() const noexcept;
+
+private:
+    // Stored as the mean square so that bins of different widths combine exactly.
+    struct Bin
+    {
+        float min;
+        float max;
+        float meanSquare;
+    };
+
+    size_t binWidth(size_t level) const noexcept;
+    Bin reduceInput(const float* input, size_t begin, size_t end) const noexcept;
+    Bin reduceLevel(size_t level, size_t begin, size_t end) const noexcept;
+    void buildLevelRange(size_t level, size_t begin, size_t end) noexcept;
+
+    size_t length_{0};
+    double unitsPerSecond_{1.0};
+    size_t baseBinUnits_{1};
+    std::vector<std::vector<Bin>> levels_;
+};
+
+// The per-channel pyramids of one stem. Positions are in seconds, so the overview built
+// when a stem is decoded stays valid when the stem is later resampled for another device rate.
+struct StemOverview
+{
+    std::vector<WaveformPyramid> channels;
+
+    size_t memoryBytes() const noexcept;
+};
+} // namespace singwithme::dsp
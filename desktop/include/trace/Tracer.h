@@ -0,0 +1,145 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace singwithme::trace
+{
+enum class Phase : uint8_t
+{
+    Begin,
+    End,
+    Counter,
+    FlowStart,
+    FlowEnd
+};
+
+struct Event
+{
+    uint64_t timestampNs{0};
+    const char* name{nullptr}; // a string literal: only the pointer is recorded
+    uint64_t value{0};         // flow id, or the counter value's bits
+    Phase phase{Phase::Begin};
+};
+
+class TraceWriter;
+
+// Opt-in recorder for pipeline events. Each thread writes to its own fixed-size ring, which
+// only the flush thread reads, so recording takes no lock and never allocates; a full ring
+// drops events and counts them. The flush thread drains the rings every 50 ms into a Chrome
+// trace JSON file (.json) or a Perfetto protobuf trace (any other extension). While stopped,
+// every instrumentation point costs one relaxed load and a branch.
+class Tracer
+{
+public:
+    static constexpr size_t kMaxThreads = 64;
+
+    static Tracer& instance();
+    ~Tracer();
+
+    // The rings are allocated by the first start(), sized to eventsPerThread rounded up to a
+    // power of two, and kept for the life of the process; later calls reuse them.
+    bool start(const std::string& path, size_t eventsPerThread);
+    void stop();
+    bool isRecording() const;
+    uint64_t droppedEvents() const;
+
+    static bool enabled() noexcept { return enabled_.load(std::memory_order_relaxed); }
+    // False when the thread's ring is full (or it has no ring) and the event was dropped.
+    bool record(Phase phase, const char* name, uint64_t value) noexcept;
+    void nameThread(const char* name) noexcept;
+
+private:
+    struct ThreadBuffer;
+
+    enum class Description : uint8_t
+    {
+        None,
+        Placeholder,
+        Named
+    };
+
+    Tracer() = default;
+    ThreadBuffer* threadBuffer() noexcept;
+    void flushLoop();
+    void drain();
+
+    static inline std::atomic<bool> enabled_{false};
+
+    std::array<std::unique_ptr<ThreadBuffer>, kMaxThreads> buffers_;
+    std::atomic<size_t> claimed_{0};
+    size_t capacity_{0};
+
+    mutable std::mutex mutex_; // start()/stop() and the flush thread's wake-ups
+    std::condition_variable wake_;
+    bool stopping_{false};
+    std::thread flusher_;
+    std::unique_ptr<TraceWriter> writer_;
+    std::array<Description, kMaxThreads> described_{};
+    uint64_t originNs_{0};
+};
+
+inline uint64_t& currentFlow() noexcept
+{
+    static thread_local uint64_t flow = 0;
+    return flow;
+}
+
+// Begin/end pair around a scope, recorded only if tracing was on when the scope opened and
+// the Begin found room.
+class Zone
+{
+public:
+    explicit Zone(const char* name) noexcept
+        : name_(Tracer::enabled() && Tracer::instance().record(Phase::Begin, name, 0) ? name : nullptr)
+    {
+    }
+
+    ~Zone()
+    {
+        if (name_ != nullptr)
+        {
+            Tracer::instance().record(Phase::End, name_, 0);
+        }
+    }
+
+    Zone(const Zone&) = delete;
+    Zone& operator=(const Zone&) = delete;
+
+private:
+    const char* name_;
+};
+
+void counter(const char* name, double value) noexcept;
+// Starts a flow arrow inside the current zone and makes it the thread's current flow, which
+// the next flowEnd() on this thread terminates inside its own zone.
+void flowStart(uint64_t id) noexcept;
+void flowEnd() noexcept;
+} // namespace singwithme::trace
+
+// Instrumentation points. They compile to nothing unless TUNETRIX_TRACING is set (CMake
+// ENABLE_TRACING); otherwise arguments are only evaluated while tracing is on.
+#if TUNETRIX_TRACING
+ #define TUNETRIX_TRACE_CONCAT_INNER(a, b) a##b
+ #define TUNETRIX_TRACE_CONCAT(a, b) TUNETRIX_TRACE_CONCAT_INNER(a, b)
+ #define TUNETRIX_TRACE_ENABLED() ::singwithme::trace::Tracer::enabled()
+ #define TUNETRIX_TRACE_ZONE(name) const ::singwithme::trace::Zone TUNETRIX_TRACE_CONCAT(traceZone, __LINE__){name}
+ #define TUNETRIX_TRACE_THREAD(name) do { if (TUNETRIX_TRACE_ENABLED()) ::singwithme::trace::Tracer::instance().nameThread(name); } while (false)
+ #define TUNETRIX_TRACE_COUNTER(name, value) do { if (TUNETRIX_TRACE_ENABLED()) ::singwithme::trace::counter(name, value); } while (false)
+ #define TUNETRIX_TRACE_FLOW_START(id) do { if (TUNETRIX_TRACE_ENABLED()) ::singwithme::trace::flowStart(id); } while (false)
+ #define TUNETRIX_TRACE_FLOW_END() do { if (TUNETRIX_TRACE_ENABLED()) ::singwithme::trace::flowEnd(); } while (false)
+#else
+ #define TUNETRIX_TRACE_ENABLED() false
+ #define TUNETRIX_TRACE_ZONE(name) static_cast<void>(0)
+ #define TUNETRIX_TRACE_THREAD(name) static_cast<void>(0)
+ #define TUNETRIX_TRACE_COUNTER(name, value) static_cast<void>(0)
+ #define TUNETRIX_TRACE_FLOW_START(id) static_cast<void>(0)
+ #define TUNETRIX_TRACE_FLOW_END() static_cast<void>(0)
+#endif
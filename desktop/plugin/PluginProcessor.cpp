@@ -0,0 +1,252 @@
+#include "PluginProcessor.h"
+
+#include <algorithm>
+#include <exception>
+
+#include "dsp/ModelStore.h"
+
+namespace singwithme::plugin
+{
+namespace
+{
+constexpr int kMicChannels = 1;
+constexpr int kOutputChannels = 2;
+// The largest block PipelineProcessor sizes its scratch buffers for.
+constexpr int kMaxBlock = 4096;
+constexpr const char* kStateType = "TuneTrixPlugin";
+
+dsp::GateConfig makeGateConfig(const config::GateParams& params)
+{
+    dsp::GateConfig gateConfig;
+    gateConfig.lookAheadMs = params.lookAheadMs;
+    gateConfig.attackMs = params.attackMs;
+    gateConfig.releaseMs = params.releaseMs;
+    gateConfig.holdMs = params.holdMs;
+    gateConfig.thresholdOn = params.thresholdOn;
+    gateConfig.thresholdOff = params.thresholdOff;
+    gateConfig.framesOn = params.framesOn;
+    gateConfig.framesOff = params.framesOff;
+    gateConfig.duckDb = params.duckDb;
+    gateConfig.predictiveOpen = params.predictiveOpen;
+    return gateConfig;
+}
+
+config::RuntimeConfig loadConfig(const config::ConfigLoader& loader)
+{
+    const auto path = juce::SystemStats::getEnvironmentVariable("TUNETRIX_CONFIG", {}).toStdString();
+    return path.empty() ? loader.loadDefaults() : loader.loadFromFile(path);
+}
+
+bool sameTuning(const audio::PipelineProcessor::GateTuning& a, const audio::PipelineProcessor::GateTuning& b)
+{
+    return a.thresholdOn == b.thresholdOn && a.thresholdOff == b.thresholdOff && a.attackMs == b.attackMs
+           && a.releaseMs == b.releaseMs && a.holdMs == b.holdMs && a.duckDb == b.duckDb;
+}
+} // namespace
+
+PluginProcessor::PluginProcessor()
+    : juce::AudioProcessor(BusesProperties()
+                               .withInput("Mic", juce::AudioChannelSet::mono(), true)
+                               .withOutput("Main", juce::AudioChannelSet::stereo(), true)),
+      runtimeConfig_(loadConfig(configLoader_)),
+      ortEnv_(dsp::sharedOrtEnvironment()),
+      parameters_(*this, nullptr, kStateType, createParameters())
+{
+    thresholdOn_ = parameters_.getRawParameterValue("thresholdOn");
+    thresholdOff_ = parameters_.getRawParameterValue("thresholdOff");
+    attackMs_ = parameters_.getRawParameterValue("attackMs");
+    releaseMs_ = parameters_.getRawParameterValue("releaseMs");
+    holdMs_ = parameters_.getRawParameterValue("holdMs");
+    duckDb_ = parameters_.getRawParameterValue("duckDb");
+    manualMode_ = parameters_.getRawParameterValue("manualMode");
+
+    // A host must survive a missing model: without one the plugin outputs silence rather
+    // than throwing from the audio thread.
+    try
+    {
+        vad_ = std::make_unique<dsp::VadProcessor>(ortEnv_);
+        vad_->loadModel(runtimeConfig_.vadModelPath);
+        pitch_ = std::make_unique<dsp::PitchProcessor>(ortEnv_);
+        pitch_->loadModel(runtimeConfig_.pitchModelPath);
+        pitch_->setHopSamples(runtimeConfig_.pitchHopSamples());
+        modelsLoaded_ = true;
+    }
+    catch (const std::exception& error)
+    {
+        juce::Logger::writeToLog("TuneTrix: " + juce::String(error.what()));
+    }
+    pipeline_.setOrtEnvironment(ortEnv_);
+}
+
+PluginProcessor::~PluginProcessor()
+{
+    releaseResources();
+}
+
+juce::AudioProcessorValueTreeState::ParameterLayout PluginProcessor::createParameters() const
+{
+    const auto& gate = runtimeConfig_.gate;
+    juce::AudioProcessorValueTreeState::ParameterLayout layout;
+    layout.add(std::make_unique<juce::AudioParameterFloat>(juce::ParameterID{"thresholdOn", 1},
+                                                           "Open threshold",
+                                                           juce::NormalisableRange<float>(0.0f, 1.0f, 0.01f),
+                                                           gate.thresholdOn));
+    layout.add(std::make_unique<juce::AudioParameterFloat>(juce::ParameterID{"thresholdOff", 1},
+                                                           "Close threshold",
+                                                           juce::NormalisableRange<float>(0.0f, 1.0f, 0.01f),
+                                                           gate.thresholdOff));
+    layout.add(std::make_unique<juce::AudioParameterFloat>(juce::ParameterID{"attackMs", 1},
+                                                           "Attack",
+                                                           juce::NormalisableRange<float>(1.0f, 100.0f, 0.1f, 0.5f),
+                                                           gate.attackMs,
+                                                           juce::AudioParameterFloatAttributes().withLabel("ms")));
+    layout.add(std::make_unique<juce::AudioParameterFloat>(juce::ParameterID{"releaseMs", 1},
+                                                           "Release",
+                                                           juce::NormalisableRange<float>(10.0f, 2000.0f, 1.0f, 0.4f),
+                                                           gate.releaseMs,
+                                                           juce::AudioParameterFloatAttributes().withLabel("ms")));
+    layout.add(std::make_unique<juce::AudioParameterFloat>(juce::ParameterID{"holdMs", 1},
+                                                           "Hold",
+                                                           juce::NormalisableRange<float>(0.0f, 1000.0f, 1.0f, 0.5f),
+                                                           gate.holdMs,
+                                                           juce::AudioParameterFloatAttributes().withLabel("ms")));
+    layout.add(std::make_unique<juce::AudioParameterFloat>(juce::ParameterID{"duckDb", 1},
+                                                           "Duck depth",
+                                                           juce::NormalisableRange<float>(-80.0f, 0.0f, 0.1f),
+                                                           gate.duckDb,
+                                                           juce::AudioParameterFloatAttributes().withLabel("dB")));
+    layout.add(std::make_unique<juce::AudioParameterChoice>(juce::ParameterID{"manualMode", 1},
+                                                            "Guide",
+                                                            juce::StringArray{"Auto", "Always on", "Always off"},
+                                                            0));
+    return layout;
+}
+
+void PluginProcessor::prepareToPlay(double sampleRate, int maximumExpectedSamplesPerBlock)
+{
+    const int blockSize = std::clamp(maximumExpectedSamplesPerBlock, 1, kMaxBlock);
+    mic_.assign(static_cast<size_t>(blockSize), 0.0f);
+    if (!modelsLoaded_)
+    {
+        return;
+    }
+
+    if (!configured_)
+    {
+        // Decodes the stems at the host rate before the first block; configure() waits for them.
+        runtimeConfig_.sampleRate = sampleRate;
+        runtimeConfig_.bufferSamples = blockSize;
+        gate_.configure(static_cast<float>(sampleRate), static_cast<size_t>(blockSize), makeGateConfig(runtimeConfig_.gate));
+        pipeline_.configure(runtimeConfig_, gate_, *vad_, *pitch_, calibrator_);
+        configured_ = true;
+    }
+    else
+    {
+        // As in configure(), the stems are at the host rate before the first block.
+        pipeline_.adaptToSampleRate(sampleRate).wait();
+        pipeline_.updateBufferSize(blockSize);
+    }
+    pipeline_.setOffline(isNonRealtime());
+    pipeline_.audioDeviceAboutToStart(nullptr);
+    tuningPushed_ = false;
+    pushedManualMode_ = -1;
+    setLatencySamples(pipeline_.outputLatencySamples(sampleRate));
+}
+
+void PluginProcessor::releaseResources()
+{
+    if (configured_)
+    {
+        pipeline_.audioDeviceStopped();
+    }
+}
+
+bool PluginProcessor::isBusesLayoutSupported(const BusesLayout& layouts) const
+{
+    return layouts.getMainInputChannelSet() == juce::AudioChannelSet::mono()
+           && layouts.getMainOutputChannelSet() == juce::AudioChannelSet::stereo();
+}
+
+void PluginProcessor::setNonRealtime(bool isNonRealtime) noexcept
+{
+    juce::AudioProcessor::setNonRealtime(isNonRealtime);
+    pipeline_.setOffline(isNonRealtime);
+}
+
+double PluginProcessor::getTailLengthSeconds() const
+{
+    return runtimeConfig_.media.reverbTailSeconds;
+}
+
+void PluginProcessor::processBlock(juce::AudioBuffer<float>& buffer, juce::MidiBuffer&)
+{
+    if (!configured_ || buffer.getNumChannels() < kOutputChannels)
+    {
+        buffer.clear();
+        return;
+    }
+    pushParameters();
+
+    // Hosts may exceed the block size they announced; larger blocks run in pieces.
+    const juce::AudioIODeviceCallbackContext context{};
+    const int capacity = static_cast<int>(mic_.size());
+    const int numSamples = buffer.getNumSamples();
+    for (int start = 0; start < numSamples; start += capacity)
+    {
+        const int count = std::min(capacity, numSamples - start);
+        std::copy_n(buffer.getReadPointer(0, start), count, mic_.data());
+        const float* inputs[kMicChannels] = {mic_.data()};
+        float* outputs[kOutputChannels] = {buffer.getWritePointer(0, start), buffer.getWritePointer(1, start)};
+        pipeline_.audioDeviceIOCallbackWithContext(inputs, kMicChannels, outputs, kOutputChannels, count, context);
+    }
+}
+
+void PluginProcessor::pushParameters()
+{
+    const audio::PipelineProcessor::GateTuning tuning{thresholdOn_->load(std::memory_order_relaxed),
+                                                      thresholdOff_->load(std::memory_order_relaxed),
+                                                      attackMs_->load(std::memory_order_relaxed),
+                                                      releaseMs_->load(std::memory_order_relaxed),
+                                                      holdMs_->load(std::memory_order_relaxed),
+                                                      duckDb_->load(std::memory_order_relaxed)};
+    if (!tuningPushed_ || !sameTuning(tuning, pushedTuning_))
+    {
+        pipeline_.setGateTuning(tuning);
+        pushedTuning_ = tuning;
+        tuningPushed_ = true;
+    }
+
+    const int manualMode = static_cast<int>(manualMode_->load(std::memory_order_relaxed));
+    if (manualMode != pushedManualMode_)
+    {
+        pipeline_.setManualMode(static_cast<dsp::ManualMode>(std::clamp(manualMode, 0, 2)));
+        pushedManualMode_ = manualMode;
+    }
+}
+
+juce::AudioProcessorEditor* PluginProcessor::createEditor()
+{
+    return new juce::GenericAudioProcessorEditor(*this);
+}
+
+void PluginProcessor::getStateInformation(juce::MemoryBlock& destination)
+{
+    if (const auto xml = parameters_.copyState().createXml())
+    {
+        copyXmlToBinary(*xml, destination);
+    }
+}
+
+void PluginProcessor::setStateInformation(const void* data, int sizeInBytes)
+{
+    if (const auto xml = getXmlFromBinary(data, sizeInBytes); xml != nullptr && xml->hasTagName(parameters_.state.getType()))
+    {
+        parameters_.replaceState(juce::ValueTree::fromXml(*xml));
+    }
+}
+} // namespace singwithme::plugin
+
+juce::AudioProcessor* JUCE_CALLTYPE createPluginFilter()
+{
+    return new singwithme::plugin::PluginProcessor();
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <juce_audio_processors/juce_audio_processors.h>
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "audio/PipelineProcessor.h"
+#include "calibration/Calibrator.h"
+#include "config/RuntimeConfig.h"
+#include "dsp/ConfidenceGate.h"
+#include "dsp/PitchProcessor.h"
+#include "dsp/VadProcessor.h"
+
+namespace singwithme::plugin
+{
+// The pipeline as an insert on the vocal mic: mono in, the stereo stem mix out, no
+// sidechain. The gate's thresholds, envelope times, duck depth and manual mode are host
+// parameters; everything else comes from the config named by TUNETRIX_CONFIG (an absolute
+// path is best, hosts rarely start in the repository). processBlock() hands the host's
+// buffers to PipelineProcessor in place and allocates nothing.
+class PluginProcessor : public juce::AudioProcessor
+{
+public:
+    PluginProcessor();
+    ~PluginProcessor() override;
+
+    void prepareToPlay(double sampleRate, int maximumExpectedSamplesPerBlock) override;
+    void releaseResources() override;
+    bool isBusesLayoutSupported(const BusesLayout& layouts) const override;
+    void processBlock(juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midi) override;
+    void setNonRealtime(bool isNonRealtime) noexcept override;
+
+    juce::AudioProcessorEditor* createEditor() override;
+    bool hasEditor() const override { return true; }
+
+    const juce::String getName() const override { return "TuneTrix"; }
+    bool acceptsMidi() const override { return false; }
+    bool producesMidi() const override { return false; }
+    double getTailLengthSeconds() const override;
+
+    int getNumPrograms() override { return 1; }
+    int getCurrentProgram() override { return 0; }
+    void setCurrentProgram(int) override {}
+    const juce::String getProgramName(int) override { return {}; }
+    void changeProgramName(int, const juce::String&) override {}
+
+    void getStateInformation(juce::MemoryBlock& destination) override;
+    void setStateInformation(const void* data, int sizeInBytes) override;
+
+private:
+    juce::AudioProcessorValueTreeState::ParameterLayout createParameters() const;
+    void pushParameters();
+
+    config::ConfigLoader configLoader_;
+    config::RuntimeConfig runtimeConfig_;
+    Ort::Env& ortEnv_;
+    std::unique_ptr<dsp::VadProcessor> vad_;
+    std::unique_ptr<dsp::PitchProcessor> pitch_;
+    dsp::ConfidenceGate gate_;
+    calibration::Calibrator calibrator_;
+    audio::PipelineProcessor pipeline_;
+    bool modelsLoaded_{false};
+    bool configured_{false};
+
+    juce::AudioProcessorValueTreeState parameters_;
+    std::atomic<float>* thresholdOn_{nullptr};
+    std::atomic<float>* thresholdOff_{nullptr};
+    std::atomic<float>* attackMs_{nullptr};
+    std::atomic<float>* releaseMs_{nullptr};
+    std::atomic<float>* holdMs_{nullptr};
+    std::atomic<float>* duckDb_{nullptr};
+    std::atomic<float>* manualMode_{nullptr};
+    // What was last handed to the pipeline, so unchanged parameters cost a compare per block.
+    audio::PipelineProcessor::GateTuning pushedTuning_{};
+    int pushedManualMode_{-1};
+    bool tuningPushed_{false};
+
+    // The mic is copied out before the pipeline clears its outputs, which share the buffer.
+    std::vector<float> mic_;
+};
+} // namespace singwithme::plugin
@@ -26,16 +26,18 @@ DeviceManager::~DeviceManager()
     shutdown();
 }
 
-void DeviceManager::initialise(double sampleRate, int bufferSize)
+void DeviceManager::initialise(double sampleRate, int bufferSize, int outputChannels)
 {
     sampleRate_ = sampleRate;
     bufferSize_ = bufferSize;
-    deviceManager_.initialise(1, 2, nullptr, true, {}, nullptr);
+    // Later setups keep useDefaultOutputChannels, which opens this many outputs again.
+    deviceManager_.initialise(1, std::max(1, outputChannels), nullptr, true, {}, nullptr);
     applyCurrentSettings();
 }
 
 void DeviceManager::shutdown()
 {
+    inputBridge_.close();
     deviceManager_.closeAudioDevice();
 }
 
@@ -90,6 +92,11 @@ juce::String DeviceManager::currentOutputDevice() const
 
 juce::String DeviceManager::currentInputDevice() const
 {
+    if (inputBridge_.isOpen())
+    {
+        return inputBridge_.deviceName();
+    }
+
     juce::AudioDeviceManager::AudioDeviceSetup setup;
     deviceManager_.getAudioDeviceSetup(setup);
     return setup.inputDeviceName;
@@ -115,7 +122,13 @@ bool DeviceManager::setOutputDevice(const juce::String& deviceName)
     setup.bufferSize = bufferSize_;
 
     const juce::String error = deviceManager_.setAudioDeviceSetup(setup, true);
-    return error.isEmpty();
+    if (error.isNotEmpty())
+    {
+        return false;
+    }
+
+    followOutputDevice();
+    return true;
 }
 
 bool DeviceManager::setInputDevice(const juce::String& deviceName)
@@ -127,6 +140,12 @@ bool DeviceManager::setInputDevice(const juce::String& deviceName)
 
     juce::AudioDeviceManager::AudioDeviceSetup setup;
     deviceManager_.getAudioDeviceSetup(setup);
+    if (bridgeInput_ && deviceName != setup.outputDeviceName)
+    {
+        return openBridgedInput(deviceName);
+    }
+
+    inputBridge_.close();
     if (setup.inputDeviceName == deviceName)
     {
         return true;
@@ -161,12 +180,86 @@ bool DeviceManager::setBufferSize(int newBufferSize)
         return false;
     }
 
-    deviceManager_.getAudioDeviceSetup(setup);
-    bufferSize_ = setup.bufferSize;
-    sampleRate_ = setup.sampleRate;
+    followOutputDevice();
     return true;
 }
 
+void DeviceManager::setInputBridging(bool enabled, float targetLatencyMs)
+{
+    bridgeInput_ = enabled;
+    bridgeLatencyMs_ = targetLatencyMs;
+    if (!enabled && inputBridge_.isOpen())
+    {
+        const juce::String name = inputBridge_.deviceName();
+        inputBridge_.close();
+        setInputDevice(name);
+    }
+}
+
+bool DeviceManager::openBridgedInput(const juce::String& deviceName)
+{
+    auto* type = deviceManager_.getCurrentDeviceTypeObject();
+    if (type == nullptr)
+    {
+        return false;
+    }
+
+    // The main device keeps the outputs only; the mic comes from the bridge.
+    juce::AudioDeviceManager::AudioDeviceSetup setup;
+    deviceManager_.getAudioDeviceSetup(setup);
+    if (setup.inputDeviceName.isNotEmpty())
+    {
+        setup.inputDeviceName = {};
+        setup.useDefaultInputChannels = false;
+        setup.inputChannels.clear();
+        deviceManager_.setAudioDeviceSetup(setup, true);
+        deviceManager_.getAudioDeviceSetup(setup);
+    }
+
+    const juce::String name = deviceName;
+    return inputBridge_.open(*type, name, setup.sampleRate, setup.bufferSize, bridgeLatencyMs_);
+}
+
+void DeviceManager::followOutputDevice()
+{
+    // The device may not grant the rate or block size asked for; the bridge is prepared for
+    // what it runs at.
+    juce::AudioDeviceManager::AudioDeviceSetup setup;
+    deviceManager_.getAudioDeviceSetup(setup);
+    if (setup.sampleRate > 0.0)
+    {
+        sampleRate_ = setup.sampleRate;
+    }
+    if (setup.bufferSize > 0)
+    {
+        bufferSize_ = setup.bufferSize;
+    }
+    if (!inputBridge_.isOpen())
+    {
+        return;
+    }
+
+    const juce::String name = inputBridge_.deviceName();
+    if (name == setup.outputDeviceName)
+    {
+        // The mic is on the output device now, on its clock; JUCE runs the two together.
+        inputBridge_.close();
+        setInputDevice(name);
+        return;
+    }
+    openBridgedInput(name);
+}
+
+int DeviceManager::reportedRoundTripSamples() const
+{
+    auto* device = deviceManager_.getCurrentAudioDevice();
+    if (device == nullptr)
+    {
+        return 0;
+    }
+    return device->getInputLatencyInSamples() + device->getOutputLatencyInSamples() + device->getCurrentBufferSizeSamples();
+}
+
 void DeviceManager::applyCurrentSettings()
 {
     juce::AudioDeviceManager::AudioDeviceSetup setup;
@@ -0,0 +1,118 @@
+#include "audio/GuideAnalysis.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+#include "dsp/Resampler.h"
+#include "trace/Tracer.h"
+
+namespace singwithme::audio
+{
+namespace
+{
+constexpr size_t kVadFrameSamples = dsp::FeatureExtractor::kHopSamples;
+
+// Silero on the guide when a model is available, falling back to the feature track's
+// activity flags so an energy-only map is still produced.
+std::vector<float> guideVoiceActivity(const std::vector<float>& samples,
+                                      size_t numHops,
+                                      const dsp::GuideFeatureTrack& features,
+                                      const GuideAnalysisSettings& settings)
+{
+    std::vector<float> probability(numHops, 0.0f);
+    if (settings.env != nullptr)
+    {
+        try
+        {
+            dsp::VadProcessor vad(*settings.env);
+            vad.loadModel(settings.vadModelPath);
+            vad.setModelSampleRate(static_cast<int64_t>(settings.modelSampleRate));
+            vad.resetState();
+            for (size_t hop = 0; hop < numHops; ++hop)
+            {
+                probability[hop] = vad.processFrame(samples.data() + hop * kVadFrameSamples, kVadFrameSamples);
+            }
+            return probability;
+        }
+        catch (const std::exception&)
+        {
+            // Fall through to the energy-based activity below.
+        }
+    }
+
+    for (size_t hop = 0; hop < numHops; ++hop)
+    {
+        const size_t frame = std::min(hop, features.active.empty() ? size_t{0} : features.active.size() - 1);
+        probability[hop] = !features.active.empty() && features.active[frame] != 0 ? 1.0f : 0.0f;
+    }
+    return probability;
+}
+} // namespace
+
+std::shared_ptr<const GuideAnalysis> analyseGuide(const juce::AudioBuffer<float>& guide,
+                                                  const GuideAnalysisSettings& settings)
+{
+    TUNETRIX_TRACE_ZONE("Guide analysis");
+    auto analysis = std::make_shared<GuideAnalysis>();
+    const int channels = guide.getNumChannels();
+    const int samples = guide.getNumSamples();
+    if (channels <= 0 || samples <= 0)
+    {
+        return analysis;
+    }
+
+    std::vector<float> mono(static_cast<size_t>(samples), 0.0f);
+    const float scale = 1.0f / static_cast<float>(channels);
+    for (int ch = 0; ch < channels; ++ch)
+    {
+        const float* source = guide.getReadPointer(ch);
+        for (int i = 0; i < samples; ++i)
+        {
+            mono[static_cast<size_t>(i)] += source[i] * scale;
+        }
+    }
+
+    dsp::Resampler decimator;
+    decimator.prepare(settings.sampleRate, settings.modelSampleRate, dsp::ResamplerQuality::SincFast, 0);
+    const size_t length = dsp::Resampler::outputLength(mono.size(), settings.sampleRate, settings.modelSampleRate);
+    std::vector<float> decimated(length, 0.0f);
+    decimator.render(mono.data(), mono.size(), decimated.data(), 0, length);
+
+    dsp::FeatureExtractor extractor;
+    extractor.prepare(settings.modelSampleRate);
+    analysis->features = extractor.analyseGuide(decimated.data(), decimated.size());
+
+    // The onset map works on the VAD's own 10 ms frames, so energy is taken over the same
+    // span rather than the longer feature window, which would place onsets early.
+    const size_t numHops = decimated.size() / kVadFrameSamples;
+    std::vector<float> energyDb(numHops, -100.0f);
+    for (size_t hop = 0; hop < numHops; ++hop)
+    {
+        const float* frame = decimated.data() + hop * kVadFrameSamples;
+        float sumSquares = 0.0f;
+        for (size_t i = 0; i < kVadFrameSamples; ++i)
+        {
+            sumSquares += frame[i] * frame[i];
+        }
+        energyDb[hop] = 10.0f * std::log10(sumSquares / static_cast<float>(kVadFrameSamples) + 1.0e-10f);
+    }
+
+    const auto probability = guideVoiceActivity(decimated, numHops, analysis->features, settings);
+    analysis->onsets = dsp::OnsetMap::build(probability.data(), energyDb.data(), numHops, extractor.hopSeconds());
+
+    const auto& frames = analysis->features.frames;
+    std::vector<float> pitch(frames.size());
+    for (size_t frame = 0; frame < frames.size(); ++frame)
+    {
+        pitch[frame] = frames[frame].pitchSemitones != 0.0f ? frames[frame].pitchSemitones
+                                                            : std::numeric_limits<float>::quiet_NaN();
+    }
+    const double hopsPerSecond = 1.0 / extractor.hopSeconds();
+    analysis->pitchLane.build(pitch.data(), pitch.size(), hopsPerSecond, 1);
+    analysis->activityLane.build(probability.data(), probability.size(), hopsPerSecond, 1);
+    return analysis;
+}
+} // namespace singwithme::audio
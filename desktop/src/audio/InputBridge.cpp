@@ -0,0 +1,102 @@
+#include "audio/InputBridge.h"
+
+#include <cmath>
+#include <thread>
+
+namespace singwithme::audio
+{
+InputBridge::~InputBridge()
+{
+    close();
+}
+
+bool InputBridge::open(juce::AudioIODeviceType& type,
+                       const juce::String& deviceName,
+                       double outputSampleRate,
+                       int outputBufferSize,
+                       float targetLatencyMs)
+{
+    close();
+
+    std::unique_ptr<juce::AudioIODevice> device(type.createDevice({}, deviceName));
+    if (device == nullptr)
+    {
+        return false;
+    }
+
+    juce::BigInteger inputs;
+    inputs.setBit(0);
+    // Ask for the output's rate and block size; the bridge copes with whatever is granted.
+    const juce::String error = device->open(inputs, {}, outputSampleRate, outputBufferSize);
+    if (error.isNotEmpty())
+    {
+        return false;
+    }
+
+    const double inputRate = device->getCurrentSampleRate();
+    const auto targetFill = static_cast<size_t>(std::ceil(inputRate * targetLatencyMs / 1000.0));
+    bridge_.prepare(inputRate,
+                    outputSampleRate,
+                    static_cast<size_t>(device->getCurrentBufferSizeSamples()),
+                    static_cast<size_t>(outputBufferSize),
+                    targetFill);
+
+    device_ = std::move(device);
+    deviceName_ = deviceName;
+    open_.store(true, std::memory_order_release);
+    device_->start(this);
+    return true;
+}
+
+void InputBridge::close()
+{
+    // A read() that saw the bridge open finishes before the device and ring go away. Both
+    // sides use sequentially consistent operations so neither can miss the other.
+    open_.store(false);
+    while (readers_.load() != 0)
+    {
+        std::this_thread::yield();
+    }
+
+    if (device_ != nullptr)
+    {
+        device_->stop();
+        device_->close();
+        device_.reset();
+    }
+    deviceName_.clear();
+}
+
+bool InputBridge::read(float* destination, int numSamples) noexcept
+{
+    readers_.fetch_add(1);
+    const bool active = open_.load();
+    if (active)
+    {
+        bridge_.pull(destination, static_cast<size_t>(numSamples));
+    }
+    readers_.fetch_sub(1);
+    return active;
+}
+
+void InputBridge::audioDeviceIOCallbackWithContext(const float* const* inputChannelData,
+                                                   int numInputChannels,
+                                                   float* const* /*outputChannelData*/,
+                                                   int /*numOutputChannels*/,
+                                                   int numSamples,
+                                                   const juce::AudioIODeviceCallbackContext& /*context*/)
+{
+    if (inputChannelData != nullptr && numInputChannels > 0 && inputChannelData[0] != nullptr)
+    {
+        bridge_.push(inputChannelData[0], static_cast<size_t>(numSamples));
+    }
+}
+
+void InputBridge::audioDeviceAboutToStart(juce::AudioIODevice* /*device*/)
+{
+}
+
+void InputBridge::audioDeviceStopped()
+{
+}
+} // namespace singwithme::audio
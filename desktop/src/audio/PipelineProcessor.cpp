@@ -1,19 +1,135 @@
-
 #include "audio/PipelineProcessor.h"
 
 #include <algorithm>
 #include <cmath>
 #include <memory>
+#include <utility>
+
+#include "dsp/Simd.h"
+#include "trace/Tracer.h"
 
 namespace singwithme::audio
 {
 namespace
 {
+constexpr size_t kMaxDeviceBlock = 4096;
+constexpr float kMaxThresholdOn = 0.95f;
+constexpr size_t kBleedPartitionSamples = 64;
+// Part of the trip left to the canceller so it can still model the direct path's onset.
+constexpr int kBleedCausalMarginSamples = 32;
+constexpr double kMaxBleedDelaySeconds = 0.5;
+// FeatureFrame::pitchSemitones is measured from this.
+constexpr double kPitchReferenceHz = 100.0;
+// A bus gain at or below this leaves the source off the bus.
+constexpr float kRouteOffDb = -80.0f;
+// Widest device a block can be split for a transport change in; wider ones take it at the
+// block's start.
+constexpr size_t kMaxSplitOutputs = 16;
+// The core's noise floor until calibration measures the room.
+constexpr float kDefaultNoiseFloorAmplitude = 0.13f;
+// The core's reverb send and timbre matching while the guide is played here instead.
+constexpr float kCoreGuideEffectsOff = 0.0f;
+
+// Slices of stemScratch_, kMaxDeviceBlock each.
+enum StemSlot : size_t
+{
+    kStemInstrumentLeft,
+    kStemInstrumentRight,
+    kStemGuide,
+    kStemGuideRight,
+    kStemWetLeft,
+    kStemWetRight,
+    kStemSlots
+};
+
+// Routing matrix sources; each also owns a kMaxDeviceBlock slice of routingScratch_.
+enum RoutedSource : size_t
+{
+    kMixLeft,
+    kMixRight,
+    kMic,
+    kGuideLeft,
+    kGuideRight,
+    kInstrumentLeft,
+    kInstrumentRight,
+    kRoutedSources
+};
+
 float dbToLinear(float db)
 {
     return juce::Decibels::decibelsToGain(db);
 }
 
+dsp::ResamplerQuality parseResamplerQuality(const std::string& name)
+{
+    if (name == "sinc-best")
+    {
+        return dsp::ResamplerQuality::SincBest;
+    }
+    if (name == "sinc-fast")
+    {
+        return dsp::ResamplerQuality::SincFast;
+    }
+    return dsp::ResamplerQuality::Lagrange;
+}
+
+int rateKey(double sampleRate)
+{
+    return static_cast<int>(std::lround(sampleRate));
+}
+
+bool sameRate(double a, double b)
+{
+    return std::abs(a - b) < 1e-3;
+}
+
+std::shared_future<bool> settledFuture(bool value)
+{
+    std::promise<bool> promise;
+    promise.set_value(value);
+    return promise.get_future().share();
+}
+
+// Null for an empty buffer, so a stem that failed to load and one that is missing read the same.
+std::shared_ptr<const juce::AudioBuffer<float>> shareStem(juce::AudioBuffer<float>&& buffer)
+{
+    if (buffer.getNumSamples() == 0)
+    {
+        return nullptr;
+    }
+    return std::make_shared<const juce::AudioBuffer<float>>(std::move(buffer));
+}
+
+int64_t stemLength(const juce::AudioBuffer<float>* stem)
+{
+    return stem != nullptr ? stem->getNumSamples() : 0;
+}
+
+// For a load that was started before a rate change and finished after it.
+void resampleStem(juce::AudioBuffer<float>& buffer, double sourceRate, double targetRate, dsp::ResamplerQuality quality)
+{
+    if (sameRate(sourceRate, targetRate) || buffer.getNumSamples() == 0)
+    {
+        return;
+    }
+
+    dsp::Resampler resampler;
+    resampler.prepare(sourceRate, targetRate, quality, 0);
+    const auto inputLength = static_cast<size_t>(buffer.getNumSamples());
+    const auto outputLength = dsp::Resampler::outputLength(inputLength, sourceRate, targetRate);
+    juce::AudioBuffer<float> resampled(buffer.getNumChannels(), static_cast<int>(outputLength));
+    for (int ch = 0; ch < buffer.getNumChannels(); ++ch)
+    {
+        resampler.render(buffer.getReadPointer(ch), inputLength, resampled.getWritePointer(ch), 0, outputLength);
+    }
+    buffer = std::move(resampled);
+}
+
+size_t loopCrossfadeSamples(const config::RuntimeConfig& config, double sampleRate)
+{
+    return static_cast<size_t>(std::max(0.0, static_cast<double>(config.media.loopCrossfadeMs) * sampleRate / 1000.0));
+}
+
 juce::File resolveToWorkingDirectory(const std::string& path)
 {
     juce::File file(path);
@@ -26,20 +142,46 @@ juce::File resolveToWorkingDirectory(const std::string& path)
 } // namespace
 
 PipelineProcessor::PipelineProcessor()
+    : stems_(makeStems(nullptr, nullptr))
 {
     formatManager_.registerBasicFormats();
+    liveStems_.store(stems_.get());
+}
+
+PipelineProcessor::~PipelineProcessor()
+{
+    shutdown();
+    delete pendingSong_.exchange(nullptr);
+    delete startedSong_.exchange(nullptr);
+    while (const auto* queued = transportQueue_.front())
+    {
+        delete queued->tracks;
+        transportQueue_.pop();
+    }
+    delete armedTransport_.tracks;
+    freeRetiredTracksLocked();
+}
+
+void PipelineProcessor::shutdown()
+{
+    setlist_.shutdown();
+    stemLoader_.shutdown();
 }
 
 PipelineProcessor::Metrics PipelineProcessor::getMetrics() const
 {
     const auto coreMetrics = corePipeline_.getMetrics();
-    return {coreMetrics.inputRms,
-            coreMetrics.outputRms,
-            coreMetrics.vad,
-            coreMetrics.pitch,
-            coreMetrics.confidence,
-            coreMetrics.strength,
-            coreMetrics.gateDb};
+    Metrics metrics{coreMetrics.inputRms,
+                    guidePitchFollow_ ? outputRms_.load(std::memory_order_relaxed) : coreMetrics.outputRms,
+                    coreMetrics.vad,
+                    coreMetrics.pitch,
+                    coreMetrics.confidence,
+                    coreMetrics.strength,
+                    coreMetrics.gateDb};
+    metrics.vadSkippedPercent = vad_ != nullptr ? vad_->inferenceSkippedPercent() : 0.0f;
+    metrics.pitchSkippedPercent = pitch_ != nullptr ? pitch_->inferenceSkippedPercent() : 0.0f;
+    metrics.guidePitchRatio = guidePitchRatio_.load(std::memory_order_relaxed);
+    return metrics;
 }
 
 void PipelineProcessor::setManualMode(dsp::ManualMode mode)
@@ -52,6 +194,33 @@ dsp::ManualMode PipelineProcessor::manualMode() const
     return corePipeline_.manualMode();
 }
 
+void PipelineProcessor::setGateTuning(const GateTuning& tuning)
+{
+    const float fields[] = {tuning.thresholdOn, tuning.thresholdOff, tuning.attackMs, tuning.releaseMs, tuning.holdMs, tuning.duckDb};
+    for (size_t i = 0; i < gateTuning_.size(); ++i)
+    {
+        gateTuning_[i].store(fields[i], std::memory_order_relaxed);
+    }
+    gateTuned_.store(true, std::memory_order_relaxed);
+    gateTuningPending_.store(true, std::memory_order_release);
+}
+
+int PipelineProcessor::outputLatencySamples(double sampleRate) const
+{
+    const float lookAheadMs = runtimeConfig_ != nullptr ? runtimeConfig_->gate.lookAheadMs : 0.0f;
+    return static_cast<int>(std::lround(std::max(0.0, static_cast<double>(lookAheadMs) * sampleRate / 1000.0)));
+}
+
+void PipelineProcessor::setOffline(bool offline)
+{
+    offline_.store(offline, std::memory_order_relaxed);
+}
+
+void PipelineProcessor::setOrtEnvironment(Ort::Env& env)
+{
+    ortEnv_ = &env;
+}
+
 void PipelineProcessor::configure(const config::RuntimeConfig& runtimeConfig,
                                   dsp::ConfidenceGate& gate,
                                   dsp::VadProcessor& vad,
@@ -62,8 +231,22 @@ void PipelineProcessor::configure(const config::RuntimeConfig& runtimeConfig,
     gate_ = &gate;
     vad_ = &vad;
     pitch_ = &pitch;
+    // Pitch runs on the windows feedModels() pushes, and each window is a gate frame; the core
+    // only reads the latest result.
+    pitch_->setStreamed(true);
     calibrator_ = &calibrator;
+    {
+        const std::lock_guard<std::mutex> lock(stemMutex_);
+        sampleRate_.store(runtimeConfig.sampleRate);
+        targetSampleRate_ = runtimeConfig.sampleRate;
+        stemsByRate_.clear();
+        ++stemGeneration_;
+        reportHeldStemsLocked();
+    }
 
+    // With media.guidePitchFollow the guide is played here, through the shifter, so the core's
+    // reverb send and timbre matching stay off.
+    const bool coreGuide = !runtimeConfig.media.guidePitchFollow;
     coreConfig_ = core::PipelineConfig{
         runtimeConfig.sampleRate,
         runtimeConfig.bufferSamples,
@@ -81,101 +264,1111 @@ void PipelineProcessor::configure(const config::RuntimeConfig& runtimeConfig,
             runtimeConfig.gate.thresholdOff,
             runtimeConfig.gate.framesOn,
             runtimeConfig.gate.framesOff,
-            runtimeConfig.gate.duckDb},
+            runtimeConfig.gate.duckDb,
+            runtimeConfig.gate.predictiveOpen},
         runtimeConfig.media.loop,
         dbToLinear(runtimeConfig.media.instrumentGainDb),
         dbToLinear(runtimeConfig.media.guideGainDb),
         runtimeConfig.media.micMonitorGainDb,
-        0.13f,
+        kDefaultNoiseFloorAmplitude,
         runtimeConfig.media.playbackLeakCompensation,
         runtimeConfig.media.crowdCancelAdaptRate,
         runtimeConfig.media.crowdCancelRecoveryRate,
         runtimeConfig.media.crowdCancelClamp,
-        runtimeConfig.media.reverbTailMix,
+        coreGuide ? runtimeConfig.media.reverbTailMix : kCoreGuideEffectsOff,
         runtimeConfig.media.reverbTailSeconds,
-        runtimeConfig.media.timbreMatchStrength,
+        coreGuide ? runtimeConfig.media.timbreMatchStrength : kCoreGuideEffectsOff,
         runtimeConfig.media.envelopeHoldMs,
         runtimeConfig.media.envelopeReleaseMs,
         runtimeConfig.media.envelopeReleaseMod};
 
     corePipeline_.configure(coreConfig_, gate_, vad_, pitch_, calibrator_);
+    gate_->setPitchFrames(true, runtimeConfig.weights.vad, runtimeConfig.weights.pitch);
     corePipeline_.setLooping(runtimeConfig.media.loop);
     corePipeline_.setGuideMute(false);
     corePipeline_.setNoiseFloorAmplitude(coreConfig_.noiseFloorAmplitude);
     corePipeline_.setMicMonitorGainDb(runtimeConfig.media.micMonitorGainDb);
+    stemLoader_.setResamplerQuality(parseResamplerQuality(runtimeConfig.media.resamplerQuality));
+
+    bridgedMic_.assign(kMaxDeviceBlock, 0.0f);
+    stemScratch_.assign(kStemSlots * kMaxDeviceBlock, 0.0f);
+    guideGain_ = dbToLinear(runtimeConfig.media.guideGainDb);
+    guideDuckDb_ = runtimeConfig.gate.duckDb;
+    envelopeHoldMs_.store(runtimeConfig.media.envelopeHoldMs, std::memory_order_relaxed);
+    envelopeReleaseMs_.store(runtimeConfig.media.envelopeReleaseMs, std::memory_order_relaxed);
+    envelopeReleaseMod_.store(runtimeConfig.media.envelopeReleaseMod, std::memory_order_relaxed);
+    guidePitchFollow_ = runtimeConfig.media.guidePitchFollow;
+    reverbTailMix_.store(runtimeConfig.media.reverbTailMix, std::memory_order_relaxed);
+    reverbTailSeconds_.store(runtimeConfig.media.reverbTailSeconds, std::memory_order_relaxed);
+    timbreMatchStrength_ = runtimeConfig.media.timbreMatchStrength;
+    guideTimbre_.setStrength(timbreMatchStrength_);
+    bleedCancellation_ = runtimeConfig.media.bleedCancellation;
+    if (bleedCancellation_)
+    {
+        bleedCanceller_.setStepSize(runtimeConfig.media.bleedStepSize);
+        cleanedMic_.assign(kMaxDeviceBlock, 0.0f);
+        bleedReference_.assign(kMaxDeviceBlock, 0.0f);
+    }
+    configureRouting(runtimeConfig.routing);
+    prepareForSampleRate(runtimeConfig.sampleRate);
 
-    if (!runtimeConfig.media.instrumentPath.empty())
+    configureSetlist();
+    setlist_.setServiceCallback([this] { serviceSetlist(); });
     {
-        loadInstrumentFile(resolveFile(runtimeConfig.media.instrumentPath));
+        const std::lock_guard<std::mutex> lock(setlistMutex_);
+        autoAdvance_ = runtimeConfig.setlist.autoAdvance;
     }
-    if (!runtimeConfig.media.guidePath.empty())
+
+    if (!runtimeConfig.setlist.songs.empty())
     {
-        loadGuideFile(resolveFile(runtimeConfig.media.guidePath));
+        // The first song arrives through the setlist cache and is swapped in as soon as it is decoded.
+        std::vector<SetlistEntry> songs;
+        for (const auto& song : runtimeConfig.setlist.songs)
+        {
+            songs.push_back(SetlistEntry{song.instrumentPath, song.guidePath});
+        }
+        setSetlist(std::move(songs));
+    }
+    else
+    {
+        std::future<bool> instrumentLoad;
+        std::future<bool> guideLoad;
+        if (!runtimeConfig.media.instrumentPath.empty())
+        {
+            instrumentLoad = loadInstrumentFileAsync(resolveFile(runtimeConfig.media.instrumentPath));
+        }
+        if (!runtimeConfig.media.guidePath.empty())
+        {
+            guideLoad = loadGuideFileAsync(resolveFile(runtimeConfig.media.guidePath));
+        }
+        if (instrumentLoad.valid())
+        {
+            instrumentLoad.wait();
+        }
+        if (guideLoad.valid())
+        {
+            guideLoad.wait();
+        }
     }
 
     corePipeline_.play();
 }
 
+void PipelineProcessor::prepareForSampleRate(double sampleRate)
+{
+    const double modelRate = runtimeConfig_->modelSampleRate;
+    modelFeed_.prepare(sampleRate, modelRate, dsp::ResamplerQuality::SincFast, kMaxDeviceBlock);
+    modelBlock_.assign(dsp::Resampler::outputLength(kMaxDeviceBlock, sampleRate, modelRate) + 1, 0.0f);
+    phraseTracker_.prepare(sampleRate, modelRate, modelFeed_.latencySamples());
+    stemDelay_ = outputLatencySamples(sampleRate);
+    guideEnvelope_.configure(sampleRate, dsp::GuideEnvelopeConfig{});
+    guideReverb_.prepare(sampleRate);
+    guideTimbre_.prepare(sampleRate);
+    loopLayout_.prepare(loopCrossfadeSamples(*runtimeConfig_, sampleRate));
+    if (guidePitchFollow_)
+    {
+        guideShifter_.prepare(sampleRate, kMaxDeviceBlock);
+    }
+    guideLead_ = guidePitchFollow_ ? static_cast<int64_t>(guideShifter_.latencySamples() + dsp::TimbreMatcher::latencySamples()) : 0;
+    if (bleedCancellation_)
+    {
+        const auto filterLength = static_cast<size_t>(std::max(0.0, runtimeConfig_->media.bleedFilterMs * sampleRate / 1000.0));
+        bleedCanceller_.prepare(kBleedPartitionSamples, filterLength, kMaxDeviceBlock);
+        bleedDelay_.prepare(static_cast<size_t>(sampleRate * kMaxBleedDelaySeconds));
+    }
+}
+
+void PipelineProcessor::configureSetlist()
+{
+    setlist_.configure(guideAnalysisSettings(),
+                       runtimeConfig_->setlist.preloadDepth,
+                       static_cast<size_t>(std::max(0.0f, runtimeConfig_->setlist.memoryBudgetMb)) * 1024u * 1024u);
+}
+
 bool PipelineProcessor::loadInstrumentFile(const juce::File& file)
+{
+    return loadInstrumentFileAsync(file).get();
+}
+
+bool PipelineProcessor::loadGuideFile(const juce::File& file)
+{
+    return loadGuideFileAsync(file).get();
+}
+
+std::future<bool> PipelineProcessor::loadInstrumentFileAsync(const juce::File& file)
 {
     if (!runtimeConfig_)
     {
-        return false;
+        std::promise<bool> rejected;
+        rejected.set_value(false);
+        return rejected.get_future();
     }
 
-    if (!loadAudioFile(file, backingBuffer_, runtimeConfig_->sampleRate))
+    const double rate = sampleRate();
+    return stemLoader_.load(file,
+                            rate,
+                            [this, file, rate](bool decoded,
+                                               juce::AudioBuffer<float>& buffer,
+                                               std::shared_ptr<const dsp::StemOverview> overview)
+                            { return applyInstrument(file, decoded, buffer, std::move(overview), rate); });
+}
+
+std::future<bool> PipelineProcessor::loadGuideFileAsync(const juce::File& file)
+{
+    if (!runtimeConfig_)
+    {
+        std::promise<bool> rejected;
+        rejected.set_value(false);
+        return rejected.get_future();
+    }
+
+    const double rate = sampleRate();
+    return stemLoader_.load(file,
+                            rate,
+                            [this, file, rate](bool decoded,
+                                               juce::AudioBuffer<float>& buffer,
+                                               std::shared_ptr<const dsp::StemOverview> overview)
+                            { return applyGuide(file, decoded, buffer, std::move(overview), rate); });
+}
+
+bool PipelineProcessor::applyInstrument(const juce::File& file,
+                                        bool decoded,
+                                        juce::AudioBuffer<float>& buffer,
+                                        std::shared_ptr<const dsp::StemOverview> overview,
+                                        double sampleRate)
+{
+    const std::lock_guard<std::mutex> lock(stemMutex_);
+    stemsByRate_.clear();
+    ++stemGeneration_;
+    backingOverview_ = std::move(overview);
+    if (!decoded)
     {
         instrumentPath_.clear();
         backingDurationSeconds_ = 0.0;
-        corePipeline_.clearBackingTrack();
+        publishStemsLocked(nullptr, stems_->guide);
         return false;
     }
 
+    resampleStem(buffer, sampleRate, this->sampleRate(), parseResamplerQuality(runtimeConfig_->media.resamplerQuality));
     instrumentPath_ = file.getFullPathName().toStdString();
-    backingDurationSeconds_ = backingBuffer_.getNumSamples() / runtimeConfig_->sampleRate;
-    pushBackingToCore(backingBuffer_, runtimeConfig_->sampleRate);
+    backingDurationSeconds_ = buffer.getNumSamples() / this->sampleRate();
+    publishStemsLocked(shareStem(std::move(buffer)), stems_->guide);
+    startRateConversionLocked();
     return true;
 }
 
-bool PipelineProcessor::loadGuideFile(const juce::File& file)
+bool PipelineProcessor::applyGuide(const juce::File& file,
+                                   bool decoded,
+                                   juce::AudioBuffer<float>& buffer,
+                                   std::shared_ptr<const dsp::StemOverview> overview,
+                                   double sampleRate)
 {
-    if (!runtimeConfig_)
+    // Analysed on the loader thread before taking the lock; this is the expensive part.
+    auto analysis = decoded ? analyseGuide(buffer, guideAnalysisSettings()) : nullptr;
+
+    const std::lock_guard<std::mutex> lock(stemMutex_);
+    stemsByRate_.clear();
+    ++stemGeneration_;
+    guideOverview_ = std::move(overview);
+    publishGuideAnalysisLocked(std::move(analysis));
+    if (!decoded)
     {
+        guidePath_.clear();
+        vocalDurationSeconds_ = 0.0;
+        publishStemsLocked(stems_->backing, nullptr);
         return false;
     }
 
-    if (!loadAudioFile(file, vocalBuffer_, runtimeConfig_->sampleRate))
+    resampleStem(buffer, sampleRate, this->sampleRate(), parseResamplerQuality(runtimeConfig_->media.resamplerQuality));
+    guidePath_ = file.getFullPathName().toStdString();
+    vocalDurationSeconds_ = buffer.getNumSamples() / this->sampleRate();
+    publishStemsLocked(stems_->backing, shareStem(std::move(buffer)));
+    startRateConversionLocked();
+    return true;
+}
+
+void PipelineProcessor::setSetlist(std::vector<SetlistEntry> songs)
+{
+    const std::lock_guard<std::mutex> lock(setlistMutex_);
+    dropArmedSongLocked();
+    activeSongIndex_ = -1;
+    setlist_.setSongs(std::move(songs));
+}
+
+int PipelineProcessor::setlistSize() const
+{
+    return setlist_.size();
+}
+
+int PipelineProcessor::currentSongIndex() const
+{
+    const std::lock_guard<std::mutex> lock(setlistMutex_);
+    return activeSongIndex_;
+}
+
+void PipelineProcessor::jumpToSong(int index)
+{
+    const std::lock_guard<std::mutex> lock(setlistMutex_);
+    if (index < 0 || index >= setlist_.size())
+    {
+        return;
+    }
+
+    dropArmedSongLocked();
+    if (!armSongLocked(index, true))
+    {
+        // Not decoded yet: make it the head of the preload window and let serviceSetlist()
+        // swap it in as soon as it is ready.
+        activeSongIndex_ = -1;
+        setlist_.setCurrent(index);
+    }
+}
+
+void PipelineProcessor::nextSong()
+{
+    int next = 0;
+    {
+        const std::lock_guard<std::mutex> lock(setlistMutex_);
+        next = (activeSongIndex_ < 0 ? setlist_.current() : activeSongIndex_) + 1;
+    }
+    jumpToSong(next);
+}
+
+void PipelineProcessor::serviceSetlist()
+{
+    const std::lock_guard<std::mutex> lock(setlistMutex_);
+    if (auto* started = startedSong_.exchange(nullptr, std::memory_order_acq_rel))
+    {
+        const std::unique_ptr<ArmedSong> retired(started);
+        adoptStartedSong(*retired);
+        activeSongIndex_ = retired->song->index;
+        cuedSongIndex_ = -1;
+        setlist_.setCurrent(activeSongIndex_);
+    }
+
+    // A song armed before the device changed rate is re-armed from the new rate's cache. The
+    // audio thread never starts it, so reading it here is safe.
+    if (auto* armed = pendingSong_.load(std::memory_order_acquire);
+        armed != nullptr && !sameRate(armed->sampleRate, sampleRate()))
+    {
+        const int cued = cuedSongIndex_;
+        const bool immediate = armed->immediate;
+        dropArmedSongLocked();
+        if (immediate && !armSongLocked(cued, true))
+        {
+            activeSongIndex_ = -1;
+            setlist_.setCurrent(cued);
+        }
+    }
+
+    if (cuedSongIndex_ >= 0 || pendingSong_.load(std::memory_order_acquire) != nullptr)
+    {
+        return;
+    }
+
+    if (activeSongIndex_ < 0)
+    {
+        if (setlist_.size() > 0)
+        {
+            armSongLocked(setlist_.current(), true);
+        }
+    }
+    else if (autoAdvance_ && activeSongIndex_ + 1 < setlist_.size())
+    {
+        armSongLocked(activeSongIndex_ + 1, false);
+    }
+}
+
+bool PipelineProcessor::armSongLocked(int index, bool immediately)
+{
+    auto song = setlist_.prepared(index);
+    if (song == nullptr)
     {
-        guidePath_.clear();
-        vocalDurationSeconds_ = 0.0;
-        corePipeline_.clearVocalTrack();
         return false;
     }
 
-    guidePath_ = file.getFullPathName().toStdString();
-    vocalDurationSeconds_ = vocalBuffer_.getNumSamples() / runtimeConfig_->sampleRate;
-    pushGuideToCore(vocalBuffer_, runtimeConfig_->sampleRate);
+    auto armed = std::make_unique<ArmedSong>();
+    armed->song = song;
+    auto stems = makeStems(song->backing.getNumSamples() > 0 ? StemBuffer(song, &song->backing) : nullptr,
+                           song->guide.getNumSamples() > 0 ? StemBuffer(song, &song->guide) : nullptr);
+    stems->cached = true;
+    {
+        // Laid out like a loaded song: with media.loop its end is crossfaded into its start.
+        const std::lock_guard<std::mutex> stemLock(stemMutex_);
+        armed->tracks = layOutTracks(loopLayout_, *stems, homeSpan(stems->length));
+    }
+    armed->stems = std::move(stems);
+    armed->sampleRate = song->sampleRate;
+    armed->immediate = immediately;
+    delete pendingSong_.exchange(armed.release(), std::memory_order_acq_rel);
+    cuedSongIndex_ = index;
+    return true;
+}
+
+void PipelineProcessor::dropArmedSongLocked()
+{
+    delete pendingSong_.exchange(nullptr, std::memory_order_acq_rel);
+    cuedSongIndex_ = -1;
+}
+
+void PipelineProcessor::adoptStartedSong(const ArmedSong& started)
+{
+    const auto& song = *started.song;
+    const std::lock_guard<std::mutex> lock(stemMutex_);
+    stemsByRate_.clear();
+    ++stemGeneration_;
+    // The audio thread has moved on to the song's stems, unless a load replaced them since;
+    // the stems they took over from are freed here rather than on the audio thread.
+    if (liveStems_.load(std::memory_order_acquire) == started.stems.get())
+    {
+        stems_ = started.stems;
+    }
+    reportHeldStemsLocked();
+    instrumentPath_ = song.entry.instrumentPath.empty() ? std::string{} : resolveFile(song.entry.instrumentPath).getFullPathName().toStdString();
+    guidePath_ = song.entry.guidePath.empty() ? std::string{} : resolveFile(song.entry.guidePath).getFullPathName().toStdString();
+    backingDurationSeconds_ = song.backing.getNumSamples() / song.sampleRate;
+    vocalDurationSeconds_ = song.guide.getNumSamples() / song.sampleRate;
+    backingOverview_ = song.backingOverview;
+    guideOverview_ = song.guideOverview;
+    publishGuideAnalysisLocked(song.guideAnalysis);
+    startRateConversionLocked();
+}
+
+void PipelineProcessor::publishGuideAnalysisLocked(std::shared_ptr<const GuideAnalysis> analysis)
+{
+    liveGuideAnalysis_.store(analysis.get(), std::memory_order_release);
+    retiredGuideAnalysis_ = std::move(guideAnalysis_);
+    guideAnalysis_ = std::move(analysis);
+}
+
+size_t PipelineProcessor::SongStems::memoryBytes() const
+{
+    const auto bytes = [](const StemBuffer& stem)
+    {
+        return stem != nullptr ? static_cast<size_t>(stem->getNumChannels()) * static_cast<size_t>(stem->getNumSamples()) * sizeof(float) : 0;
+    };
+    return bytes(backing) + bytes(guide);
+}
+
+std::shared_ptr<PipelineProcessor::SongStems> PipelineProcessor::makeStems(StemBuffer backing, StemBuffer guide)
+{
+    auto stems = std::make_shared<SongStems>();
+    stems->length = std::max(stemLength(backing.get()), stemLength(guide.get()));
+    stems->backing = std::move(backing);
+    stems->guide = std::move(guide);
+    return stems;
+}
+
+void PipelineProcessor::publishStemsLocked(StemBuffer backing, StemBuffer guide)
+{
+    std::shared_ptr<const SongStems> stems = makeStems(std::move(backing), std::move(guide));
+    // Both stems go back into the core together, so the one that did not change never keeps
+    // an older seek or loop layout. They are laid out from where the transport is before the
+    // audio thread is locked out, and the playhead carries on from there.
+    const auto span = homeSpan(stems->length, transportPosition_.load(std::memory_order_relaxed));
+    auto tracks = layOutTracks(loopLayout_, *stems, span);
+    {
+        const std::lock_guard<std::mutex> coreLock(coreMutex_);
+        loadCoreTracks(tracks, rateKey(sampleRate()));
+        liveStems_.store(stems.get(), std::memory_order_release);
+        homeOrigin_ = span.origin;
+        layoutGeneration_.fetch_add(1, std::memory_order_acq_rel);
+    }
+    // No block can still be reading the old stems, and the core has let go of its old tracks;
+    // both are freed on this thread.
+    stems_.swap(stems);
+    reportHeldStemsLocked();
+}
+
+void PipelineProcessor::reportHeldStemsLocked()
+{
+    // Stems loaded from files and copies at other rates live outside the setlist cache but
+    // share its budget. A setlist song's copy at an old rate may be counted by both until
+    // the cache evicts its own.
+    size_t bytes = stems_->cached ? 0 : stems_->memoryBytes();
+    for (const auto& [rate, stems] : stemsByRate_)
+    {
+        bytes += stems->memoryBytes();
+    }
+    setlist_.setHeldBytes(bytes);
+}
+
+void PipelineProcessor::swapArmedSong()
+{
+    auto* armed = pendingSong_.load(std::memory_order_acquire);
+    if (armed == nullptr || startedSong_.load(std::memory_order_acquire) != nullptr || runtimeConfig_ == nullptr
+        || !sameRate(armed->sampleRate, sampleRate()))
+    {
+        return;
+    }
+
+    // Gapless hand-over: processCore() ends a stretch on the current song's last sample and
+    // swaps before the next. The core's tracks were laid out on the setlist thread and are
+    // moved in; the core frees the ones it was playing here, as PipelineCore has no way to
+    // hand them back. The song keeps its stems and analysis alive until adoptStartedSong()
+    // takes them over, and the ones they replace are freed there.
+    const int64_t length = liveStems_.load(std::memory_order_relaxed)->length;
+    const bool playing = corePipeline_.transportState() == core::TransportState::Playing;
+    const bool due = armed->immediate || length <= 0 || (playing && (songEnded_ || samplesUntilSongEnd() == 0));
+    if (!due || !pendingSong_.compare_exchange_strong(armed, nullptr, std::memory_order_acq_rel))
+    {
+        return;
+    }
+
+    loadCoreTracks(armed->tracks, rateKey(armed->sampleRate));
+    liveGuideAnalysis_.store(armed->song->guideAnalysis.get(), std::memory_order_release);
+    liveStems_.store(armed->stems.get(), std::memory_order_release);
+    homeTransport(armed->stems->length, 0);
+    songEnded_ = false;
+    startedSong_.store(armed, std::memory_order_release);
+    // After startedSong_, so a transport producer that sees the new generation also sees the
+    // song it belongs to; spans planned on the last song are dropped.
+    appliedGeneration_ = layoutGeneration_.fetch_add(1, std::memory_order_acq_rel) + 1;
+}
+
+int64_t PipelineProcessor::samplesUntilSongEnd() const
+{
+    // Until the core has played the song's last sample along span_. A loop ends it only by
+    // wrapping at that sample; one that stops short never gets there.
+    const int64_t length = liveStems_.load(std::memory_order_relaxed)->length;
+    if (!span_.looping())
+    {
+        return std::max<int64_t>(0, length - span_.origin - layoutOffset_);
+    }
+    if (span_.loopEnd < length)
+    {
+        return -1;
+    }
+    return span_.loopEnd - span_.position(layoutOffset_);
+}
+
+bool PipelineProcessor::startLatencyMeasurement()
+{
+    if (runtimeConfig_ == nullptr || measuringLatency_.load(std::memory_order_acquire))
+    {
+        return false;
+    }
+
+    latencyProbe_.start(sampleRate());
+    measuringLatency_.store(true, std::memory_order_release);
     return true;
 }
 
+bool PipelineProcessor::isMeasuringLatency() const
+{
+    return measuringLatency_.load(std::memory_order_acquire);
+}
+
+calibration::LatencyMeasurement PipelineProcessor::latencyMeasurement() const
+{
+    if (measuringLatency_.load(std::memory_order_acquire))
+    {
+        return {};
+    }
+    return latencyProbe_.result();
+}
+
+void PipelineProcessor::setRoundTripLatency(int samples)
+{
+    roundTripSamples_.store(std::max(0, samples), std::memory_order_relaxed);
+}
+
+int PipelineProcessor::roundTripLatency() const
+{
+    return roundTripSamples_.load(std::memory_order_relaxed);
+}
+
+void PipelineProcessor::setInputBridge(InputBridge* bridge)
+{
+    inputBridge_.store(bridge, std::memory_order_release);
+}
+
+void PipelineProcessor::runLatencyProbe(const float* micInput, float* const* outputs, int numOutputs, int numSamples)
+{
+    latencyProbe_.processBlock(micInput, outputs[0], static_cast<size_t>(numSamples));
+    for (int ch = 1; ch < numOutputs; ++ch)
+    {
+        if (outputs[ch] != nullptr && outputs[0] != nullptr)
+        {
+            std::copy(outputs[0], outputs[0] + numSamples, outputs[ch]);
+        }
+    }
+    if (latencyProbe_.isComplete())
+    {
+        measuringLatency_.store(false, std::memory_order_release);
+    }
+}
+
+const float* PipelineProcessor::cancelBleed(const float* micInput, int numSamples)
+{
+    if (!bleedCancellation_ || micInput == nullptr || static_cast<size_t>(numSamples) > cleanedMic_.size())
+    {
+        return micInput;
+    }
+
+    TUNETRIX_TRACE_ZONE("Bleed cancel");
+    bleedCanceller_.process(micInput, cleanedMic_.data(), static_cast<size_t>(numSamples));
+    return cleanedMic_.data();
+}
+
+void PipelineProcessor::pushBleedReference(const float* micInput,
+                                           const float* const* outputs,
+                                           int numOutputs,
+                                           int numSamples)
+{
+    if (!bleedCancellation_ || static_cast<size_t>(numSamples) > bleedReference_.size())
+    {
+        return;
+    }
+
+    // The reference is what the speakers play, minus the direct mic monitor: left in, it
+    // would teach the filter to cancel the singer along with the bleed.
+    const float monitorGain = dbToLinear(corePipeline_.micMonitorGainDb());
+    const float channelScale = 1.0f / static_cast<float>(numOutputs);
+    for (int i = 0; i < numSamples; ++i)
+    {
+        float sum = 0.0f;
+        for (int ch = 0; ch < numOutputs; ++ch)
+        {
+            sum += outputs[ch] != nullptr ? outputs[ch][i] : 0.0f;
+        }
+        const float monitored = micInput != nullptr ? monitorGain * micInput[i] : 0.0f;
+        bleedReference_[static_cast<size_t>(i)] = sum * channelScale - monitored;
+    }
+
+    // Take the bulk of the measured round trip out of the reference so the filter only has
+    // to learn the room. process() already puts one block between the two streams.
+    const int bulkDelay = std::max(0, roundTripSamples_.load(std::memory_order_relaxed) - numSamples - kBleedCausalMarginSamples);
+    if (static_cast<size_t>(bulkDelay) != bleedDelay_.delay())
+    {
+        bleedDelay_.setDelay(static_cast<size_t>(bulkDelay));
+        bleedCanceller_.reset();
+    }
+    bleedDelay_.process(bleedReference_.data(), bleedReference_.data(), static_cast<size_t>(numSamples));
+    bleedCanceller_.pushReference(bleedReference_.data(), static_cast<size_t>(numSamples));
+}
+
+void PipelineProcessor::feedModels(const float* micInput, int numSamples)
+{
+    // The mic is decimated to the model rate once for all the inference run here: pitch over
+    // windows every models.pitchHopMs, each of which is a decision frame for the gate, and the
+    // phrase tracker while the song plays. The core keeps its own feed for the VAD.
+    if (micInput == nullptr || runtimeConfig_ == nullptr || pitch_ == nullptr)
+    {
+        return;
+    }
+
+    TUNETRIX_TRACE_ZONE("Model feed");
+    const bool tracking = (runtimeConfig_->weights.phraseAware > 0.0f || guidePitchFollow_)
+                          && corePipeline_.transportState() == core::TransportState::Playing;
+    const auto total = static_cast<size_t>(numSamples);
+    for (size_t offset = 0; offset < total; offset += kMaxDeviceBlock)
+    {
+        const size_t count = std::min(kMaxDeviceBlock, total - offset);
+        const size_t produced = modelFeed_.process(micInput + offset, count, modelBlock_.data(), modelBlock_.size());
+        const size_t windows = pitch_->push(modelBlock_.data(), produced);
+        for (size_t i = 0; i < windows && gate_ != nullptr; ++i)
+        {
+            const auto estimate = pitch_->pushedEstimate(i);
+            gate_->pushPitchFrame(estimate.confidence, estimate.endSample);
+        }
+        if (tracking)
+        {
+            phraseTracker_.push(modelBlock_.data(), produced);
+        }
+    }
+}
+
+void PipelineProcessor::updateGateContext(const float* micInput, int numSamples)
+{
+    if (runtimeConfig_ == nullptr || gate_ == nullptr)
+    {
+        return;
+    }
+
+    // Only follow the song while it is rolling; a paused transport must not pre-arm the gate
+    // and lets the phrase estimate decay.
+    const bool playing = corePipeline_.transportState() == core::TransportState::Playing;
+    const auto* analysis = liveGuideAnalysis_.load(std::memory_order_acquire);
+    gate_->setGuideOnsets(playing && analysis != nullptr ? &analysis->onsets : nullptr,
+                          static_cast<double>(playheadSamples_) / sampleRate());
+
+    if (runtimeConfig_->weights.phraseAware <= 0.0f && !guidePitchFollow_)
+    {
+        return;
+    }
+
+    phraseTracker_.setReference(analysis != nullptr ? &analysis->features : nullptr);
+    // The singer follows what they hear, so the mic trails the playhead by the round trip.
+    const auto estimate = phraseTracker_.process(playing && micInput != nullptr,
+                                                 playheadSamples_ + numSamples - roundTripSamples_.load(std::memory_order_relaxed));
+    gate_->setPhraseContext(estimate.phraseAware, runtimeConfig_->weights.phraseAware, estimate.msUntilOnset);
+    steerGuideShifter(playing ? analysis : nullptr, estimate);
+}
+
+void PipelineProcessor::steerGuideShifter(const GuideAnalysis* analysis, const dsp::PhraseEstimate& estimate)
+{
+    if (!guidePitchFollow_)
+    {
+        return;
+    }
+
+    // The period is that of the guide frame now going into the shifter; the ratio compares
+    // the singer with the guide frame they aligned to, and holds while either is unvoiced.
+    double period = 0.0;
+    if (analysis != nullptr && analysis->features.hopSeconds > 0.0)
+    {
+        const auto& frames = analysis->features.frames;
+        const int64_t fed = std::max<int64_t>(0, span_.position(layoutOffset_ - stemDelay_ + guideLead_));
+        const auto index = static_cast<size_t>(static_cast<double>(fed) / sampleRate() / analysis->features.hopSeconds);
+        if (index < frames.size() && frames[index].pitchSemitones != 0.0f)
+        {
+            const double hz = kPitchReferenceHz * std::exp2(static_cast<double>(frames[index].pitchSemitones) / 12.0);
+            period = sampleRate() / hz;
+        }
+    }
+    guideShifter_.setPeriod(period);
+    if (estimate.guidePitchSemitones != 0.0f && estimate.micPitchSemitones != 0.0f)
+    {
+        const double semitones = static_cast<double>(estimate.micPitchSemitones - estimate.guidePitchSemitones);
+        guideShifter_.setRatio(std::exp2(semitones / 12.0));
+    }
+    guidePitchRatio_.store(static_cast<float>(guideShifter_.ratio()), std::memory_order_relaxed);
+}
+
+void PipelineProcessor::applyCalibration()
+{
+    if (calibrationApplied_.load(std::memory_order_relaxed) || calibrator_ == nullptr || !calibrator_->isComplete())
+    {
+        return;
+    }
+
+    calibrationApplied_.store(true);
+    const auto calibration = calibrator_->result();
+    if (calibration.isValid)
+    {
+        writeCalibration(calibration);
+    }
+}
+
+void PipelineProcessor::writeCalibration(const calibration::CalibrationResult& calibration)
+{
+    // The inference schedulers treat anything near the measured room floor as silence.
+    vad_->setNoiseFloorDb(calibration.noiseFloorDb);
+    pitch_->setNoiseFloorDb(calibration.noiseFloorDb);
+    corePipeline_.setNoiseFloorAmplitude(calibration.noiseGateAmplitude);
+
+    const float thresholdOn = std::min(kMaxThresholdOn, runtimeConfig_->gate.thresholdOn + calibration.thresholdBoost);
+    const float thresholdOff = std::min(thresholdOn, runtimeConfig_->gate.thresholdOff + calibration.thresholdBoost);
+    gate_->setThresholds(thresholdOn, thresholdOff);
+    thresholdBoost_ = calibration.thresholdBoost;
+    if (gateTuned_.load(std::memory_order_relaxed))
+    {
+        // The tuned thresholds replace the preset's on the next block, boosted the same way.
+        gateTuningPending_.store(true, std::memory_order_release);
+    }
+}
+
+void PipelineProcessor::applyGateTuning()
+{
+    if (gate_ == nullptr || !gateTuningPending_.exchange(false, std::memory_order_acquire))
+    {
+        return;
+    }
+
+    std::array<float, 6> tuning{};
+    for (size_t i = 0; i < tuning.size(); ++i)
+    {
+        tuning[i] = gateTuning_[i].load(std::memory_order_relaxed);
+    }
+    const float thresholdOn = std::min(kMaxThresholdOn, tuning[0] + thresholdBoost_);
+    gate_->setThresholds(thresholdOn, std::min(thresholdOn, tuning[1] + thresholdBoost_));
+    gate_->setResponse(tuning[2], tuning[3], tuning[4], tuning[5]);
+    guideDuckDb_ = tuning[5];
+}
+
+GuideAnalysisSettings PipelineProcessor::guideAnalysisSettings() const
+{
+    GuideAnalysisSettings settings;
+    if (runtimeConfig_ != nullptr)
+    {
+        settings.sampleRate = sampleRate();
+        settings.modelSampleRate = runtimeConfig_->modelSampleRate;
+        settings.vadModelPath = runtimeConfig_->vadModelPath;
+    }
+    settings.env = ortEnv_;
+    return settings;
+}
+
+void PipelineProcessor::configureRouting(const config::RoutingConfig& routing)
+{
+    routing_.clearRoutes();
+    routedGuides_.clear();
+    for (const auto& bus : routing.buses)
+    {
+        if (bus.outputs.empty())
+        {
+            continue;
+        }
+
+        // A mono bus takes both routes of a stereo source on the one output, at half gain.
+        const bool stereo = bus.outputs.size() > 1;
+        const float fold = stereo ? 1.0f : 0.5f;
+        const auto left = static_cast<size_t>(bus.outputs.front());
+        const auto right = static_cast<size_t>(bus.outputs.back());
+        const auto addPair = [&](size_t leftSource, size_t rightSource, float gain)
+        {
+            const size_t leftRoute = routing_.addRoute(leftSource, left, gain * fold);
+            return std::make_pair(leftRoute, routing_.addRoute(rightSource, right, gain * fold));
+        };
+
+        if (bus.mixGainDb > kRouteOffDb)
+        {
+            addPair(kMixLeft, kMixRight, dbToLinear(bus.mixGainDb));
+        }
+        if (bus.instrumentGainDb > kRouteOffDb)
+        {
+            addPair(kInstrumentLeft, kInstrumentRight, dbToLinear(bus.instrumentGainDb));
+        }
+        if (bus.guideGainDb > kRouteOffDb)
+        {
+            // Silent until the first block sets it from the gate.
+            const auto [leftRoute, rightRoute] = addPair(kGuideLeft, kGuideRight, 0.0f);
+            routedGuides_.push_back(RoutedGuide{leftRoute, rightRoute, dbToLinear(bus.guideGainDb) * fold, dbToLinear(bus.gateDepthDb)});
+        }
+        if (bus.micGainDb > kRouteOffDb)
+        {
+            routing_.addRoute(kMic, left, dbToLinear(bus.micGainDb));
+            if (stereo)
+            {
+                routing_.addRoute(kMic, right, dbToLinear(bus.micGainDb));
+            }
+        }
+    }
+    routingScratch_.assign(routing_.numRoutes() > 0 ? kRoutedSources * kMaxDeviceBlock : 0, 0.0f);
+}
+
+void PipelineProcessor::routeOutputs(const float* micInput, float* const* outputs, int numOutputs, int numSamples)
+{
+    TUNETRIX_TRACE_ZONE("Output routing");
+    const auto count = static_cast<size_t>(numSamples);
+    const auto scratch = [this](RoutedSource source) { return routingScratch_.data() + source * kMaxDeviceBlock; };
+
+    // The buses add the mic at their own levels, so the core's monitor comes out of its mix
+    // the same way it does for the bleed reference.
+    float* mixLeft = scratch(kMixLeft);
+    float* mixRight = scratch(kMixRight);
+    if (micInput != nullptr)
+    {
+        const float monitorGain = dbToLinear(corePipeline_.micMonitorGainDb());
+        dsp::simd::rampMultiplyAccumulate(micInput, -monitorGain, 0.0f, mixLeft, count);
+        dsp::simd::rampMultiplyAccumulate(micInput, -monitorGain, 0.0f, mixRight, count);
+    }
+
+    // The guide routes take the guide before it is levelled for the mix.
+    const float* sources[kRoutedSources] = {mixLeft,
+                                            mixRight,
+                                            micInput,
+                                            stemBlock_.guide,
+                                            stemBlock_.guide,
+                                            stemBlock_.instrumentLeft,
+                                            stemBlock_.instrumentRight};
+
+    const bool guideMuted = corePipeline_.guideMuted();
+    const float gate = dbToLinear(corePipeline_.getMetrics().gateDb);
+    for (const auto& guide : routedGuides_)
+    {
+        const float gain = guideMuted ? 0.0f : guide.gain * std::max(gate, guide.depth);
+        routing_.setGain(guide.left, gain);
+        routing_.setGain(guide.right, gain);
+    }
+    routing_.process(sources, kRoutedSources, outputs, static_cast<size_t>(numOutputs), count);
+}
+
+void PipelineProcessor::mixStems(const float* micInput, float* const* outputs, int numOutputs, int numSamples)
+{
+    stemBlock_ = StemBlock{};
+    if (numSamples <= 0 || static_cast<size_t>(numSamples) > kMaxDeviceBlock)
+    {
+        return;
+    }
+
+    // The core plays the instrument, and the guide too unless media.guidePitchFollow has it
+    // played here. The routed buses take both from the stems, dry.
+    const bool routed = routing_.numRoutes() > 0;
+    if (!guidePitchFollow_ && !routed)
+    {
+        return;
+    }
+
+    TUNETRIX_TRACE_ZONE("Stem mix");
+    const auto count = static_cast<size_t>(numSamples);
+    const auto scratch = [this](StemSlot slot) { return stemScratch_.data() + slot * kMaxDeviceBlock; };
+    const auto segmentsEnd = segments_.begin() + segmentCount_;
+    const bool playing = std::any_of(segments_.begin(), segmentsEnd, [](const TransportSegment& segment) { return segment.playing; });
+    const bool stereoGuide = std::any_of(segments_.begin(), segmentsEnd, [](const TransportSegment& segment) {
+        return segment.stems->guide != nullptr && segment.stems->guide->getNumChannels() > 1;
+    });
+
+    const float* instrument[] = {routed ? readStem(false, 0, numSamples, 0, scratch(kStemInstrumentLeft)) : nullptr,
+                                 routed ? readStem(false, 1, numSamples, 0, scratch(kStemInstrumentRight)) : nullptr};
+
+    // The guide is a voice: a stereo one is folded to mono. Played here, it is read ahead by
+    // what its effects delay it, so it comes out of them in time with the core's instrument.
+    float* guide = scratch(kStemGuide);
+    if (const float* left = readStem(true, 0, numSamples, guideLead_, guide); left == nullptr)
+    {
+        std::fill(guide, guide + count, 0.0f);
+    }
+    else if (left != guide)
+    {
+        std::copy(left, left + count, guide);
+    }
+    if (const float* right = stereoGuide ? readStem(true, 1, numSamples, guideLead_, scratch(kStemGuideRight)) : nullptr;
+        right != nullptr)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            guide[i] = 0.5f * (guide[i] + right[i]);
+        }
+    }
+    if (!guidePitchFollow_)
+    {
+        stemBlock_ = StemBlock{instrument[0], instrument[1], guide};
+        return;
+    }
+    guideShifter_.process(guide, guide, count);
+    guideTimbre_.process(guide, guide, count);
+
+    // The guide follows the gate: up while the singer is confidently on, held and released
+    // slowly after.
+    float peak = 0.0f;
+    for (size_t i = 0; micInput != nullptr && i < count; ++i)
+    {
+        peak = std::max(peak, std::abs(micInput[i]));
+    }
+    dsp::GuideEnvelopeConfig envelope;
+    envelope.holdMs = envelopeHoldMs_.load(std::memory_order_relaxed);
+    envelope.releaseMs = envelopeReleaseMs_.load(std::memory_order_relaxed);
+    envelope.releaseMod = envelopeReleaseMod_.load(std::memory_order_relaxed);
+    envelope.tailMix = reverbTailMix_.load(std::memory_order_relaxed);
+    envelope.tailSeconds = reverbTailSeconds_.load(std::memory_order_relaxed);
+    envelope.duckDb = guideDuckDb_;
+    envelope.noiseFloor = corePipeline_.noiseFloorAmplitude();
+    guideEnvelope_.setConfig(envelope);
+    const auto metrics = corePipeline_.getMetrics();
+    const auto levels = guideEnvelope_.update(count, peak, metrics.gateDb, metrics.confidence, metrics.strength, playing);
+    const float guideGain = corePipeline_.guideMuted() ? 0.0f : guideGain_;
+    const float guideLevel = levels.guideMix * guideGain;
+    const float guideStep = (guideLevel - guideLevel_) / static_cast<float>(count);
+
+    // The tail is sent the guide before levelling, at a send that follows the envelope
+    // slowly, so it rings out after the guide ducks.
+    float* wet[] = {scratch(kStemWetLeft), scratch(kStemWetRight)};
+    std::fill(wet[0], wet[0] + count, 0.0f);
+    std::fill(wet[1], wet[1] + count, 0.0f);
+    guideReverb_.setTail(levels.tailMix * guideGain, envelope.tailSeconds);
+    guideReverb_.process(guide, wet[0], wet[1], count);
+
+    // A mono device takes both sides on its one output at half gain, like a mono bus.
+    const int sides = std::min(numOutputs, 2);
+    const float fold = sides == 1 ? 0.5f : 1.0f;
+    for (int side = 0; side < 2; ++side)
+    {
+        float* out = outputs[std::min(side, sides - 1)];
+        if (out == nullptr)
+        {
+            continue;
+        }
+        dsp::simd::rampMultiplyAccumulate(guide, guideLevel_ * fold, guideStep * fold, out, count);
+        dsp::simd::rampMultiplyAccumulate(wet[side], fold, 0.0f, out, count);
+    }
+    guideLevel_ = guideLevel;
+
+    float sumOfSquares = 0.0f;
+    for (int side = 0; side < sides; ++side)
+    {
+        sumOfSquares += outputs[side] != nullptr ? dsp::simd::sumOfSquares(outputs[side], count) : 0.0f;
+    }
+    outputRms_.store(std::sqrt(sumOfSquares / static_cast<float>(count * static_cast<size_t>(sides))), std::memory_order_relaxed);
+    stemBlock_ = StemBlock{instrument[0], instrument[1], guide};
+}
+
+const float* PipelineProcessor::readStem(bool guide,
+                                         int channel,
+                                         int numSamples,
+                                         int64_t lead,
+                                         float* scratch) const
+{
+    // Each stretch reads the stems it was played with, so a block that hands over to the
+    // next song reads both.
+    const auto stemOf = [guide](const TransportSegment& segment) -> const juce::AudioBuffer<float>* {
+        const auto* stem = guide ? segment.stems->guide.get() : segment.stems->backing.get();
+        return stem != nullptr && stem->getNumChannels() > 0 ? stem : nullptr;
+    };
+
+    // A mono stem feeds both channels. The core's output trails its tracks by the gate's
+    // look-ahead and the stems follow it, lead samples early, through the same spans,
+    // crossfades included; the look-ahead's worth before a new song's first sample reads
+    // silent. A block that plays straight through the stem points into it; any other is
+    // rendered to scratch.
+    if (segmentCount_ == 1 && segments_[0].playing)
+    {
+        const auto& segment = segments_[0];
+        const auto* stem = stemOf(segment);
+        if (stem == nullptr)
+        {
+            return nullptr;
+        }
+        if (const int64_t position = loopLayout_.directRead(segment.span, segment.layoutOffset - stemDelay_ + lead, numSamples, stem->getNumSamples());
+            position >= 0)
+        {
+            return stem->getReadPointer(std::min(channel, stem->getNumChannels() - 1)) + position;
+        }
+    }
+
+    bool rendered = false;
+    for (int i = 0; i < segmentCount_; ++i)
+    {
+        const auto& segment = segments_[static_cast<size_t>(i)];
+        const auto* stem = stemOf(segment);
+        float* out = scratch + segment.start;
+        if (segment.playing && stem != nullptr)
+        {
+            loopLayout_.render(stem->getReadPointer(std::min(channel, stem->getNumChannels() - 1)),
+                               stem->getNumSamples(),
+                               segment.span,
+                               segment.layoutOffset - stemDelay_ + lead,
+                               out,
+                               segment.count);
+            rendered = true;
+        }
+        else
+        {
+            std::fill(out, out + segment.count, 0.0f);
+        }
+    }
+    return rendered ? scratch : nullptr;
+}
+
+void PipelineProcessor::advancePlayhead(int numSamples)
+{
+    switch (corePipeline_.transportState())
+    {
+        case core::TransportState::Playing:
+            layoutOffset_ += numSamples;
+            break;
+        case core::TransportState::Stopped:
+            layoutOffset_ = 0;
+            break;
+        case core::TransportState::Paused:
+        default:
+            break;
+    }
+    playheadSamples_ = span_.position(layoutOffset_);
+}
+
+dsp::PlaybackSpan PipelineProcessor::homeSpan(int64_t songLength, int64_t origin) const
+{
+    const bool loop = runtimeConfig_ != nullptr && runtimeConfig_->media.loop && songLength > 0;
+    return dsp::PlaybackSpan{std::clamp<int64_t>(origin, 0, std::max<int64_t>(0, songLength - 1)), 0, loop ? songLength : 0};
+}
+
+PipelineProcessor::CoreTracks PipelineProcessor::layOutTracks(const dsp::LoopLayout& layout,
+                                                              const SongStems& stems,
+                                                              const dsp::PlaybackSpan& span) const
+{
+    TUNETRIX_TRACE_ZONE("Core layout");
+    CoreTracks tracks;
+    tracks.backing = layOutStem(layout, stems.backing.get(), span, stems.length);
+    if (!guidePitchFollow_)
+    {
+        tracks.guide = layOutStem(layout, stems.guide.get(), span, stems.length);
+    }
+    return tracks;
+}
+
+std::vector<std::vector<float>> PipelineProcessor::layOutStem(const dsp::LoopLayout& layout,
+                                                              const juce::AudioBuffer<float>* stem,
+                                                              const dsp::PlaybackSpan& span,
+                                                              int64_t songLength)
+{
+    const int64_t length = stem != nullptr ? span.bufferLength(songLength) : 0;
+    if (length <= 0)
+    {
+        return {};
+    }
+
+    std::vector<std::vector<float>> result(static_cast<size_t>(stem->getNumChannels()),
+                                           std::vector<float>(static_cast<size_t>(length), 0.0f));
+    for (int ch = 0; ch < stem->getNumChannels(); ++ch)
+    {
+        layout.render(stem->getReadPointer(ch), stem->getNumSamples(), span, 0, result[static_cast<size_t>(ch)].data(), length);
+    }
+    return result;
+}
+
+void PipelineProcessor::loadCoreTracks(CoreTracks& tracks, int sampleRate)
+{
+    // Loading restarts the core at the tracks' first sample; their buffers are moved in.
+    if (!tracks.backing.empty())
+    {
+        corePipeline_.loadBackingTrack(std::move(tracks.backing), sampleRate);
+    }
+    else
+    {
+        corePipeline_.clearBackingTrack();
+    }
+    if (!tracks.guide.empty())
+    {
+        corePipeline_.loadVocalTrack(std::move(tracks.guide), sampleRate);
+    }
+    else
+    {
+        corePipeline_.clearVocalTrack();
+    }
+}
+
 std::string PipelineProcessor::instrumentPath() const
 {
+    const std::lock_guard<std::mutex> lock(stemMutex_);
     return instrumentPath_;
 }
 
-std::string PipelineProcessor::guidePath() const
+std::string PipelineProcessor::guidePath() const
+{
+    const std::lock_guard<std::mutex> lock(stemMutex_);
+    return guidePath_;
+}
+
+double PipelineProcessor::instrumentDurationSeconds() const
+{
+    const std::lock_guard<std::mutex> lock(stemMutex_);
+    return backingDurationSeconds_;
+}
+
+double PipelineProcessor::guideDurationSeconds() const
+{
+    const std::lock_guard<std::mutex> lock(stemMutex_);
+    return vocalDurationSeconds_;
+}
+
+std::shared_ptr<const dsp::StemOverview> PipelineProcessor::instrumentOverview() const
 {
-    return guidePath_;
+    const std::lock_guard<std::mutex> lock(stemMutex_);
+    return backingOverview_;
 }
 
-double PipelineProcessor::instrumentDurationSeconds() const
+std::shared_ptr<const dsp::StemOverview> PipelineProcessor::guideOverview() const
 {
-    return backingDurationSeconds_;
+    const std::lock_guard<std::mutex> lock(stemMutex_);
+    return guideOverview_;
 }
 
-double PipelineProcessor::guideDurationSeconds() const
+std::shared_ptr<const GuideAnalysis> PipelineProcessor::guideAnalysis() const
 {
-    return vocalDurationSeconds_;
+    const std::lock_guard<std::mutex> lock(stemMutex_);
+    return guideAnalysis_;
 }
 
 void PipelineProcessor::setNoiseFloorAmplitude(float amp)
@@ -206,17 +1399,19 @@ std::tuple<float, float, float> PipelineProcessor::crowdCancelParameters() const
 
 std::pair<float, float> PipelineProcessor::reverbTailSettings() const
 {
-    return {coreConfig_.reverbTailMix, coreConfig_.reverbTailSeconds};
+    return {reverbTailMix_.load(std::memory_order_relaxed), reverbTailSeconds_.load(std::memory_order_relaxed)};
 }
 
 float PipelineProcessor::timbreMatchStrength() const
 {
-    return coreConfig_.timbreMatchStrength;
+    return timbreMatchStrength_;
 }
 
 std::tuple<float, float, float> PipelineProcessor::envelopeSmoothing() const
 {
-    return {coreConfig_.envelopeHoldMs, coreConfig_.envelopeReleaseMs, coreConfig_.envelopeReleaseMod};
+    return {envelopeHoldMs_.load(std::memory_order_relaxed),
+            envelopeReleaseMs_.load(std::memory_order_relaxed),
+            envelopeReleaseMod_.load(std::memory_order_relaxed)};
 }
 
 void PipelineProcessor::setCrowdCancelParameters(float adaptRate, float recoveryRate, float clamp)
@@ -229,19 +1424,32 @@ void PipelineProcessor::setCrowdCancelParameters(float adaptRate, float recovery
 
 void PipelineProcessor::setReverbTail(float mix, float tailSeconds)
 {
-    coreConfig_.reverbTailMix = mix;
+    reverbTailMix_.store(mix, std::memory_order_relaxed);
+    reverbTailSeconds_.store(tailSeconds, std::memory_order_relaxed);
     coreConfig_.reverbTailSeconds = tailSeconds;
-    corePipeline_.setReverbTail(mix, tailSeconds);
+    if (!guidePitchFollow_)
+    {
+        coreConfig_.reverbTailMix = mix;
+        corePipeline_.setReverbTail(mix, tailSeconds);
+    }
 }
 
 void PipelineProcessor::setTimbreMatchStrength(float strength)
 {
-    coreConfig_.timbreMatchStrength = strength;
-    corePipeline_.setTimbreMatchStrength(strength);
+    timbreMatchStrength_ = strength;
+    guideTimbre_.setStrength(strength);
+    if (!guidePitchFollow_)
+    {
+        coreConfig_.timbreMatchStrength = strength;
+        corePipeline_.setTimbreMatchStrength(strength);
+    }
 }
 
 void PipelineProcessor::setEnvelopeSmoothing(float holdMs, float releaseMs, float releaseMod)
 {
+    envelopeHoldMs_.store(holdMs, std::memory_order_relaxed);
+    envelopeReleaseMs_.store(releaseMs, std::memory_order_relaxed);
+    envelopeReleaseMod_.store(releaseMod, std::memory_order_relaxed);
     coreConfig_.envelopeHoldMs = holdMs;
     coreConfig_.envelopeReleaseMs = releaseMs;
     coreConfig_.envelopeReleaseMod = releaseMod;
@@ -265,25 +1473,198 @@ void PipelineProcessor::updateBufferSize(int bufferSamples)
         return;
     }
 
+    const std::lock_guard<std::mutex> lock(stemMutex_);
+    reconfigureCoreLocked(sampleRate(), bufferSamples, nullptr);
+}
+
+double PipelineProcessor::sampleRate() const
+{
+    return sampleRate_.load(std::memory_order_acquire);
+}
+
+std::shared_future<bool> PipelineProcessor::adaptToSampleRate(double sampleRate)
+{
+    if (!runtimeConfig_ || sampleRate <= 0.0 || !gate_ || !vad_ || !pitch_ || !calibrator_)
+    {
+        return settledFuture(false);
+    }
+
+    const std::lock_guard<std::mutex> lock(stemMutex_);
+    if (!sameRate(sampleRate, targetSampleRate_))
+    {
+        targetSampleRate_ = sampleRate;
+        ++stemGeneration_;
+        startRateConversionLocked();
+    }
+    return rateSwitch_.valid() ? rateSwitch_ : settledFuture(true);
+}
+
+void PipelineProcessor::startRateConversionLocked()
+{
+    if (!rateSwitchPromise_)
+    {
+        rateSwitchPromise_ = std::make_shared<std::promise<bool>>();
+        rateSwitch_ = rateSwitchPromise_->get_future().share();
+    }
+
+    const double current = sampleRate();
+    if (sameRate(targetSampleRate_, current))
+    {
+        settleRateSwitchLocked(true);
+        return;
+    }
+
+    if (auto cached = stemsByRate_.find(rateKey(targetSampleRate_)); cached != stemsByRate_.end())
+    {
+        auto stems = std::move(cached->second);
+        stemsByRate_.erase(cached);
+        switchStemsLocked(targetSampleRate_, std::move(stems));
+        settleRateSwitchLocked(true);
+        return;
+    }
+
+    auto conversion = std::make_shared<RateConversion>();
+    conversion->sampleRate = targetSampleRate_;
+    conversion->generation = stemGeneration_;
+    const bool hasBacking = stems_->backing != nullptr;
+    const bool hasGuide = stems_->guide != nullptr;
+    conversion->pending.store((hasBacking ? 1 : 0) + (hasGuide ? 1 : 0));
+    if (!hasBacking && !hasGuide)
+    {
+        switchStemsLocked(targetSampleRate_, makeStems(nullptr, nullptr));
+        settleRateSwitchLocked(true);
+        return;
+    }
+    rateConversion_ = conversion;
+
+    // The current configuration keeps playing while copies of its stems are resampled.
+    const auto onConverted = [this, conversion](bool isGuide)
+    {
+        return [this, conversion, isGuide](bool converted, juce::AudioBuffer<float>& buffer, std::shared_ptr<const dsp::StemOverview>)
+        {
+            (isGuide ? conversion->guide : conversion->backing) = std::move(buffer);
+            if (!converted)
+            {
+                conversion->failed.store(true);
+            }
+            if (conversion->pending.fetch_sub(1) == 1)
+            {
+                finishRateConversion(conversion);
+            }
+            return converted;
+        };
+    };
+    if (hasBacking)
+    {
+        juce::AudioBuffer<float> copy;
+        copy.makeCopyOf(*stems_->backing);
+        stemLoader_.resample(std::move(copy), current, targetSampleRate_, onConverted(false));
+    }
+    if (hasGuide)
+    {
+        juce::AudioBuffer<float> copy;
+        copy.makeCopyOf(*stems_->guide);
+        stemLoader_.resample(std::move(copy), current, targetSampleRate_, onConverted(true));
+    }
+}
+
+void PipelineProcessor::finishRateConversion(const std::shared_ptr<RateConversion>& conversion)
+{
+    const std::lock_guard<std::mutex> lock(stemMutex_);
+    if (conversion->generation != stemGeneration_)
+    {
+        // Superseded. If nothing newer is converting (a stem was cleared, say), convert what
+        // is loaded now so waiters are not left hanging.
+        if (rateConversion_ == conversion)
+        {
+            rateConversion_.reset();
+            startRateConversionLocked();
+        }
+        return;
+    }
+    rateConversion_.reset();
+    if (conversion->failed.load())
+    {
+        settleRateSwitchLocked(false);
+        return;
+    }
+    switchStemsLocked(conversion->sampleRate, makeStems(shareStem(std::move(conversion->backing)), shareStem(std::move(conversion->guide))));
+    settleRateSwitchLocked(true);
+}
+
+void PipelineProcessor::settleRateSwitchLocked(bool switched)
+{
+    rateConversion_.reset();
+    if (rateSwitchPromise_)
+    {
+        rateSwitchPromise_->set_value(switched);
+        rateSwitchPromise_.reset();
+    }
+}
+
+void PipelineProcessor::switchStemsLocked(double sampleRate, std::shared_ptr<const SongStems> stems)
+{
+    // The outgoing rate stays cached so a device that switches back is served immediately.
+    stemsByRate_[rateKey(this->sampleRate())] = stems_;
+    reconfigureCoreLocked(sampleRate, coreConfig_.bufferSamples, std::move(stems));
+    reportHeldStemsLocked();
+    // Upcoming setlist songs are decoded at the new rate; the guide analysis is rate-free.
+    configureSetlist();
+}
+
+void PipelineProcessor::reconfigureCoreLocked(double sampleRate, int bufferSamples, std::shared_ptr<const SongStems> stems)
+{
+    TUNETRIX_TRACE_ZONE("Core reconfigure");
+    // Configuring the core drops its tracks, so they go back in from where the transport is,
+    // at the same song position in seconds, laid out before the audio thread is locked out.
+    const double previousRate = this->sampleRate();
+    const SongStems& played = stems != nullptr ? *stems : *stems_;
+    const auto position = static_cast<int64_t>(std::llround(static_cast<double>(transportPosition_.load(std::memory_order_relaxed)) * sampleRate / previousRate));
+    dsp::LoopLayout loopLayout;
+    loopLayout.prepare(loopCrossfadeSamples(*runtimeConfig_, sampleRate));
+    const auto span = homeSpan(played.length, position);
+    auto tracks = layOutTracks(loopLayout, played, span);
+
+    const std::lock_guard<std::mutex> coreLock(coreMutex_);
     const auto manualMode = corePipeline_.manualMode();
     const auto previousState = corePipeline_.transportState();
     const bool vocalsMuted = corePipeline_.guideMuted();
+    const float noiseFloorAmplitude = corePipeline_.noiseFloorAmplitude();
+    coreConfig_.sampleRate = sampleRate;
     coreConfig_.bufferSamples = bufferSamples;
+    // Re-derives the decimator, gate and envelope coefficients for the rate.
     corePipeline_.configure(coreConfig_, gate_, vad_, pitch_, calibrator_);
     corePipeline_.setLooping(runtimeConfig_->media.loop);
     corePipeline_.setManualMode(manualMode);
     corePipeline_.setMicMonitorGainDb(coreConfig_.micMonitorGainDb);
-    corePipeline_.setNoiseFloorAmplitude(coreConfig_.noiseFloorAmplitude);
+    corePipeline_.setNoiseFloorAmplitude(noiseFloorAmplitude);
     corePipeline_.setGuideMute(vocalsMuted);
-
-    if (backingBuffer_.getNumSamples() > 0)
+    if (calibrationApplied_.load())
+    {
+        // Reconfiguring the core resets the gate to the preset thresholds.
+        if (const auto calibration = calibrator_->result(); calibration.isValid)
+        {
+            writeCalibration(calibration);
+        }
+    }
+    if (gateTuned_.load(std::memory_order_relaxed))
     {
-        pushBackingToCore(backingBuffer_, runtimeConfig_->sampleRate);
+        gateTuningPending_.store(true, std::memory_order_release);
     }
-    if (vocalBuffer_.getNumSamples() > 0)
+
+    loadCoreTracks(tracks, rateKey(sampleRate));
+    if (stems != nullptr)
     {
-        pushGuideToCore(vocalBuffer_, runtimeConfig_->sampleRate);
+        // Everything sized in samples follows the new rate. The outgoing stems stay in
+        // stemsByRate_.
+        prepareForSampleRate(sampleRate);
+        liveStems_.store(stems.get(), std::memory_order_release);
+        stems_ = std::move(stems);
+        sampleRate_.store(sampleRate, std::memory_order_release);
     }
+    // A seek or loop region is dropped along with any span still queued for it.
+    homeOrigin_ = span.origin;
+    layoutGeneration_.fetch_add(1, std::memory_order_acq_rel);
 
     switch (previousState)
     {
@@ -300,19 +1681,341 @@ void PipelineProcessor::updateBufferSize(int bufferSamples)
     }
 }
 
+bool PipelineProcessor::scheduleTransport(const TransportCommand& command)
+{
+    const std::lock_guard<std::mutex> lock(transportMutex_);
+    freeRetiredTracksLocked();
+    QueuedTransport queued{command};
+    queued.moves = command.action == TransportAction::Seek || command.action == TransportAction::SetLoop
+                   || command.action == TransportAction::ClearLoop;
+    if (queued.moves)
+    {
+        const std::lock_guard<std::mutex> setlistLock(setlistMutex_);
+        const std::lock_guard<std::mutex> stemLock(stemMutex_);
+        if (!planSpanLocked(queued))
+        {
+            return false;
+        }
+    }
+    if (!transportQueue_.push(queued))
+    {
+        delete queued.tracks;
+        return false;
+    }
+    if (queued.moves)
+    {
+        plannedLoopStart_ = queued.loopStart;
+        plannedLoopEnd_ = queued.loopEnd;
+    }
+    return true;
+}
+
+bool PipelineProcessor::planSpanLocked(QueuedTransport& queued)
+{
+    // The generation is read first: once a song swap's generation is visible, so is the song.
+    queued.generation = layoutGeneration_.load(std::memory_order_acquire);
+    const auto* started = startedSong_.load(std::memory_order_acquire);
+    if (queued.generation != plannedGeneration_)
+    {
+        plannedGeneration_ = queued.generation;
+        plannedLoopStart_ = 0;
+        plannedLoopEnd_ = 0;
+    }
+
+    // A song the audio thread has started but the setlist thread not yet adopted is laid out
+    // from its own stems.
+    const auto& stems = started != nullptr ? *started->stems : *stems_;
+    const int64_t length = stems.length;
+    if (length <= 0)
+    {
+        return false;
+    }
+
+    const auto& command = queued.command;
+    const dsp::PlaybackSpan region{0, plannedLoopStart_, plannedLoopEnd_};
+    const int64_t homeEnd = homeSpan(length).loopEnd;
+    dsp::PlaybackSpan span;
+    switch (command.action)
+    {
+        case TransportAction::Seek:
+        {
+            const int64_t position = std::clamp<int64_t>(command.position, 0, length - 1);
+            const bool inRegion = region.looping() && position >= region.loopStart && position < region.loopEnd;
+            span = inRegion ? dsp::PlaybackSpan{position, region.loopStart, region.loopEnd} : dsp::PlaybackSpan{position, 0, homeEnd};
+            queued.loopStart = inRegion ? region.loopStart : 0;
+            queued.loopEnd = inRegion ? region.loopEnd : 0;
+            break;
+        }
+        case TransportAction::SetLoop:
+            if (command.position < 0 || command.position >= command.end || command.end > length)
+            {
+                return false;
+            }
+            // Starts at the crossfade into the loop's start: reached by playing on, or jumped to.
+            span = dsp::PlaybackSpan{0, command.position, command.end};
+            span.origin = loopLayout_.crossfadeStart(span);
+            queued.atPosition = command.at < 0 ? span.origin : -1;
+            queued.loopStart = command.position;
+            queued.loopEnd = command.end;
+            break;
+        case TransportAction::ClearLoop:
+        default:
+            if (!region.looping())
+            {
+                return false;
+            }
+            // Plays on through the loop's end where its crossfade would start.
+            span = dsp::PlaybackSpan{loopLayout_.crossfadeStart(region), 0, homeEnd};
+            queued.atPosition = command.at < 0 ? span.origin : -1;
+            break;
+    }
+
+    queued.span = span;
+    queued.tracks = std::make_unique<CoreTracks>(layOutTracks(loopLayout_, stems, span)).release();
+    return true;
+}
+
+void PipelineProcessor::freeRetiredTracksLocked()
+{
+    while (const auto* retired = retiredTracks_.front())
+    {
+        delete *retired;
+        retiredTracks_.pop();
+    }
+}
+
+void PipelineProcessor::retireTracks(CoreTracks* tracks)
+{
+    // Never full: a producer frees the ring before queueing, and at most one queue's worth
+    // of tracks plus the armed ones can be retired in between.
+    if (tracks != nullptr && !retiredTracks_.push(tracks))
+    {
+        delete tracks;
+    }
+}
+
+void PipelineProcessor::homeTransport(int64_t songLength, int64_t origin)
+{
+    // The core has just been handed the song laid out along its home span from origin.
+    span_ = homeSpan(songLength, origin);
+    layoutOffset_ = 0;
+    playheadSamples_ = span_.position(layoutOffset_);
+    corePipeline_.setLooping(span_.looping());
+    retireTracks(armedTransport_.tracks);
+    armedTransport_ = QueuedTransport{};
+    loopStart_.store(0, std::memory_order_relaxed);
+    loopEnd_.store(0, std::memory_order_relaxed);
+}
+
+void PipelineProcessor::syncTransportLayout()
+{
+    const uint64_t generation = layoutGeneration_.load(std::memory_order_acquire);
+    if (generation == appliedGeneration_)
+    {
+        return;
+    }
+    // New stems, a new rate or a reconfigure went into the core from homeOrigin_.
+    appliedGeneration_ = generation;
+    homeTransport(liveStems_.load(std::memory_order_relaxed)->length, homeOrigin_);
+}
+
+void PipelineProcessor::applyDueTransport(int64_t now, int window)
+{
+    while (const auto* front = transportQueue_.front())
+    {
+        if (front->command.at >= now + window)
+        {
+            break;
+        }
+        const QueuedTransport queued = *front;
+        transportQueue_.pop();
+        if (queued.moves && queued.generation != appliedGeneration_)
+        {
+            retireTracks(queued.tracks);
+            continue;
+        }
+        if (queued.moves)
+        {
+            // A newer span replaces one still waiting for the playhead.
+            retireTracks(armedTransport_.tracks);
+            armedTransport_ = QueuedTransport{};
+        }
+        if (queued.atPosition >= 0)
+        {
+            armedTransport_ = queued;
+        }
+        else
+        {
+            applyTransport(queued);
+        }
+    }
+
+    if (armedTransport_.moves)
+    {
+        const int64_t distance = armedDistance();
+        const bool playing = corePipeline_.transportState() == core::TransportState::Playing;
+        if (distance < 0 || (playing && distance < window))
+        {
+            applyTransport(std::exchange(armedTransport_, QueuedTransport{}));
+        }
+    }
+}
+
+int64_t PipelineProcessor::armedDistance() const
+{
+    // A loop is entered by playing into it only while playing and with its crossfade still
+    // ahead in this pass; otherwise it is jumped to rather than waiting for the song to come
+    // round. Leaving a loop may wait for one more pass through it.
+    const int64_t target = armedTransport_.atPosition;
+    const bool playing = corePipeline_.transportState() == core::TransportState::Playing;
+    const bool ahead = armedTransport_.command.action == TransportAction::ClearLoop || (playing && playheadSamples_ <= target);
+    return ahead ? span_.distanceTo(layoutOffset_, target) : -1;
+}
+
+int PipelineProcessor::samplesUntilTransport(int64_t now, int remaining) const
+{
+    int64_t until = remaining;
+    if (const auto* front = transportQueue_.front())
+    {
+        until = std::min(until, front->command.at - now);
+    }
+    if (armedTransport_.moves && corePipeline_.transportState() == core::TransportState::Playing)
+    {
+        if (const int64_t distance = armedDistance(); distance > 0)
+        {
+            until = std::min(until, distance);
+        }
+    }
+    return static_cast<int>(std::max<int64_t>(1, until));
+}
+
+void PipelineProcessor::applyTransport(const QueuedTransport& queued)
+{
+    switch (queued.command.action)
+    {
+        case TransportAction::Play:
+            corePipeline_.play();
+            return;
+        case TransportAction::Pause:
+            corePipeline_.pause();
+            return;
+        case TransportAction::Stop:
+            corePipeline_.stop();
+            layoutOffset_ = 0;
+            break;
+        case TransportAction::Seek:
+        case TransportAction::SetLoop:
+        case TransportAction::ClearLoop:
+        default:
+        {
+            loadCoreTracks(*queued.tracks, rateKey(sampleRate()));
+            retireTracks(queued.tracks);
+            corePipeline_.setLooping(queued.span.looping());
+            span_ = queued.span;
+            layoutOffset_ = 0;
+            loopStart_.store(queued.loopStart, std::memory_order_relaxed);
+            loopEnd_.store(queued.loopEnd, std::memory_order_relaxed);
+            break;
+        }
+    }
+    playheadSamples_ = span_.position(layoutOffset_);
+}
+
+void PipelineProcessor::processCore(const float* micInput,
+                                    float* const* outputs,
+                                    int numOutputs,
+                                    int numSamples,
+                                    int64_t blockClock)
+{
+    TUNETRIX_TRACE_ZONE("Core process");
+    syncTransportLayout();
+
+    // The core runs once per stretch between transport changes, on offset output pointers. A
+    // device too wide to offset, or a block with every segment used, takes what falls due
+    // later at the stretch's start or in the next block.
+    std::array<float*, kMaxSplitOutputs> shifted{};
+    const bool split = static_cast<size_t>(numOutputs) <= shifted.size();
+    segmentCount_ = 0;
+    for (int start = 0; start < numSamples;)
+    {
+        const int64_t now = blockClock + start;
+        swapArmedSong();
+        applyDueTransport(now, split ? 1 : numSamples);
+        const bool last = !split || segmentCount_ + 1 == static_cast<int>(segments_.size());
+        const bool playing = corePipeline_.transportState() == core::TransportState::Playing;
+        // A song waiting for this one to end starts on the sample after its last.
+        const int64_t untilSongEnd = playing && pendingSong_.load(std::memory_order_relaxed) != nullptr ? samplesUntilSongEnd() : -1;
+        int count = last ? numSamples - start : samplesUntilTransport(now, numSamples - start);
+        if (!last && untilSongEnd > 0 && untilSongEnd < count)
+        {
+            count = static_cast<int>(untilSongEnd);
+        }
+
+        float* const* segmentOutputs = outputs;
+        if (start > 0)
+        {
+            for (int ch = 0; ch < numOutputs; ++ch)
+            {
+                shifted[static_cast<size_t>(ch)] = outputs[ch] != nullptr ? outputs[ch] + start : nullptr;
+            }
+            segmentOutputs = shifted.data();
+        }
+        segments_[static_cast<size_t>(segmentCount_++)] =
+            TransportSegment{start, count, layoutOffset_, span_, playing, liveStems_.load(std::memory_order_relaxed)};
+        corePipeline_.process(micInput != nullptr ? micInput + start : nullptr,
+                              count,
+                              const_cast<float**>(segmentOutputs),
+                              numOutputs);
+        advancePlayhead(count);
+        songEnded_ = untilSongEnd > 0 && untilSongEnd <= count;
+        start += count;
+    }
+    transportPosition_.store(playheadSamples_, std::memory_order_relaxed);
+}
+
 void PipelineProcessor::playTransport()
 {
-    corePipeline_.play();
+    scheduleTransport(TransportCommand{TransportAction::Play});
 }
 
 void PipelineProcessor::pauseTransport()
 {
-    corePipeline_.pause();
+    scheduleTransport(TransportCommand{TransportAction::Pause});
 }
 
 void PipelineProcessor::stopTransport()
 {
-    corePipeline_.stop();
+    scheduleTransport(TransportCommand{TransportAction::Stop});
+}
+
+bool PipelineProcessor::seekTransport(int64_t position)
+{
+    return scheduleTransport(TransportCommand{TransportAction::Seek, position});
+}
+
+bool PipelineProcessor::setLoopRegion(int64_t start, int64_t end)
+{
+    return scheduleTransport(TransportCommand{TransportAction::SetLoop, start, end});
+}
+
+bool PipelineProcessor::clearLoopRegion()
+{
+    return scheduleTransport(TransportCommand{TransportAction::ClearLoop});
+}
+
+std::pair<int64_t, int64_t> PipelineProcessor::loopRegion() const
+{
+    return {loopStart_.load(std::memory_order_relaxed), loopEnd_.load(std::memory_order_relaxed)};
+}
+
+int64_t PipelineProcessor::transportPosition() const
+{
+    return transportPosition_.load(std::memory_order_relaxed);
+}
+
+int64_t PipelineProcessor::deviceClock() const
+{
+    return deviceClock_.load(std::memory_order_relaxed);
 }
 
 bool PipelineProcessor::isTransportPlaying() const
@@ -336,11 +2039,31 @@ PipelineProcessor::TransportState PipelineProcessor::transportState() const
 
 void PipelineProcessor::audioDeviceAboutToStart(juce::AudioIODevice* device)
 {
-    corePipeline_.reset();
+    {
+        const std::lock_guard<std::mutex> coreLock(coreMutex_);
+        corePipeline_.reset();
+        modelFeed_.reset();
+        phraseTracker_.reset();
+        bleedCanceller_.reset();
+        bleedDelay_.reset();
+        guideShifter_.reset();
+        guideReverb_.reset();
+        guideTimbre_.reset();
+        guideEnvelope_.reset();
+        guideLevel_ = 0.0f;
+        // A new calibration pass is about to measure the room again.
+        thresholdBoost_ = 0.0f;
+        if (gateTuned_.load(std::memory_order_relaxed))
+        {
+            gateTuningPending_.store(true, std::memory_order_release);
+        }
+    }
     if (calibrator_ && runtimeConfig_)
     {
-        const double rate = device ? device->getCurrentSampleRate() : runtimeConfig_->sampleRate;
+        const double rate = device ? device->getCurrentSampleRate() : sampleRate();
         calibrator_->start(rate);
+        calibrationApplied_.store(false);
+        adaptToSampleRate(rate);
     }
     corePipeline_.play();
 }
@@ -357,10 +2080,16 @@ void PipelineProcessor::audioDeviceIOCallbackWithContext(const float* const* inp
                                                          int numSamples,
                                                          const juce::AudioIODeviceCallbackContext& /*context*/)
 {
+    const int64_t blockClock = deviceClock_.fetch_add(numSamples, std::memory_order_relaxed);
     if (outputChannelData == nullptr || numOutputChannels <= 0)
     {
         return;
     }
+    // Decaying feedback loops (reverb tail, bleed filter) would otherwise slow to a crawl
+    // once they reach denormal range.
+    const juce::ScopedNoDenormals noDenormals;
+    TUNETRIX_TRACE_THREAD("Audio callback");
+    TUNETRIX_TRACE_ZONE("Audio callback");
 
     for (int ch = 0; ch < numOutputChannels; ++ch)
     {
@@ -370,111 +2099,97 @@ void PipelineProcessor::audioDeviceIOCallbackWithContext(const float* const* inp
         }
     }
 
-    const float* micInput = (inputChannelData && numInputChannels > 0) ? inputChannelData[0] : nullptr;
-    corePipeline_.process(micInput,
-                          numSamples,
-                          const_cast<float**>(outputChannelData),
-                          numOutputChannels);
-}
-
-juce::File PipelineProcessor::resolveFile(const std::string& path) const
-{
-    return resolveToWorkingDirectory(path);
-}
-
-bool PipelineProcessor::loadAudioFile(const juce::File& file,
-                                      juce::AudioBuffer<float>& destination,
-                                      double targetSampleRate)
-{
-    if (!file.existsAsFile())
+    const float* rawMic = (inputChannelData && numInputChannels > 0) ? inputChannelData[0] : nullptr;
+    // A bridged mic is already on this device's clock; the loopback probe and the round-trip
+    // alignment below see its latency like any other part of the input path.
+    if (auto* bridge = inputBridge_.load(std::memory_order_acquire);
+        bridge != nullptr && static_cast<size_t>(numSamples) <= bridgedMic_.size() && bridge->read(bridgedMic_.data(), numSamples))
     {
-        destination.setSize(0, 0);
-        return false;
+        rawMic = bridgedMic_.data();
     }
 
-    std::unique_ptr<juce::AudioFormatReader> reader(formatManager_.createReaderFor(file));
-    if (reader == nullptr)
+    std::unique_lock<std::mutex> coreLock(coreMutex_, std::defer_lock);
+    if (offline_.load(std::memory_order_relaxed))
     {
-        destination.setSize(0, 0);
-        return false;
+        coreLock.lock();
     }
-
-    const int numChannels = static_cast<int>(reader->numChannels);
-    const int64_t totalSamples = static_cast<int64_t>(reader->lengthInSamples);
-    if (numChannels <= 0 || totalSamples <= 0)
+    else if (!coreLock.try_lock())
     {
-        destination.setSize(0, 0);
-        return false;
+        return;
     }
-
-    juce::AudioBuffer<float> tempBuffer(numChannels, static_cast<int>(totalSamples));
-    const bool ok = reader->read(&tempBuffer, 0, static_cast<int>(totalSamples), 0, true, true);
-    if (!ok)
+    if (measuringLatency_.load(std::memory_order_acquire))
     {
-        destination.setSize(0, 0);
-        return false;
+        runLatencyProbe(rawMic, outputChannelData, numOutputChannels, numSamples);
+        return;
     }
 
-    if (std::abs(reader->sampleRate - targetSampleRate) < 1e-3)
+    swapArmedSong();
+    applyGateTuning();
+    // Inference run for this block ends the flow, linking it back to the mic block.
+    TUNETRIX_TRACE_FLOW_START(++traceBlock_);
+
+    const float* micInput = cancelBleed(rawMic, numSamples);
+    feedModels(micInput, numSamples);
+    updateGateContext(micInput, numSamples);
+    if (guidePitchFollow_)
     {
-        destination = std::move(tempBuffer);
-        return true;
+        guideTimbre_.pushMic(micInput, static_cast<size_t>(numSamples));
     }
 
-    const double ratio = reader->sampleRate / targetSampleRate;
-    const int resampledSamples = static_cast<int>(std::ceil(totalSamples / ratio));
-    destination.setSize(numChannels, resampledSamples);
-
-    juce::LagrangeInterpolator interpolator;
-    for (int ch = 0; ch < numChannels; ++ch)
+    // With output buses the core and the stems mix into scratch and the routing matrix fills
+    // the outputs.
+    const bool routed = routing_.numRoutes() > 0 && static_cast<size_t>(numSamples) <= kMaxDeviceBlock;
+    float* mix[] = {nullptr, nullptr};
+    if (routed)
     {
-        interpolator.reset();
-        interpolator.process(ratio,
-                             tempBuffer.getReadPointer(ch),
-                             destination.getWritePointer(ch),
-                             resampledSamples);
+        mix[0] = routingScratch_.data() + kMixLeft * kMaxDeviceBlock;
+        mix[1] = routingScratch_.data() + kMixRight * kMaxDeviceBlock;
+        std::fill(mix[0], mix[0] + numSamples, 0.0f);
+        std::fill(mix[1], mix[1] + numSamples, 0.0f);
+    }
+    float* const* coreOutputs = routed ? mix : outputChannelData;
+    const int numCoreOutputs = routed ? 2 : numOutputChannels;
+    processCore(micInput, coreOutputs, numCoreOutputs, numSamples, blockClock);
+    mixStems(micInput, coreOutputs, numCoreOutputs, numSamples);
+    pushBleedReference(micInput, coreOutputs, numCoreOutputs, numSamples);
+    if (routed)
+    {
+        routeOutputs(micInput, outputChannelData, numOutputChannels, numSamples);
+    }
+    if (TUNETRIX_TRACE_ENABLED())
+    {
+        const auto metrics = corePipeline_.getMetrics();
+        TUNETRIX_TRACE_COUNTER("gateDb", metrics.gateDb);
+        TUNETRIX_TRACE_COUNTER("confidence", metrics.confidence);
     }
 
-    return true;
-}
-
-bool PipelineProcessor::loadAudioFile(const std::string& path,
-                                      juce::AudioBuffer<float>& destination,
-                                      double targetSampleRate)
-{
-    return loadAudioFile(resolveFile(path), destination, targetSampleRate);
+    applyCalibration();
 }
 
-void PipelineProcessor::pushBackingToCore(const juce::AudioBuffer<float>& buffer, double sampleRate)
+juce::File PipelineProcessor::resolveFile(const std::string& path) const
 {
-    corePipeline_.loadBackingTrack(convertBuffer(buffer),
-                                   static_cast<int>(std::round(sampleRate)));
+    return resolveToWorkingDirectory(path);
 }
 
-void PipelineProcessor::pushGuideToCore(const juce::AudioBuffer<float>& buffer, double sampleRate)
+bool PipelineProcessor::loadAudioFile(const juce::File& file,
+                                      juce::AudioBuffer<float>& destination,
+                                      double targetSampleRate)
 {
-    corePipeline_.loadVocalTrack(convertBuffer(buffer),
-                                 static_cast<int>(std::round(sampleRate)));
+    return stemLoader_.load(file,
+                            targetSampleRate,
+                            [&destination](bool decoded, juce::AudioBuffer<float>& buffer, std::shared_ptr<const dsp::StemOverview>)
+                            {
+                                destination = std::move(buffer);
+                                return decoded;
+                            })
+        .get();
 }
 
-std::vector<std::vector<float>> PipelineProcessor::convertBuffer(const juce::AudioBuffer<float>& buffer)
+bool PipelineProcessor::loadAudioFile(const std::string& path,
+                                      juce::AudioBuffer<float>& destination,
+                                      double targetSampleRate)
 {
-    const int channels = std::max(1, buffer.getNumChannels());
-    const int samples = buffer.getNumSamples();
-    std::vector<std::vector<float>> result(static_cast<size_t>(channels),
-                                           std::vector<float>(static_cast<size_t>(samples), 0.0f));
-
-    for (int ch = 0; ch < channels; ++ch)
-    {
-        const float* source = buffer.getNumChannels() > ch ? buffer.getReadPointer(ch) : nullptr;
-        auto& dest = result[static_cast<size_t>(ch)];
-        if (source != nullptr)
-        {
-            std::copy(source, source + samples, dest.begin());
-        }
-    }
-
-    return result;
+    return loadAudioFile(resolveFile(path), destination, targetSampleRate);
 }
 
 } // namespace singwithme::audio
@@ -0,0 +1,332 @@
+#include "audio/SetlistEngine.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <utility>
+
+#include "trace/Tracer.h"
+
+namespace singwithme::audio
+{
+namespace
+{
+constexpr int kServiceIntervalMs = 20;
+constexpr int kStopTimeoutMs = 4000;
+
+juce::File resolveToWorkingDirectory(const std::string& path)
+{
+    juce::File file(path);
+    if (file.existsAsFile())
+    {
+        return file;
+    }
+    return juce::File::getCurrentWorkingDirectory().getChildFile(path);
+}
+
+bool isReady(const std::future<bool>& future)
+{
+    return !future.valid() || future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+} // namespace
+
+size_t PreparedSong::memoryBytes() const
+{
+    const auto samples = static_cast<size_t>(backing.getNumChannels()) * static_cast<size_t>(backing.getNumSamples())
+                         + static_cast<size_t>(guide.getNumChannels()) * static_cast<size_t>(guide.getNumSamples());
+    return samples * sizeof(float)
+           + (backingOverview != nullptr ? backingOverview->memoryBytes() : 0)
+           + (guideOverview != nullptr ? guideOverview->memoryBytes() : 0);
+}
+
+SetlistEngine::SetlistEngine(StemLoader& loader)
+    : juce::Thread("TuneTrix setlist"),
+      loader_(loader)
+{
+}
+
+SetlistEngine::~SetlistEngine()
+{
+    shutdown();
+    for (auto& load : pending_)
+    {
+        if (load.instrument.valid())
+        {
+            load.instrument.wait();
+        }
+        if (load.guide.valid())
+        {
+            load.guide.wait();
+        }
+    }
+}
+
+void SetlistEngine::configure(const GuideAnalysisSettings& analysis, int preloadDepth, size_t memoryBudgetBytes)
+{
+    {
+        const std::lock_guard<std::mutex> lock(mutex_);
+        // A new device rate only changes which entries are current; the guide analysis is
+        // tied to the model rate, so a change there invalidates everything.
+        if (std::abs(analysis.modelSampleRate - analysis_.modelSampleRate) > 1e-3)
+        {
+            cache_.clear();
+        }
+        analysis_ = analysis;
+        preloadDepth_ = std::max(0, preloadDepth);
+        memoryBudgetBytes_ = memoryBudgetBytes;
+    }
+
+    if (!isThreadRunning())
+    {
+        startThread();
+    }
+    notify();
+}
+
+void SetlistEngine::shutdown()
+{
+    stopThread(kStopTimeoutMs);
+}
+
+void SetlistEngine::setSongs(std::vector<SetlistEntry> songs)
+{
+    {
+        const std::lock_guard<std::mutex> lock(mutex_);
+        songs_ = std::move(songs);
+        cache_.clear();
+        current_ = 0;
+    }
+    notify();
+}
+
+void SetlistEngine::setServiceCallback(std::function<void()> callback)
+{
+    const std::lock_guard<std::mutex> lock(mutex_);
+    serviceCallback_ = std::move(callback);
+}
+
+int SetlistEngine::size() const
+{
+    const std::lock_guard<std::mutex> lock(mutex_);
+    return static_cast<int>(songs_.size());
+}
+
+int SetlistEngine::current() const
+{
+    const std::lock_guard<std::mutex> lock(mutex_);
+    return current_;
+}
+
+void SetlistEngine::setCurrent(int index)
+{
+    {
+        const std::lock_guard<std::mutex> lock(mutex_);
+        current_ = std::clamp(index, 0, std::max(0, static_cast<int>(songs_.size()) - 1));
+        if (auto it = cache_.find(keyFor(current_)); it != cache_.end())
+        {
+            it->second.lastUsed = ++useCounter_;
+        }
+    }
+    notify();
+}
+
+std::shared_ptr<PreparedSong> SetlistEngine::prepared(int index)
+{
+    const std::lock_guard<std::mutex> lock(mutex_);
+    auto it = cache_.find(keyFor(index));
+    if (it == cache_.end())
+    {
+        return nullptr;
+    }
+    it->second.lastUsed = ++useCounter_;
+    return it->second.song;
+}
+
+size_t SetlistEngine::cachedBytes() const
+{
+    const std::lock_guard<std::mutex> lock(mutex_);
+    return cachedBytesLocked();
+}
+
+void SetlistEngine::setHeldBytes(size_t bytes)
+{
+    {
+        const std::lock_guard<std::mutex> lock(mutex_);
+        if (bytes == heldBytes_)
+        {
+            return;
+        }
+        heldBytes_ = bytes;
+    }
+    notify();
+}
+
+void SetlistEngine::run()
+{
+    while (!threadShouldExit())
+    {
+        TUNETRIX_TRACE_THREAD("Setlist service");
+        {
+            TUNETRIX_TRACE_ZONE("Setlist service");
+            collectFinishedLoads();
+            scheduleLoads();
+        }
+
+        std::function<void()> callback;
+        {
+            const std::lock_guard<std::mutex> lock(mutex_);
+            callback = serviceCallback_;
+        }
+        if (callback)
+        {
+            callback();
+        }
+
+        wait(kServiceIntervalMs);
+    }
+}
+
+void SetlistEngine::collectFinishedLoads()
+{
+    const std::lock_guard<std::mutex> lock(mutex_);
+    for (auto it = pending_.begin(); it != pending_.end();)
+    {
+        if (!isReady(it->instrument) || !isReady(it->guide))
+        {
+            ++it;
+            continue;
+        }
+
+        const bool instrumentOk = !it->instrument.valid() || it->instrument.get();
+        const bool guideOk = !it->guide.valid() || it->guide.get();
+        auto song = std::move(it->song);
+        it = pending_.erase(it);
+
+        const bool stillListed = song->index < static_cast<int>(songs_.size())
+                                 && songs_[static_cast<size_t>(song->index)].instrumentPath == song->entry.instrumentPath
+                                 && songs_[static_cast<size_t>(song->index)].guidePath == song->entry.guidePath;
+        if (!instrumentOk || !guideOk || !stillListed)
+        {
+            continue;
+        }
+
+        song->lengthSamples = std::max(song->backing.getNumSamples(), song->guide.getNumSamples());
+        const CacheKey key{song->index, static_cast<int>(std::lround(song->sampleRate))};
+        cache_[key] = CacheEntry{std::move(song), ++useCounter_};
+    }
+
+    evictToBudget();
+}
+
+void SetlistEngine::scheduleLoads()
+{
+    const std::lock_guard<std::mutex> lock(mutex_);
+    const int last = std::min(current_ + preloadDepth_, static_cast<int>(songs_.size()) - 1);
+    for (int index = current_; index <= last; ++index)
+    {
+        if (usedBytesLocked() >= memoryBudgetBytes_)
+        {
+            return;
+        }
+
+        const CacheKey key = keyFor(index);
+        const bool cached = cache_.count(key) > 0;
+        const bool loading = std::any_of(pending_.begin(), pending_.end(),
+                                         [index, rate = analysis_.sampleRate](const PendingLoad& load)
+                                         { return load.song->index == index && std::abs(load.song->sampleRate - rate) < 1e-3; });
+        if (cached || loading)
+        {
+            continue;
+        }
+
+        auto song = std::make_shared<PreparedSong>();
+        song->index = index;
+        song->entry = songs_[static_cast<size_t>(index)];
+        song->sampleRate = analysis_.sampleRate;
+
+        PendingLoad load;
+        load.song = song;
+        if (!song->entry.instrumentPath.empty())
+        {
+            load.instrument = loader_.load(resolveToWorkingDirectory(song->entry.instrumentPath),
+                                           analysis_.sampleRate,
+                                           [song](bool decoded,
+                                                  juce::AudioBuffer<float>& buffer,
+                                                  std::shared_ptr<const dsp::StemOverview> overview)
+                                           {
+                                               song->backing = std::move(buffer);
+                                               song->backingOverview = std::move(overview);
+                                               return decoded;
+                                           });
+        }
+        if (!song->entry.guidePath.empty())
+        {
+            load.guide = loader_.load(resolveToWorkingDirectory(song->entry.guidePath),
+                                      analysis_.sampleRate,
+                                      [song, settings = analysis_](bool decoded,
+                                                                   juce::AudioBuffer<float>& buffer,
+                                                                   std::shared_ptr<const dsp::StemOverview> overview)
+                                      {
+                                          song->guide = std::move(buffer);
+                                          song->guideOverview = std::move(overview);
+                                          if (decoded)
+                                          {
+                                              song->guideAnalysis = analyseGuide(song->guide, settings);
+                                          }
+                                          return decoded;
+                                      });
+        }
+        pending_.push_back(std::move(load));
+    }
+}
+
+void SetlistEngine::evictToBudget()
+{
+    while (usedBytesLocked() > memoryBudgetBytes_)
+    {
+        auto victim = cache_.end();
+        for (auto it = cache_.begin(); it != cache_.end(); ++it)
+        {
+            if (inWindow(it->first))
+            {
+                continue;
+            }
+            if (victim == cache_.end() || it->second.lastUsed < victim->second.lastUsed)
+            {
+                victim = it;
+            }
+        }
+
+        if (victim == cache_.end())
+        {
+            return;
+        }
+        cache_.erase(victim);
+    }
+}
+
+bool SetlistEngine::inWindow(const CacheKey& key) const
+{
+    return key.second == keyFor(key.first).second && key.first >= current_ && key.first <= current_ + preloadDepth_;
+}
+
+SetlistEngine::CacheKey SetlistEngine::keyFor(int index) const
+{
+    return {index, static_cast<int>(std::lround(analysis_.sampleRate))};
+}
+
+size_t SetlistEngine::cachedBytesLocked() const
+{
+    size_t total = 0;
+    for (const auto& [key, entry] : cache_)
+    {
+        total += entry.song->memoryBytes();
+    }
+    return total;
+}
+
+size_t SetlistEngine::usedBytesLocked() const
+{
+    return cachedBytesLocked() + heldBytes_;
+}
+} // namespace singwithme::audio
@@ -0,0 +1,369 @@
+#include "audio/StemLoader.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <mutex>
+#include <vector>
+
+#include "trace/Tracer.h"
+
+namespace singwithme::audio
+{
+namespace
+{
+constexpr int64_t kDecodeChunkSamples = 1 << 20;  // ~22 s @ 48 kHz
+constexpr int kResampleChunkSamples = 1 << 16;
+// 32 samples per finest overview bin: under a millisecond at 48 kHz, and the whole pyramid
+// takes an eighth of the stem's own memory.
+constexpr size_t kOverviewBaseBinSamples = 32;
+constexpr int kShutdownTimeoutMs = 10000;
+
+bool supportsChunkedDecode(const juce::File& file)
+{
+    // Compressed formats seek by scanning from the start, so splitting them only adds work.
+    return file.hasFileExtension("wav;aif;aiff;flac");
+}
+} // namespace
+
+struct StemLoader::Job
+{
+    juce::File file;
+    double targetSampleRate{0.0};
+    double sourceSampleRate{0.0};
+    dsp::ResamplerQuality quality{dsp::ResamplerQuality::Lagrange};
+    Completion onComplete;
+    std::promise<bool> promise;
+    bool buildOverview{false};
+
+    juce::AudioBuffer<float> decoded;
+    juce::AudioBuffer<float> resampled;
+    std::vector<float*> decodedChannels;
+    std::vector<float*> resampledChannels;
+    std::shared_ptr<dsp::StemOverview> overview;
+    dsp::Resampler resampler;
+    std::atomic<int> pendingTasks{0};
+    std::atomic<bool> failed{false};
+    std::atomic<bool> settled{false};
+};
+
+StemLoader::StemLoader(juce::AudioFormatManager& formatManager, int numThreads)
+    : formatManager_(formatManager),
+      pool_(std::max(2, numThreads))
+{
+}
+
+StemLoader::~StemLoader()
+{
+    shutdown();
+}
+
+void StemLoader::shutdown()
+{
+    stopped_.store(true);
+    // A task that read stopped_ just before it was set may still queue one more, so sweep
+    // until the pool is empty (or a running task outlasts the timeout).
+    while (pool_.removeAllJobs(false, kShutdownTimeoutMs) && pool_.getNumJobs() > 0)
+    {
+    }
+
+    // The dropped tasks held the only other references to their jobs, so every load still
+    // pending resolves to false here rather than breaking its promise.
+    std::vector<std::shared_ptr<Job>> pending;
+    {
+        const std::lock_guard<std::mutex> lock(jobsMutex_);
+        pending.swap(jobs_);
+    }
+    for (const auto& job : pending)
+    {
+        if (!job->settled.exchange(true))
+        {
+            job->promise.set_value(false);
+        }
+    }
+}
+
+void StemLoader::start(const std::shared_ptr<Job>& job, std::function<void()> task)
+{
+    {
+        const std::lock_guard<std::mutex> lock(jobsMutex_);
+        if (!stopped_.load())
+        {
+            jobs_.push_back(job);
+            pool_.addJob(std::move(task));
+            return;
+        }
+    }
+    job->settled.store(true);
+    job->promise.set_value(false);
+}
+
+void StemLoader::enqueue(std::function<void()> task)
+{
+    // After shutdown() a running task's follow-ups are dropped; shutdown() resolves their loads.
+    if (!stopped_.load())
+    {
+        pool_.addJob(std::move(task));
+    }
+}
+
+void StemLoader::setResamplerQuality(dsp::ResamplerQuality quality)
+{
+    quality_.store(quality);
+}
+
+std::future<bool> StemLoader::load(const juce::File& file, double targetSampleRate, Completion onComplete)
+{
+    auto job = std::make_shared<Job>();
+    job->file = file;
+    job->targetSampleRate = targetSampleRate;
+    job->quality = quality_.load();
+    job->onComplete = std::move(onComplete);
+    job->buildOverview = true;
+
+    auto future = job->promise.get_future();
+    start(job, [this, job] { open(job); });
+    return future;
+}
+
+std::future<bool> StemLoader::resample(juce::AudioBuffer<float> source,
+                                      double sourceSampleRate,
+                                      double targetSampleRate,
+                                      Completion onComplete)
+{
+    auto job = std::make_shared<Job>();
+    job->sourceSampleRate = sourceSampleRate;
+    job->targetSampleRate = targetSampleRate;
+    job->quality = quality_.load();
+    job->onComplete = std::move(onComplete);
+    job->decoded = std::move(source);
+
+    auto future = job->promise.get_future();
+    if (job->decoded.getNumChannels() <= 0 || job->decoded.getNumSamples() <= 0)
+    {
+        start(job, [this, job] { finish(job, false); });
+        return future;
+    }
+    start(job, [this, job] { onDecoded(job); });
+    return future;
+}
+
+void StemLoader::open(const std::shared_ptr<Job>& job)
+{
+    TUNETRIX_TRACE_THREAD("Stem loader");
+    TUNETRIX_TRACE_ZONE("Stem open");
+    if (!job->file.existsAsFile())
+    {
+        finish(job, false);
+        return;
+    }
+
+    std::unique_ptr<juce::AudioFormatReader> reader(formatManager_.createReaderFor(job->file));
+    if (reader == nullptr)
+    {
+        finish(job, false);
+        return;
+    }
+
+    const int numChannels = static_cast<int>(reader->numChannels);
+    const int64_t totalSamples = static_cast<int64_t>(reader->lengthInSamples);
+    if (numChannels <= 0 || totalSamples <= 0 || totalSamples > std::numeric_limits<int>::max())
+    {
+        finish(job, false);
+        return;
+    }
+
+    job->sourceSampleRate = reader->sampleRate;
+    job->decoded.setSize(numChannels, static_cast<int>(totalSamples));
+
+    if (!supportsChunkedDecode(job->file) || totalSamples <= kDecodeChunkSamples)
+    {
+        const bool ok = reader->read(&job->decoded, 0, static_cast<int>(totalSamples), 0, true, true);
+        if (!ok)
+        {
+            finish(job, false);
+            return;
+        }
+        onDecoded(job);
+        return;
+    }
+
+    // Fetch the write pointers once here so the chunk tasks only ever touch disjoint sample ranges.
+    auto* const* channels = job->decoded.getArrayOfWritePointers();
+    job->decodedChannels.assign(channels, channels + numChannels);
+
+    const int numChunks = static_cast<int>((totalSamples + kDecodeChunkSamples - 1) / kDecodeChunkSamples);
+    job->pendingTasks.store(numChunks);
+    for (int chunk = 0; chunk < numChunks; ++chunk)
+    {
+        const int64_t start = static_cast<int64_t>(chunk) * kDecodeChunkSamples;
+        const int count = static_cast<int>(std::min(kDecodeChunkSamples, totalSamples - start));
+        enqueue([this, job, start, count] { decodeChunk(job, start, count); });
+    }
+}
+
+void StemLoader::decodeChunk(const std::shared_ptr<Job>& job, int64_t startSample, int numSamples)
+{
+    TUNETRIX_TRACE_THREAD("Stem loader");
+    TUNETRIX_TRACE_ZONE("Stem decode");
+    if (!job->failed.load())
+    {
+        std::unique_ptr<juce::AudioFormatReader> reader(formatManager_.createReaderFor(job->file));
+        std::vector<float*> destination(job->decodedChannels.size());
+        for (size_t ch = 0; ch < destination.size(); ++ch)
+        {
+            destination[ch] = job->decodedChannels[ch] + startSample;
+        }
+
+        const bool ok = reader != nullptr
+                        && reader->read(destination.data(),
+                                        static_cast<int>(destination.size()),
+                                        startSample,
+                                        numSamples);
+        if (!ok)
+        {
+            job->failed.store(true);
+        }
+    }
+
+    if (job->pendingTasks.fetch_sub(1) == 1)
+    {
+        if (job->failed.load())
+        {
+            finish(job, false);
+            return;
+        }
+        onDecoded(job);
+    }
+}
+
+void StemLoader::onDecoded(const std::shared_ptr<Job>& job)
+{
+    if (std::abs(job->sourceSampleRate - job->targetSampleRate) < 1e-3)
+    {
+        job->resampled = std::move(job->decoded);
+        onResampled(job);
+        return;
+    }
+
+    const int numChannels = job->decoded.getNumChannels();
+    const int totalSamples = job->decoded.getNumSamples();
+    const auto resampledSamples = static_cast<int>(dsp::Resampler::outputLength(static_cast<size_t>(totalSamples),
+                                                                               job->sourceSampleRate,
+                                                                               job->targetSampleRate));
+    job->resampled.setSize(numChannels, resampledSamples);
+    auto* const* channels = job->resampled.getArrayOfWritePointers();
+    job->resampledChannels.assign(channels, channels + numChannels);
+
+    // Resampler::render is stateless per output sample, so each chunk reads the decoded
+    // input it needs (including the filter overlap past its edges) straight from the
+    // shared buffer and the chunks can run in any order.
+    job->resampler.prepare(job->sourceSampleRate, job->targetSampleRate, job->quality, 0);
+    const int numChunks = (resampledSamples + kResampleChunkSamples - 1) / kResampleChunkSamples;
+
+    job->pendingTasks.store(numChannels * numChunks);
+    for (int ch = 0; ch < numChannels; ++ch)
+    {
+        for (int chunk = 0; chunk < numChunks; ++chunk)
+        {
+            const int outputStart = chunk * kResampleChunkSamples;
+            const int outputCount = std::min(kResampleChunkSamples, resampledSamples - outputStart);
+            enqueue([this, job, ch, outputStart, outputCount] {
+                resampleChunk(job, ch, outputStart, outputCount);
+            });
+        }
+    }
+}
+
+void StemLoader::resampleChunk(const std::shared_ptr<Job>& job, int channel, int outputStart, int outputCount)
+{
+    TUNETRIX_TRACE_THREAD("Stem loader");
+    TUNETRIX_TRACE_ZONE("Stem resample");
+    job->resampler.render(job->decoded.getReadPointer(channel),
+                          static_cast<size_t>(job->decoded.getNumSamples()),
+                          job->resampledChannels[static_cast<size_t>(channel)] + outputStart,
+                          static_cast<size_t>(outputStart),
+                          static_cast<size_t>(outputCount));
+
+    if (job->pendingTasks.fetch_sub(1) == 1)
+    {
+        job->decoded.setSize(0, 0);
+        onResampled(job);
+    }
+}
+
+void StemLoader::onResampled(const std::shared_ptr<Job>& job)
+{
+    if (!job->buildOverview)
+    {
+        finish(job, true);
+        return;
+    }
+
+    // Each chunk of each channel's pyramid depends on that chunk's samples alone, so the
+    // chunks go to the pool like the resample chunks and only the top levels are left.
+    const int numChannels = job->resampled.getNumChannels();
+    const auto numSamples = static_cast<size_t>(job->resampled.getNumSamples());
+    job->overview = std::make_shared<dsp::StemOverview>();
+    job->overview->channels.resize(static_cast<size_t>(numChannels));
+    size_t numTasks = 0;
+    for (auto& channel : job->overview->channels)
+    {
+        channel.prepare(numSamples, job->targetSampleRate, kOverviewBaseBinSamples);
+        numTasks += channel.numChunks();
+    }
+    if (numTasks == 0)
+    {
+        finish(job, true);
+        return;
+    }
+
+    job->pendingTasks.store(static_cast<int>(numTasks));
+    for (int ch = 0; ch < numChannels; ++ch)
+    {
+        const size_t numChunks = job->overview->channels[static_cast<size_t>(ch)].numChunks();
+        for (size_t chunk = 0; chunk < numChunks; ++chunk)
+        {
+            enqueue([this, job, ch, chunk] { overviewChunk(job, ch, chunk); });
+        }
+    }
+}
+
+void StemLoader::overviewChunk(const std::shared_ptr<Job>& job, int channel, size_t chunk)
+{
+    TUNETRIX_TRACE_THREAD("Stem loader");
+    TUNETRIX_TRACE_ZONE("Stem overview");
+    job->overview->channels[static_cast<size_t>(channel)].buildChunk(job->resampled.getReadPointer(channel), chunk);
+
+    if (job->pendingTasks.fetch_sub(1) == 1)
+    {
+        for (auto& pyramid : job->overview->channels)
+        {
+            pyramid.finish();
+        }
+        finish(job, true);
+    }
+}
+
+void StemLoader::finish(const std::shared_ptr<Job>& job, bool ok)
+{
+    {
+        const std::lock_guard<std::mutex> lock(jobsMutex_);
+        jobs_.erase(std::remove(jobs_.begin(), jobs_.end(), job), jobs_.end());
+    }
+    // A task that outlasted shutdown()'s timeout finds its load already resolved.
+    if (job->settled.exchange(true))
+    {
+        return;
+    }
+    if (!ok)
+    {
+        job->resampled.setSize(0, 0);
+        job->overview.reset();
+    }
+
+    const bool applied = job->onComplete ? job->onComplete(ok, job->resampled, std::move(job->overview)) : ok;
+    job->promise.set_value(applied);
+}
+} // namespace singwithme::audio
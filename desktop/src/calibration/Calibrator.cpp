@@ -9,6 +9,26 @@ namespace
 {
 constexpr float epsilon = 1e-6f;
 constexpr float referenceDb = -80.0f;
+constexpr double kLevelHopSeconds = 0.01;
+constexpr size_t kFftSize = 1024;
+constexpr size_t kFftHop = kFftSize / 2;
+constexpr float kLowestBandHz = 62.5f;
+constexpr float kHighestBandHz = 16000.0f;
+constexpr float kBandSmoothing = 0.7f;
+constexpr float kMinimumBias = 1.5f; // minimum statistics underestimates the mean noise power
+constexpr float kNoiseQuantile = 0.1f;
+constexpr float kNoiseCrestDb = 12.0f;
+constexpr float kVoiceHeadroomDb = 6.0f;
+constexpr float kComfortableSnrDb = 20.0f;
+constexpr float kBoostPerDb = 0.01f;
+constexpr float kMaxThresholdBoost = 0.2f;
+constexpr float kMaxGateAmplitude = 0.6f;
+constexpr double kPi = 3.14159265358979323846;
+
+float powerToDb(float power)
+{
+    return 10.0f * std::log10(std::max(power, 1.0e-12f));
+}
 } // namespace
 
 void Calibrator::start(double sampleRate, float durationSeconds)
@@ -17,23 +37,110 @@ void Calibrator::start(double sampleRate, float durationSeconds)
     targetDuration_ = durationSeconds;
     processedSamples_ = 0;
     maxAmplitude_ = 0.0f;
+
+    hopSamples_ = std::max<size_t>(1, static_cast<size_t>(std::round(sampleRate_ * kLevelHopSeconds)));
+    hopFill_ = 0;
+    hopSumSquares_ = 0.0f;
+    levels_.reset();
+
+    fft_.prepare(kFftSize);
+    window_.resize(kFftSize);
+    windowPower_ = 0.0f;
+    for (size_t i = 0; i < kFftSize; ++i)
+    {
+        window_[i] = static_cast<float>(0.5 - 0.5 * std::cos(2.0 * kPi * static_cast<double>(i) / static_cast<double>(kFftSize)));
+        windowPower_ += window_[i] * window_[i];
+    }
+    frame_.assign(kFftSize, 0.0f);
+    windowed_.assign(kFftSize, 0.0f);
+    spectrum_.assign(fft_.numBins(), {});
+    frameFill_ = 0;
+
+    // Log-spaced bands up to the lower of 16 kHz and Nyquist, each at least one bin wide.
+    const float binHz = static_cast<float>(sampleRate_) / static_cast<float>(kFftSize);
+    const float highestHz = std::min(kHighestBandHz, 0.5f * static_cast<float>(sampleRate_));
+    const float ratio = std::pow(highestHz / kLowestBandHz, 1.0f / static_cast<float>(kNumNoiseBands));
+    float lowHz = kLowestBandHz;
+    for (size_t band = 0; band < kNumNoiseBands; ++band)
+    {
+        const float highHz = lowHz * ratio;
+        auto& range = bands_[band];
+        range.firstBin = std::min(fft_.numBins() - 1, static_cast<size_t>(std::ceil(lowHz / binHz)));
+        range.lastBin = std::clamp(static_cast<size_t>(std::floor(highHz / binHz)), range.firstBin, fft_.numBins() - 1);
+        bandCentreHz_[band] = std::sqrt(lowHz * highHz);
+        lowHz = highHz;
+    }
+    bandSmoothed_.fill(0.0f);
+    bandMinimum_.fill(0.0f);
+    spectrumPrimed_ = false;
 }
 
 void Calibrator::processBlock(const float* samples, size_t numSamples)
 {
-    if (isComplete())
+    if (isComplete() || samples == nullptr || frame_.empty())
     {
         return;
     }
 
     for (size_t i = 0; i < numSamples; ++i)
     {
-        maxAmplitude_ = std::max(maxAmplitude_, std::abs(samples[i]));
+        const float sample = samples[i];
+        maxAmplitude_ = std::max(maxAmplitude_, std::abs(sample));
+
+        hopSumSquares_ += sample * sample;
+        if (++hopFill_ == hopSamples_)
+        {
+            levels_.add(powerToDb(hopSumSquares_ / static_cast<float>(hopSamples_)));
+            hopSumSquares_ = 0.0f;
+            hopFill_ = 0;
+        }
+
+        frame_[frameFill_] = sample;
+        if (++frameFill_ == kFftSize)
+        {
+            analyseSpectrum();
+            std::copy(frame_.begin() + kFftHop, frame_.end(), frame_.begin());
+            frameFill_ = kFftSize - kFftHop;
+        }
     }
 
     processedSamples_ += numSamples;
 }
 
+void Calibrator::analyseSpectrum()
+{
+    for (size_t i = 0; i < kFftSize; ++i)
+    {
+        windowed_[i] = frame_[i] * window_[i];
+    }
+    fft_.forwardReal(windowed_.data(), spectrum_.data());
+
+    // Minimum statistics per band: smooth the band power over frames and keep the lowest
+    // value seen, so singing during the pass does not leak into the noise estimate.
+    for (size_t band = 0; band < kNumNoiseBands; ++band)
+    {
+        const auto& range = bands_[band];
+        float power = 0.0f;
+        for (size_t bin = range.firstBin; bin <= range.lastBin; ++bin)
+        {
+            power += std::norm(spectrum_[bin]);
+        }
+        power /= static_cast<float>(range.lastBin - range.firstBin + 1) * windowPower_;
+
+        if (!spectrumPrimed_)
+        {
+            bandSmoothed_[band] = power;
+            bandMinimum_[band] = power;
+        }
+        else
+        {
+            bandSmoothed_[band] = kBandSmoothing * bandSmoothed_[band] + (1.0f - kBandSmoothing) * power;
+            bandMinimum_[band] = std::min(bandMinimum_[band], bandSmoothed_[band]);
+        }
+    }
+    spectrumPrimed_ = true;
+}
+
 bool Calibrator::isComplete() const noexcept
 {
     const double totalSamplesNeeded = sampleRate_ * targetDuration_;
@@ -43,10 +150,32 @@ bool Calibrator::isComplete() const noexcept
 CalibrationResult Calibrator::result() const noexcept
 {
     CalibrationResult res;
-    res.isValid = processedSamples_ > 0;
+    res.isValid = processedSamples_ > 0 && levels_.count() > 0;
     const float amplitude = std::max(maxAmplitude_, epsilon);
     res.vocalPeakDb = 20.0f * std::log10(amplitude);
-    res.noiseFloorDb = referenceDb;
+    if (!res.isValid)
+    {
+        res.noiseFloorDb = referenceDb;
+        return res;
+    }
+
+    res.noiseFloorDb = levels_.quantile(kNoiseQuantile);
+    res.medianDb = levels_.quantile(0.5f);
+    res.p95Db = levels_.quantile(0.95f);
+
+    for (size_t band = 0; band < kNumNoiseBands; ++band)
+    {
+        res.noiseBandCentreHz[band] = bandCentreHz_[band];
+        res.noiseBandDb[band] = spectrumPrimed_ ? powerToDb(bandMinimum_[band] * kMinimumBias) : referenceDb;
+    }
+
+    // Noise peaks sit roughly a crest factor above the RMS floor; keep the gate between
+    // them and the loud end of the voice.
+    const float gateDb = std::min(res.noiseFloorDb + kNoiseCrestDb, res.p95Db - kVoiceHeadroomDb);
+    res.noiseGateAmplitude = std::clamp(std::pow(10.0f, gateDb / 20.0f), epsilon, kMaxGateAmplitude);
+
+    const float snrDb = res.p95Db - res.noiseFloorDb;
+    res.thresholdBoost = std::clamp((kComfortableSnrDb - snrDb) * kBoostPerDb, 0.0f, kMaxThresholdBoost);
     return res;
 }
 } // namespace singwithme::calibration
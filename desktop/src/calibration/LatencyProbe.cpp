@@ -0,0 +1,139 @@
+#include "calibration/LatencyProbe.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <complex>
+#include <cstdint>
+
+#include "dsp/Fft.h"
+
+namespace singwithme::calibration
+{
+namespace
+{
+// x^15 + x^14 + 1 is primitive, so the register cycles through all 2^15 - 1 non-zero states.
+constexpr uint32_t kFeedbackMask = (1u << 14) | (1u << 13);
+constexpr float kMinPeakToNoiseDb = 20.0f;
+constexpr int kMaxSpreadSamples = 1;
+} // namespace
+
+void LatencyProbe::start(double sampleRate, int repeats, float level)
+{
+    const size_t length = (static_cast<size_t>(1) << kSequenceOrder) - 1;
+    sequence_.resize(length);
+    uint32_t state = 1;
+    for (size_t i = 0; i < length; ++i)
+    {
+        sequence_[i] = (state & 1u) != 0 ? level : -level;
+        const uint32_t feedback = static_cast<uint32_t>(std::popcount(state & kFeedbackMask) & 1);
+        state = ((state << 1) | feedback) & ((1u << kSequenceOrder) - 1);
+    }
+
+    // Each repeat is the sequence followed by enough silence for the longest expected trip.
+    repeats_ = std::max(1, repeats);
+    maxLagSamples_ = static_cast<size_t>(std::ceil(sampleRate * kMaxLatencySeconds));
+    segmentSamples_ = length + maxLagSamples_;
+    recording_.assign(segmentSamples_ * static_cast<size_t>(repeats_), 0.0f);
+    position_ = 0;
+    complete_.store(false, std::memory_order_release);
+}
+
+void LatencyProbe::processBlock(const float* input, float* output, size_t numSamples)
+{
+    if (isComplete())
+    {
+        if (output != nullptr)
+        {
+            std::fill(output, output + numSamples, 0.0f);
+        }
+        return;
+    }
+
+    const size_t count = std::min(numSamples, recording_.size() - position_);
+    for (size_t i = 0; i < count; ++i)
+    {
+        const size_t inSegment = (position_ + i) % segmentSamples_;
+        if (output != nullptr)
+        {
+            output[i] = inSegment < sequence_.size() ? sequence_[inSegment] : 0.0f;
+        }
+        recording_[position_ + i] = input != nullptr ? input[i] : 0.0f;
+    }
+    if (output != nullptr)
+    {
+        std::fill(output + count, output + numSamples, 0.0f);
+    }
+
+    position_ += count;
+    if (position_ >= recording_.size())
+    {
+        complete_.store(true, std::memory_order_release);
+    }
+}
+
+LatencyMeasurement LatencyProbe::result() const
+{
+    LatencyMeasurement measurement;
+    if (!isComplete() || recording_.empty() || position_ < recording_.size())
+    {
+        return measurement;
+    }
+
+    // Linear correlation for lags 0..maxLag needs segment + sequence samples without wrap.
+    size_t fftSize = 1;
+    while (fftSize < segmentSamples_ + sequence_.size())
+    {
+        fftSize <<= 1;
+    }
+    dsp::Fft fft;
+    fft.prepare(fftSize);
+    std::vector<float> frame(fftSize, 0.0f);
+    std::vector<std::complex<float>> reference(fft.numBins());
+    std::vector<std::complex<float>> recorded(fft.numBins());
+
+    std::copy(sequence_.begin(), sequence_.end(), frame.begin());
+    fft.forwardReal(frame.data(), reference.data());
+
+    std::vector<int> lags;
+    float weakestDb = 1000.0f;
+    for (int repeat = 0; repeat < repeats_; ++repeat)
+    {
+        const auto segment = recording_.begin() + static_cast<std::ptrdiff_t>(segmentSamples_ * static_cast<size_t>(repeat));
+        std::fill(frame.begin(), frame.end(), 0.0f);
+        std::copy(segment, segment + static_cast<std::ptrdiff_t>(segmentSamples_), frame.begin());
+        fft.forwardReal(frame.data(), recorded.data());
+        for (size_t k = 0; k < recorded.size(); ++k)
+        {
+            recorded[k] *= std::conj(reference[k]);
+        }
+        fft.inverseReal(recorded.data(), frame.data());
+
+        // The trip may invert polarity, so look for the largest magnitude.
+        size_t peakLag = 0;
+        float peak = 0.0f;
+        double energy = 0.0;
+        for (size_t lag = 0; lag <= maxLagSamples_; ++lag)
+        {
+            const float value = std::abs(frame[lag]);
+            energy += static_cast<double>(value) * value;
+            if (value > peak)
+            {
+                peak = value;
+                peakLag = lag;
+            }
+        }
+        const double noise = (energy - static_cast<double>(peak) * peak) / static_cast<double>(maxLagSamples_);
+        const float ratioDb = noise > 0.0 ? static_cast<float>(10.0 * std::log10(static_cast<double>(peak) * peak / noise)) : 0.0f;
+        weakestDb = std::min(weakestDb, ratioDb);
+        lags.push_back(static_cast<int>(peakLag));
+    }
+
+    std::sort(lags.begin(), lags.end());
+    measurement.roundTripSamples = lags[lags.size() / 2];
+    measurement.spreadSamples = lags.back() - lags.front();
+    measurement.peakToNoiseDb = weakestDb;
+    measurement.isValid = weakestDb >= kMinPeakToNoiseDb && measurement.spreadSamples <= kMaxSpreadSamples;
+    return measurement;
+}
+} // namespace singwithme::calibration
@@ -0,0 +1,41 @@
+#include "calibration/QuantileSketch.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace singwithme::calibration
+{
+void QuantileSketch::reset() noexcept
+{
+    bins_.fill(0);
+    count_ = 0;
+}
+
+void QuantileSketch::add(float levelDb) noexcept
+{
+    const float clamped = std::clamp(levelDb, kMinDb, kMaxDb - kBinDb);
+    const auto bin = static_cast<size_t>((clamped - kMinDb) / kBinDb);
+    ++bins_[std::min(bin, kNumBins - 1)];
+    ++count_;
+}
+
+float QuantileSketch::quantile(float q) const noexcept
+{
+    if (count_ == 0)
+    {
+        return kMinDb;
+    }
+
+    const auto rank = static_cast<uint64_t>(std::ceil(std::clamp(q, 0.0f, 1.0f) * static_cast<float>(count_)));
+    uint64_t seen = 0;
+    for (size_t bin = 0; bin < kNumBins; ++bin)
+    {
+        seen += bins_[bin];
+        if (seen >= std::max<uint64_t>(rank, 1))
+        {
+            return kMinDb + (static_cast<float>(bin) + 0.5f) * kBinDb;
+        }
+    }
+    return kMaxDb;
+}
+} // namespace singwithme::calibration
@@ -1,11 +1,19 @@
 #include "config/RuntimeConfig.h"
 
+#include <algorithm>
+#include <cmath>
+
+#include "dsp/RoutingMatrix.h"
+#include "trace/Tracer.h"
+
 #include <juce_data_structures/juce_data_structures.h>
 
 namespace singwithme::config
 {
 namespace
 {
+constexpr int kMaxOutputChannel = static_cast<int>(dsp::RoutingMatrix::kMaxOutputs) - 1;
+
 RuntimeConfig makeDefaults()
 {
     RuntimeConfig cfg;
@@ -14,6 +22,7 @@ RuntimeConfig makeDefaults()
     cfg.modelSampleRate = 16000.0;
     cfg.vadModelPath = "models/vad.onnx";
     cfg.pitchModelPath = "models/crepe_tiny.onnx";
+    cfg.pitchHopMs = 64.0;
     cfg.weights = ConfidenceWeights{0.6f, 0.4f, 0.0f};
     cfg.gate = GateParams{10.0f, 20.0f, 180.0f, 150.0f, 0.7f, 0.4f, 3, 6, -18.0f};
     cfg.media = MediaConfig{};
@@ -74,8 +83,95 @@ std::string getString(const juce::DynamicObject& object, const juce::Identifier&
     }
     return object.getProperty(key).toString().toStdString();
 }
+
+bool sameDeviceSetup(const DeviceLatency& entry,
+                     const std::string& inputDevice,
+                     const std::string& outputDevice,
+                     double sampleRate,
+                     int bufferSamples)
+{
+    return entry.inputDevice == inputDevice && entry.outputDevice == outputDevice
+           && std::abs(entry.sampleRate - sampleRate) < 0.5 && entry.bufferSamples == bufferSamples;
+}
+
+std::vector<DeviceLatency> parseDeviceLatencies(const juce::var& devices)
+{
+    std::vector<DeviceLatency> parsed;
+    if (auto* list = devices.getArray())
+    {
+        for (const auto& entry : *list)
+        {
+            if (auto* device = entry.getDynamicObject())
+            {
+                parsed.push_back(DeviceLatency{getString(*device, "inputDevice", {}),
+                                               getString(*device, "outputDevice", {}),
+                                               getDouble(*device, "sampleRateHz", 48000.0),
+                                               getInt(*device, "bufferSamples", 0),
+                                               getInt(*device, "roundTripSamples", 0)});
+            }
+        }
+    }
+    return parsed;
+}
+
+void putDeviceLatency(std::vector<DeviceLatency>& devices, const DeviceLatency& entry)
+{
+    const auto existing = std::find_if(devices.begin(), devices.end(), [&entry](const DeviceLatency& candidate)
+                                       { return sameDeviceSetup(candidate, entry.inputDevice, entry.outputDevice, entry.sampleRate, entry.bufferSamples); });
+    if (existing != devices.end())
+    {
+        *existing = entry;
+    }
+    else
+    {
+        devices.push_back(entry);
+    }
+}
+
+std::vector<DeviceLatency> readLatencyStore(const juce::File& file)
+{
+    juce::var root;
+    if (!file.existsAsFile() || !juce::JSON::parse(file.loadFileAsString(), root) || root.getDynamicObject() == nullptr)
+    {
+        return {};
+    }
+    return parseDeviceLatencies(root.getProperty("devices", {}));
+}
 } // namespace
 
+const DeviceLatency* LatencyConfig::find(const std::string& inputDevice,
+                                         const std::string& outputDevice,
+                                         double sampleRate,
+                                         int bufferSamples) const
+{
+    for (const auto& entry : devices)
+    {
+        if (sameDeviceSetup(entry, inputDevice, outputDevice, sampleRate, bufferSamples))
+        {
+            return &entry;
+        }
+    }
+    return nullptr;
+}
+
+int RoutingConfig::outputChannels() const
+{
+    int channels = 2;
+    for (const auto& bus : buses)
+    {
+        for (const int output : bus.outputs)
+        {
+            channels = std::max(channels, output + 1);
+        }
+    }
+    return channels;
+}
+
+size_t RuntimeConfig::pitchHopSamples() const
+{
+    return static_cast<size_t>(std::max(1L, std::lround(pitchHopMs * modelSampleRate / 1000.0)));
+}
+
 RuntimeConfig ConfigLoader::loadDefaults() const
 {
     return makeDefaults();
@@ -83,6 +179,7 @@ RuntimeConfig ConfigLoader::loadDefaults() const
 
 RuntimeConfig ConfigLoader::loadFromFile(const juce::File& file) const
 {
+    TUNETRIX_TRACE_ZONE("Config load");
     if (!file.existsAsFile())
     {
         return loadDefaults();
@@ -129,6 +226,7 @@ RuntimeConfig ConfigLoader::applyOverrides(const RuntimeConfig& baseConfig, cons
                 config.vadModelPath = getString(*models, "vad", config.vadModelPath);
                 config.pitchModelPath = getString(*models, "pitch", config.pitchModelPath);
                 config.modelSampleRate = getDouble(*models, "modelSampleRateHz", config.modelSampleRate);
+                config.pitchHopMs = getDouble(*models, "pitchHopMs", config.pitchHopMs);
             }
         }
 
@@ -155,6 +253,7 @@ RuntimeConfig ConfigLoader::applyOverrides(const RuntimeConfig& baseConfig, cons
                 config.gate.framesOn = getInt(*gate, "framesOn", config.gate.framesOn);
                 config.gate.framesOff = getInt(*gate, "framesOff", config.gate.framesOff);
                 config.gate.duckDb = getFloat(*gate, "duckDb", config.gate.duckDb);
+                config.gate.predictiveOpen = getBool(*gate, "predictiveOpen", config.gate.predictiveOpen);
             }
         }
 
@@ -165,6 +264,7 @@ RuntimeConfig ConfigLoader::applyOverrides(const RuntimeConfig& baseConfig, cons
                 config.media.instrumentPath = getString(*media, "instrumentPath", config.media.instrumentPath);
                 config.media.guidePath = getString(*media, "guidePath", config.media.guidePath);
                 config.media.loop = getBool(*media, "loop", config.media.loop);
+                config.media.loopCrossfadeMs = getFloat(*media, "loopCrossfadeMs", config.media.loopCrossfadeMs);
                 config.media.instrumentGainDb = getFloat(*media, "instrumentGainDb", config.media.instrumentGainDb);
                 config.media.guideGainDb = getFloat(*media, "guideGainDb", config.media.guideGainDb);
                 config.media.micMonitorGainDb = getFloat(*media, "micMonitorGainDb", config.media.micMonitorGainDb);
@@ -178,6 +278,97 @@ RuntimeConfig ConfigLoader::applyOverrides(const RuntimeConfig& baseConfig, cons
                 config.media.envelopeHoldMs = getFloat(*media, "envelopeHoldMs", config.media.envelopeHoldMs);
                 config.media.envelopeReleaseMs = getFloat(*media, "envelopeReleaseMs", config.media.envelopeReleaseMs);
                 config.media.envelopeReleaseMod = getFloat(*media, "envelopeReleaseMod", config.media.envelopeReleaseMod);
+                config.media.resamplerQuality = getString(*media, "resamplerQuality", config.media.resamplerQuality);
+                config.media.bleedCancellation = getBool(*media, "bleedCancellation", config.media.bleedCancellation);
+                config.media.bleedFilterMs = getFloat(*media, "bleedFilterMs", config.media.bleedFilterMs);
+                config.media.bleedStepSize = getFloat(*media, "bleedStepSize", config.media.bleedStepSize);
+                config.media.guidePitchFollow = getBool(*media, "guidePitchFollow", config.media.guidePitchFollow);
+            }
+        }
+
+        if (object->hasProperty("latency"))
+        {
+            if (auto* latency = object->getProperty("latency").getDynamicObject())
+            {
+                config.latency.measureWhenUnknown = getBool(*latency, "measureWhenUnknown", config.latency.measureWhenUnknown);
+                if (latency->getProperty("devices").isArray())
+                {
+                    config.latency.devices = parseDeviceLatencies(latency->getProperty("devices"));
+                }
+            }
+        }
+
+        if (object->hasProperty("inputBridge"))
+        {
+            if (auto* bridge = object->getProperty("inputBridge").getDynamicObject())
+            {
+                config.inputBridge.enabled = getBool(*bridge, "enabled", config.inputBridge.enabled);
+                config.inputBridge.targetLatencyMs = getFloat(*bridge, "targetLatencyMs", config.inputBridge.targetLatencyMs);
+            }
+        }
+
+        if (object->hasProperty("routing"))
+        {
+            if (auto* routing = object->getProperty("routing").getDynamicObject())
+            {
+                if (auto* buses = routing->getProperty("buses").getArray())
+                {
+                    config.routing.buses.clear();
+                    for (const auto& entry : *buses)
+                    {
+                        auto* bus = entry.getDynamicObject();
+                        auto* outputs = bus != nullptr ? bus->getProperty("outputs").getArray() : nullptr;
+                        if (outputs == nullptr || outputs->isEmpty())
+                        {
+                            continue;
+                        }
+
+                        RoutingBus parsed;
+                        parsed.name = getString(*bus, "name", {});
+                        for (int i = 0; i < std::min(2, outputs->size()); ++i)
+                        {
+                            parsed.outputs.push_back(std::clamp(static_cast<int>((*outputs)[i]), 0, kMaxOutputChannel));
+                        }
+                        parsed.mixGainDb = getFloat(*bus, "mixGainDb", parsed.mixGainDb);
+                        parsed.guideGainDb = getFloat(*bus, "guideGainDb", parsed.guideGainDb);
+                        parsed.instrumentGainDb = getFloat(*bus, "instrumentGainDb", parsed.instrumentGainDb);
+                        parsed.micGainDb = getFloat(*bus, "micGainDb", parsed.micGainDb);
+                        parsed.gateDepthDb = getFloat(*bus, "gateDepthDb", parsed.gateDepthDb);
+                        config.routing.buses.push_back(std::move(parsed));
+                    }
+                }
+            }
+        }
+
+        if (object->hasProperty("trace"))
+        {
+            if (auto* trace = object->getProperty("trace").getDynamicObject())
+            {
+                config.trace.enabled = getBool(*trace, "enabled", config.trace.enabled);
+                config.trace.path = getString(*trace, "path", config.trace.path);
+                config.trace.eventsPerThread = std::max(1, getInt(*trace, "eventsPerThread", config.trace.eventsPerThread));
+            }
+        }
+
+        if (object->hasProperty("setlist"))
+        {
+            if (auto* setlist = object->getProperty("setlist").getDynamicObject())
+            {
+                config.setlist.preloadDepth = getInt(*setlist, "preloadDepth", config.setlist.preloadDepth);
+                config.setlist.memoryBudgetMb = getFloat(*setlist, "memoryBudgetMb", config.setlist.memoryBudgetMb);
+                config.setlist.autoAdvance = getBool(*setlist, "autoAdvance", config.setlist.autoAdvance);
+                if (auto* songs = setlist->getProperty("songs").getArray())
+                {
+                    config.setlist.songs.clear();
+                    for (const auto& entry : *songs)
+                    {
+                        if (auto* song = entry.getDynamicObject())
+                        {
+                            config.setlist.songs.push_back(SetlistSong{getString(*song, "instrumentPath", {}),
+                                                                       getString(*song, "guidePath", {})});
+                        }
+                    }
+                }
             }
         }
     }
@@ -189,4 +380,43 @@ RuntimeConfig ConfigLoader::loadFromFile(const std::string& path) const
 {
     return loadFromFile(resolvePath(path));
 }
+
+std::string ConfigLoader::latencyStorePath()
+{
+    return juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory)
+        .getChildFile("TuneTrix")
+        .getChildFile("latency.json")
+        .getFullPathName()
+        .toStdString();
+}
+
+void ConfigLoader::loadDeviceLatencies(const std::string& path, LatencyConfig& latency) const
+{
+    for (const auto& entry : readLatencyStore(juce::File(path)))
+    {
+        putDeviceLatency(latency.devices, entry);
+    }
+}
+
+bool ConfigLoader::storeDeviceLatency(const std::string& path, const DeviceLatency& entry) const
+{
+    const juce::File file(path);
+    auto devices = readLatencyStore(file);
+    putDeviceLatency(devices, entry);
+
+    juce::Array<juce::var> list;
+    for (const auto& device : devices)
+    {
+        auto* object = new juce::DynamicObject();
+        object->setProperty("inputDevice", juce::String(device.inputDevice));
+        object->setProperty("outputDevice", juce::String(device.outputDevice));
+        object->setProperty("sampleRateHz", device.sampleRate);
+        object->setProperty("bufferSamples", device.bufferSamples);
+        object->setProperty("roundTripSamples", device.roundTripSamples);
+        list.add(juce::var(object));
+    }
+    auto* root = new juce::DynamicObject();
+    root->setProperty("devices", list);
+    return file.getParentDirectory().createDirectory() && file.replaceWithText(juce::JSON::toString(juce::var(root)));
+}
 } // namespace singwithme::config
@@ -0,0 +1,264 @@
+#include "dsp/AsrcBridge.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include "dsp/Simd.h"
+
+namespace singwithme::dsp
+{
+namespace
+{
+constexpr double kPi = 3.14159265358979323846;
+constexpr double kKaiserBeta = 8.6;
+constexpr double kPassband = 0.45; // of the lower Nyquist
+// Loop bandwidth and damping of the fill-level PLL, and the fill smoothing ahead of it.
+// The smoothing removes the sawtooth of the producer's block size.
+constexpr double kLoopHz = 0.02;
+constexpr double kLoopDamping = 0.8;
+constexpr double kFillSmoothingSeconds = 2.0;
+// Far beyond any real crystal drift; also bounds the pitch error while locking.
+constexpr double kMaxCorrection = 0.005;
+
+double besselI0(double x)
+{
+    double sum = 1.0;
+    double term = 1.0;
+    const double halfX = 0.5 * x;
+    for (int k = 1; k < 64; ++k)
+    {
+        const double factor = halfX / static_cast<double>(k);
+        term *= factor * factor;
+        sum += term;
+        if (term < sum * 1.0e-14)
+        {
+            break;
+        }
+    }
+    return sum;
+}
+} // namespace
+
+void AsrcBridge::prepare(double inputRate,
+                         double outputRate,
+                         size_t maxInputBlock,
+                         size_t maxOutputBlock,
+                         size_t targetFillSamples)
+{
+    inputRate_ = inputRate;
+    outputRate_ = outputRate;
+    nominalStep_ = inputRate / outputRate;
+    maxInputBlock_ = std::max<size_t>(maxInputBlock, 1);
+
+    // The extrapolated fill runs up to one input block ahead of what has arrived, the
+    // interpolator reads kTaps / 2 past the read position and one output block consumes up
+    // to maxOutputBlock * step inputs; the target has to cover all three, plus headroom for
+    // the drift that accumulates while the loop is still acquiring.
+    const auto blockInputs = static_cast<size_t>(std::ceil(static_cast<double>(std::max<size_t>(maxOutputBlock, 1)) * nominalStep_ * (1.0 + kMaxCorrection)));
+    targetFill_ = std::max(targetFillSamples, 2 * kTaps + blockInputs + maxInputBlock_);
+
+    size_t capacity = 1;
+    while (capacity < 4 * (targetFill_ + blockInputs + maxInputBlock_))
+    {
+        capacity <<= 1;
+    }
+    capacity_ = capacity;
+    mask_ = capacity - 1;
+    ring_.assign(2 * capacity_, 0.0f);
+
+    buildKernel(kPassband * std::min(1.0, 1.0 / nominalStep_));
+    reset();
+}
+
+void AsrcBridge::reset()
+{
+    std::fill(ring_.begin(), ring_.end(), 0.0f);
+    written_.store(0, std::memory_order_relaxed);
+    consumed_.store(0, std::memory_order_relaxed);
+    stampSequence_.store(0, std::memory_order_relaxed);
+    stampWritten_.store(0, std::memory_order_relaxed);
+    stampTime_.store(0.0, std::memory_order_relaxed);
+    readIndex_ = 0;
+    readFraction_ = 0.0;
+    integrator_ = 0.0;
+    fillEstimate_ = 0.0;
+    locked_ = false;
+    correction_.store(0.0, std::memory_order_relaxed);
+    smoothedFill_.store(0.0, std::memory_order_relaxed);
+    underruns_.store(0, std::memory_order_relaxed);
+    overruns_.store(0, std::memory_order_relaxed);
+}
+
+void AsrcBridge::buildKernel(double cutoff)
+{
+    // Row p holds the taps for a read position p / kPhases past an input sample; tap k sits
+    // at input offset k - (kTaps / 2 - 1). The extra row lets interpolate() blend p and p + 1.
+    kernel_.assign((kPhases + 1) * kTaps, 0.0f);
+    const double halfLength = static_cast<double>(kTaps) / 2.0;
+    const double windowNorm = besselI0(kKaiserBeta);
+    for (size_t phase = 0; phase <= kPhases; ++phase)
+    {
+        const double fraction = static_cast<double>(phase) / static_cast<double>(kPhases);
+        double sum = 0.0;
+        float* row = kernel_.data() + phase * kTaps;
+        for (size_t k = 0; k < kTaps; ++k)
+        {
+            const double offset = static_cast<double>(k) - (halfLength - 1.0) - fraction;
+            const double x = 2.0 * cutoff * offset;
+            const double sinc = std::abs(x) < 1.0e-12 ? 1.0 : std::sin(kPi * x) / (kPi * x);
+            const double t = offset / halfLength;
+            const double window = std::abs(t) >= 1.0 ? 0.0 : besselI0(kKaiserBeta * std::sqrt(1.0 - t * t)) / windowNorm;
+            row[k] = static_cast<float>(2.0 * cutoff * sinc * window);
+            sum += row[k];
+        }
+        // Unity DC gain on every phase keeps the interpolation from modulating the level.
+        for (size_t k = 0; k < kTaps; ++k)
+        {
+            row[k] = static_cast<float>(row[k] / sum);
+        }
+    }
+}
+
+double AsrcBridge::now() noexcept
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void AsrcBridge::push(const float* input, size_t numSamples) noexcept
+{
+    push(input, numSamples, now());
+}
+
+void AsrcBridge::pull(float* output, size_t numSamples) noexcept
+{
+    pull(output, numSamples, now());
+}
+
+void AsrcBridge::push(const float* input, size_t numSamples, double timeSeconds) noexcept
+{
+    if (capacity_ == 0 || input == nullptr)
+    {
+        return;
+    }
+
+    const uint64_t written = written_.load(std::memory_order_relaxed);
+    const uint64_t consumed = consumed_.load(std::memory_order_acquire);
+    if (written + numSamples - consumed > capacity_ - kTaps)
+    {
+        overruns_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    for (size_t i = 0; i < numSamples; ++i)
+    {
+        const size_t slot = static_cast<size_t>(written + i) & mask_;
+        ring_[slot] = input[i];
+        ring_[slot + capacity_] = input[i];
+    }
+    written_.store(written + numSamples, std::memory_order_release);
+
+    const uint32_t sequence = stampSequence_.load(std::memory_order_relaxed);
+    stampSequence_.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    stampWritten_.store(written + numSamples, std::memory_order_relaxed);
+    stampTime_.store(timeSeconds, std::memory_order_relaxed);
+    stampSequence_.store(sequence + 2, std::memory_order_release);
+}
+
+double AsrcBridge::extrapolatedWritten(uint64_t written, double timeSeconds) const noexcept
+{
+    // A block arriving now was captured over the last block period, so between pushes the
+    // ring "fills" at the input rate. Capped at one block so a stalled input cannot hide.
+    for (int attempt = 0; attempt < 4; ++attempt)
+    {
+        const uint32_t before = stampSequence_.load(std::memory_order_acquire);
+        const uint64_t stampWritten = stampWritten_.load(std::memory_order_relaxed);
+        const double stampTime = stampTime_.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if ((before & 1u) == 0 && before == stampSequence_.load(std::memory_order_relaxed) && stampWritten == written)
+        {
+            const double elapsed = std::clamp((timeSeconds - stampTime) * inputRate_, 0.0, static_cast<double>(maxInputBlock_));
+            return static_cast<double>(written) + elapsed;
+        }
+    }
+    return static_cast<double>(written);
+}
+
+void AsrcBridge::pull(float* output, size_t numSamples, double timeSeconds) noexcept
+{
+    if (capacity_ == 0 || output == nullptr)
+    {
+        return;
+    }
+
+    const uint64_t written = written_.load(std::memory_order_acquire);
+    if (!locked_)
+    {
+        if (written < readIndex_ + targetFill_)
+        {
+            std::fill(output, output + numSamples, 0.0f);
+            return;
+        }
+        // Start exactly on target, dropping anything that piled up while waiting.
+        const double start = extrapolatedWritten(written, timeSeconds) - static_cast<double>(targetFill_);
+        readIndex_ = std::min(static_cast<uint64_t>(start), written - targetFill_ + maxInputBlock_);
+        readFraction_ = 0.0;
+        fillEstimate_ = static_cast<double>(targetFill_);
+        locked_ = true;
+    }
+
+    const double position = static_cast<double>(readIndex_) + readFraction_;
+    steer(extrapolatedWritten(written, timeSeconds) - position, numSamples);
+
+    const double step = nominalStep_ * (1.0 + correction_.load(std::memory_order_relaxed));
+    const double needed = static_cast<double>(numSamples) * step + static_cast<double>(kTaps / 2) + 1.0;
+    if (static_cast<double>(written) - position < needed)
+    {
+        underruns_.fetch_add(1, std::memory_order_relaxed);
+        std::fill(output, output + numSamples, 0.0f);
+        locked_ = false;
+        return;
+    }
+
+    for (size_t i = 0; i < numSamples; ++i)
+    {
+        output[i] = interpolate(readIndex_, readFraction_);
+        readFraction_ += step;
+        const double whole = std::floor(readFraction_);
+        readIndex_ += static_cast<uint64_t>(whole);
+        readFraction_ -= whole;
+    }
+    consumed_.store(readIndex_ > kTaps ? readIndex_ - kTaps : 0, std::memory_order_release);
+}
+
+void AsrcBridge::steer(double fill, size_t numSamples) noexcept
+{
+    const double blockSeconds = static_cast<double>(numSamples) / outputRate_;
+    const double smoothing = 1.0 - std::exp(-blockSeconds / kFillSmoothingSeconds);
+    fillEstimate_ += smoothing * (fill - fillEstimate_);
+    smoothedFill_.store(fillEstimate_, std::memory_order_relaxed);
+
+    // Second-order loop: a fractional ratio change a moves the fill by -numSamples * step * a
+    // per block, so the PI gains are scaled by that to keep the bandwidth fixed.
+    const double omega = 2.0 * kPi * kLoopHz * blockSeconds;
+    const double plantGain = static_cast<double>(numSamples) * nominalStep_;
+    const double error = fillEstimate_ - static_cast<double>(targetFill_);
+    integrator_ = std::clamp(integrator_ + error * omega * omega / plantGain, -kMaxCorrection, kMaxCorrection);
+    const double correction = integrator_ + error * 2.0 * kLoopDamping * omega / plantGain;
+    correction_.store(std::clamp(correction, -kMaxCorrection, kMaxCorrection), std::memory_order_relaxed);
+}
+
+float AsrcBridge::interpolate(uint64_t position, double fraction) const noexcept
+{
+    const size_t start = static_cast<size_t>(position + capacity_ - (kTaps / 2 - 1)) & mask_;
+    const float* samples = ring_.data() + start;
+
+    const double scaled = fraction * static_cast<double>(kPhases);
+    const auto phase = std::min(static_cast<size_t>(scaled), kPhases - 1);
+    const auto blend = static_cast<float>(scaled - static_cast<double>(phase));
+    const float a = simd::dotProduct(samples, kernel_.data() + phase * kTaps, kTaps);
+    const float b = simd::dotProduct(samples, kernel_.data() + (phase + 1) * kTaps, kTaps);
+    return a + (b - a) * blend;
+}
+} // namespace singwithme::dsp
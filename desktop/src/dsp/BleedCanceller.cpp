@@ -0,0 +1,237 @@
+#include "dsp/BleedCanceller.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "dsp/Simd.h"
+
+namespace singwithme::dsp
+{
+namespace
+{
+constexpr float kPowerSmoothing = 0.9f;
+constexpr float kEnergySmoothing = 0.95f;
+// Per-bin regularisation relative to a full-scale reference, so silence never drives the step.
+constexpr float kRegularisation = 1.0e-6f;
+// A partition whose residual is this much louder than the mic means the filter has diverged.
+constexpr float kDivergenceRatio = 4.0f;
+} // namespace
+
+void BleedCanceller::prepare(size_t partitionSize, size_t filterLength, size_t maxBlockSize)
+{
+    size_t size = 16;
+    while (size < partitionSize)
+    {
+        size <<= 1;
+    }
+    partitionSize_ = size;
+    numPartitions_ = std::clamp<size_t>((filterLength + partitionSize_ - 1) / partitionSize_, 1, kMaxPartitions);
+    maxBlockSize_ = std::max<size_t>(maxBlockSize, 1);
+
+    fft_.prepare(2 * partitionSize_);
+    numBins_ = fft_.numBins();
+
+    referenceSpectra_.assign(numPartitions_ * numBins_, {});
+    weights_.assign(numPartitions_ * numBins_, {});
+    binPower_.assign(numBins_, 0.0f);
+    echoSpectrum_.assign(numBins_, {});
+    errorSpectrum_.assign(numBins_, {});
+    frame_.assign(2 * partitionSize_, 0.0f);
+    previousReference_.assign(partitionSize_, 0.0f);
+
+    micFifo_.assign(partitionSize_ + maxBlockSize_, 0.0f);
+    referenceFifo_.assign(partitionSize_ + 3 * maxBlockSize_, 0.0f);
+    outputFifo_.assign(2 * partitionSize_ + maxBlockSize_, 0.0f);
+    reset();
+}
+
+void BleedCanceller::reset()
+{
+    std::fill(referenceSpectra_.begin(), referenceSpectra_.end(), std::complex<float>{});
+    std::fill(weights_.begin(), weights_.end(), std::complex<float>{});
+    std::fill(binPower_.begin(), binPower_.end(), 0.0f);
+    std::fill(previousReference_.begin(), previousReference_.end(), 0.0f);
+    spectraHead_ = 0;
+    constrainNext_ = 0;
+    referenceCount_ = 0;
+    micCount_ = 0;
+
+    // Prime the output with one partition of silence; that is the canceller's latency.
+    std::fill(outputFifo_.begin(), outputFifo_.begin() + static_cast<std::ptrdiff_t>(partitionSize_), 0.0f);
+    outputCount_ = partitionSize_;
+    micEnergy_ = 0.0f;
+    errorEnergy_ = 0.0f;
+    erleDb_ = 0.0f;
+}
+
+void BleedCanceller::pushReference(const float* reference, size_t numSamples)
+{
+    if (partitionSize_ == 0)
+    {
+        return;
+    }
+
+    for (size_t offset = 0; offset < numSamples; offset += maxBlockSize_)
+    {
+        const size_t count = std::min(maxBlockSize_, numSamples - offset);
+        // A reference that runs far ahead of the mic (shrinking blocks) loses its oldest samples.
+        const size_t limit = referenceFifo_.size() - count;
+        if (referenceCount_ > limit)
+        {
+            popFifo(referenceFifo_, referenceCount_, referenceCount_ - limit);
+        }
+        if (reference != nullptr)
+        {
+            pushFifo(referenceFifo_, referenceCount_, reference + offset, count);
+        }
+        else
+        {
+            std::fill_n(referenceFifo_.begin() + static_cast<std::ptrdiff_t>(referenceCount_), count, 0.0f);
+            referenceCount_ += count;
+        }
+    }
+}
+
+void BleedCanceller::process(const float* mic, float* output, size_t numSamples)
+{
+    if (partitionSize_ == 0 || mic == nullptr || output == nullptr)
+    {
+        return;
+    }
+
+    for (size_t offset = 0; offset < numSamples; offset += maxBlockSize_)
+    {
+        const size_t count = std::min(maxBlockSize_, numSamples - offset);
+        pushFifo(micFifo_, micCount_, mic + offset, count);
+
+        // The reference for this block has not been rendered yet; treat the gap as silence so
+        // both streams advance together. In steady state this only happens on the first block.
+        if (referenceCount_ < micCount_)
+        {
+            const size_t gap = micCount_ - referenceCount_;
+            std::fill_n(referenceFifo_.begin() + static_cast<std::ptrdiff_t>(referenceCount_), gap, 0.0f);
+            referenceCount_ += gap;
+        }
+
+        while (micCount_ >= partitionSize_)
+        {
+            processPartition();
+        }
+
+        const size_t available = std::min(count, outputCount_);
+        std::copy_n(outputFifo_.begin(), available, output + offset);
+        std::fill(output + offset + available, output + offset + count, 0.0f);
+        popFifo(outputFifo_, outputCount_, available);
+    }
+}
+
+void BleedCanceller::processPartition()
+{
+    const size_t n = partitionSize_;
+    const float* reference = referenceFifo_.data();
+    const float* mic = micFifo_.data();
+
+    // Overlap-save frame: previous partition followed by the new one.
+    std::copy(previousReference_.begin(), previousReference_.end(), frame_.begin());
+    std::copy(reference, reference + n, frame_.begin() + static_cast<std::ptrdiff_t>(n));
+    std::copy(reference, reference + n, previousReference_.begin());
+
+    spectraHead_ = (spectraHead_ + numPartitions_ - 1) % numPartitions_;
+    auto* newest = referenceSpectra_.data() + spectraHead_ * numBins_;
+    fft_.forwardReal(frame_.data(), newest);
+
+    float referencePower = 0.0f;
+    for (size_t k = 0; k < numBins_; ++k)
+    {
+        const float power = std::norm(newest[k]);
+        binPower_[k] = kPowerSmoothing * binPower_[k] + (1.0f - kPowerSmoothing) * power;
+        referencePower += power;
+    }
+
+    std::fill(echoSpectrum_.begin(), echoSpectrum_.end(), std::complex<float>{});
+    for (size_t p = 0; p < numPartitions_; ++p)
+    {
+        const size_t slot = (spectraHead_ + p) % numPartitions_;
+        simd::complexMultiplyAccumulate(weights_.data() + p * numBins_,
+                                        referenceSpectra_.data() + slot * numBins_,
+                                        echoSpectrum_.data(),
+                                        numBins_);
+    }
+    fft_.inverseReal(echoSpectrum_.data(), frame_.data());
+
+    float micEnergy = 0.0f;
+    float errorEnergy = 0.0f;
+    float* error = frame_.data() + n;
+    for (size_t i = 0; i < n; ++i)
+    {
+        error[i] = mic[i] - error[i];
+        micEnergy += mic[i] * mic[i];
+        errorEnergy += error[i] * error[i];
+    }
+
+    const bool diverged = errorEnergy > kDivergenceRatio * micEnergy + 1.0e-9f;
+    pushFifo(outputFifo_, outputCount_, diverged ? mic : error, n);
+    micEnergy_ = kEnergySmoothing * micEnergy_ + (1.0f - kEnergySmoothing) * micEnergy;
+    errorEnergy_ = kEnergySmoothing * errorEnergy_ + (1.0f - kEnergySmoothing) * std::min(errorEnergy, micEnergy);
+    erleDb_ = micEnergy_ > 1.0e-12f ? 10.0f * std::log10(micEnergy_ / std::max(errorEnergy_, 1.0e-12f)) : 0.0f;
+
+    popFifo(micFifo_, micCount_, n);
+    popFifo(referenceFifo_, referenceCount_, n);
+
+    if (diverged)
+    {
+        std::fill(weights_.begin(), weights_.end(), std::complex<float>{});
+        return;
+    }
+
+    const float frameScale = static_cast<float>(2 * n);
+    const float regularisation = kRegularisation * frameScale * frameScale;
+    if (referencePower <= regularisation)
+    {
+        return;
+    }
+
+    // Gradient: conj(X_p) * mu_k * E, with E the spectrum of the zero-padded residual.
+    std::fill(frame_.begin(), frame_.begin() + static_cast<std::ptrdiff_t>(n), 0.0f);
+    fft_.forwardReal(frame_.data(), errorSpectrum_.data());
+    for (size_t k = 0; k < numBins_; ++k)
+    {
+        errorSpectrum_[k] *= stepSize_ / (static_cast<float>(numPartitions_) * binPower_[k] + regularisation);
+    }
+    for (size_t p = 0; p < numPartitions_; ++p)
+    {
+        const size_t slot = (spectraHead_ + p) % numPartitions_;
+        simd::conjugateMultiplyAccumulate(referenceSpectra_.data() + slot * numBins_,
+                                          errorSpectrum_.data(),
+                                          weights_.data() + p * numBins_,
+                                          numBins_);
+    }
+
+    constrainPartition(constrainNext_);
+    constrainNext_ = (constrainNext_ + 1) % numPartitions_;
+}
+
+void BleedCanceller::constrainPartition(size_t partition)
+{
+    auto* weights = weights_.data() + partition * numBins_;
+    fft_.inverseReal(weights, frame_.data());
+    std::fill(frame_.begin() + static_cast<std::ptrdiff_t>(partitionSize_), frame_.end(), 0.0f);
+    fft_.forwardReal(frame_.data(), weights);
+}
+
+void BleedCanceller::pushFifo(std::vector<float>& fifo, size_t& count, const float* samples, size_t numSamples)
+{
+    const size_t accepted = std::min(numSamples, fifo.size() - count);
+    std::copy_n(samples, accepted, fifo.begin() + static_cast<std::ptrdiff_t>(count));
+    count += accepted;
+}
+
+void BleedCanceller::popFifo(std::vector<float>& fifo, size_t& count, size_t numSamples)
+{
+    const size_t removed = std::min(numSamples, count);
+    std::copy(fifo.begin() + static_cast<std::ptrdiff_t>(removed),
+              fifo.begin() + static_cast<std::ptrdiff_t>(count),
+              fifo.begin());
+    count -= removed;
+}
+} // namespace singwithme::dsp
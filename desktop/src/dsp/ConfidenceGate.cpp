@@ -21,6 +21,8 @@ void ConfidenceGate::configure(float sampleRate, size_t blockSize, GateConfig co
     holdTimerMs_ = 0.0f;
     consecutiveOn_ = 0;
     consecutiveOff_ = 0;
+    phraseAware_ = 0.0f;
+    msUntilOnset_ = -1.0f;
 }
 
 void ConfidenceGate::setManualMode(ManualMode mode)
@@ -28,10 +30,99 @@ void ConfidenceGate::setManualMode(ManualMode mode)
     manualMode_ = mode;
 }
 
+void ConfidenceGate::setThresholds(float thresholdOn, float thresholdOff)
+{
+    config_.thresholdOn = thresholdOn;
+    config_.thresholdOff = std::min(thresholdOff, thresholdOn);
+}
+
+void ConfidenceGate::setResponse(float attackMs, float releaseMs, float holdMs, float duckDb)
+{
+    const bool ducked = targetDb_ < kZeroDb;
+    config_.attackMs = attackMs;
+    config_.releaseMs = releaseMs;
+    config_.holdMs = holdMs;
+    config_.duckDb = std::min(duckDb, kZeroDb);
+    holdTimerMs_ = std::min(holdTimerMs_, config_.holdMs);
+    if (ducked)
+    {
+        targetDb_ = config_.duckDb;
+    }
+}
+
+void ConfidenceGate::setPhraseContext(float phraseAware, float weight, float msUntilOnset)
+{
+    phraseAware_ = std::clamp(phraseAware, 0.0f, 1.0f);
+    phraseWeight_ = std::max(0.0f, weight);
+    msUntilOnset_ = msUntilOnset;
+}
+
+void ConfidenceGate::setGuideOnsets(const OnsetMap* onsets, double transportSeconds)
+{
+    onsets_ = onsets;
+    transportSeconds_ = transportSeconds;
+}
+
+void ConfidenceGate::setPitchFrames(bool enabled, float vadWeight, float pitchWeight)
+{
+    pitchFramed_ = enabled;
+    frameVadWeight_ = std::max(0.0f, vadWeight);
+    framePitchWeight_ = std::max(0.0f, pitchWeight);
+    consecutiveOn_ = 0;
+    consecutiveOff_ = 0;
+}
+
+void ConfidenceGate::pushPitchFrame(float pitch, uint64_t endSample)
+{
+    if (!pitchFramed_ || (pitchFrameCount_ > 0 && endSample == lastFrameEnd_))
+    {
+        return;
+    }
+    lastFrameEnd_ = endSample;
+    ++pitchFrameCount_;
+    if (manualMode_ == ManualMode::Auto)
+    {
+        decide(frameVadWeight_ * lastVad_ + framePitchWeight_ * pitch);
+    }
+}
+
+void ConfidenceGate::decide(float confidence)
+{
+    confidence = std::clamp(confidence + phraseWeight_ * phraseAware_, 0.0f, 1.0f);
+    const bool entryDue = phraseWeight_ > 0.0f && msUntilOnset_ >= 0.0f
+                          && msUntilOnset_ <= config_.lookAheadMs + config_.attackMs;
+    const int framesOn = entryDue ? 1 : config_.framesOn;
+
+    if (confidence >= config_.thresholdOn)
+    {
+        consecutiveOn_++;
+        consecutiveOff_ = 0;
+    }
+    else if (confidence <= config_.thresholdOff)
+    {
+        consecutiveOff_++;
+        consecutiveOn_ = 0;
+    }
+    else
+    {
+        consecutiveOn_ = 0;
+    }
+
+    if (consecutiveOn_ >= framesOn)
+    {
+        targetDb_ = kZeroDb;
+        holdTimerMs_ = config_.holdMs;
+    }
+    else if (consecutiveOff_ >= config_.framesOff && holdTimerMs_ <= 0.0f)
+    {
+        targetDb_ = config_.duckDb;
+    }
+}
+
 float ConfidenceGate::update(float confidence, float vad, float pitch)
 {
-    (void)vad;
     (void)pitch;
+    lastVad_ = vad;
 
     if (manualMode_ == ManualMode::AlwaysOn)
     {
@@ -43,29 +134,19 @@ float ConfidenceGate::update(float confidence, float vad, float pitch)
     }
     else
     {
-        if (confidence >= config_.thresholdOn)
+        if (!pitchFramed_)
         {
-            consecutiveOn_++;
-            consecutiveOff_ = 0;
-        }
-        else if (confidence <= config_.thresholdOff)
-        {
-            consecutiveOff_++;
-            consecutiveOn_ = 0;
-        }
-        else
-        {
-            consecutiveOn_ = 0;
+            decide(confidence);
         }
 
-        if (consecutiveOn_ >= config_.framesOn)
-        {
-            targetDb_ = kZeroDb;
-            holdTimerMs_ = config_.holdMs;
-        }
-        else if (consecutiveOff_ >= config_.framesOff && holdTimerMs_ <= 0.0f)
+        if (config_.predictiveOpen && onsets_ != nullptr)
         {
-            targetDb_ = config_.duckDb;
+            const float untilOnsetMs = onsets_->msUntilOnset(transportSeconds_);
+            if (untilOnsetMs >= 0.0f && untilOnsetMs <= config_.lookAheadMs + config_.attackMs)
+            {
+                targetDb_ = kZeroDb;
+                holdTimerMs_ = std::max(holdTimerMs_, untilOnsetMs + config_.holdMs);
+            }
         }
     }
 
@@ -0,0 +1,47 @@
+#include "dsp/DelayLine.h"
+
+#include <algorithm>
+
+namespace singwithme::dsp
+{
+void DelayLine::prepare(size_t maxDelaySamples)
+{
+    size_t size = 1;
+    while (size <= maxDelaySamples)
+    {
+        size <<= 1;
+    }
+    buffer_.assign(size, 0.0f);
+    mask_ = size - 1;
+    delay_ = std::min(delay_, mask_);
+    reset();
+}
+
+void DelayLine::reset()
+{
+    std::fill(buffer_.begin(), buffer_.end(), 0.0f);
+    writeIndex_ = 0;
+}
+
+void DelayLine::setDelay(size_t delaySamples) noexcept
+{
+    delay_ = std::min(delaySamples, mask_);
+}
+
+void DelayLine::process(const float* input, float* output, size_t numSamples) noexcept
+{
+    if (buffer_.empty())
+    {
+        std::copy(input, input + numSamples, output);
+        return;
+    }
+
+    // Write before read so a zero delay passes the input straight through.
+    for (size_t i = 0; i < numSamples; ++i)
+    {
+        buffer_[writeIndex_] = input[i];
+        output[i] = buffer_[(writeIndex_ - delay_) & mask_];
+        writeIndex_ = (writeIndex_ + 1) & mask_;
+    }
+}
+} // namespace singwithme::dsp
@@ -0,0 +1,146 @@
+#include "dsp/FdnReverb.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "dsp/Simd.h"
+
+namespace singwithme::dsp
+{
+namespace
+{
+// Spread over roughly an octave so the modes interleave; each is rounded up to a prime
+// sample count at the device rate.
+constexpr std::array<double, FdnReverb::kLines> kLineSeconds{0.0191, 0.0233, 0.0277, 0.0319, 0.0367, 0.0413, 0.0461, 0.0517};
+// The tail at Nyquist is this fraction of the tail at DC.
+constexpr double kHighFrequencyTailRatio = 0.4;
+constexpr double kParameterSmoothingSeconds = 0.05;
+// Output taps: two orthogonal sign patterns, so left and right are decorrelated.
+constexpr std::array<float, FdnReverb::kLines> kLeftTaps{0.5f, -0.5f, 0.5f, -0.5f, 0.5f, -0.5f, 0.5f, -0.5f};
+constexpr std::array<float, FdnReverb::kLines> kRightTaps{0.5f, 0.5f, -0.5f, -0.5f, 0.5f, 0.5f, -0.5f, -0.5f};
+// The input enters every line with alternating sign, scaled to keep the loop energy at unity.
+constexpr std::array<float, FdnReverb::kLines> kInputTaps{0.35355339f, -0.35355339f, 0.35355339f, 0.35355339f, -0.35355339f, 0.35355339f, -0.35355339f, -0.35355339f};
+
+bool isPrime(size_t value)
+{
+    if (value < 2)
+    {
+        return false;
+    }
+    for (size_t divisor = 2; divisor * divisor <= value; ++divisor)
+    {
+        if (value % divisor == 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+} // namespace
+
+void FdnReverb::prepare(double sampleRate)
+{
+    sampleRate_ = sampleRate;
+    size_t longest = 0;
+    for (size_t line = 0; line < kLines; ++line)
+    {
+        auto length = static_cast<size_t>(std::ceil(kLineSeconds[line] * sampleRate));
+        while (!isPrime(length))
+        {
+            ++length;
+        }
+        lengths_[line] = length;
+        longest = std::max(longest, length);
+    }
+
+    size_t capacity = 1;
+    while (capacity <= longest)
+    {
+        capacity <<= 1;
+    }
+    capacity_ = capacity;
+    mask_ = capacity - 1;
+    lines_.assign(kLines * capacity_, 0.0f);
+    reset();
+}
+
+void FdnReverb::reset()
+{
+    std::fill(lines_.begin(), lines_.end(), 0.0f);
+    writeIndex_ = 0;
+    state_.fill(0.0f);
+    // Start on the current settings instead of gliding in from silence.
+    updateTargets(targetTail_.load(std::memory_order_relaxed));
+    gain_ = targetGain_;
+    pole_ = targetPole_;
+    mix_ = targetMix_.load(std::memory_order_relaxed);
+}
+
+void FdnReverb::setTail(float mix, float tailSeconds) noexcept
+{
+    targetMix_.store(std::max(0.0f, mix), std::memory_order_relaxed);
+    targetTail_.store(std::clamp(tailSeconds, kMinTailSeconds, kMaxTailSeconds), std::memory_order_relaxed);
+}
+
+void FdnReverb::updateTargets(float tailSeconds) noexcept
+{
+    // Jot's absorptive loop: per pass a line of d samples loses 60 dB * d / (T60 * rate) at
+    // DC, and the one-pole shapes that loss so it reaches the shorter high-frequency tail.
+    appliedTail_ = tailSeconds;
+    const double samplesT60 = static_cast<double>(tailSeconds) * sampleRate_;
+    const double highFrequencyFactor = 1.0 - 1.0 / (kHighFrequencyTailRatio * kHighFrequencyTailRatio);
+    for (size_t line = 0; line < kLines; ++line)
+    {
+        const double decayDb = -60.0 * static_cast<double>(lengths_[line]) / samplesT60;
+        const double gain = std::pow(10.0, decayDb / 20.0);
+        const double pole = std::clamp(std::log(10.0) / 80.0 * decayDb * highFrequencyFactor, 0.0, 0.99);
+        targetGain_[line] = static_cast<float>(gain * (1.0 - pole));
+        targetPole_[line] = static_cast<float>(pole);
+    }
+}
+
+void FdnReverb::process(const float* input, float* left, float* right, size_t numSamples) noexcept
+{
+    if (capacity_ == 0 || input == nullptr || left == nullptr || right == nullptr)
+    {
+        return;
+    }
+
+    if (const float tail = targetTail_.load(std::memory_order_relaxed); tail != appliedTail_)
+    {
+        updateTargets(tail);
+    }
+    const double blockSeconds = static_cast<double>(numSamples) / sampleRate_;
+    const auto glide = static_cast<float>(1.0 - std::exp(-blockSeconds / kParameterSmoothingSeconds));
+    for (size_t line = 0; line < kLines; ++line)
+    {
+        gain_[line] += glide * (targetGain_[line] - gain_[line]);
+        pole_[line] += glide * (targetPole_[line] - pole_[line]);
+    }
+    const float targetMix = targetMix_.load(std::memory_order_relaxed);
+    const auto mixStep = static_cast<float>(1.0 - std::exp(-1.0 / (kParameterSmoothingSeconds * sampleRate_)));
+
+    alignas(32) std::array<float, kLines> feedback{};
+    for (size_t i = 0; i < numSamples; ++i)
+    {
+        const float dry = input[i];
+        for (size_t line = 0; line < kLines; ++line)
+        {
+            const float delayed = lines_[line * capacity_ + ((writeIndex_ - lengths_[line]) & mask_)];
+            state_[line] = gain_[line] * delayed + pole_[line] * state_[line];
+        }
+
+        mix_ += mixStep * (targetMix - mix_);
+        left[i] += mix_ * simd::dotProduct(state_.data(), kLeftTaps.data(), kLines);
+        right[i] += mix_ * simd::dotProduct(state_.data(), kRightTaps.data(), kLines);
+
+        feedback = state_;
+        simd::hadamard8(feedback.data());
+        for (size_t line = 0; line < kLines; ++line)
+        {
+            lines_[line * capacity_ + writeIndex_] = feedback[line] + kInputTaps[line] * dry;
+        }
+        writeIndex_ = (writeIndex_ + 1) & mask_;
+    }
+}
+} // namespace singwithme::dsp
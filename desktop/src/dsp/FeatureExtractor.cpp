@@ -0,0 +1,276 @@
+#include "dsp/FeatureExtractor.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace singwithme::dsp
+{
+namespace
+{
+constexpr size_t kFftSize = 1024;
+constexpr size_t kNumMelBands = 24;
+constexpr size_t kBacklogHops = 16;
+constexpr float kMelLowHz = 80.0f;
+constexpr float kMelHighHz = 7600.0f;
+constexpr float kMinPitchHz = 80.0f;
+constexpr float kMaxPitchHz = 500.0f;
+constexpr float kVoicedThreshold = 0.45f;
+constexpr float kReferenceHz = 100.0f;
+constexpr float kActiveRangeDb = 35.0f;
+constexpr float kActiveFloorDb = -60.0f;
+constexpr size_t kOnsetGapFrames = 20; // 200 ms of silence separates phrases
+constexpr double kPi = 3.14159265358979323846;
+
+float hzToMel(float hz)
+{
+    return 2595.0f * std::log10(1.0f + hz / 700.0f);
+}
+
+float melToHz(float mel)
+{
+    return 700.0f * (std::pow(10.0f, mel / 2595.0f) - 1.0f);
+}
+} // namespace
+
+void FeatureExtractor::prepare(double sampleRate)
+{
+    sampleRate_ = sampleRate;
+    fft_.prepare(kFftSize);
+
+    hann_.resize(kFrameSamples);
+    for (size_t i = 0; i < kFrameSamples; ++i)
+    {
+        hann_[i] = static_cast<float>(0.5 - 0.5 * std::cos(2.0 * kPi * static_cast<double>(i) / static_cast<double>(kFrameSamples)));
+    }
+
+    fftInput_.assign(kFftSize, 0.0f);
+    spectrum_.assign(fft_.numBins(), {});
+    autocorrelation_.assign(kFftSize, 0.0f);
+
+    const float binHz = static_cast<float>(sampleRate_) / static_cast<float>(kFftSize);
+    const float highHz = std::min(kMelHighHz, 0.5f * static_cast<float>(sampleRate_));
+    const float lowMel = hzToMel(kMelLowHz);
+    const float highMel = hzToMel(highHz);
+    melBands_.assign(kNumMelBands, {});
+    melWeights_.clear();
+    for (size_t band = 0; band < kNumMelBands; ++band)
+    {
+        const float step = (highMel - lowMel) / static_cast<float>(kNumMelBands + 1);
+        const float left = melToHz(lowMel + step * static_cast<float>(band));
+        const float centre = melToHz(lowMel + step * static_cast<float>(band + 1));
+        const float right = melToHz(lowMel + step * static_cast<float>(band + 2));
+
+        auto& melBand = melBands_[band];
+        melBand.firstBin = static_cast<size_t>(std::ceil(left / binHz));
+        melBand.weightOffset = melWeights_.size();
+        for (size_t bin = melBand.firstBin; static_cast<float>(bin) * binHz < right && bin < fft_.numBins(); ++bin)
+        {
+            const float hz = static_cast<float>(bin) * binHz;
+            const float weight = hz <= centre ? (hz - left) / (centre - left) : (right - hz) / (right - centre);
+            melWeights_.push_back(std::max(0.0f, weight));
+        }
+        melBand.numWeights = melWeights_.size() - melBand.weightOffset;
+    }
+    logMel_.assign(kNumMelBands, 0.0f);
+
+    dctTable_.resize(kNumMfcc * kNumMelBands);
+    for (size_t m = 0; m < kNumMfcc; ++m)
+    {
+        for (size_t band = 0; band < kNumMelBands; ++band)
+        {
+            dctTable_[m * kNumMelBands + band] = static_cast<float>(
+                std::cos(kPi * static_cast<double>(m + 1) * (static_cast<double>(band) + 0.5) / static_cast<double>(kNumMelBands)));
+        }
+    }
+
+    buffer_.assign(kFrameSamples + kBacklogHops * kHopSamples, 0.0f);
+    reset();
+}
+
+void FeatureExtractor::reset()
+{
+    readPos_ = 0;
+    fill_ = 0;
+}
+
+void FeatureExtractor::push(const float* samples, size_t count)
+{
+    if (fill_ + count > buffer_.size())
+    {
+        std::copy(buffer_.begin() + static_cast<std::ptrdiff_t>(readPos_),
+                  buffer_.begin() + static_cast<std::ptrdiff_t>(fill_),
+                  buffer_.begin());
+        fill_ -= readPos_;
+        readPos_ = 0;
+    }
+
+    while (fill_ + count > buffer_.size())
+    {
+        // Falling behind: drop the oldest hops rather than growing.
+        const size_t drop = std::min(fill_, kHopSamples);
+        std::copy(buffer_.begin() + static_cast<std::ptrdiff_t>(drop),
+                  buffer_.begin() + static_cast<std::ptrdiff_t>(fill_),
+                  buffer_.begin());
+        fill_ -= drop;
+        if (drop == 0)
+        {
+            samples += count - buffer_.size();
+            count = buffer_.size();
+        }
+    }
+
+    std::copy(samples, samples + count, buffer_.begin() + static_cast<std::ptrdiff_t>(fill_));
+    fill_ += count;
+}
+
+size_t FeatureExtractor::pendingFrames() const noexcept
+{
+    const size_t available = fill_ - readPos_;
+    return available < kFrameSamples ? 0 : 1 + (available - kFrameSamples) / kHopSamples;
+}
+
+void FeatureExtractor::discardBacklog(size_t keepFrames)
+{
+    const size_t pending = pendingFrames();
+    if (pending > keepFrames)
+    {
+        readPos_ += (pending - keepFrames) * kHopSamples;
+    }
+}
+
+bool FeatureExtractor::nextFrame(FeatureFrame& frame)
+{
+    if (pendingFrames() == 0)
+    {
+        return false;
+    }
+
+    frame = analyse(buffer_.data() + readPos_);
+    readPos_ += kHopSamples;
+    return true;
+}
+
+FeatureFrame FeatureExtractor::analyse(const float* window)
+{
+    FeatureFrame frame;
+
+    float sumSquares = 0.0f;
+    for (size_t i = 0; i < kFrameSamples; ++i)
+    {
+        const float windowed = window[i] * hann_[i];
+        fftInput_[i] = windowed;
+        sumSquares += window[i] * window[i];
+    }
+    std::fill(fftInput_.begin() + static_cast<std::ptrdiff_t>(kFrameSamples), fftInput_.end(), 0.0f);
+    frame.energyDb = 10.0f * std::log10(sumSquares / static_cast<float>(kFrameSamples) + 1.0e-10f);
+
+    fft_.forwardReal(fftInput_.data(), spectrum_.data());
+    for (auto& bin : spectrum_)
+    {
+        bin = {std::norm(bin), 0.0f};
+    }
+
+    for (size_t band = 0; band < kNumMelBands; ++band)
+    {
+        const auto& melBand = melBands_[band];
+        float energy = 1.0e-10f;
+        for (size_t w = 0; w < melBand.numWeights; ++w)
+        {
+            energy += melWeights_[melBand.weightOffset + w] * spectrum_[melBand.firstBin + w].real();
+        }
+        logMel_[band] = std::log(energy);
+    }
+    for (size_t m = 0; m < kNumMfcc; ++m)
+    {
+        float sum = 0.0f;
+        for (size_t band = 0; band < kNumMelBands; ++band)
+        {
+            sum += dctTable_[m * kNumMelBands + band] * logMel_[band];
+        }
+        frame.mfcc[m] = sum / static_cast<float>(kNumMelBands);
+    }
+
+    // The inverse transform of the power spectrum is the (zero-padded, linear) autocorrelation.
+    fft_.inverseReal(spectrum_.data(), autocorrelation_.data());
+    const float zeroLag = autocorrelation_[0];
+    if (zeroLag > 1.0e-9f)
+    {
+        const auto minLag = static_cast<size_t>(sampleRate_ / kMaxPitchHz);
+        const auto maxLag = std::min(static_cast<size_t>(sampleRate_ / kMinPitchHz), kFrameSamples - 1);
+        size_t bestLag = 0;
+        float best = 0.0f;
+        for (size_t lag = minLag; lag <= maxLag; ++lag)
+        {
+            const float r = autocorrelation_[lag] / zeroLag;
+            if (r > best)
+            {
+                best = r;
+                bestLag = lag;
+            }
+        }
+
+        frame.voicing = std::clamp(best, 0.0f, 1.0f);
+        if (bestLag > 0 && frame.voicing >= kVoicedThreshold)
+        {
+            const float hz = static_cast<float>(sampleRate_) / static_cast<float>(bestLag);
+            frame.pitchSemitones = 12.0f * std::log2(hz / kReferenceHz);
+        }
+    }
+
+    return frame;
+}
+
+GuideFeatureTrack FeatureExtractor::analyseGuide(const float* samples, size_t count)
+{
+    GuideFeatureTrack track;
+    track.hopSeconds = hopSeconds();
+    if (count < kFrameSamples)
+    {
+        return track;
+    }
+
+    const size_t numFrames = 1 + (count - kFrameSamples) / kHopSamples;
+    track.frames.reserve(numFrames);
+    float peakDb = -100.0f;
+    for (size_t i = 0; i < numFrames; ++i)
+    {
+        track.frames.push_back(analyse(samples + i * kHopSamples));
+        peakDb = std::max(peakDb, track.frames.back().energyDb);
+    }
+
+    const float activeDb = std::max(kActiveFloorDb, peakDb - kActiveRangeDb);
+    track.active.resize(numFrames);
+    for (size_t i = 0; i < numFrames; ++i)
+    {
+        track.active[i] = track.frames[i].energyDb >= activeDb ? 1 : 0;
+    }
+
+    track.nextOnset.assign(numFrames, -1);
+    std::vector<uint8_t> isOnset(numFrames, 0);
+    size_t silentRun = kOnsetGapFrames;
+    for (size_t i = 0; i < numFrames; ++i)
+    {
+        if (track.active[i] != 0)
+        {
+            isOnset[i] = silentRun >= kOnsetGapFrames ? 1 : 0;
+            silentRun = 0;
+        }
+        else
+        {
+            ++silentRun;
+        }
+    }
+
+    int32_t next = -1;
+    for (size_t i = numFrames; i-- > 0;)
+    {
+        if (isOnset[i] != 0)
+        {
+            next = static_cast<int32_t>(i);
+        }
+        track.nextOnset[i] = next;
+    }
+
+    return track;
+}
+} // namespace singwithme::dsp
@@ -0,0 +1,154 @@
+#include "dsp/Fft.h"
+
+#include <cmath>
+#include <utility>
+
+namespace singwithme::dsp
+{
+namespace
+{
+constexpr double kTwoPi = 6.28318530717958647692;
+
+void buildTables(size_t size, std::vector<size_t>& bitReverse, std::vector<std::complex<float>>& twiddles)
+{
+    bitReverse.assign(size, 0);
+    size_t bits = 0;
+    while ((static_cast<size_t>(1) << bits) < size)
+    {
+        ++bits;
+    }
+    for (size_t i = 0; i < size; ++i)
+    {
+        size_t reversed = 0;
+        for (size_t b = 0; b < bits; ++b)
+        {
+            reversed |= ((i >> b) & 1u) << (bits - 1 - b);
+        }
+        bitReverse[i] = reversed;
+    }
+
+    twiddles.resize(size / 2);
+    for (size_t k = 0; k < size / 2; ++k)
+    {
+        const double angle = -kTwoPi * static_cast<double>(k) / static_cast<double>(size);
+        twiddles[k] = {static_cast<float>(std::cos(angle)), static_cast<float>(std::sin(angle))};
+    }
+}
+} // namespace
+
+void Fft::prepare(size_t size)
+{
+    size_t rounded = 4;
+    while (rounded < size)
+    {
+        rounded <<= 1;
+    }
+
+    size_ = rounded;
+    buildTables(size_, bitReverse_, twiddles_);
+    buildTables(size_ / 2, halfBitReverse_, halfTwiddles_);
+
+    realTwiddles_.resize(size_ / 2);
+    for (size_t k = 0; k < size_ / 2; ++k)
+    {
+        const double angle = -kTwoPi * static_cast<double>(k) / static_cast<double>(size_);
+        realTwiddles_[k] = {static_cast<float>(std::cos(angle)), static_cast<float>(std::sin(angle))};
+    }
+    scratch_.assign(size_ / 2, {});
+}
+
+void Fft::forward(std::complex<float>* data) const
+{
+    transform(data, size_, bitReverse_, twiddles_, false);
+}
+
+void Fft::inverse(std::complex<float>* data) const
+{
+    transform(data, size_, bitReverse_, twiddles_, true);
+    const float scale = 1.0f / static_cast<float>(size_);
+    for (size_t i = 0; i < size_; ++i)
+    {
+        data[i] *= scale;
+    }
+}
+
+void Fft::forwardReal(const float* input, std::complex<float>* spectrum)
+{
+    const size_t half = size_ / 2;
+    for (size_t n = 0; n < half; ++n)
+    {
+        scratch_[n] = {input[2 * n], input[2 * n + 1]};
+    }
+    transform(scratch_.data(), half, halfBitReverse_, halfTwiddles_, false);
+
+    // Split the packed even/odd spectra: X[k] = E[k] + W^k O[k].
+    spectrum[0] = {scratch_[0].real() + scratch_[0].imag(), 0.0f};
+    spectrum[half] = {scratch_[0].real() - scratch_[0].imag(), 0.0f};
+    for (size_t k = 1; k < half; ++k)
+    {
+        const std::complex<float> z = scratch_[k];
+        const std::complex<float> zc = std::conj(scratch_[half - k]);
+        const std::complex<float> even = 0.5f * (z + zc);
+        const std::complex<float> odd = std::complex<float>(0.0f, -0.5f) * (z - zc);
+        spectrum[k] = even + realTwiddles_[k] * odd;
+    }
+}
+
+void Fft::inverseReal(const std::complex<float>* spectrum, float* output)
+{
+    const size_t half = size_ / 2;
+    for (size_t k = 0; k < half; ++k)
+    {
+        const std::complex<float> x = spectrum[k];
+        const std::complex<float> xc = std::conj(spectrum[half - k]);
+        const std::complex<float> even = 0.5f * (x + xc);
+        const std::complex<float> odd = 0.5f * (x - xc) * std::conj(realTwiddles_[k]);
+        scratch_[k] = even + std::complex<float>(0.0f, 1.0f) * odd;
+    }
+    transform(scratch_.data(), half, halfBitReverse_, halfTwiddles_, true);
+
+    const float scale = 1.0f / static_cast<float>(half);
+    for (size_t n = 0; n < half; ++n)
+    {
+        output[2 * n] = scratch_[n].real() * scale;
+        output[2 * n + 1] = scratch_[n].imag() * scale;
+    }
+}
+
+void Fft::transform(std::complex<float>* data,
+                    size_t size,
+                    const std::vector<size_t>& bitReverse,
+                    const std::vector<std::complex<float>>& twiddles,
+                    bool inverse)
+{
+    for (size_t i = 0; i < size; ++i)
+    {
+        const size_t j = bitReverse[i];
+        if (j > i)
+        {
+            std::swap(data[i], data[j]);
+        }
+    }
+
+    for (size_t length = 2; length <= size; length <<= 1)
+    {
+        const size_t halfLength = length / 2;
+        const size_t stride = size / length;
+        for (size_t start = 0; start < size; start += length)
+        {
+            for (size_t k = 0; k < halfLength; ++k)
+            {
+                std::complex<float> w = twiddles[k * stride];
+                if (inverse)
+                {
+                    w = std::conj(w);
+                }
+                const std::complex<float> even = data[start + k];
+                const std::complex<float> odd = data[start + k + halfLength] * w;
+                data[start + k] = even + odd;
+                data[start + k + halfLength] = even - odd;
+            }
+        }
+    }
+}
+} // namespace singwithme::dsp
@@ -0,0 +1,104 @@
+#include "dsp/GuideEnvelope.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace singwithme::dsp
+{
+namespace
+{
+constexpr float kGuideFloor = 0.05f;
+constexpr float kStrengthBlendBase = 0.25f;
+constexpr float kStrengthBlendScale = 0.75f;
+// The gate counts as lifted once it is this far from the duck level towards 0 dB.
+constexpr float kGateLifted = 0.6f;
+constexpr float kNoiseGateRiseMs = 21.0f;
+constexpr float kNoiseGateFallMs = 265.0f;
+constexpr float kNoiseGateHoldMs = 32.0f;
+constexpr float kAttackMs = 20.0f;
+constexpr float kMinReleaseMs = 10.0f;
+constexpr float kMinHoldMs = 10.0f;
+constexpr float kTailRiseMs = 52.0f;
+// The tail send falls over this many reverb tails.
+constexpr float kTailFallScale = 8.0f;
+constexpr float kMaxTailMix = 0.4f;
+
+float smoothing(float elapsedMs, float timeConstantMs) noexcept
+{
+    return 1.0f - std::exp(-elapsedMs / std::max(timeConstantMs, 1.0e-3f));
+}
+} // namespace
+
+void GuideEnvelope::configure(double sampleRate, GuideEnvelopeConfig config)
+{
+    sampleRate_ = sampleRate;
+    config_ = config;
+    reset();
+}
+
+void GuideEnvelope::reset() noexcept
+{
+    noiseGate_ = 0.0f;
+    noiseGateHoldMs_ = 0.0f;
+    envelope_ = 0.0f;
+    releaseHoldMs_ = 0.0f;
+    tailFollower_ = 0.0f;
+}
+
+GuideEnvelope::Levels GuideEnvelope::update(size_t numSamples,
+                                            float peak,
+                                            float gainDb,
+                                            float confidence,
+                                            float vocalStrength,
+                                            bool playing) noexcept
+{
+    const auto elapsedMs = static_cast<float>(static_cast<double>(numSamples) * 1000.0 / sampleRate_);
+    const float duckDb = std::min(config_.duckDb, -1.0e-3f);
+    const float gate = std::clamp((gainDb - duckDb) / -duckDb, 0.0f, 1.0f);
+
+    // Noise gate: open while the singer is above the floor or the gate is lifted, held
+    // briefly after both drop so consonants do not chop the guide.
+    const bool amplitudeOpen = peak > config_.noiseFloor;
+    if (amplitudeOpen || gate >= kGateLifted)
+    {
+        noiseGateHoldMs_ = kNoiseGateHoldMs;
+    }
+    else
+    {
+        noiseGateHoldMs_ = std::max(0.0f, noiseGateHoldMs_ - elapsedMs);
+    }
+    const float noiseTarget = std::max(noiseGateHoldMs_ > 0.0f || amplitudeOpen ? 1.0f : 0.0f, gate);
+    const float noiseMs = noiseTarget > noiseGate_ ? kNoiseGateRiseMs : kNoiseGateFallMs;
+    noiseGate_ = std::clamp(noiseGate_ + smoothing(elapsedMs, noiseMs) * (noiseTarget - noiseGate_), 0.0f, 1.0f);
+
+    const float target = (playing ? gate : 0.0f) * noiseGate_;
+    if (target >= envelope_)
+    {
+        envelope_ += smoothing(elapsedMs, kAttackMs) * (target - envelope_);
+        releaseHoldMs_ = std::max(kMinHoldMs, config_.holdMs);
+    }
+    else if (releaseHoldMs_ > 0.0f)
+    {
+        releaseHoldMs_ = std::max(0.0f, releaseHoldMs_ - elapsedMs);
+    }
+    else
+    {
+        const float releaseMs = std::max(kMinReleaseMs, config_.releaseMs)
+                                / std::max(1.0e-3f, 1.0f - config_.releaseMod * std::clamp(confidence, 0.0f, 1.0f));
+        envelope_ += smoothing(elapsedMs, releaseMs) * (target - envelope_);
+    }
+    envelope_ = std::clamp(envelope_, 0.0f, 1.0f);
+
+    const float envelope = std::max(kGuideFloor, envelope_);
+    const float blend = std::clamp(kStrengthBlendBase + vocalStrength * kStrengthBlendScale, 0.0f, 1.0f);
+
+    const float tailMs = envelope >= tailFollower_ ? kTailRiseMs : kTailFallScale * 1000.0f * std::max(0.05f, config_.tailSeconds);
+    tailFollower_ = std::clamp(tailFollower_ + smoothing(elapsedMs, tailMs) * (envelope - tailFollower_), 0.0f, 1.0f);
+
+    if (!playing)
+    {
+        return {};
+    }
+    return {envelope * blend, std::clamp(config_.tailMix * tailFollower_ * tailFollower_, 0.0f, kMaxTailMix)};
+}
+} // namespace singwithme::dsp
@@ -0,0 +1,107 @@
+#include "dsp/InferenceScheduler.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "dsp/Simd.h"
+
+namespace singwithme::dsp
+{
+namespace
+{
+constexpr float kSilenceMarginDb = 6.0f;
+constexpr float kBorderlineMarginDb = 15.0f;
+constexpr float kNoiseLikeZcr = 0.3f; // fraction of sign changes typical of hiss/fricatives
+constexpr float kMinMeanSquare = 1.0e-12f;
+} // namespace
+
+void InferenceScheduler::prepare(Settings settings)
+{
+    settings_ = settings;
+    settings_.thinInterval = std::max(1, settings_.thinInterval);
+    reset();
+}
+
+void InferenceScheduler::reset() noexcept
+{
+    lastMeanSquare_ = 0.0f;
+    silentRun_ = 0;
+    skippedRun_ = 0;
+    thinCounter_ = 0;
+}
+
+void InferenceScheduler::setNoiseFloorDb(float noiseFloorDb) noexcept
+{
+    noiseFloorDb_.store(noiseFloorDb, std::memory_order_relaxed);
+}
+
+float InferenceScheduler::skippedPercent() const noexcept
+{
+    const auto seen = framesSeen();
+    return seen == 0 ? 0.0f : 100.0f * static_cast<float>(framesSkipped()) / static_cast<float>(seen);
+}
+
+InferenceScheduler::Activity InferenceScheduler::classify(const float* samples, size_t count) noexcept
+{
+    if (samples == nullptr || count == 0)
+    {
+        lastMeanSquare_ = 0.0f;
+        return Activity::Silent;
+    }
+
+    lastMeanSquare_ = simd::sumOfSquares(samples, count) / static_cast<float>(count);
+    const float levelDb = 10.0f * std::log10(std::max(lastMeanSquare_, kMinMeanSquare));
+    const float snrDb = levelDb - noiseFloorDb_.load(std::memory_order_relaxed);
+    if (snrDb < kSilenceMarginDb)
+    {
+        return Activity::Silent;
+    }
+
+    const float zcr = static_cast<float>(simd::zeroCrossings(samples, count)) / static_cast<float>(count);
+    if (snrDb < kBorderlineMarginDb || zcr > kNoiseLikeZcr)
+    {
+        return Activity::Borderline;
+    }
+    return Activity::Active;
+}
+
+InferenceDecision InferenceScheduler::next(const float* samples, size_t count) noexcept
+{
+    framesSeen_.fetch_add(1, std::memory_order_relaxed);
+    const auto activity = classify(samples, count);
+
+    bool run = true;
+    if (activity == Activity::Silent)
+    {
+        ++silentRun_;
+        run = silentRun_ <= settings_.hangoverFrames;
+        thinCounter_ = 0;
+    }
+    else
+    {
+        silentRun_ = 0;
+        if (activity == Activity::Borderline)
+        {
+            // The counter restarts on silence and on active frames, so the first borderline
+            // frame after either always runs; later ones are thinned.
+            run = thinCounter_ % settings_.thinInterval == 0;
+            ++thinCounter_;
+        }
+        else
+        {
+            thinCounter_ = 0;
+        }
+    }
+
+    if (!run)
+    {
+        ++skippedRun_;
+        framesSkipped_.fetch_add(1, std::memory_order_relaxed);
+        return InferenceDecision::Skip;
+    }
+
+    const bool stale = settings_.stateResetFrames > 0 && skippedRun_ >= settings_.stateResetFrames;
+    skippedRun_ = 0;
+    return stale ? InferenceDecision::ResetAndRun : InferenceDecision::Run;
+}
+} // namespace singwithme::dsp
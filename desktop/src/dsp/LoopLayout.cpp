@@ -0,0 +1,141 @@
+#include "dsp/LoopLayout.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace singwithme::dsp
+{
+namespace
+{
+constexpr double kHalfPi = 1.57079632679489661923;
+} // namespace
+
+int64_t PlaybackSpan::position(int64_t offset) const noexcept
+{
+    if (offset < 0)
+    {
+        return -1;
+    }
+    if (!looping())
+    {
+        return origin + offset;
+    }
+    const int64_t period = loopEnd - loopStart;
+    return loopStart + (origin - loopStart + offset) % period;
+}
+
+int64_t PlaybackSpan::distanceTo(int64_t offset, int64_t target) const noexcept
+{
+    const int64_t current = position(offset);
+    if (current < 0)
+    {
+        return -1;
+    }
+    if (!looping())
+    {
+        return target >= current ? target - current : -1;
+    }
+    if (target < loopStart || target >= loopEnd)
+    {
+        return -1;
+    }
+    const int64_t period = loopEnd - loopStart;
+    return ((target - current) % period + period) % period;
+}
+
+int64_t PlaybackSpan::bufferLength(int64_t songLength) const noexcept
+{
+    return looping() ? loopEnd - loopStart : std::max<int64_t>(0, songLength - origin);
+}
+
+void LoopLayout::prepare(size_t crossfadeSamples)
+{
+    fadeIn_.resize(crossfadeSamples);
+    for (size_t i = 0; i < crossfadeSamples; ++i)
+    {
+        fadeIn_[i] = static_cast<float>(std::sin(kHalfPi * (static_cast<double>(i) + 0.5) / static_cast<double>(crossfadeSamples)));
+    }
+}
+
+int64_t LoopLayout::crossfadeLength(const PlaybackSpan& span) const noexcept
+{
+    if (!span.looping())
+    {
+        return 0;
+    }
+    return std::min({static_cast<int64_t>(fadeIn_.size()), (span.loopEnd - span.loopStart) / 2, span.loopStart});
+}
+
+int64_t LoopLayout::crossfadeStart(const PlaybackSpan& span) const noexcept
+{
+    return span.loopEnd - crossfadeLength(span);
+}
+
+float LoopLayout::crossfaded(const float* stem, int64_t stemLength, const PlaybackSpan& span, int64_t position) const noexcept
+{
+    // A fade shorter than the table (a short loop) reads it at a coarser step.
+    const int64_t length = crossfadeLength(span);
+    const int64_t i = position - (span.loopEnd - length);
+    const auto table = static_cast<int64_t>(fadeIn_.size());
+    const float fadeIn = fadeIn_[static_cast<size_t>(i * table / length)];
+    const float fadeOut = fadeIn_[static_cast<size_t>((length - 1 - i) * table / length)];
+    const int64_t incoming = span.loopStart - length + i;
+    const float outgoingSample = position < stemLength ? stem[position] : 0.0f;
+    const float incomingSample = incoming >= 0 && incoming < stemLength ? stem[incoming] : 0.0f;
+    return outgoingSample * fadeOut + incomingSample * fadeIn;
+}
+
+void LoopLayout::render(const float* stem,
+                        int64_t stemLength,
+                        const PlaybackSpan& span,
+                        int64_t offset,
+                        float* out,
+                        int64_t count) const noexcept
+{
+    const int64_t fadeStart = span.looping() ? crossfadeStart(span) : std::numeric_limits<int64_t>::max();
+    for (int64_t k = 0; k < count;)
+    {
+        if (offset + k < 0)
+        {
+            const int64_t run = std::min(count - k, -(offset + k));
+            std::fill(out + k, out + k + run, 0.0f);
+            k += run;
+            continue;
+        }
+
+        const int64_t position = span.position(offset + k);
+        if (position >= fadeStart)
+        {
+            const int64_t run = std::min(count - k, span.loopEnd - position);
+            for (int64_t i = 0; i < run; ++i)
+            {
+                out[k + i] = crossfaded(stem, stemLength, span, position + i);
+            }
+            k += run;
+            continue;
+        }
+
+        // Straight copy up to the crossfade, the loop's wrap or the stem's end.
+        const int64_t run = std::min(count - k, fadeStart - position);
+        const int64_t copied = std::clamp<int64_t>(stemLength - position, 0, run);
+        if (copied > 0)
+        {
+            std::copy(stem + position, stem + position + copied, out + k);
+        }
+        std::fill(out + k + copied, out + k + run, 0.0f);
+        k += run;
+    }
+}
+
+int64_t LoopLayout::directRead(const PlaybackSpan& span, int64_t offset, int64_t count, int64_t stemLength) const noexcept
+{
+    if (offset < 0)
+    {
+        return -1;
+    }
+    const int64_t position = span.position(offset);
+    const int64_t limit = span.looping() ? std::min(stemLength, crossfadeStart(span)) : stemLength;
+    return position + count <= limit ? position : -1;
+}
+} // namespace singwithme::dsp
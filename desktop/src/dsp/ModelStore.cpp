@@ -0,0 +1,184 @@
+#include "dsp/ModelStore.h"
+
+#if TUNETRIX_ONNX_RUNTIME
+
+#include <filesystem>
+#include <stdexcept>
+#include <system_error>
+
+#ifdef _WIN32
+ #ifndef NOMINMAX
+  #define NOMINMAX
+ #endif
+ #include <windows.h>
+#else
+ #include <fcntl.h>
+ #include <sys/mman.h>
+ #include <sys/stat.h>
+ #include <unistd.h>
+#endif
+
+namespace singwithme::dsp
+{
+namespace
+{
+constexpr const char* kOrtFormatExtension = ".ort";
+
+// The ORT-format sibling if one was converted next to the model, otherwise the model itself.
+std::filesystem::path resolveModel(const std::string& modelPath)
+{
+    std::error_code error;
+    std::filesystem::path path = std::filesystem::weakly_canonical(modelPath, error);
+    if (error)
+    {
+        path = modelPath;
+    }
+    if (path.extension() != kOrtFormatExtension)
+    {
+        auto ortPath = path;
+        ortPath.replace_extension(kOrtFormatExtension);
+        if (std::filesystem::is_regular_file(ortPath, error))
+        {
+            return ortPath;
+        }
+    }
+    return path;
+}
+} // namespace
+
+Ort::Env& sharedOrtEnvironment()
+{
+    // Inference runs on the calling thread, as with the previous one-thread session
+    // pools; the global pools only replace those per-session pools.
+    static Ort::Env env = []
+    {
+        Ort::ThreadingOptions threading;
+        threading.SetGlobalIntraOpNumThreads(1);
+        threading.SetGlobalInterOpNumThreads(1);
+        threading.SetGlobalSpinControl(0);
+        return Ort::Env{threading, ORT_LOGGING_LEVEL_WARNING, "TuneTrix"};
+    }();
+    return env;
+}
+
+std::shared_ptr<const MappedModel> MappedModel::open(const std::string& path)
+{
+    std::shared_ptr<MappedModel> model(new MappedModel());
+    model->path_ = path;
+#ifdef _WIN32
+    const std::wstring widePath = std::filesystem::path(path).wstring();
+    HANDLE file = CreateFileW(widePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        throw std::runtime_error("Cannot open model " + path);
+    }
+    model->file_ = file;
+    LARGE_INTEGER size{};
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+    {
+        throw std::runtime_error("Empty model " + path);
+    }
+    model->mapping_ = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (model->mapping_ == nullptr)
+    {
+        throw std::runtime_error("Cannot map model " + path);
+    }
+    model->data_ = MapViewOfFile(model->mapping_, FILE_MAP_READ, 0, 0, 0);
+    model->size_ = static_cast<size_t>(size.QuadPart);
+#else
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        throw std::runtime_error("Cannot open model " + path);
+    }
+    struct stat info{};
+    if (::fstat(fd, &info) != 0 || info.st_size <= 0)
+    {
+        ::close(fd);
+        throw std::runtime_error("Empty model " + path);
+    }
+    void* data = ::mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (data != MAP_FAILED)
+    {
+        model->data_ = data;
+        model->size_ = static_cast<size_t>(info.st_size);
+    }
+#endif
+    if (model->data_ == nullptr)
+    {
+        throw std::runtime_error("Cannot map model " + path);
+    }
+    return model;
+}
+
+MappedModel::~MappedModel()
+{
+#ifdef _WIN32
+    if (data_ != nullptr)
+    {
+        UnmapViewOfFile(data_);
+    }
+    if (mapping_ != nullptr)
+    {
+        CloseHandle(mapping_);
+    }
+    if (file_ != nullptr)
+    {
+        CloseHandle(file_);
+    }
+#else
+    if (data_ != nullptr)
+    {
+        ::munmap(const_cast<void*>(data_), size_);
+    }
+#endif
+}
+
+ModelStore& ModelStore::instance()
+{
+    static ModelStore store;
+    return store;
+}
+
+ModelSession ModelStore::openSession(Ort::Env& env, const std::string& modelPath, Ort::SessionOptions& options)
+{
+    const auto path = resolveModel(modelPath);
+    ModelSession result;
+    {
+        const std::lock_guard<std::mutex> lock(mutex_);
+        auto& entry = models_[path.string()];
+        result.model = entry.lock();
+        if (result.model == nullptr)
+        {
+            result.model = MappedModel::open(path.string());
+            entry = result.model;
+        }
+    }
+
+    if (&env == &sharedOrtEnvironment())
+    {
+        options.DisablePerSessionThreads();
+    }
+    if (path.extension() == kOrtFormatExtension)
+    {
+        options.AddConfigEntry("session.use_ort_model_bytes_directly", "1");
+        options.AddConfigEntry("session.use_ort_model_bytes_for_initializers", "1");
+    }
+    result.session = std::make_unique<Ort::Session>(env, result.model->data(), result.model->size(), options, prepackedWeights_);
+    return result;
+}
+} // namespace singwithme::dsp
+
+#else
+
+namespace singwithme::dsp
+{
+Ort::Env& sharedOrtEnvironment()
+{
+    static Ort::Env env{};
+    return env;
+}
+} // namespace singwithme::dsp
+
+#endif
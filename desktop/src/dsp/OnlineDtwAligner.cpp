@@ -0,0 +1,163 @@
+#include "dsp/OnlineDtwAligner.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace singwithme::dsp
+{
+namespace
+{
+constexpr float kInfinity = std::numeric_limits<float>::infinity();
+constexpr float kVoicedThreshold = 0.45f;
+constexpr float kEnergyFloorDb = -80.0f;
+constexpr float kEnergyScaleDb = 20.0f;
+constexpr float kMfccScale = 5.0f;
+constexpr float kEnergyWeight = 0.4f;
+constexpr float kTimbreWeight = 0.3f;
+constexpr float kPitchWeight = 0.3f;
+constexpr float kReentryPenalty = 1.0f;
+} // namespace
+
+void OnlineDtwAligner::prepare(int bandRadius)
+{
+    bandRadius_ = std::max(1, bandRadius);
+    const auto width = static_cast<size_t>(2 * bandRadius_ + 1);
+    previous_.assign(width, kInfinity);
+    current_.assign(width, kInfinity);
+    reset();
+}
+
+void OnlineDtwAligner::reset()
+{
+    std::fill(previous_.begin(), previous_.end(), kInfinity);
+    previousCentre_ = 0;
+    primed_ = false;
+}
+
+OnlineDtwAligner::Step OnlineDtwAligner::step(const FeatureFrame& live,
+                                              const GuideFeatureTrack& reference,
+                                              int64_t expectedFrame)
+{
+    const auto numReference = static_cast<int64_t>(reference.frames.size());
+    if (numReference == 0)
+    {
+        return {};
+    }
+
+    if (primed_ && std::abs(expectedFrame - previousCentre_) > bandRadius_)
+    {
+        // Seek, loop or song change: the old column no longer overlaps the band.
+        reset();
+    }
+
+    float previousMin = kInfinity;
+    if (primed_)
+    {
+        previousMin = *std::min_element(previous_.begin(), previous_.end());
+    }
+
+    const int64_t first = expectedFrame - bandRadius_;
+    const int64_t previousFirst = previousCentre_ - bandRadius_;
+    const auto width = static_cast<int64_t>(current_.size());
+    float columnMin = kInfinity;
+    int64_t columnArgMin = -1;
+    float costAtMin = 1.0f;
+
+    for (int64_t i = 0; i < width; ++i)
+    {
+        const int64_t j = first + i;
+        if (j < 0 || j >= numReference)
+        {
+            current_[static_cast<size_t>(i)] = kInfinity;
+            continue;
+        }
+
+        const float cost = distance(live, reference.frames[static_cast<size_t>(j)]);
+        float best = kInfinity;
+        if (primed_)
+        {
+            const int64_t p = j - previousFirst;
+            if (p >= 0 && p < width)
+            {
+                best = std::min(best, previous_[static_cast<size_t>(p)]);
+            }
+            if (p - 1 >= 0 && p - 1 < width)
+            {
+                best = std::min(best, previous_[static_cast<size_t>(p - 1)]);
+            }
+            if (i > 0)
+            {
+                best = std::min(best, current_[static_cast<size_t>(i - 1)]);
+            }
+            if (best == kInfinity)
+            {
+                best = previousMin == kInfinity ? 0.0f : previousMin + kReentryPenalty;
+            }
+        }
+        else
+        {
+            best = 0.0f;
+        }
+
+        const float total = cost + best;
+        current_[static_cast<size_t>(i)] = total;
+        if (total < columnMin)
+        {
+            columnMin = total;
+            columnArgMin = j;
+            costAtMin = cost;
+        }
+    }
+
+    if (columnArgMin < 0)
+    {
+        reset();
+        return {};
+    }
+
+    // Keep accumulated costs bounded; subtracting the column minimum does not move the path.
+    for (auto& value : current_)
+    {
+        if (value != kInfinity)
+        {
+            value -= columnMin;
+        }
+    }
+
+    std::swap(previous_, current_);
+    previousCentre_ = expectedFrame;
+    primed_ = true;
+    return {columnArgMin, costAtMin};
+}
+
+float OnlineDtwAligner::distance(const FeatureFrame& live, const FeatureFrame& reference)
+{
+    const float liveDb = std::max(live.energyDb, kEnergyFloorDb);
+    const float referenceDb = std::max(reference.energyDb, kEnergyFloorDb);
+    const float energy = std::min(1.0f, std::abs(liveDb - referenceDb) / kEnergyScaleDb);
+
+    float timbre = 0.0f;
+    for (size_t m = 0; m < kNumMfcc; ++m)
+    {
+        timbre += std::abs(live.mfcc[m] - reference.mfcc[m]);
+    }
+    timbre = std::min(1.0f, timbre / (kMfccScale * static_cast<float>(kNumMfcc)));
+
+    // Pitch class only, so singing an octave away from the guide still aligns.
+    const bool liveVoiced = live.voicing >= kVoicedThreshold;
+    const bool referenceVoiced = reference.voicing >= kVoicedThreshold;
+    float pitch = 0.0f;
+    if (liveVoiced && referenceVoiced)
+    {
+        const float interval = std::fmod(std::abs(live.pitchSemitones - reference.pitchSemitones), 12.0f);
+        pitch = std::min(interval, 12.0f - interval) / 6.0f;
+    }
+    else if (liveVoiced != referenceVoiced)
+    {
+        pitch = 1.0f;
+    }
+
+    return kEnergyWeight * energy + kTimbreWeight * timbre + kPitchWeight * pitch;
+}
+} // namespace singwithme::dsp
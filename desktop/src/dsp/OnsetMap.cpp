@@ -0,0 +1,158 @@
+#include "dsp/OnsetMap.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace singwithme::dsp
+{
+namespace
+{
+constexpr float kVadOn = 0.5f;
+constexpr float kVadOff = 0.35f;
+constexpr size_t kMinGapHops = 15;     // shorter pauses do not start a new segment
+constexpr size_t kMinSegmentHops = 5;  // blips under 50 ms are ignored
+constexpr size_t kRefineHops = 5;      // how far an onset may move back to the energy rise
+constexpr float kRiseDb = 6.0f;
+constexpr float kReattackDb = 12.0f;
+constexpr size_t kReattackWindowHops = 4;
+constexpr size_t kMinOnsetSpacingHops = 15;
+constexpr float kActiveRangeDb = 35.0f;
+constexpr float kActiveFloorDb = -60.0f;
+} // namespace
+
+OnsetMap OnsetMap::build(const float* vadProbability, const float* energyDb, size_t numHops, double hopSeconds)
+{
+    OnsetMap map;
+    map.hopSeconds_ = hopSeconds;
+    if (numHops == 0)
+    {
+        return map;
+    }
+
+    // Vocal activity segments with hysteresis and a minimum gap, so breaths inside a phrase
+    // do not register as entries.
+    std::vector<std::pair<size_t, size_t>> segments;
+    bool inSegment = false;
+    size_t start = 0;
+    size_t quietHops = 0;
+    for (size_t i = 0; i < numHops; ++i)
+    {
+        const float p = vadProbability[i];
+        if (!inSegment)
+        {
+            if (p >= kVadOn)
+            {
+                inSegment = true;
+                start = i;
+                quietHops = 0;
+            }
+            continue;
+        }
+
+        quietHops = p < kVadOff ? quietHops + 1 : 0;
+        if (quietHops >= kMinGapHops)
+        {
+            segments.emplace_back(start, i + 1 - quietHops);
+            inSegment = false;
+        }
+    }
+    if (inSegment)
+    {
+        segments.emplace_back(start, numHops);
+    }
+
+    float peakDb = -100.0f;
+    for (size_t i = 0; i < numHops; ++i)
+    {
+        peakDb = std::max(peakDb, energyDb[i]);
+    }
+    const float activeDb = std::max(kActiveFloorDb, peakDb - kActiveRangeDb);
+
+    std::vector<uint8_t> isOnset(numHops, 0);
+    size_t previousEnd = 0;
+    for (const auto& [first, last] : segments)
+    {
+        if (last - first < kMinSegmentHops)
+        {
+            continue;
+        }
+
+        // VAD reacts a little late; pull the onset back to where the energy starts rising
+        // above the floor of the preceding gap.
+        float floorDb = energyDb[first];
+        for (size_t i = previousEnd; i < first; ++i)
+        {
+            floorDb = std::min(floorDb, energyDb[i]);
+        }
+        size_t onset = first;
+        const size_t earliest = first > kRefineHops ? std::max(previousEnd, first - kRefineHops) : previousEnd;
+        while (onset > earliest && energyDb[onset - 1] >= floorDb + kRiseDb)
+        {
+            --onset;
+        }
+        isOnset[onset] = 1;
+
+        // Hard re-attacks inside a segment (a new line sung without a pause).
+        size_t lastOnset = onset;
+        for (size_t i = first + kReattackWindowHops; i < last; ++i)
+        {
+            if (i - lastOnset < kMinOnsetSpacingHops || energyDb[i] < activeDb)
+            {
+                continue;
+            }
+            const float dipDb = *std::min_element(energyDb + (i - kReattackWindowHops), energyDb + i);
+            if (energyDb[i] - dipDb >= kReattackDb)
+            {
+                isOnset[i] = 1;
+                lastOnset = i;
+            }
+        }
+        previousEnd = last;
+    }
+
+    map.nextOnset_.assign(numHops, -1);
+    int32_t next = -1;
+    for (size_t i = numHops; i-- > 0;)
+    {
+        if (isOnset[i] != 0)
+        {
+            next = static_cast<int32_t>(i);
+        }
+        map.nextOnset_[i] = next;
+    }
+    for (size_t i = 0; i < numHops; ++i)
+    {
+        if (isOnset[i] != 0)
+        {
+            map.onsets_.push_back(static_cast<int32_t>(i));
+        }
+    }
+    return map;
+}
+
+float OnsetMap::msUntilOnset(double positionSeconds) const noexcept
+{
+    if (nextOnset_.empty())
+    {
+        return -1.0f;
+    }
+
+    const auto hop = positionSeconds <= 0.0 ? size_t{0} : static_cast<size_t>(positionSeconds / hopSeconds_);
+    if (hop >= nextOnset_.size())
+    {
+        return -1.0f;
+    }
+
+    // The onset in the current hop may already have passed; then the answer is one hop on.
+    int32_t onset = nextOnset_[hop];
+    if (onset >= 0 && static_cast<double>(onset) * hopSeconds_ < positionSeconds)
+    {
+        onset = hop + 1 < nextOnset_.size() ? nextOnset_[hop + 1] : -1;
+    }
+    if (onset < 0)
+    {
+        return -1.0f;
+    }
+    return static_cast<float>((static_cast<double>(onset) * hopSeconds_ - positionSeconds) * 1000.0);
+}
+} // namespace singwithme::dsp
@@ -0,0 +1,96 @@
+#include "dsp/PhraseTracker.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace singwithme::dsp
+{
+namespace
+{
+constexpr float kSmoothing = 0.3f;
+constexpr float kCostSlope = 2.0f;
+constexpr float kIdleDecay = 0.9f;
+} // namespace
+
+void PhraseTracker::prepare(double sampleRate, double modelSampleRate, size_t feedLatencySamples, int bandRadiusFrames)
+{
+    sampleRate_ = sampleRate;
+    modelSampleRate_ = modelSampleRate;
+    feedLatencySamples_ = feedLatencySamples;
+    features_.prepare(modelSampleRate_);
+    aligner_.prepare(bandRadiusFrames);
+    reset();
+}
+
+void PhraseTracker::reset()
+{
+    features_.reset();
+    aligner_.reset();
+    latest_ = {};
+}
+
+void PhraseTracker::setReference(const GuideFeatureTrack* track)
+{
+    if (track != reference_)
+    {
+        reference_ = track;
+        aligner_.reset();
+        latest_ = {};
+    }
+}
+
+void PhraseTracker::push(const float* modelSamples, size_t numSamples)
+{
+    features_.push(modelSamples, numSamples);
+}
+
+PhraseEstimate PhraseTracker::process(bool listening, int64_t transportSample)
+{
+    if (reference_ == nullptr || reference_->frames.empty() || !listening)
+    {
+        latest_.phraseAware *= kIdleDecay;
+        latest_.msUntilOnset = -1.0f;
+        return latest_;
+    }
+    features_.discardBacklog(kMaxStepsPerBlock);
+
+    // The newest complete frame is centred half a frame (plus the feed's delay) behind the
+    // end of this block; older pending frames are a hop earlier each.
+    const double hopSeconds = features_.hopSeconds();
+    const double latencySeconds = static_cast<double>(feedLatencySamples_) / sampleRate_
+                                  + 0.5 * static_cast<double>(FeatureExtractor::kFrameSamples) / modelSampleRate_;
+    const double blockEndSeconds = static_cast<double>(transportSample) / sampleRate_;
+
+    FeatureFrame frame;
+    for (size_t step = 0; step < kMaxStepsPerBlock; ++step)
+    {
+        const size_t pending = features_.pendingFrames();
+        if (!features_.nextFrame(frame))
+        {
+            break;
+        }
+
+        const double frameSeconds = blockEndSeconds - latencySeconds - static_cast<double>(pending - 1) * hopSeconds;
+        const auto expectedFrame = static_cast<int64_t>(std::llround(frameSeconds / hopSeconds));
+        const auto aligned = aligner_.step(frame, *reference_, expectedFrame);
+        if (aligned.alignedFrame < 0)
+        {
+            continue;
+        }
+
+        const auto index = static_cast<size_t>(aligned.alignedFrame);
+        const float match = reference_->active[index] != 0 ? std::exp(-kCostSlope * aligned.localCost) : 0.0f;
+        latest_.phraseAware += kSmoothing * (match - latest_.phraseAware);
+        latest_.alignedFrame = aligned.alignedFrame;
+        latest_.micPitchSemitones = frame.pitchSemitones;
+        latest_.guidePitchSemitones = reference_->frames[index].pitchSemitones;
+
+        const int32_t onset = reference_->nextOnset[index];
+        latest_.msUntilOnset = onset >= 0
+                                   ? static_cast<float>(static_cast<double>(onset - aligned.alignedFrame) * hopSeconds * 1000.0)
+                                   : -1.0f;
+    }
+
+    return latest_;
+}
+} // namespace singwithme::dsp
@@ -1,5 +1,7 @@
 #include "dsp/PitchProcessor.h"
 
+#include "trace/Tracer.h"
+
 #if TUNETRIX_ONNX_RUNTIME
 
 #include <algorithm>
@@ -13,6 +15,11 @@ namespace
 constexpr const char* kInputName = "audio";
 constexpr const char* kOutputName = "probabilities";
 constexpr size_t kExpectedHopSamples = 1024; // 64 ms @ 16 kHz
+constexpr size_t kBins = 360;
+constexpr size_t kMaxBatch = 8; // windows per push(); older ones are dropped when more are due
+constexpr float kSkipDecay = 0.5f;
+// CREPE is stateless: one hop of hangover, and borderline hops run every other time.
+constexpr InferenceScheduler::Settings kSchedule{1, 2, 0};
 } // namespace
 
 PitchProcessor::PitchProcessor(Ort::Env& env)
@@ -20,13 +27,95 @@ PitchProcessor::PitchProcessor(Ort::Env& env)
 {
     options_.SetIntraOpNumThreads(1);
     options_.SetGraphOptimizationLevel(GraphOptimizationLevel::ORT_ENABLE_ALL);
+    scheduler_.prepare(kSchedule);
+    setHopSamples(kExpectedHopSamples);
+}
+
+void PitchProcessor::setNoiseFloorDb(float noiseFloorDb)
+{
+    scheduler_.setNoiseFloorDb(noiseFloorDb);
 }
 
 void PitchProcessor::loadModel(const std::string& modelPath)
 {
-    session_ = std::make_unique<Ort::Session>(env_, modelPath.c_str(), options_);
+    session_ = ModelStore::instance().openSession(env_, modelPath, options_);
     inputBuffer_.resize(kExpectedHopSamples);
-    probabilities_.resize(360);
+    probabilities_.resize(kBins);
+
+    // CREPE exports differ: some take [batch, 1024], others a fixed [1, 1024].
+    const auto shape = session_->GetInputTypeInfo(0).GetTensorTypeAndShapeInfo().GetShape();
+    batchedModel_ = shape.size() == 2 && shape[0] < 0;
+}
+
+void PitchProcessor::setHopSamples(size_t hopSamples)
+{
+    window_.prepare(kExpectedHopSamples, hopSamples, kMaxBatch);
+    batchInput_.assign(kMaxBatch * kExpectedHopSamples, 0.0f);
+    batchConfidence_.assign(kMaxBatch, 0.0f);
+    runWindow_.assign(kMaxBatch, 0);
+    pushed_.assign(kMaxBatch, PitchEstimate{});
+    latest_ = {};
+}
+
+size_t PitchProcessor::push(const float* samples, size_t sampleCount)
+{
+    if (!session_)
+    {
+        throw std::runtime_error("Pitch model not loaded");
+    }
+
+    const size_t due = window_.push(samples, sampleCount);
+    size_t rows = 0;
+    for (size_t i = 0; i < due; ++i)
+    {
+        const float* window = window_.window(i);
+        runWindow_[i] = scheduler_.next(window, kExpectedHopSamples) != InferenceDecision::Skip ? 1 : 0;
+        if (runWindow_[i] != 0)
+        {
+            std::copy_n(window, kExpectedHopSamples, batchInput_.begin() + static_cast<std::ptrdiff_t>(rows * kExpectedHopSamples));
+            ++rows;
+        }
+    }
+    if (rows > 0)
+    {
+        runBatch(rows);
+    }
+
+    size_t row = 0;
+    for (size_t i = 0; i < due; ++i)
+    {
+        latest_.confidence = runWindow_[i] != 0 ? batchConfidence_[row++] : latest_.confidence * kSkipDecay;
+        latest_.endSample = window_.windowEnd(i);
+        pushed_[i] = latest_;
+    }
+    lastConfidence_ = latest_.confidence;
+    return due;
+}
+
+void PitchProcessor::runBatch(size_t rows)
+{
+    TUNETRIX_TRACE_ZONE("Pitch inference");
+    TUNETRIX_TRACE_FLOW_END();
+    auto memoryInfo = Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault);
+    const size_t perRun = batchedModel_ ? rows : 1;
+    for (size_t first = 0; first < rows; first += perRun)
+    {
+        std::array<int64_t, 2> shape{static_cast<int64_t>(perRun), static_cast<int64_t>(kExpectedHopSamples)};
+        Ort::Value inputTensor = Ort::Value::CreateTensor<float>(
+            memoryInfo,
+            batchInput_.data() + first * kExpectedHopSamples,
+            perRun * kExpectedHopSamples,
+            shape.data(),
+            shape.size());
+
+        auto outputTensors = session_->Run(Ort::RunOptions{nullptr}, &kInputName, &inputTensor, 1, &kOutputName, 1);
+        const float* probs = outputTensors.front().GetTensorData<float>();
+        const size_t bins = static_cast<size_t>(outputTensors.front().GetTensorTypeAndShapeInfo().GetElementCount()) / perRun;
+        for (size_t r = 0; r < perRun; ++r)
+        {
+            batchConfidence_[first + r] = *std::max_element(probs + r * bins, probs + (r + 1) * bins);
+        }
+    }
 }
 
 float PitchProcessor::processHop(const float* samples, size_t sampleCount)
@@ -36,11 +125,24 @@ float PitchProcessor::processHop(const float* samples, size_t sampleCount)
         throw std::runtime_error("Pitch model not loaded");
     }
 
+    if (streamed_)
+    {
+        return latest_.confidence;
+    }
+
     if (sampleCount != inputBuffer_.size())
     {
         throw std::runtime_error("Unexpected pitch hop length");
     }
 
+    if (scheduler_.next(samples, sampleCount) == InferenceDecision::Skip)
+    {
+        lastConfidence_ *= kSkipDecay;
+        return lastConfidence_;
+    }
+
+    TUNETRIX_TRACE_ZONE("Pitch inference");
+    TUNETRIX_TRACE_FLOW_END();
     std::copy(samples, samples + sampleCount, inputBuffer_.begin());
 
     auto memoryInfo = Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault);
@@ -66,7 +168,8 @@ float PitchProcessor::processHop(const float* samples, size_t sampleCount)
     const auto elementCount = static_cast<size_t>(typeInfo.GetElementCount());
 
     probabilities_.assign(probs, probs + elementCount);
-    return *std::max_element(probabilities_.begin(), probabilities_.end());
+    lastConfidence_ = *std::max_element(probabilities_.begin(), probabilities_.end());
+    return lastConfidence_;
 }
 } // namespace singwithme::dsp
 
@@ -75,6 +178,8 @@ float PitchProcessor::processHop(const float* samples, size_t sampleCount)
 #include <algorithm>
 #include <cmath>
 
+#include "dsp/Simd.h"
+
 namespace singwithme::dsp
 {
 namespace
@@ -83,21 +188,78 @@ constexpr float kSampleRate = 16000.0f;
 constexpr float kMinFrequency = 80.0f;
 constexpr float kMaxFrequency = 500.0f;
 constexpr float kSmoothing = 0.4f;
+constexpr float kSkipDecay = 0.5f;
+constexpr size_t kWindowSamples = 1024;
+constexpr size_t kMaxBatch = 8;
+constexpr InferenceScheduler::Settings kSchedule{1, 2, 0};
 } // namespace
 
+PitchProcessor::PitchProcessor(Ort::Env&)
+{
+    scheduler_.prepare(kSchedule);
+    setHopSamples(kWindowSamples);
+}
+
+void PitchProcessor::setHopSamples(size_t hopSamples)
+{
+    window_.prepare(kWindowSamples, hopSamples, kMaxBatch);
+    // Same smoothing per second of audio whatever the hop.
+    const float hops = static_cast<float>(window_.hopSamples()) / static_cast<float>(kWindowSamples);
+    windowSmoothing_ = 1.0f - std::pow(1.0f - kSmoothing, hops);
+    pushed_.assign(kMaxBatch, PitchEstimate{});
+    latest_ = {};
+}
+
+size_t PitchProcessor::push(const float* samples, size_t sampleCount)
+{
+    const size_t due = window_.push(samples, sampleCount);
+    if (due == 0)
+    {
+        return 0;
+    }
+
+    TUNETRIX_TRACE_ZONE("Pitch inference");
+    TUNETRIX_TRACE_FLOW_END();
+    for (size_t i = 0; i < due; ++i)
+    {
+        latest_.confidence = estimate(window_.window(i), kWindowSamples, windowSmoothing_);
+        latest_.endSample = window_.windowEnd(i);
+        pushed_[i] = latest_;
+    }
+    return due;
+}
+
+void PitchProcessor::setNoiseFloorDb(float noiseFloorDb)
+{
+    scheduler_.setNoiseFloorDb(noiseFloorDb);
+}
+
 float PitchProcessor::processHop(const float* samples, size_t sampleCount)
+{
+    if (streamed_)
+    {
+        return latest_.confidence;
+    }
+
+    TUNETRIX_TRACE_ZONE("Pitch inference");
+    TUNETRIX_TRACE_FLOW_END();
+    return estimate(samples, sampleCount, kSmoothing);
+}
+
+float PitchProcessor::estimate(const float* samples, size_t sampleCount, float smoothing)
 {
     if (samples == nullptr || sampleCount == 0)
     {
         return 0.0f;
     }
 
-    float sumSquares = 0.0f;
-    for (size_t i = 0; i < sampleCount; ++i)
+    if (scheduler_.next(samples, sampleCount) == InferenceDecision::Skip)
     {
-        sumSquares += samples[i] * samples[i];
+        smoothedConfidence_ *= kSkipDecay;
+        return smoothedConfidence_;
     }
 
+    const float sumSquares = simd::sumOfSquares(samples, sampleCount);
     if (sumSquares <= 1.0e-8f)
     {
         smoothedConfidence_ *= 0.5f;
@@ -118,20 +280,14 @@ float PitchProcessor::processHop(const float* samples, size_t sampleCount)
     }
 
     const float confidence = std::clamp(bestCorrelation, 0.0f, 1.0f);
-    smoothedConfidence_ = (kSmoothing * confidence) + ((1.0f - kSmoothing) * smoothedConfidence_);
+    smoothedConfidence_ = (smoothing * confidence) + ((1.0f - smoothing) * smoothedConfidence_);
     return smoothedConfidence_;
 }
 
 float PitchProcessor::estimateAutocorrelation(const float* samples, size_t sampleCount, int lag)
 {
-    float correlation = 0.0f;
     const size_t limit = sampleCount - static_cast<size_t>(lag);
-    for (size_t i = 0; i < limit; ++i)
-    {
-        correlation += samples[i] * samples[i + static_cast<size_t>(lag)];
-    }
-
-    return correlation / static_cast<float>(limit);
+    return simd::dotProduct(samples, samples + lag, limit) / static_cast<float>(limit);
 }
 } // namespace singwithme::dsp
 
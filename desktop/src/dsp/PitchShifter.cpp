@@ -0,0 +1,198 @@
+#include "dsp/PitchShifter.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "dsp/Simd.h"
+
+namespace singwithme::dsp
+{
+namespace
+{
+constexpr double kPi = 3.14159265358979323846;
+// Grain spacing used while the guide is unvoiced, and the shortest period accepted.
+constexpr double kUnvoicedPeriodSeconds = 0.005;
+constexpr double kMinPeriodSeconds = 0.001;
+constexpr double kRatioSmoothingSeconds = 0.03;
+// Pitch marks are searched this fraction of a period either side of the prediction.
+constexpr double kMarkSearchFraction = 0.25;
+// Only reached where grains no longer overlap (long periods shifted down); attenuates there
+// instead of amplifying the window edges.
+constexpr float kMinWindowSum = 0.5f;
+} // namespace
+
+void PitchShifter::prepare(double sampleRate, size_t maxBlockSize)
+{
+    sampleRate_ = sampleRate;
+    maxBlock_ = std::max<size_t>(maxBlockSize, 1);
+    maxHalfGrain_ = std::max<size_t>(static_cast<size_t>(kMaxHalfGrainSeconds * sampleRate), 16);
+    latency_ = 2 * maxHalfGrain_;
+    unvoicedPeriod_ = kUnvoicedPeriodSeconds * sampleRate;
+
+    size_t capacity = 1;
+    while (capacity < 2 * (latency_ + maxBlock_ + 2 * maxHalfGrain_))
+    {
+        capacity <<= 1;
+    }
+    capacity_ = capacity;
+    mask_ = capacity - 1;
+    input_.assign(2 * capacity_, 0.0f);
+    output_.assign(capacity_, 0.0f);
+    weight_.assign(capacity_, 0.0f);
+    window_.assign(2 * maxHalfGrain_, 0.0f);
+    windowHalf_ = 0;
+    reset();
+}
+
+void PitchShifter::reset()
+{
+    std::fill(input_.begin(), input_.end(), 0.0f);
+    std::fill(output_.begin(), output_.end(), 0.0f);
+    std::fill(weight_.begin(), weight_.end(), 0.0f);
+    written_ = 0;
+    // Start so the first grain ends exactly where the first output sample is emitted.
+    synthesisMark_ = static_cast<double>(latency_);
+    analysisMark_ = static_cast<int64_t>(latency_);
+    nextAnalysisMark_ = analysisMark_;
+    ratio_ = targetRatio_;
+}
+
+void PitchShifter::setRatio(double ratio) noexcept
+{
+    targetRatio_ = std::clamp(ratio, kMinRatio, kMaxRatio);
+}
+
+void PitchShifter::setPeriod(double periodSamples) noexcept
+{
+    period_ = periodSamples >= kMinPeriodSeconds * sampleRate_ ? periodSamples : 0.0;
+}
+
+void PitchShifter::process(const float* input, float* output, size_t numSamples) noexcept
+{
+    if (capacity_ == 0 || input == nullptr || output == nullptr)
+    {
+        return;
+    }
+
+    for (size_t offset = 0; offset < numSamples; offset += maxBlock_)
+    {
+        processChunk(input + offset, output + offset, std::min(maxBlock_, numSamples - offset));
+    }
+}
+
+void PitchShifter::processChunk(const float* input, float* output, size_t numSamples) noexcept
+{
+    for (size_t i = 0; i < numSamples; ++i)
+    {
+        const size_t slot = static_cast<size_t>(written_ + static_cast<int64_t>(i)) & mask_;
+        input_[slot] = input[i];
+        input_[slot + capacity_] = input[i];
+    }
+    written_ += static_cast<int64_t>(numSamples);
+
+    // Output sample p leaves latency_ samples after input sample p arrived. Every grain that
+    // reaches into this block's outputs has its source fully written by now.
+    const int64_t end = written_ - static_cast<int64_t>(latency_);
+    const int64_t start = end - static_cast<int64_t>(numSamples);
+    while (std::llround(synthesisMark_) - static_cast<int64_t>(maxHalfGrain_) < end)
+    {
+        placeGrain(start);
+    }
+
+    for (size_t i = 0; i < numSamples; ++i)
+    {
+        const int64_t position = start + static_cast<int64_t>(i);
+        if (position < 0)
+        {
+            output[i] = 0.0f;
+            continue;
+        }
+        const size_t slot = static_cast<size_t>(position) & mask_;
+        // Dividing by the root of the window sum keeps the level roughly constant whether
+        // grains crowd together (shifting up) or spread apart (shifting down).
+        output[i] = output_[slot] / std::sqrt(std::max(weight_[slot], kMinWindowSum));
+        output_[slot] = 0.0f;
+        weight_[slot] = 0.0f;
+    }
+}
+
+void PitchShifter::placeGrain(int64_t emittedUpTo) noexcept
+{
+    const double period = period_ > 0.0 ? period_ : unvoicedPeriod_;
+    const double spacing = period / ratio_;
+    const auto centre = static_cast<int64_t>(std::llround(synthesisMark_));
+
+    // Two periods long, so each grain carries one pitch pulse at its centre. Never reaches
+    // back into outputs that have already been emitted.
+    auto half = std::clamp<int64_t>(std::llround(period), 1, static_cast<int64_t>(maxHalfGrain_));
+    half = std::min(half, centre - emittedUpTo);
+
+    while (nextAnalysisMark_ <= centre)
+    {
+        analysisMark_ = nextAnalysisMark_;
+        nextAnalysisMark_ = findPitchMark(analysisMark_ + std::llround(period), period);
+    }
+    const int64_t source = std::min(analysisMark_, written_ - half);
+
+    if (half > 0)
+    {
+        const auto length = static_cast<size_t>(2 * half);
+        buildWindow(static_cast<size_t>(half));
+        const float* grain = input_.data() + (static_cast<size_t>(source - half) & mask_);
+        const size_t first = static_cast<size_t>(centre - half) & mask_;
+        const size_t head = std::min(length, capacity_ - first);
+        simd::multiplyAccumulate(window_.data(), grain, output_.data() + first, head);
+        simd::accumulate(window_.data(), weight_.data() + first, head);
+        if (head < length)
+        {
+            simd::multiplyAccumulate(window_.data() + head, grain + head, output_.data(), length - head);
+            simd::accumulate(window_.data() + head, weight_.data(), length - head);
+        }
+    }
+
+    synthesisMark_ += spacing;
+    // One-pole approach to the target per grain; the time constant is in seconds.
+    const double smoothing = 1.0 - std::exp(-spacing / (kRatioSmoothingSeconds * sampleRate_));
+    ratio_ += smoothing * (targetRatio_ - ratio_);
+}
+
+int64_t PitchShifter::findPitchMark(int64_t predicted, double period) const noexcept
+{
+    // Marks sit on the waveform peak near one period after the last, so every grain is cut
+    // at the same phase of the cycle; unvoiced input just keeps the predicted spacing.
+    if (period_ <= 0.0)
+    {
+        return predicted;
+    }
+    const auto reach = static_cast<int64_t>(period * kMarkSearchFraction);
+    const int64_t first = predicted - reach;
+    const int64_t last = std::min(predicted + reach, written_ - 1);
+    int64_t best = predicted;
+    float peak = -1.0f;
+    for (int64_t position = first; position <= last; ++position)
+    {
+        const float value = input_[static_cast<size_t>(position) & mask_];
+        if (value > peak)
+        {
+            peak = value;
+            best = position;
+        }
+    }
+    return best;
+}
+
+void PitchShifter::buildWindow(size_t halfGrain)
+{
+    if (halfGrain == windowHalf_)
+    {
+        return;
+    }
+    // Periodic Hann: copies spaced halfGrain apart sum to exactly one.
+    windowHalf_ = halfGrain;
+    const double step = kPi / static_cast<double>(halfGrain);
+    for (size_t i = 0; i < 2 * halfGrain; ++i)
+    {
+        window_[i] = static_cast<float>(0.5 - 0.5 * std::cos(step * static_cast<double>(i)));
+    }
+}
+} // namespace singwithme::dsp
@@ -0,0 +1,396 @@
+#include "dsp/Resampler.h"
+
+#include "dsp/Simd.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <numeric>
+
+namespace singwithme::dsp
+{
+namespace
+{
+constexpr double kPi = 3.14159265358979323846;
+constexpr size_t kLagrangeTaps = 4;
+constexpr size_t kMaxTaps = 256;
+constexpr uint64_t kMaxRuntimePhases = 1024;
+
+constexpr double constexprSin(double x)
+{
+    const double turns = x / (2.0 * kPi);
+    const auto wraps = static_cast<long long>(turns + (turns >= 0.0 ? 0.5 : -0.5));
+    x -= static_cast<double>(wraps) * 2.0 * kPi;
+
+    const double x2 = x * x;
+    double term = x;
+    double sum = x;
+    for (int n = 1; n < 14; ++n)
+    {
+        term *= -x2 / static_cast<double>((2 * n) * (2 * n + 1));
+        sum += term;
+    }
+    return sum;
+}
+
+constexpr double constexprSqrt(double x)
+{
+    if (x <= 0.0)
+    {
+        return 0.0;
+    }
+    double estimate = x > 1.0 ? x : 1.0;
+    for (int i = 0; i < 64; ++i)
+    {
+        const double next = 0.5 * (estimate + x / estimate);
+        if (next == estimate)
+        {
+            break;
+        }
+        estimate = next;
+    }
+    return estimate;
+}
+
+constexpr double besselI0(double x)
+{
+    double sum = 1.0;
+    double term = 1.0;
+    const double halfX = 0.5 * x;
+    for (int k = 1; k < 64; ++k)
+    {
+        const double factor = halfX / static_cast<double>(k);
+        term *= factor * factor;
+        sum += term;
+        if (term < sum * 1.0e-14)
+        {
+            break;
+        }
+    }
+    return sum;
+}
+
+struct BankSpec
+{
+    uint64_t up;
+    uint64_t down;
+    int zeroCrossings;
+    double rolloff;
+    double kaiserBeta;
+};
+
+constexpr double cutoffFor(const BankSpec& spec)
+{
+    const double band = spec.up < spec.down ? static_cast<double>(spec.up) / static_cast<double>(spec.down) : 1.0;
+    return spec.rolloff * band;
+}
+
+constexpr size_t tapsFor(const BankSpec& spec)
+{
+    const double halfSpan = static_cast<double>(spec.zeroCrossings) / cutoffFor(spec);
+    auto taps = static_cast<size_t>(2 * static_cast<size_t>(halfSpan + 0.999999));
+    taps = (taps + 7) & ~static_cast<size_t>(7);
+    return std::min(taps, kMaxTaps);
+}
+
+// Coefficient j of a phase multiplies x[s + j]; the phase evaluates the signal at
+// s + taps/2 - 1 + phase/up. Each phase is normalised to unity DC gain.
+constexpr void designPhase(float* coefficients, size_t taps, uint64_t up, uint64_t phase, double cutoff, double beta)
+{
+    const double halfLength = static_cast<double>(taps) / 2.0;
+    const double i0Beta = besselI0(beta);
+    double sum = 0.0;
+    for (size_t j = 0; j < taps; ++j)
+    {
+        const double d = halfLength - 1.0 - static_cast<double>(j) + static_cast<double>(phase) / static_cast<double>(up);
+        const double x = d / halfLength;
+        const double window = (x >= 1.0 || x <= -1.0) ? 0.0 : besselI0(beta * constexprSqrt(1.0 - x * x)) / i0Beta;
+        const double arg = kPi * cutoff * d;
+        const double sinc = (d == 0.0) ? 1.0 : constexprSin(arg) / arg;
+        const double h = sinc * window;
+        coefficients[j] = static_cast<float>(h);
+        sum += h;
+    }
+
+    const double scale = sum != 0.0 ? 1.0 / sum : 1.0;
+    for (size_t j = 0; j < taps; ++j)
+    {
+        coefficients[j] = static_cast<float>(static_cast<double>(coefficients[j]) * scale);
+    }
+}
+
+template <BankSpec Spec>
+constexpr auto makeBank()
+{
+    constexpr size_t taps = tapsFor(Spec);
+    std::array<float, Spec.up * taps> bank{};
+    for (uint64_t phase = 0; phase < Spec.up; ++phase)
+    {
+        designPhase(bank.data() + phase * taps, taps, Spec.up, phase, cutoffFor(Spec), Spec.kaiserBeta);
+    }
+    return bank;
+}
+
+constexpr int kFastZeroCrossings = 8;
+constexpr double kFastRolloff = 0.90;
+constexpr double kFastBeta = 6.0;
+constexpr int kBestZeroCrossings = 24;
+constexpr double kBestRolloff = 0.95;
+constexpr double kBestBeta = 10.0;
+
+constexpr BankSpec k44To48Fast{160, 147, kFastZeroCrossings, kFastRolloff, kFastBeta};
+constexpr BankSpec k44To48Best{160, 147, kBestZeroCrossings, kBestRolloff, kBestBeta};
+constexpr BankSpec k48To44Fast{147, 160, kFastZeroCrossings, kFastRolloff, kFastBeta};
+constexpr BankSpec k48To44Best{147, 160, kBestZeroCrossings, kBestRolloff, kBestBeta};
+constexpr BankSpec k48To16Fast{1, 3, kFastZeroCrossings, kFastRolloff, kFastBeta};
+constexpr BankSpec k48To16Best{1, 3, kBestZeroCrossings, kBestRolloff, kBestBeta};
+
+constexpr auto kBank44To48Fast = makeBank<k44To48Fast>();
+constexpr auto kBank44To48Best = makeBank<k44To48Best>();
+constexpr auto kBank48To44Fast = makeBank<k48To44Fast>();
+constexpr auto kBank48To44Best = makeBank<k48To44Best>();
+constexpr auto kBank48To16Fast = makeBank<k48To16Fast>();
+constexpr auto kBank48To16Best = makeBank<k48To16Best>();
+
+struct PrecomputedBank
+{
+    const BankSpec& spec;
+    const float* coefficients;
+};
+
+constexpr std::array<PrecomputedBank, 6> kPrecomputedBanks{{
+    {k44To48Fast, kBank44To48Fast.data()},
+    {k44To48Best, kBank44To48Best.data()},
+    {k48To44Fast, kBank48To44Fast.data()},
+    {k48To44Best, kBank48To44Best.data()},
+    {k48To16Fast, kBank48To16Fast.data()},
+    {k48To16Best, kBank48To16Best.data()},
+}};
+
+bool isIntegralRate(double rate)
+{
+    return rate > 0.0 && std::abs(rate - std::round(rate)) < 1e-6;
+}
+
+float lagrange4(const float* x, float f)
+{
+    const float fm1 = f - 1.0f;
+    const float fm2 = f - 2.0f;
+    const float fp1 = f + 1.0f;
+    return (-f * fm1 * fm2 / 6.0f) * x[0]
+           + (fp1 * fm1 * fm2 * 0.5f) * x[1]
+           + (-fp1 * f * fm2 * 0.5f) * x[2]
+           + (fp1 * f * fm1 / 6.0f) * x[3];
+}
+} // namespace
+
+void Resampler::prepare(double sourceRate, double targetRate, ResamplerQuality quality, size_t maxBlockSize)
+{
+    quality_ = quality;
+    ratio_ = sourceRate / targetRate;
+    polyphase_ = false;
+    upFactor_ = 1;
+    downFactor_ = 1;
+    taps_ = kLagrangeTaps;
+    bank_ = nullptr;
+    runtimeBank_.clear();
+    rational_ = isIntegralRate(sourceRate) && isIntegralRate(targetRate);
+
+    if (rational_)
+    {
+        const auto source = static_cast<uint64_t>(std::llround(sourceRate));
+        const auto target = static_cast<uint64_t>(std::llround(targetRate));
+        const uint64_t divisor = std::gcd(source, target);
+        upFactor_ = target / divisor;
+        downFactor_ = source / divisor;
+    }
+
+    if (rational_ && !isPassthrough() && quality != ResamplerQuality::Lagrange)
+    {
+        const bool best = quality == ResamplerQuality::SincBest;
+        for (const auto& bank : kPrecomputedBanks)
+        {
+            const bool bestBank = bank.spec.zeroCrossings == kBestZeroCrossings;
+            if (bank.spec.up == upFactor_ && bank.spec.down == downFactor_ && bestBank == best)
+            {
+                bank_ = bank.coefficients;
+                taps_ = tapsFor(bank.spec);
+                polyphase_ = true;
+                break;
+            }
+        }
+
+        if (!polyphase_ && upFactor_ <= kMaxRuntimePhases)
+        {
+            const BankSpec spec{upFactor_,
+                                downFactor_,
+                                best ? kBestZeroCrossings : kFastZeroCrossings,
+                                best ? kBestRolloff : kFastRolloff,
+                                best ? kBestBeta : kFastBeta};
+            taps_ = tapsFor(spec);
+            runtimeBank_.assign(static_cast<size_t>(upFactor_) * taps_, 0.0f);
+            for (uint64_t phase = 0; phase < upFactor_; ++phase)
+            {
+                designPhase(runtimeBank_.data() + phase * taps_, taps_, upFactor_, phase, cutoffFor(spec), spec.kaiserBeta);
+            }
+            bank_ = runtimeBank_.data();
+            polyphase_ = true;
+        }
+    }
+
+    history_.assign(taps_ + std::max<size_t>(maxBlockSize, 1), 0.0f);
+    reset();
+}
+
+void Resampler::reset()
+{
+    std::fill(history_.begin(), history_.end(), 0.0f);
+    historyFill_ = taps_ - 1;
+    streamPhase_ = 0;
+    streamPosition_ = 0.0;
+}
+
+size_t Resampler::process(const float* input, size_t numInput, float* output, size_t maxOutput)
+{
+    if (rational_ && isPassthrough())
+    {
+        const size_t count = std::min(numInput, maxOutput);
+        std::copy(input, input + count, output);
+        return count;
+    }
+
+    size_t produced = 0;
+    while (numInput > 0)
+    {
+        const size_t room = history_.size() - historyFill_;
+        const size_t chunk = std::min(room, numInput);
+        std::copy(input, input + chunk, history_.begin() + static_cast<std::ptrdiff_t>(historyFill_));
+        historyFill_ += chunk;
+        input += chunk;
+        numInput -= chunk;
+
+        size_t consumed = 0;
+        if (polyphase_)
+        {
+            while (produced < maxOutput)
+            {
+                const auto start = static_cast<size_t>(streamPhase_ / upFactor_);
+                if (start + taps_ > historyFill_)
+                {
+                    break;
+                }
+                const auto phase = static_cast<size_t>(streamPhase_ % upFactor_);
+                output[produced++] = simd::dotProduct(bank_ + phase * taps_, history_.data() + start, taps_);
+                streamPhase_ += downFactor_;
+            }
+            consumed = std::min(static_cast<size_t>(streamPhase_ / upFactor_), historyFill_);
+            streamPhase_ -= static_cast<uint64_t>(consumed) * upFactor_;
+        }
+        else
+        {
+            while (produced < maxOutput)
+            {
+                const auto start = static_cast<size_t>(streamPosition_);
+                if (start + kLagrangeTaps > historyFill_)
+                {
+                    break;
+                }
+                const auto fraction = static_cast<float>(streamPosition_ - static_cast<double>(start));
+                output[produced++] = lagrange4(history_.data() + start, fraction);
+                streamPosition_ += ratio_;
+            }
+            consumed = std::min(static_cast<size_t>(streamPosition_), historyFill_);
+            streamPosition_ -= static_cast<double>(consumed);
+        }
+
+        std::copy(history_.begin() + static_cast<std::ptrdiff_t>(consumed),
+                  history_.begin() + static_cast<std::ptrdiff_t>(historyFill_),
+                  history_.begin());
+        historyFill_ -= consumed;
+        if (chunk == 0 && consumed == 0)
+        {
+            // The history is full and maxOutput used up; the rest of the input is dropped.
+            break;
+        }
+    }
+
+    return produced;
+}
+
+void Resampler::render(const float* input,
+                       size_t inputLength,
+                       float* output,
+                       size_t outputStart,
+                       size_t outputCount) const
+{
+    if (rational_ && isPassthrough())
+    {
+        for (size_t n = 0; n < outputCount; ++n)
+        {
+            const size_t index = outputStart + n;
+            output[n] = index < inputLength ? input[index] : 0.0f;
+        }
+        return;
+    }
+
+    for (size_t n = 0; n < outputCount; ++n)
+    {
+        const size_t index = outputStart + n;
+        if (polyphase_)
+        {
+            output[n] = renderPolyphase(input, inputLength, static_cast<uint64_t>(index));
+        }
+        else if (rational_)
+        {
+            const uint64_t numerator = static_cast<uint64_t>(index) * downFactor_;
+            const double position = static_cast<double>(numerator / upFactor_)
+                                    + static_cast<double>(numerator % upFactor_) / static_cast<double>(upFactor_);
+            output[n] = renderLagrange(input, inputLength, position);
+        }
+        else
+        {
+            output[n] = renderLagrange(input, inputLength, static_cast<double>(index) * ratio_);
+        }
+    }
+}
+
+size_t Resampler::outputLength(size_t inputLength, double sourceRate, double targetRate)
+{
+    return static_cast<size_t>(std::ceil(static_cast<double>(inputLength) * targetRate / sourceRate));
+}
+
+float Resampler::renderPolyphase(const float* input, size_t inputLength, uint64_t outputIndex) const
+{
+    const uint64_t numerator = outputIndex * downFactor_;
+    const auto centre = static_cast<int64_t>(numerator / upFactor_);
+    const auto phase = static_cast<size_t>(numerator % upFactor_);
+    const int64_t start = centre - static_cast<int64_t>(taps_ / 2) + 1;
+    const float* coefficients = bank_ + phase * taps_;
+
+    if (start >= 0 && start + static_cast<int64_t>(taps_) <= static_cast<int64_t>(inputLength))
+    {
+        return simd::dotProduct(coefficients, input + start, taps_);
+    }
+
+    std::array<float, kMaxTaps> window{};
+    for (size_t j = 0; j < taps_; ++j)
+    {
+        const int64_t index = start + static_cast<int64_t>(j);
+        window[j] = (index >= 0 && index < static_cast<int64_t>(inputLength)) ? input[index] : 0.0f;
+    }
+    return simd::dotProduct(coefficients, window.data(), taps_);
+}
+
+float Resampler::renderLagrange(const float* input, size_t inputLength, double position) const
+{
+    const auto base = static_cast<int64_t>(std::floor(position));
+    const auto fraction = static_cast<float>(position - static_cast<double>(base));
+    std::array<float, kLagrangeTaps> window{};
+    for (size_t j = 0; j < kLagrangeTaps; ++j)
+    {
+        const int64_t index = base - 1 + static_cast<int64_t>(j);
+        window[j] = (index >= 0 && index < static_cast<int64_t>(inputLength)) ? input[index] : 0.0f;
+    }
+    return lagrange4(window.data(), fraction);
+}
+} // namespace singwithme::dsp
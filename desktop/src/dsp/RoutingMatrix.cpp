@@ -0,0 +1,91 @@
+#include "dsp/RoutingMatrix.h"
+
+#include <algorithm>
+
+#include "dsp/Simd.h"
+
+namespace singwithme::dsp
+{
+namespace
+{
+// Samples per tile: every output's tile and its sources stay in L1 while its routes sum.
+constexpr size_t kTileSamples = 64;
+} // namespace
+
+size_t RoutingMatrix::addRoute(size_t source, size_t output, float gain)
+{
+    const size_t index = routes_.size();
+    routes_.push_back(Route{source, output, gain, gain, 0.0f});
+    order_.push_back(index);
+    std::stable_sort(order_.begin(), order_.end(), [this](size_t a, size_t b) { return routes_[a].output < routes_[b].output; });
+    return index;
+}
+
+void RoutingMatrix::clearRoutes()
+{
+    routes_.clear();
+    order_.clear();
+}
+
+size_t RoutingMatrix::outputsUsed() const noexcept
+{
+    return order_.empty() ? 0 : routes_[order_.back()].output + 1;
+}
+
+void RoutingMatrix::setGain(size_t route, float gain) noexcept
+{
+    if (route < routes_.size())
+    {
+        routes_[route].target = gain;
+    }
+}
+
+void RoutingMatrix::process(const float* const* sources,
+                            size_t numSources,
+                            float* const* outputs,
+                            size_t numOutputs,
+                            size_t numSamples) noexcept
+{
+    if (numSamples == 0)
+    {
+        return;
+    }
+
+    const float blockScale = 1.0f / static_cast<float>(numSamples);
+    for (auto& route : routes_)
+    {
+        route.step = (route.target - route.gain) * blockScale;
+    }
+
+    for (size_t start = 0; start < numSamples; start += kTileSamples)
+    {
+        const size_t count = std::min(kTileSamples, numSamples - start);
+        const float offset = static_cast<float>(start);
+        size_t current = static_cast<size_t>(-1);
+        float* output = nullptr;
+        for (const size_t index : order_)
+        {
+            const auto& route = routes_[index];
+            if (route.output != current)
+            {
+                current = route.output;
+                output = current < numOutputs && outputs[current] != nullptr ? outputs[current] + start : nullptr;
+                if (output != nullptr)
+                {
+                    std::fill(output, output + count, 0.0f);
+                }
+            }
+            const float* source = route.source < numSources ? sources[route.source] : nullptr;
+            if (output != nullptr && source != nullptr)
+            {
+                simd::rampMultiplyAccumulate(source + start, route.gain + route.step * offset, route.step, output, count);
+            }
+        }
+    }
+
+    for (auto& route : routes_)
+    {
+        route.gain = route.target;
+    }
+}
+} // namespace singwithme::dsp
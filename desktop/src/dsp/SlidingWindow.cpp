@@ -0,0 +1,86 @@
+#include "dsp/SlidingWindow.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace singwithme::dsp
+{
+namespace
+{
+// Room for a few pushes past what the due windows need before the buffer is compacted.
+constexpr size_t kSlackSamples = 4096;
+} // namespace
+
+void SlidingWindow::prepare(size_t windowSamples, size_t hopSamples, size_t maxDue)
+{
+    windowSamples_ = std::max<size_t>(1, windowSamples);
+    hopSamples_ = std::clamp<size_t>(hopSamples, 1, windowSamples_);
+    maxDue_ = std::max<size_t>(1, maxDue);
+    buffer_.assign(windowSamples_ + maxDue_ * hopSamples_ + kSlackSamples, 0.0f);
+    reset();
+}
+
+void SlidingWindow::reset() noexcept
+{
+    fill_ = 0;
+    bufferStart_ = 0;
+    nextEnd_ = windowSamples_;
+    firstDueEnd_ = windowSamples_;
+}
+
+size_t SlidingWindow::push(const float* samples, size_t count) noexcept
+{
+    if (buffer_.empty())
+    {
+        return 0;
+    }
+
+    // Only the newest maxDue windows can be reported, so anything older is not kept.
+    const size_t keep = windowSamples_ + (maxDue_ - 1) * hopSamples_;
+    if (count > buffer_.size())
+    {
+        const size_t skip = count - keep;
+        bufferStart_ += fill_ + skip;
+        fill_ = 0;
+        samples += skip;
+        count = keep;
+    }
+    if (fill_ + count > buffer_.size())
+    {
+        const size_t retain = std::min(fill_, buffer_.size() - count);
+        const size_t drop = fill_ - retain;
+        std::memmove(buffer_.data(), buffer_.data() + drop, retain * sizeof(float));
+        bufferStart_ += drop;
+        fill_ = retain;
+    }
+    std::memcpy(buffer_.data() + fill_, samples, count * sizeof(float));
+    fill_ += count;
+
+    const uint64_t streamEnd = bufferStart_ + fill_;
+    if (nextEnd_ > streamEnd)
+    {
+        return 0;
+    }
+    size_t due = static_cast<size_t>((streamEnd - nextEnd_) / hopSamples_) + 1;
+    // Windows that start before the buffer, or beyond the newest maxDue, are dropped.
+    const uint64_t oldestReachable = bufferStart_ + windowSamples_;
+    while (due > 0 && (due > maxDue_ || nextEnd_ < oldestReachable))
+    {
+        nextEnd_ += hopSamples_;
+        --due;
+    }
+    firstDueEnd_ = nextEnd_;
+    nextEnd_ += due * hopSamples_;
+    return due;
+}
+
+const float* SlidingWindow::window(size_t index) const noexcept
+{
+    return buffer_.data() + static_cast<size_t>(windowEnd(index) - windowSamples_ - bufferStart_);
+}
+
+uint64_t SlidingWindow::windowEnd(size_t index) const noexcept
+{
+    return firstDueEnd_ + index * hopSamples_;
+}
+} // namespace singwithme::dsp
@@ -0,0 +1,278 @@
+#include "dsp/TimbreMatcher.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "dsp/Simd.h"
+
+namespace singwithme::dsp
+{
+namespace
+{
+constexpr double kPi = 3.14159265358979323846;
+constexpr double kFrameSeconds = 0.02;
+// Quefrencies above this are cut, which is shorter than the pitch period of any sung note
+// up to about 1 kHz.
+constexpr double kLifterSeconds = 0.001;
+constexpr std::array<double, TimbreMatcher::kBands> kBandHz{150.0, 300.0, 600.0, 1200.0, 2400.0, 4000.0, 6500.0, 10000.0};
+// Roughly one octave wide.
+constexpr double kBandQ = 1.4;
+// Bands this close to Nyquist are left out at low device rates.
+constexpr double kMaxBandFraction = 0.45;
+constexpr double kGainSmoothingSeconds = 0.3;
+// Frames where either side is quieter than this (mean square) leave the curve as it is.
+constexpr float kMinFramePower = 1.0e-6f;
+constexpr float kLogFloor = 1.0e-10f;
+constexpr float kNepersToDb = 8.6858896f;
+} // namespace
+
+void TimbreMatcher::prepare(double sampleRate)
+{
+    sampleRate_ = sampleRate;
+    size_t frameSize = 256;
+    while (static_cast<double>(frameSize) < kFrameSeconds * sampleRate)
+    {
+        frameSize <<= 1;
+    }
+    frameSize_ = frameSize;
+    fft_.prepare(frameSize_);
+    lifterLength_ = std::clamp<size_t>(static_cast<size_t>(std::lround(kLifterSeconds * sampleRate)), 1, frameSize_ / 2 - 1);
+
+    window_.resize(frameSize_);
+    for (size_t i = 0; i < frameSize_; ++i)
+    {
+        window_[i] = static_cast<float>(0.5 - 0.5 * std::cos(2.0 * kPi * static_cast<double>(i) / static_cast<double>(frameSize_)));
+    }
+    micRing_.assign(frameSize_, 0.0f);
+    guideRing_.assign(frameSize_, 0.0f);
+    ringMask_ = frameSize_ - 1;
+    micFrame_.assign(frameSize_, 0.0f);
+    guideFrame_.assign(frameSize_, 0.0f);
+    cepstrum_.assign(frameSize_, 0.0f);
+    spectrum_.assign(fft_.numBins(), {});
+    micEnvelopeDb_.assign(fft_.numBins(), 0.0f);
+    guideEnvelopeDb_.assign(fft_.numBins(), 0.0f);
+
+    // Each band is analysed between the geometric midpoints to its neighbours.
+    const double binHz = sampleRate / static_cast<double>(frameSize_);
+    activeBands_ = 0;
+    for (size_t band = 0; band < kBands; ++band)
+    {
+        alpha_[band] = 0.0f;
+        cosine_[band] = 1.0f;
+        if (kBandHz[band] >= kMaxBandFraction * sampleRate)
+        {
+            continue;
+        }
+        activeBands_ = band + 1;
+        const double w0 = 2.0 * kPi * kBandHz[band] / sampleRate;
+        alpha_[band] = static_cast<float>(std::sin(w0) / (2.0 * kBandQ));
+        cosine_[band] = static_cast<float>(std::cos(w0));
+    }
+    for (size_t edge = 0; edge <= activeBands_; ++edge)
+    {
+        const double hz = edge == 0 ? kBandHz[0] / std::sqrt(2.0)
+                          : edge == activeBands_ ? std::min(kBandHz[edge - 1] * std::sqrt(2.0), 0.5 * sampleRate)
+                                                 : std::sqrt(kBandHz[edge - 1] * kBandHz[edge]);
+        bandEdges_[edge] = std::min(static_cast<size_t>(std::lround(hz / binHz)), fft_.numBins() - 1);
+    }
+    reset();
+}
+
+void TimbreMatcher::reset()
+{
+    std::fill(micRing_.begin(), micRing_.end(), 0.0f);
+    std::fill(guideRing_.begin(), guideRing_.end(), 0.0f);
+    micHead_ = 0;
+    guideHead_ = 0;
+    step_ = Step::Capture;
+    state1_.fill(0.0f);
+    state2_.fill(0.0f);
+    stageInput_.fill(0.0f);
+    targetDb_.fill(0.0f);
+    appliedDb_.fill(0.0f);
+    updateCoefficients(0.0f, 0);
+}
+
+void TimbreMatcher::setStrength(float strength) noexcept
+{
+    strength_.store(std::clamp(strength, 0.0f, 1.0f), std::memory_order_relaxed);
+}
+
+void TimbreMatcher::writeRing(std::vector<float>& ring, size_t mask, size_t& head, const float* samples, size_t numSamples) noexcept
+{
+    // Only the newest frame is ever read, so a long block just keeps its tail.
+    const size_t skip = numSamples > ring.size() ? numSamples - ring.size() : 0;
+    for (size_t i = skip; i < numSamples; ++i)
+    {
+        ring[head] = samples[i];
+        head = (head + 1) & mask;
+    }
+}
+
+void TimbreMatcher::readRing(const std::vector<float>& ring, size_t head, std::vector<float>& frame) const noexcept
+{
+    for (size_t i = 0; i < frameSize_; ++i)
+    {
+        frame[i] = ring[(head + i) & ringMask_] * window_[i];
+    }
+}
+
+void TimbreMatcher::pushMic(const float* mic, size_t numSamples) noexcept
+{
+    if (frameSize_ == 0 || mic == nullptr)
+    {
+        return;
+    }
+    writeRing(micRing_, ringMask_, micHead_, mic, numSamples);
+}
+
+void TimbreMatcher::toLogSpectrum(const std::vector<float>& frame) noexcept
+{
+    fft_.forwardReal(frame.data(), spectrum_.data());
+    for (auto& bin : spectrum_)
+    {
+        bin = {0.5f * std::log(std::norm(bin) + kLogFloor), 0.0f};
+    }
+}
+
+void TimbreMatcher::toCepstrum() noexcept
+{
+    fft_.inverseReal(spectrum_.data(), cepstrum_.data());
+    std::fill(cepstrum_.begin() + static_cast<std::ptrdiff_t>(lifterLength_ + 1),
+              cepstrum_.end() - static_cast<std::ptrdiff_t>(lifterLength_),
+              0.0f);
+}
+
+void TimbreMatcher::toEnvelope(std::vector<float>& envelopeDb) noexcept
+{
+    fft_.forwardReal(cepstrum_.data(), spectrum_.data());
+    for (size_t bin = 0; bin < spectrum_.size(); ++bin)
+    {
+        envelopeDb[bin] = kNepersToDb * spectrum_[bin].real();
+    }
+}
+
+void TimbreMatcher::advanceAnalysis() noexcept
+{
+    switch (step_)
+    {
+        case Step::Capture:
+        {
+            // Both frames are taken at the same instant so they describe the same moment.
+            readRing(micRing_, micHead_, micFrame_);
+            readRing(guideRing_, guideHead_, guideFrame_);
+            const float scale = 1.0f / static_cast<float>(frameSize_);
+            const bool active = simd::sumOfSquares(micFrame_.data(), frameSize_) * scale >= kMinFramePower
+                                && simd::sumOfSquares(guideFrame_.data(), frameSize_) * scale >= kMinFramePower;
+            step_ = active ? Step::MicSpectrum : Step::Capture;
+            break;
+        }
+        case Step::MicSpectrum:
+            toLogSpectrum(micFrame_);
+            step_ = Step::MicCepstrum;
+            break;
+        case Step::MicCepstrum:
+            toCepstrum();
+            step_ = Step::MicEnvelope;
+            break;
+        case Step::MicEnvelope:
+            toEnvelope(micEnvelopeDb_);
+            step_ = Step::GuideSpectrum;
+            break;
+        case Step::GuideSpectrum:
+            toLogSpectrum(guideFrame_);
+            step_ = Step::GuideCepstrum;
+            break;
+        case Step::GuideCepstrum:
+            toCepstrum();
+            step_ = Step::GuideEnvelope;
+            break;
+        case Step::GuideEnvelope:
+            toEnvelope(guideEnvelopeDb_);
+            step_ = Step::Compare;
+            break;
+        case Step::Compare:
+        {
+            // Only the shape is matched; the level difference is the gate's business.
+            std::array<float, kBands> difference{};
+            float mean = 0.0f;
+            for (size_t band = 0; band < activeBands_; ++band)
+            {
+                const size_t first = bandEdges_[band];
+                const size_t last = std::max(bandEdges_[band + 1], first + 1);
+                float sum = 0.0f;
+                for (size_t bin = first; bin < last; ++bin)
+                {
+                    sum += micEnvelopeDb_[bin] - guideEnvelopeDb_[bin];
+                }
+                difference[band] = sum / static_cast<float>(last - first);
+                mean += difference[band];
+            }
+            mean /= static_cast<float>(std::max<size_t>(activeBands_, 1));
+            for (size_t band = 0; band < activeBands_; ++band)
+            {
+                targetDb_[band] = std::clamp(difference[band] - mean, -kMaxGainDb, kMaxGainDb);
+            }
+            step_ = Step::Capture;
+            break;
+        }
+    }
+}
+
+void TimbreMatcher::process(const float* guide, float* output, size_t numSamples) noexcept
+{
+    if (frameSize_ == 0 || guide == nullptr || output == nullptr || numSamples == 0)
+    {
+        return;
+    }
+
+    writeRing(guideRing_, ringMask_, guideHead_, guide, numSamples);
+    advanceAnalysis();
+
+    updateCoefficients(strength_.load(std::memory_order_relaxed), numSamples);
+
+    // Stage k filters what stage k - 1 produced one sample earlier, so one vector step moves
+    // every band forward at once and the cascade's output is the last stage.
+    constexpr size_t kLast = kBands - 1;
+    for (size_t i = 0; i < numSamples; ++i)
+    {
+        stageInput_[0] = guide[i];
+        alignas(32) std::array<float, kBands> y{};
+        for (size_t band = 0; band < kBands; ++band)
+        {
+            const float x = stageInput_[band];
+            y[band] = b0_[band] * x + state1_[band];
+            state1_[band] = b1_[band] * x - a1_[band] * y[band] + state2_[band];
+            state2_[band] = b2_[band] * x - a2_[band] * y[band];
+        }
+        output[i] = y[kLast];
+        std::copy(y.begin(), y.end() - 1, stageInput_.begin() + 1);
+    }
+}
+
+void TimbreMatcher::updateCoefficients(float strength, size_t numSamples) noexcept
+{
+    // Gains glide in dB; only the gain terms of the peaking filters change with them.
+    const auto glide = numSamples == 0 ? 1.0f
+                                       : static_cast<float>(1.0 - std::exp(-static_cast<double>(numSamples) / (kGainSmoothingSeconds * sampleRate_)));
+    for (size_t band = 0; band < kBands; ++band)
+    {
+        appliedDb_[band] += glide * (strength * targetDb_[band] - appliedDb_[band]);
+        if (alpha_[band] == 0.0f)
+        {
+            b0_[band] = 1.0f;
+            b1_[band] = b2_[band] = a1_[band] = a2_[band] = 0.0f;
+            continue;
+        }
+        const float amplitude = std::pow(10.0f, appliedDb_[band] / 40.0f);
+        const float alpha = alpha_[band];
+        const float a0 = 1.0f + alpha / amplitude;
+        b0_[band] = (1.0f + alpha * amplitude) / a0;
+        b1_[band] = -2.0f * cosine_[band] / a0;
+        b2_[band] = (1.0f - alpha * amplitude) / a0;
+        a1_[band] = b1_[band];
+        a2_[band] = (1.0f - alpha / amplitude) / a0;
+    }
+}
+} // namespace singwithme::dsp
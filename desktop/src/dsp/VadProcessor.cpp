@@ -1,5 +1,7 @@
 #include "dsp/VadProcessor.h"
 
+#include "trace/Tracer.h"
+
 #if TUNETRIX_ONNX_RUNTIME
 
 #include <algorithm>
@@ -18,6 +20,10 @@ constexpr const char* kStateOutputName = "stateN";
 constexpr size_t kStateChannels = 2;
 constexpr size_t kStateHiddenSize = 128;
 constexpr size_t kExpectedFrameSamples = 160; // 10 ms @ 16 kHz
+constexpr float kSkipDecay = 0.5f;
+// Silero keeps seeing 100 ms of silence after activity so its state settles; after
+// 300 ms of skipped frames the next run starts from a fresh state instead.
+constexpr InferenceScheduler::Settings kSchedule{10, 1, 30};
 } // namespace
 
 VadProcessor::VadProcessor(Ort::Env& env)
@@ -25,11 +31,12 @@ VadProcessor::VadProcessor(Ort::Env& env)
 {
     options_.SetIntraOpNumThreads(1);
     options_.SetGraphOptimizationLevel(GraphOptimizationLevel::ORT_ENABLE_ALL);
+    scheduler_.prepare(kSchedule);
 }
 
 void VadProcessor::loadModel(const std::string& modelPath)
 {
-    session_ = std::make_unique<Ort::Session>(env_, modelPath.c_str(), options_);
+    session_ = ModelStore::instance().openSession(env_, modelPath, options_);
     inputBuffer_.resize(kExpectedFrameSamples);
     stateBuffer_.assign(kStateChannels * kStateHiddenSize, 0.0f);
 }
@@ -42,6 +49,13 @@ void VadProcessor::setModelSampleRate(int64_t sampleRate)
 void VadProcessor::resetState()
 {
     std::fill(stateBuffer_.begin(), stateBuffer_.end(), 0.0f);
+    scheduler_.reset();
+    lastProbability_ = 0.0f;
+}
+
+void VadProcessor::setNoiseFloorDb(float noiseFloorDb)
+{
+    scheduler_.setNoiseFloorDb(noiseFloorDb);
 }
 
 float VadProcessor::processFrame(const float* samples, size_t sampleCount)
@@ -56,12 +70,28 @@ float VadProcessor::processFrame(const float* samples, size_t sampleCount)
         throw std::runtime_error("Unexpected VAD frame length");
     }
 
+    switch (scheduler_.next(samples, sampleCount))
+    {
+        case InferenceDecision::Skip:
+            lastProbability_ *= kSkipDecay;
+            return lastProbability_;
+        case InferenceDecision::ResetAndRun:
+            std::fill(stateBuffer_.begin(), stateBuffer_.end(), 0.0f);
+            break;
+        case InferenceDecision::Run:
+        default:
+            break;
+    }
+
     std::copy(samples, samples + sampleCount, inputBuffer_.begin());
-    return runModel(inputBuffer_.data(), inputBuffer_.size());
+    lastProbability_ = runModel(inputBuffer_.data(), inputBuffer_.size());
+    return lastProbability_;
 }
 
 float VadProcessor::runModel(const float* downsampled, size_t sampleCount)
 {
+    TUNETRIX_TRACE_ZONE("VAD inference");
+    TUNETRIX_TRACE_FLOW_END();
     auto memoryInfo = Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault);
 
     std::array<int64_t, 2> inputShape{1, static_cast<int64_t>(sampleCount)};
@@ -119,6 +149,8 @@ float VadProcessor::runModel(const float* downsampled, size_t sampleCount)
 #include <algorithm>
 #include <cmath>
 
+#include "dsp/Simd.h"
+
 namespace singwithme::dsp
 {
 namespace
@@ -131,8 +163,15 @@ constexpr float kLogisticSlope = 0.9f;
 constexpr float kLogisticOffsetDb = -1.5f;
 constexpr float kLevelFloorDb = -80.0f;
 constexpr float kLevelCeilDb = -30.0f;
+constexpr float kSkipDecay = 0.5f;
+constexpr InferenceScheduler::Settings kSchedule{10, 1, 30};
 } // namespace
 
+VadProcessor::VadProcessor(Ort::Env&)
+{
+    scheduler_.prepare(kSchedule);
+}
+
 void VadProcessor::setModelSampleRate(int64_t sampleRate)
 {
     modelSampleRate_ = sampleRate;
@@ -142,6 +181,12 @@ void VadProcessor::resetState()
 {
     noiseFloor_ = 1.0e-4f;
     smoothedProbability_ = 0.0f;
+    scheduler_.reset();
+}
+
+void VadProcessor::setNoiseFloorDb(float noiseFloorDb)
+{
+    scheduler_.setNoiseFloorDb(noiseFloorDb);
 }
 
 float VadProcessor::processFrame(const float* samples, size_t sampleCount)
@@ -151,6 +196,22 @@ float VadProcessor::processFrame(const float* samples, size_t sampleCount)
         return 0.0f;
     }
 
+    const auto decision = scheduler_.next(samples, sampleCount);
+    if (decision == InferenceDecision::Skip)
+    {
+        // Keep the adaptive floor tracking the silence the scheduler measured anyway.
+        const float skippedEnergy = scheduler_.lastMeanSquare();
+        noiseFloor_ = std::max(kMinFloor, ((1.0f - kNoiseAdaptFast) * noiseFloor_) + (kNoiseAdaptFast * skippedEnergy));
+        smoothedProbability_ *= kSkipDecay;
+        return smoothedProbability_;
+    }
+    if (decision == InferenceDecision::ResetAndRun)
+    {
+        smoothedProbability_ = 0.0f;
+    }
+
+    TUNETRIX_TRACE_ZONE("VAD inference");
+    TUNETRIX_TRACE_FLOW_END();
     const float frameEnergy = computeEnergy(samples, sampleCount);
 
     const bool likelyNoise = frameEnergy <= noiseFloor_ * 1.5f;
@@ -173,13 +234,7 @@ float VadProcessor::processFrame(const float* samples, size_t sampleCount)
 
 float VadProcessor::computeEnergy(const float* samples, size_t sampleCount)
 {
-    float sumSquares = 0.0f;
-    for (size_t i = 0; i < sampleCount; ++i)
-    {
-        sumSquares += samples[i] * samples[i];
-    }
-
-    return sumSquares / static_cast<float>(sampleCount);
+    return simd::sumOfSquares(samples, sampleCount) / static_cast<float>(sampleCount);
 }
 } // namespace singwithme::dsp
 
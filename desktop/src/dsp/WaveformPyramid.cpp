@@ -0,0 +1,203 @@
+#include "dsp/WaveformPyramid.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace singwithme::dsp
+{
+namespace
+{
+constexpr size_t kChunkBins = size_t{1} << (2 * WaveformPyramid::kChunkLevels); // 4^kChunkLevels
+constexpr float kNoValue = std::numeric_limits<float>::quiet_NaN();
+
+size_t divideUp(size_t value, size_t divisor)
+{
+    return (value + divisor - 1) / divisor;
+}
+} // namespace
+
+void WaveformPyramid::prepare(size_t length, double unitsPerSecond, size_t baseBinUnits)
+{
+    length_ = length;
+    unitsPerSecond_ = unitsPerSecond > 0.0 ? unitsPerSecond : 1.0;
+    baseBinUnits_ = std::max<size_t>(1, baseBinUnits);
+    levels_.clear();
+    if (length_ == 0)
+    {
+        return;
+    }
+
+    levels_.emplace_back(divideUp(length_, baseBinUnits_));
+    while (levels_.back().size() > 1)
+    {
+        const size_t bins = divideUp(levels_.back().size(), kLevelFactor);
+        levels_.emplace_back(bins);
+    }
+}
+
+size_t WaveformPyramid::numChunks() const noexcept
+{
+    return levels_.empty() ? 0 : divideUp(levels_[0].size(), kChunkBins);
+}
+
+void WaveformPyramid::buildChunk(const float* input, size_t chunk) noexcept
+{
+    if (chunk >= numChunks())
+    {
+        return;
+    }
+
+    auto& base = levels_[0];
+    const size_t first = chunk * kChunkBins;
+    const size_t last = std::min(first + kChunkBins, base.size());
+    for (size_t bin = first; bin < last; ++bin)
+    {
+        base[bin] = reduceInput(input, bin * baseBinUnits_, std::min((bin + 1) * baseBinUnits_, length_));
+    }
+
+    size_t binsPerChunk = kChunkBins;
+    for (size_t level = 1; level <= kChunkLevels && level < levels_.size(); ++level)
+    {
+        binsPerChunk /= kLevelFactor;
+        const size_t begin = chunk * binsPerChunk;
+        buildLevelRange(level, begin, std::min(begin + binsPerChunk, levels_[level].size()));
+    }
+}
+
+void WaveformPyramid::finish() noexcept
+{
+    for (size_t level = kChunkLevels + 1; level < levels_.size(); ++level)
+    {
+        buildLevelRange(level, 0, levels_[level].size());
+    }
+}
+
+void WaveformPyramid::build(const float* input, size_t length, double unitsPerSecond, size_t baseBinUnits)
+{
+    prepare(length, unitsPerSecond, baseBinUnits);
+    for (size_t chunk = 0; chunk < numChunks(); ++chunk)
+    {
+        buildChunk(input, chunk);
+    }
+    finish();
+}
+
+void WaveformPyramid::render(double startSeconds,
+                             double endSeconds,
+                             PyramidBin* out,
+                             size_t pixels,
+                             const float* input) const noexcept
+{
+    if (pixels == 0)
+    {
+        return;
+    }
+    const double unitsPerPixel = (endSeconds - startSeconds) * unitsPerSecond_ / static_cast<double>(pixels);
+    if (levels_.empty() || !(unitsPerPixel > 0.0))
+    {
+        std::fill(out, out + pixels, PyramidBin{kNoValue, kNoValue, 0.0f});
+        return;
+    }
+
+    size_t level = 0;
+    while (level + 1 < levels_.size() && static_cast<double>(binWidth(level + 1)) <= unitsPerPixel)
+    {
+        ++level;
+    }
+    const bool fromInput = input != nullptr && level == 0 && unitsPerPixel < static_cast<double>(baseBinUnits_);
+    const double width = static_cast<double>(fromInput ? 1 : binWidth(level));
+    const size_t limit = fromInput ? length_ : levels_[level].size();
+    const double origin = startSeconds * unitsPerSecond_;
+
+    for (size_t pixel = 0; pixel < pixels; ++pixel)
+    {
+        const double from = (origin + static_cast<double>(pixel) * unitsPerPixel) / width;
+        const double to = (origin + static_cast<double>(pixel + 1) * unitsPerPixel) / width;
+        const auto begin = static_cast<size_t>(std::max(0.0, std::floor(from)));
+        const auto end = std::min(limit, std::max(begin + 1, static_cast<size_t>(std::max(0.0, std::ceil(to)))));
+        if (to <= 0.0 || begin >= limit)
+        {
+            out[pixel] = PyramidBin{kNoValue, kNoValue, 0.0f};
+            continue;
+        }
+
+        const Bin bin = fromInput ? reduceInput(input, begin, end) : reduceLevel(level, begin, end);
+        out[pixel] = bin.min <= bin.max ? PyramidBin{bin.min, bin.max, std::sqrt(bin.meanSquare)}
+                                        : PyramidBin{kNoValue, kNoValue, std::sqrt(bin.meanSquare)};
+    }
+}
+
+size_t WaveformPyramid::memoryBytes() const noexcept
+{
+    size_t bytes = 0;
+    for (const auto& level : levels_)
+    {
+        bytes += level.size() * sizeof(Bin);
+    }
+    return bytes;
+}
+
+size_t WaveformPyramid::binWidth(size_t level) const noexcept
+{
+    return baseBinUnits_ << (2 * level);
+}
+
+WaveformPyramid::Bin WaveformPyramid::reduceInput(const float* input, size_t begin, size_t end) const noexcept
+{
+    // NaN marks a gap (an unvoiced frame in a pitch lane); min/max skip it and it adds
+    // nothing to the mean square.
+    float low = std::numeric_limits<float>::infinity();
+    float high = -std::numeric_limits<float>::infinity();
+    float sumSquares = 0.0f;
+    for (size_t i = begin; i < end; ++i)
+    {
+        const float value = input[i];
+        low = std::min(low, value);
+        high = std::max(high, value);
+        sumSquares += value == value ? value * value : 0.0f;
+    }
+    return Bin{low, high, end > begin ? sumSquares / static_cast<float>(end - begin) : 0.0f};
+}
+
+WaveformPyramid::Bin WaveformPyramid::reduceLevel(size_t level, size_t begin, size_t end) const noexcept
+{
+    const auto& bins = levels_[level];
+    const size_t width = binWidth(level);
+    Bin result{std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity(), 0.0f};
+    double weightedSquares = 0.0;
+    size_t covered = 0;
+    for (size_t i = begin; i < end; ++i)
+    {
+        // Only the last bin of a level can be narrower than the rest.
+        const size_t span = std::min(width, length_ - i * width);
+        result.min = std::min(result.min, bins[i].min);
+        result.max = std::max(result.max, bins[i].max);
+        weightedSquares += static_cast<double>(bins[i].meanSquare) * static_cast<double>(span);
+        covered += span;
+    }
+    result.meanSquare = covered > 0 ? static_cast<float>(weightedSquares / static_cast<double>(covered)) : 0.0f;
+    return result;
+}
+
+void WaveformPyramid::buildLevelRange(size_t level, size_t begin, size_t end) noexcept
+{
+    auto& bins = levels_[level];
+    const size_t below = levels_[level - 1].size();
+    for (size_t bin = begin; bin < end; ++bin)
+    {
+        const size_t first = bin * kLevelFactor;
+        bins[bin] = reduceLevel(level - 1, first, std::min(first + kLevelFactor, below));
+    }
+}
+
+size_t StemOverview::memoryBytes() const noexcept
+{
+    size_t bytes = 0;
+    for (const auto& channel : channels)
+    {
+        bytes += channel.memoryBytes();
+    }
+    return bytes;
+}
+} // namespace singwithme::dsp
@@ -9,8 +9,10 @@
 #include "calibration/Calibrator.h"
 #include "config/RuntimeConfig.h"
 #include "dsp/ConfidenceGate.h"
+#include "dsp/ModelStore.h"
 #include "dsp/PitchProcessor.h"
 #include "dsp/VadProcessor.h"
+#include "trace/Tracer.h"
 #include "ui/MainWindow.h"
 namespace
 {
@@ -26,9 +28,10 @@ singwithme::dsp::GateConfig makeGateConfig(const singwithme::config::GateParams&
     gateCfg.framesOn = params.framesOn;
     gateCfg.framesOff = params.framesOff;
     gateCfg.duckDb = params.duckDb;
+    gateCfg.predictiveOpen = params.predictiveOpen;
     return gateCfg;
 }
-class TuneTrixApplication : public juce::JUCEApplication
+class TuneTrixApplication : public juce::JUCEApplication, private juce::Timer
 {
 public:
     const juce::String getApplicationName() override { return "TuneTrix"; }
@@ -36,15 +39,31 @@ public:
     bool moreThanOneInstanceAllowed() override { return true; }
     void initialise(const juce::String&) override
     {
-        const juce::String configPath = juce::SystemStats::getEnvironmentVariable("TUNETRIX_CONFIG", "configs/defaults.json");
-        runtimeConfig_ = configLoader_.loadFromFile(configPath.toStdString());
-        deviceManager_.initialise(runtimeConfig_.sampleRate, runtimeConfig_.bufferSamples);
+        // TUNETRIX_TRACE starts recording before the config is read, so its load shows up too.
+        const auto tracePath = juce::SystemStats::getEnvironmentVariable("TUNETRIX_TRACE", {}).toStdString();
+        if (!tracePath.empty())
+        {
+            startTracing(tracePath, singwithme::config::TraceConfig{}.eventsPerThread);
+        }
+        const auto configPath = juce::SystemStats::getEnvironmentVariable("TUNETRIX_CONFIG", "configs/defaults.json").toStdString();
+        runtimeConfig_ = configLoader_.loadFromFile(configPath);
+        configLoader_.loadDeviceLatencies(singwithme::config::ConfigLoader::latencyStorePath(), runtimeConfig_.latency);
+        if (tracePath.empty() && runtimeConfig_.trace.enabled)
+        {
+            startTracing(runtimeConfig_.trace.path, runtimeConfig_.trace.eventsPerThread);
+        }
+        deviceManager_.initialise(runtimeConfig_.sampleRate, runtimeConfig_.bufferSamples, runtimeConfig_.routing.outputChannels());
+        deviceManager_.setInputBridging(runtimeConfig_.inputBridge.enabled, runtimeConfig_.inputBridge.targetLatencyMs);
+        pipelineProcessor_.setOrtEnvironment(ortEnv_);
         vad_ = std::make_unique<singwithme::dsp::VadProcessor>(ortEnv_);
         vad_->loadModel(runtimeConfig_.vadModelPath);
         pitch_ = std::make_unique<singwithme::dsp::PitchProcessor>(ortEnv_);
         pitch_->loadModel(runtimeConfig_.pitchModelPath);
+        pitch_->setHopSamples(runtimeConfig_.pitchHopSamples());
         pipelineProcessor_.configure(runtimeConfig_, gate_, *vad_, *pitch_, calibrator_);
+        pipelineProcessor_.setInputBridge(&deviceManager_.inputBridge());
         deviceManager_.manager().addAudioCallback(&pipelineProcessor_);
+        applyRoundTripLatency();
         mainWindow_ = std::make_unique<singwithme::ui::MainWindow>(
             pipelineProcessor_,
             deviceManager_,
@@ -52,11 +71,16 @@ public:
     }
     void shutdown() override
     {
+        stopTimer();
         deviceManager_.manager().removeAudioCallback(&pipelineProcessor_);
+        pipelineProcessor_.shutdown();
         mainWindow_.reset();
         pitch_.reset();
         vad_.reset();
         deviceManager_.shutdown();
+#if TUNETRIX_TRACING
+        singwithme::trace::Tracer::instance().stop();
+#endif
     }
     void systemRequestedQuit() override
     {
@@ -64,6 +88,19 @@ public:
     }
     void anotherInstanceStarted(const juce::String&) override {}
 private:
+    static void startTracing(const std::string& path, int eventsPerThread)
+    {
+#if TUNETRIX_TRACING
+        if (!singwithme::trace::Tracer::instance().start(path, static_cast<size_t>(eventsPerThread)))
+        {
+            juce::Logger::writeToLog("Could not write a trace to " + juce::String(path));
+        }
+#else
+        juce::ignoreUnused(eventsPerThread);
+        juce::Logger::writeToLog("Tracing is not built in; reconfigure with ENABLE_TRACING to write " + juce::String(path));
+#endif
+    }
+
     bool applyBufferSize(int bufferSamples)
     {
         if (!deviceManager_.setBufferSize(bufferSamples))
@@ -74,23 +111,72 @@ private:
         const int appliedBuffer = deviceManager_.bufferSize();
         runtimeConfig_.bufferSamples = appliedBuffer;
         pipelineProcessor_.updateBufferSize(appliedBuffer);
+        applyRoundTripLatency();
         return true;
     }
 
+    singwithme::config::DeviceLatency currentDeviceSetup() const
+    {
+        singwithme::config::DeviceLatency setup;
+        setup.inputDevice = deviceManager_.currentInputDevice().toStdString();
+        setup.outputDevice = deviceManager_.currentOutputDevice().toStdString();
+        setup.sampleRate = deviceManager_.sampleRate();
+        setup.bufferSamples = deviceManager_.bufferSize();
+        return setup;
+    }
+
+    // Uses the stored loopback measurement for this device pair; otherwise measures it (when
+    // enabled) or falls back to what the driver reports.
+    void applyRoundTripLatency()
+    {
+        const auto setup = currentDeviceSetup();
+        if (const auto* known = runtimeConfig_.latency.find(setup.inputDevice, setup.outputDevice, setup.sampleRate, setup.bufferSamples))
+        {
+            pipelineProcessor_.setRoundTripLatency(known->roundTripSamples);
+            return;
+        }
+
+        pipelineProcessor_.setRoundTripLatency(deviceManager_.reportedRoundTripSamples());
+        if (runtimeConfig_.latency.measureWhenUnknown && pipelineProcessor_.startLatencyMeasurement())
+        {
+            startTimer(kLatencyPollMs);
+        }
+    }
+
+    void timerCallback() override
+    {
+        if (pipelineProcessor_.isMeasuringLatency())
+        {
+            return;
+        }
+        stopTimer();
+
+        const auto measurement = pipelineProcessor_.latencyMeasurement();
+        if (!measurement.isValid)
+        {
+            return;
+        }
+
+        auto setup = currentDeviceSetup();
+        setup.roundTripSamples = measurement.roundTripSamples;
+        pipelineProcessor_.setRoundTripLatency(setup.roundTripSamples);
+        configLoader_.storeDeviceLatency(singwithme::config::ConfigLoader::latencyStorePath(), setup);
+        runtimeConfig_.latency.devices.push_back(setup);
+    }
+
+    static constexpr int kLatencyPollMs = 250;
+
+    // Everything the pipeline was configured with is declared before it, so it outlives it.
     std::unique_ptr<singwithme::ui::MainWindow> mainWindow_;
     singwithme::audio::DeviceManager deviceManager_;
-    singwithme::audio::PipelineProcessor pipelineProcessor_;
-#if TUNETRIX_ONNX_RUNTIME
-    Ort::Env ortEnv_{ORT_LOGGING_LEVEL_WARNING, "TuneTrix"};
-#else
-    Ort::Env ortEnv_{};
-#endif
+    Ort::Env& ortEnv_{singwithme::dsp::sharedOrtEnvironment()};
+    singwithme::config::ConfigLoader configLoader_;
+    singwithme::config::RuntimeConfig runtimeConfig_;
     std::unique_ptr<singwithme::dsp::VadProcessor> vad_;
     std::unique_ptr<singwithme::dsp::PitchProcessor> pitch_;
     singwithme::dsp::ConfidenceGate gate_;
-    singwithme::config::ConfigLoader configLoader_;
-    singwithme::config::RuntimeConfig runtimeConfig_;
     singwithme::calibration::Calibrator calibrator_;
+    singwithme::audio::PipelineProcessor pipelineProcessor_;
 };
 } // namespace
 START_JUCE_APPLICATION(TuneTrixApplication)
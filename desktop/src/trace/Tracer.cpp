@@ -0,0 +1,524 @@
+#include "trace/Tracer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <vector>
+
+namespace singwithme::trace
+{
+namespace
+{
+constexpr auto kFlushInterval = std::chrono::milliseconds(50);
+constexpr size_t kThreadNameLength = 48;
+// Slots only an End may take, so a zone whose Begin went in can always close.
+constexpr size_t kEndReserve = 32;
+constexpr const char* kFlowName = "Mic block";
+constexpr const char* kProcessName = "TuneTrix";
+
+uint64_t nowNs() noexcept
+{
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+uint64_t toBits(double value) noexcept
+{
+    uint64_t bits = 0;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+double fromBits(uint64_t bits) noexcept
+{
+    double value = 0.0;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+} // namespace
+
+// Sinks for drained events, on the flush thread only. Timestamps are relative to start().
+class TraceWriter
+{
+public:
+    virtual ~TraceWriter() = default;
+    virtual void thread(size_t index, const char* name) = 0;
+    virtual void event(size_t thread, const Event& event, uint64_t timestampNs) = 0;
+    virtual void finish(uint64_t droppedEvents) = 0;
+    bool good() const { return out_.good(); }
+
+protected:
+    explicit TraceWriter(const std::string& path) : out_(path, std::ios::binary | std::ios::trunc) {}
+
+    std::ofstream out_;
+};
+
+namespace
+{
+// Chrome's trace event format; Perfetto and chrome://tracing both open it.
+class ChromeJsonWriter final : public TraceWriter
+{
+public:
+    explicit ChromeJsonWriter(const std::string& path) : TraceWriter(path)
+    {
+        out_ << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+        out_ << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"" << kProcessName << "\"}}";
+    }
+
+    void thread(size_t index, const char* name) override
+    {
+        out_ << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << index << ",\"args\":{\"name\":";
+        writeString(name);
+        out_ << "}}";
+    }
+
+    void event(size_t thread, const Event& event, uint64_t timestampNs) override
+    {
+        const char* phase = "B";
+        switch (event.phase)
+        {
+            case Phase::Begin: phase = "B"; break;
+            case Phase::End: phase = "E"; break;
+            case Phase::Counter: phase = "C"; break;
+            case Phase::FlowStart: phase = "s"; break;
+            case Phase::FlowEnd: phase = "f"; break;
+        }
+
+        out_ << ",\n{\"name\":";
+        writeString(event.name);
+        out_ << ",\"ph\":\"" << phase << "\",\"ts\":" << timestampNs / 1000 << '.';
+        const auto fraction = static_cast<unsigned>(timestampNs % 1000);
+        out_ << static_cast<char>('0' + fraction / 100) << static_cast<char>('0' + fraction / 10 % 10)
+             << static_cast<char>('0' + fraction % 10);
+        out_ << ",\"pid\":1,\"tid\":" << thread;
+        if (event.phase == Phase::Counter)
+        {
+            out_ << ",\"args\":{\"value\":" << fromBits(event.value) << '}';
+        }
+        else if (event.phase == Phase::FlowStart || event.phase == Phase::FlowEnd)
+        {
+            // Bound to the enclosing slice at both ends.
+            out_ << ",\"cat\":\"flow\",\"id\":" << event.value << (event.phase == Phase::FlowEnd ? ",\"bp\":\"e\"" : "");
+        }
+        out_ << '}';
+    }
+
+    void finish(uint64_t droppedEvents) override
+    {
+        out_ << "\n],\"otherData\":{\"droppedEvents\":" << droppedEvents << "}}\n";
+        out_.flush();
+    }
+
+private:
+    void writeString(const char* text)
+    {
+        out_ << '"';
+        for (const char* c = text; *c != '\0'; ++c)
+        {
+            if (*c == '"' || *c == '\\')
+            {
+                out_ << '\\';
+            }
+            out_ << *c;
+        }
+        out_ << '"';
+    }
+};
+
+// Perfetto's TracePacket/TrackEvent protobuf, hand-encoded: one track per thread, one
+// counter track per counter name, one packet sequence per thread.
+class PerfettoWriter final : public TraceWriter
+{
+public:
+    explicit PerfettoWriter(const std::string& path) : TraceWriter(path)
+    {
+        std::string process;
+        varintField(process, kProcessPid, 1);
+        stringField(process, kProcessNameField, kProcessName);
+        std::string descriptor;
+        varintField(descriptor, kDescriptorUuid, kProcessUuid);
+        messageField(descriptor, kDescriptorProcess, process);
+        writeDescriptor(kDescriptorSequence, descriptor);
+    }
+
+    void thread(size_t index, const char* name) override
+    {
+        std::string thread;
+        varintField(thread, kThreadPid, 1);
+        varintField(thread, kThreadTid, index + 1);
+        stringField(thread, kThreadName, name);
+        std::string descriptor;
+        varintField(descriptor, kDescriptorUuid, threadUuid(index));
+        varintField(descriptor, kDescriptorParent, kProcessUuid);
+        messageField(descriptor, kDescriptorThread, thread);
+        writeDescriptor(index + 1, descriptor);
+    }
+
+    void event(size_t thread, const Event& event, uint64_t timestampNs) override
+    {
+        std::string trackEvent;
+        switch (event.phase)
+        {
+            case Phase::Begin:
+                varintField(trackEvent, kEventType, kTypeSliceBegin);
+                stringField(trackEvent, kEventName, event.name);
+                break;
+            case Phase::End:
+                varintField(trackEvent, kEventType, kTypeSliceEnd);
+                break;
+            case Phase::Counter:
+                varintField(trackEvent, kEventType, kTypeCounter);
+                fixed64Field(trackEvent, kEventDoubleCounter, event.value);
+                break;
+            case Phase::FlowStart:
+            case Phase::FlowEnd:
+                varintField(trackEvent, kEventType, kTypeInstant);
+                stringField(trackEvent, kEventName, event.name);
+                fixed64Field(trackEvent, event.phase == Phase::FlowStart ? kEventFlowIds : kEventTerminatingFlowIds, event.value);
+                break;
+        }
+        varintField(trackEvent, kEventTrackUuid, event.phase == Phase::Counter ? counterUuid(event.name) : threadUuid(thread));
+
+        std::string packet;
+        varintField(packet, kPacketTimestamp, timestampNs);
+        varintField(packet, kPacketSequenceId, thread + 1);
+        messageField(packet, kPacketTrackEvent, trackEvent);
+        writePacket(packet);
+    }
+
+    void finish(uint64_t) override
+    {
+        out_.flush();
+    }
+
+private:
+    // Field numbers from perfetto/protos/perfetto/trace.
+    static constexpr uint32_t kTracePacket = 1;
+    static constexpr uint32_t kPacketTimestamp = 8;
+    static constexpr uint32_t kPacketSequenceId = 10;
+    static constexpr uint32_t kPacketTrackEvent = 11;
+    static constexpr uint32_t kPacketSequenceFlags = 13;
+    static constexpr uint32_t kPacketTrackDescriptor = 60;
+    static constexpr uint32_t kDescriptorUuid = 1;
+    static constexpr uint32_t kDescriptorName = 2;
+    static constexpr uint32_t kDescriptorProcess = 3;
+    static constexpr uint32_t kDescriptorThread = 4;
+    static constexpr uint32_t kDescriptorParent = 5;
+    static constexpr uint32_t kDescriptorCounter = 8;
+    static constexpr uint32_t kProcessPid = 1;
+    static constexpr uint32_t kProcessNameField = 6;
+    static constexpr uint32_t kThreadPid = 1;
+    static constexpr uint32_t kThreadTid = 2;
+    static constexpr uint32_t kThreadName = 5;
+    static constexpr uint32_t kEventType = 9;
+    static constexpr uint32_t kEventTrackUuid = 11;
+    static constexpr uint32_t kEventName = 23;
+    static constexpr uint32_t kEventDoubleCounter = 44;
+    static constexpr uint32_t kEventFlowIds = 47;
+    static constexpr uint32_t kEventTerminatingFlowIds = 48;
+    static constexpr uint64_t kTypeSliceBegin = 1;
+    static constexpr uint64_t kTypeSliceEnd = 2;
+    static constexpr uint64_t kTypeInstant = 3;
+    static constexpr uint64_t kTypeCounter = 4;
+    static constexpr uint64_t kSequenceIncrementalStateCleared = 1;
+
+    static constexpr uint64_t kProcessUuid = 1;
+    static constexpr uint64_t kDescriptorSequence = Tracer::kMaxThreads + 1;
+
+    static uint64_t threadUuid(size_t index) { return 0x100 + index; }
+
+    uint64_t counterUuid(const char* name)
+    {
+        auto [it, inserted] = counters_.try_emplace(name, 0x10000 + counters_.size());
+        if (inserted)
+        {
+            std::string descriptor;
+            varintField(descriptor, kDescriptorUuid, it->second);
+            varintField(descriptor, kDescriptorParent, kProcessUuid);
+            stringField(descriptor, kDescriptorName, name);
+            messageField(descriptor, kDescriptorCounter, {});
+            writeDescriptor(kDescriptorSequence, descriptor);
+        }
+        return it->second;
+    }
+
+    static void varint(std::string& out, uint64_t value)
+    {
+        while (value >= 0x80)
+        {
+            out.push_back(static_cast<char>((value & 0x7F) | 0x80));
+            value >>= 7;
+        }
+        out.push_back(static_cast<char>(value));
+    }
+
+    static void varintField(std::string& out, uint32_t field, uint64_t value)
+    {
+        varint(out, static_cast<uint64_t>(field) << 3);
+        varint(out, value);
+    }
+
+    static void fixed64Field(std::string& out, uint32_t field, uint64_t value)
+    {
+        varint(out, (static_cast<uint64_t>(field) << 3) | 1);
+        for (int byte = 0; byte < 8; ++byte)
+        {
+            out.push_back(static_cast<char>((value >> (8 * byte)) & 0xFF));
+        }
+    }
+
+    static void messageField(std::string& out, uint32_t field, const std::string& message)
+    {
+        varint(out, (static_cast<uint64_t>(field) << 3) | 2);
+        varint(out, message.size());
+        out += message;
+    }
+
+    static void stringField(std::string& out, uint32_t field, const char* text)
+    {
+        messageField(out, field, std::string(text));
+    }
+
+    void writeDescriptor(uint64_t sequence, const std::string& descriptor)
+    {
+        std::string packet;
+        varintField(packet, kPacketSequenceId, sequence);
+        if (!started_[static_cast<size_t>(sequence)])
+        {
+            started_[static_cast<size_t>(sequence)] = true;
+            varintField(packet, kPacketSequenceFlags, kSequenceIncrementalStateCleared);
+        }
+        messageField(packet, kPacketTrackDescriptor, descriptor);
+        writePacket(packet);
+    }
+
+    void writePacket(const std::string& packet)
+    {
+        std::string framed;
+        messageField(framed, kTracePacket, packet);
+        out_.write(framed.data(), static_cast<std::streamsize>(framed.size()));
+    }
+
+    std::map<std::string, uint64_t> counters_;
+    std::array<bool, Tracer::kMaxThreads + 2> started_{};
+};
+} // namespace
+
+struct Tracer::ThreadBuffer
+{
+    std::unique_ptr<Event[]> events;
+    size_t mask{0};
+    std::atomic<size_t> head{0}; // written by the owning thread
+    std::atomic<size_t> tail{0}; // written by the flush thread
+    std::atomic<uint64_t> dropped{0};
+    std::array<char, kThreadNameLength> name{};
+    std::atomic<bool> named{false};
+};
+
+Tracer& Tracer::instance()
+{
+    static Tracer tracer;
+    return tracer;
+}
+
+Tracer::~Tracer()
+{
+    stop();
+}
+
+bool Tracer::start(const std::string& path, size_t eventsPerThread)
+{
+    const std::lock_guard<std::mutex> lock(mutex_);
+    if (writer_ != nullptr)
+    {
+        return false;
+    }
+
+    const auto extension = std::filesystem::path(path).extension();
+    if (extension == ".json")
+    {
+        writer_ = std::make_unique<ChromeJsonWriter>(path);
+    }
+    else
+    {
+        writer_ = std::make_unique<PerfettoWriter>(path);
+    }
+    if (!writer_->good())
+    {
+        writer_.reset();
+        return false;
+    }
+
+    if (capacity_ == 0)
+    {
+        capacity_ = 4 * kEndReserve;
+        while (capacity_ < eventsPerThread)
+        {
+            capacity_ <<= 1;
+        }
+        for (auto& buffer : buffers_)
+        {
+            buffer = std::make_unique<ThreadBuffer>();
+            buffer->events = std::make_unique<Event[]>(capacity_);
+            buffer->mask = capacity_ - 1;
+        }
+    }
+    // Anything a thread slipped in after the last stop() belongs to no trace.
+    for (auto& buffer : buffers_)
+    {
+        buffer->tail.store(buffer->head.load(std::memory_order_acquire), std::memory_order_release);
+        buffer->dropped.store(0, std::memory_order_relaxed);
+    }
+    described_.fill(Description::None);
+    originNs_ = nowNs();
+    stopping_ = false;
+    flusher_ = std::thread([this] { flushLoop(); });
+    enabled_.store(true, std::memory_order_release);
+    return true;
+}
+
+void Tracer::stop()
+{
+    {
+        const std::lock_guard<std::mutex> lock(mutex_);
+        if (writer_ == nullptr)
+        {
+            return;
+        }
+        enabled_.store(false, std::memory_order_release);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    flusher_.join();
+
+    const std::lock_guard<std::mutex> lock(mutex_);
+    writer_->finish(droppedEvents());
+    writer_.reset();
+}
+
+bool Tracer::isRecording() const
+{
+    return enabled();
+}
+
+uint64_t Tracer::droppedEvents() const
+{
+    uint64_t dropped = 0;
+    for (const auto& buffer : buffers_)
+    {
+        if (buffer != nullptr)
+        {
+            dropped += buffer->dropped.load(std::memory_order_relaxed);
+        }
+    }
+    return dropped;
+}
+
+Tracer::ThreadBuffer* Tracer::threadBuffer() noexcept
+{
+    // A thread keeps its slot for the life of the process; the first kMaxThreads threads
+    // that record get one and any later thread is not traced.
+    static thread_local ThreadBuffer* buffer = nullptr;
+    static thread_local bool claimed = false;
+    if (!claimed)
+    {
+        claimed = true;
+        const size_t index = claimed_.fetch_add(1, std::memory_order_acq_rel);
+        buffer = index < kMaxThreads ? buffers_[index].get() : nullptr;
+    }
+    return buffer;
+}
+
+bool Tracer::record(Phase phase, const char* name, uint64_t value) noexcept
+{
+    auto* buffer = threadBuffer();
+    if (buffer == nullptr)
+    {
+        return false;
+    }
+
+    const size_t head = buffer->head.load(std::memory_order_relaxed);
+    const size_t used = head - buffer->tail.load(std::memory_order_acquire);
+    if (used + (phase == Phase::End ? 0 : kEndReserve) > buffer->mask)
+    {
+        buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    buffer->events[head & buffer->mask] = Event{nowNs(), name, value, phase};
+    buffer->head.store(head + 1, std::memory_order_release);
+    return true;
+}
+
+void Tracer::nameThread(const char* name) noexcept
+{
+    auto* buffer = threadBuffer();
+    if (buffer == nullptr || buffer->named.load(std::memory_order_relaxed))
+    {
+        return;
+    }
+    std::strncpy(buffer->name.data(), name, buffer->name.size() - 1);
+    buffer->named.store(true, std::memory_order_release);
+}
+
+void Tracer::flushLoop()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stopping_)
+    {
+        wake_.wait_for(lock, kFlushInterval, [this] { return stopping_; });
+        drain();
+    }
+}
+
+void Tracer::drain()
+{
+    const size_t threads = std::min(claimed_.load(std::memory_order_acquire), kMaxThreads);
+    for (size_t index = 0; index < threads; ++index)
+    {
+        auto& buffer = *buffers_[index];
+        const size_t head = buffer.head.load(std::memory_order_acquire);
+        size_t tail = buffer.tail.load(std::memory_order_relaxed);
+        const bool named = buffer.named.load(std::memory_order_acquire);
+        // A thread that records before naming itself gets a placeholder track first; the
+        // name replaces it once it arrives.
+        if (named && described_[index] != Description::Named)
+        {
+            writer_->thread(index, buffer.name.data());
+            described_[index] = Description::Named;
+        }
+        else if (described_[index] == Description::None && head != tail)
+        {
+            writer_->thread(index, "Thread");
+            described_[index] = Description::Placeholder;
+        }
+        for (; tail != head; ++tail)
+        {
+            const Event& event = buffer.events[tail & buffer.mask];
+            writer_->event(index, event, event.timestampNs > originNs_ ? event.timestampNs - originNs_ : 0);
+        }
+        buffer.tail.store(tail, std::memory_order_release);
+    }
+}
+
+void counter(const char* name, double value) noexcept
+{
+    Tracer::instance().record(Phase::Counter, name, toBits(value));
+}
+
+void flowStart(uint64_t id) noexcept
+{
+    currentFlow() = Tracer::instance().record(Phase::FlowStart, kFlowName, id) ? id : 0;
+}
+
+void flowEnd() noexcept
+{
+    if (const uint64_t id = currentFlow(); id != 0)
+    {
+        currentFlow() = 0;
+        Tracer::instance().record(Phase::FlowEnd, kFlowName, id);
+    }
+}
+} // namespace singwithme::trace
@@ -0,0 +1,162 @@
+// Simulated clock drift through dsp::AsrcBridge: an input device and an output device run
+// on independent clocks with jittered callback timestamps, and the bridge has to hold its
+// latency on target without dropouts for an hour of audio. No hardware is needed.
+
+#include "dsp/AsrcBridge.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace
+{
+constexpr double kPi = 3.14159265358979323846;
+constexpr double kToneHz = 997.0;
+
+struct Scenario
+{
+    const char* name;
+    double inputRate;
+    double outputRate;
+    double driftPpm;
+    size_t inputBlock;
+    size_t outputBlock;
+    double minutes;
+};
+
+// Residual against the best-fitting tone at kToneHz, in dB below the tone.
+double toneSnrDb(const std::vector<float>& samples, double sampleRate)
+{
+    double ss = 0.0, sc = 0.0, cc = 0.0, ys = 0.0, yc = 0.0;
+    for (size_t i = 0; i < samples.size(); ++i)
+    {
+        const double phase = 2.0 * kPi * kToneHz * static_cast<double>(i) / sampleRate;
+        const double s = std::sin(phase);
+        const double c = std::cos(phase);
+        ss += s * s;
+        sc += s * c;
+        cc += c * c;
+        ys += s * samples[i];
+        yc += c * samples[i];
+    }
+    const double det = ss * cc - sc * sc;
+    const double a = (ys * cc - yc * sc) / det;
+    const double b = (ss * yc - sc * ys) / det;
+
+    double signal = 0.0;
+    double error = 0.0;
+    for (size_t i = 0; i < samples.size(); ++i)
+    {
+        const double phase = 2.0 * kPi * kToneHz * static_cast<double>(i) / sampleRate;
+        const double model = a * std::sin(phase) + b * std::cos(phase);
+        signal += model * model;
+        error += (samples[i] - model) * (samples[i] - model);
+    }
+    return 10.0 * std::log10(signal / std::max(error, 1.0e-20));
+}
+
+bool run(const Scenario& scenario)
+{
+    singwithme::dsp::AsrcBridge bridge;
+    bridge.prepare(scenario.inputRate, scenario.outputRate, scenario.inputBlock, scenario.outputBlock, 480);
+
+    // The input clock is off by driftPpm; both callbacks see up to 1 ms of scheduling jitter.
+    const double trueInputRate = scenario.inputRate * (1.0 + scenario.driftPpm * 1.0e-6);
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<double> jitter(0.0, 0.001);
+
+    std::vector<float> input(scenario.inputBlock);
+    std::vector<float> output(scenario.outputBlock);
+    std::vector<float> tail;
+    uint64_t inputIndex = 0;
+    double inputTime = 0.0;
+    double outputTime = 0.0;
+    const double end = scenario.minutes * 60.0;
+    const double settle = 120.0;
+
+    double minFill = 1.0e9;
+    double maxFill = -1.0e9;
+    double correctionSum = 0.0;
+    uint64_t correctionCount = 0;
+    uint32_t dropoutsAfterLock = 0;
+    bool settled = false;
+    uint32_t baseUnderruns = 0;
+    uint32_t baseOverruns = 0;
+
+    while (outputTime < end)
+    {
+        if (inputTime <= outputTime)
+        {
+            for (size_t i = 0; i < input.size(); ++i)
+            {
+                input[i] = static_cast<float>(0.5 * std::sin(2.0 * kPi * kToneHz * static_cast<double>(inputIndex + i) / trueInputRate));
+            }
+            inputIndex += input.size();
+            bridge.push(input.data(), input.size(), inputTime + jitter(rng));
+            inputTime += static_cast<double>(input.size()) / trueInputRate;
+            continue;
+        }
+
+        bridge.pull(output.data(), output.size(), outputTime + jitter(rng));
+        outputTime += static_cast<double>(output.size()) / scenario.outputRate;
+
+        if (!settled && outputTime >= settle)
+        {
+            settled = true;
+            baseUnderruns = bridge.underruns();
+            baseOverruns = bridge.overruns();
+        }
+        if (settled)
+        {
+            minFill = std::min(minFill, bridge.fillSamples());
+            maxFill = std::max(maxFill, bridge.fillSamples());
+            correctionSum += bridge.ratioCorrection();
+            ++correctionCount;
+        }
+        if (outputTime > end - 1.0)
+        {
+            tail.insert(tail.end(), output.begin(), output.end());
+        }
+    }
+    dropoutsAfterLock = (bridge.underruns() - baseUnderruns) + (bridge.overruns() - baseOverruns);
+
+    // The ratio the loop settles on must cancel the drift: (1 + c) = (1 + drift).
+    const double correctionPpm = correctionSum / static_cast<double>(std::max<uint64_t>(correctionCount, 1)) * 1.0e6;
+    const double target = static_cast<double>(bridge.targetFillSamples());
+    const double snrDb = toneSnrDb(tail, scenario.outputRate);
+
+    const bool ok = dropoutsAfterLock == 0
+                    && std::abs(correctionPpm - scenario.driftPpm) < 2.0
+                    && minFill > target - 8.0 && maxFill < target + 8.0
+                    && snrDb > 40.0;
+    std::printf("%-28s drift %+7.1f ppm  corrected %+8.2f ppm  fill %.1f..%.1f (target %.0f)  dropouts %u  SNR %.1f dB  %s\n",
+                scenario.name,
+                scenario.driftPpm,
+                correctionPpm,
+                minFill,
+                maxFill,
+                target,
+                dropoutsAfterLock,
+                snrDb,
+                ok ? "ok" : "FAILED");
+    return ok;
+}
+} // namespace
+
+int main()
+{
+    const Scenario scenarios[] = {
+        {"48k -> 48k, fast input", 48000.0, 48000.0, 200.0, 480, 128, 60.0},
+        {"48k -> 48k, slow input", 48000.0, 48000.0, -350.0, 256, 64, 20.0},
+        {"44.1k -> 48k, odd blocks", 44100.0, 48000.0, -150.0, 441, 128, 20.0},
+    };
+
+    bool ok = true;
+    for (const auto& scenario : scenarios)
+    {
+        ok = run(scenario) && ok;
+    }
+    return ok ? 0 : 1;
+}
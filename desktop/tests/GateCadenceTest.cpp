@@ -0,0 +1,100 @@
+// dsp::ConfidenceGate driven by pitch windows: pitch windows cut by dsp::SlidingWindow at each
+// models.pitchHopMs setting are pushed to the gate as time-stamped frames between 128-sample
+// audio blocks, as PipelineProcessor::feedModels() does. The gate has to take one decision
+// frame per window, and open framesOn windows after a singer's entry, so its cadence follows
+// the hop rather than the audio block or the core's 64 ms pitch hop.
+
+#include "dsp/ConfidenceGate.h"
+#include "dsp/SlidingWindow.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+namespace
+{
+constexpr double kDeviceRate = 48000.0;
+constexpr double kModelRate = 16000.0;
+constexpr size_t kBlock = 128;
+constexpr size_t kWindow = 1024;
+constexpr int kFramesOn = 3;
+constexpr double kSeconds = 2.0;
+constexpr double kEntrySeconds = 0.5;
+constexpr float kOpenDb = -12.0f;
+
+bool run(double hopMs)
+{
+    const auto hop = static_cast<size_t>(hopMs * kModelRate / 1000.0);
+    singwithme::dsp::SlidingWindow windows;
+    windows.prepare(kWindow, hop, 8);
+
+    singwithme::dsp::GateConfig config;
+    // Fast ramps both ways, so the gain crosses kOpenDb within a block of the decision.
+    config.attackMs = 1.0f;
+    config.releaseMs = 1.0f;
+    config.framesOn = kFramesOn;
+    config.predictiveOpen = false;
+    singwithme::dsp::ConfidenceGate gate;
+    gate.configure(static_cast<float>(kDeviceRate), kBlock, config);
+    gate.setPitchFrames(true, 0.0f, 1.0f);
+
+    // The singer enters at kEntrySeconds; a window is confident once most of it is sung.
+    const auto entry = static_cast<uint64_t>(kEntrySeconds * kModelRate);
+    const std::vector<float> feed(kBlock, 0.0f);
+    const auto blocks = static_cast<size_t>(kSeconds * kDeviceRate / static_cast<double>(kBlock));
+    uint64_t fed = 0;
+    double firstConfidentMs = -1.0;
+    double openMs = -1.0;
+    for (size_t b = 0; b < blocks; ++b)
+    {
+        // The model feed's share of this block: 128 samples at 48 kHz are 42 or 43 at 16 kHz.
+        const auto target = static_cast<uint64_t>(static_cast<double>((b + 1) * kBlock) * kModelRate / kDeviceRate);
+        const size_t due = windows.push(feed.data(), static_cast<size_t>(target - fed));
+        fed = target;
+        for (size_t i = 0; i < due; ++i)
+        {
+            const uint64_t end = windows.windowEnd(i);
+            const bool confident = end >= entry + kWindow / 2;
+            if (confident && firstConfidentMs < 0.0)
+            {
+                firstConfidentMs = 1000.0 * static_cast<double>(end) / kModelRate;
+            }
+            gate.pushPitchFrame(confident ? 0.9f : 0.1f, end);
+            // The same window pushed again is not another frame.
+            gate.pushPitchFrame(confident ? 0.9f : 0.1f, end);
+        }
+        const float gainDb = gate.update(0.0f, 0.0f, 0.0f);
+        if (gainDb >= kOpenDb && openMs < 0.0)
+        {
+            openMs = 1000.0 * static_cast<double>((b + 1) * kBlock) / kDeviceRate;
+        }
+    }
+
+    // Every window from the first full one on is a frame.
+    const auto expectedFrames = static_cast<uint64_t>((fed - kWindow) / hop + 1);
+    const double expectedOpenMs = firstConfidentMs + (kFramesOn - 1) * hopMs;
+    const double blockMs = 1000.0 * static_cast<double>(kBlock) / kDeviceRate;
+    const bool ok = gate.pitchFrameCount() == expectedFrames
+                    && firstConfidentMs >= 0.0
+                    && openMs >= expectedOpenMs - blockMs && openMs <= expectedOpenMs + 2.0 * blockMs;
+    std::printf("hop %5.1f ms  frames %4llu (expected %4llu)  opens %6.1f ms after the first confident window (expected %6.1f)  %s\n",
+                hopMs,
+                static_cast<unsigned long long>(gate.pitchFrameCount()),
+                static_cast<unsigned long long>(expectedFrames),
+                openMs - firstConfidentMs,
+                expectedOpenMs - firstConfidentMs,
+                ok ? "ok" : "FAILED");
+    return ok;
+}
+} // namespace
+
+int main()
+{
+    bool ok = true;
+    for (const double hopMs : {10.0, 16.0, 32.0, 64.0})
+    {
+        ok = run(hopMs) && ok;
+    }
+    return ok ? 0 : 1;
+}
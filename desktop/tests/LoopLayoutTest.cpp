@@ -0,0 +1,120 @@
+// dsp::LoopLayout around the loop boundary: a loop with material before its start crossfades
+// into it without a step, one with less pre-roll than the fade shortens the fade to fit, and
+// a whole-song loop (nothing before its start) wraps unfaded instead of fading out to silence.
+
+#include "dsp/LoopLayout.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+namespace
+{
+constexpr double kPi = 3.14159265358979323846;
+constexpr double kSampleRate = 48000.0;
+constexpr size_t kCrossfade = 480;
+
+struct Scenario
+{
+    const char* name;
+    int64_t loopStart;
+    int64_t loopEnd;
+    int64_t expectedCrossfade;
+};
+
+std::vector<float> toneStem(int64_t length)
+{
+    std::vector<float> stem(static_cast<size_t>(length));
+    for (size_t i = 0; i < stem.size(); ++i)
+    {
+        stem[i] = static_cast<float>(0.5 * std::sin(2.0 * kPi * 220.0 * static_cast<double>(i) / kSampleRate));
+    }
+    return stem;
+}
+
+bool run(const Scenario& scenario, const std::vector<float>& stem)
+{
+    singwithme::dsp::LoopLayout layout;
+    layout.prepare(kCrossfade);
+
+    const auto stemLength = static_cast<int64_t>(stem.size());
+    const singwithme::dsp::PlaybackSpan span{scenario.loopStart, scenario.loopStart, scenario.loopEnd};
+    const int64_t period = scenario.loopEnd - scenario.loopStart;
+    const int64_t crossfade = layout.crossfadeLength(span);
+
+    // Three passes rendered in odd-sized blocks, so block edges land inside the crossfade.
+    std::vector<float> out(static_cast<size_t>(3 * period));
+    for (int64_t offset = 0; offset < 3 * period;)
+    {
+        const int64_t count = std::min<int64_t>(97, 3 * period - offset);
+        layout.render(stem.data(), stemLength, span, offset, out.data() + offset, count);
+        offset += count;
+    }
+
+    // Every pass matches the first, and nothing before the crossfade is touched.
+    float passError = 0.0f;
+    float untouchedError = 0.0f;
+    for (int64_t i = 0; i < period; ++i)
+    {
+        passError = std::max(passError, std::abs(out[static_cast<size_t>(i + period)] - out[static_cast<size_t>(i)]));
+        passError = std::max(passError, std::abs(out[static_cast<size_t>(i + 2 * period)] - out[static_cast<size_t>(i)]));
+        if (i < period - crossfade)
+        {
+            untouchedError = std::max(untouchedError, std::abs(out[static_cast<size_t>(i)] - stem[static_cast<size_t>(scenario.loopStart + i)]));
+        }
+    }
+
+    // Across the wrap the output moves no more than the tone does from one sample to the next,
+    // with some slack for the fade's own slope.
+    float maxToneStep = 0.0f;
+    for (size_t i = 1; i < stem.size(); ++i)
+    {
+        maxToneStep = std::max(maxToneStep, std::abs(stem[i] - stem[i - 1]));
+    }
+    const float wrapStep = std::abs(out[static_cast<size_t>(period)] - out[static_cast<size_t>(period - 1)]);
+
+    // Without pre-roll the loop's last sample is the stem's own, not faded out.
+    const float lastSample = out[static_cast<size_t>(period - 1)];
+    const float stemLast = stem[static_cast<size_t>(scenario.loopEnd - 1)];
+    const bool unfadedEnd = crossfade > 0 || lastSample == stemLast;
+
+    bool ok = crossfade == scenario.expectedCrossfade && passError == 0.0f && untouchedError == 0.0f && unfadedEnd;
+    if (crossfade > 0)
+    {
+        ok = ok && wrapStep <= 2.0f * maxToneStep;
+    }
+    std::printf("%-32s crossfade %4lld (expected %4lld)  wrap step %.4f (tone %.4f)  end %+.4f (stem %+.4f)  %s\n",
+                scenario.name,
+                static_cast<long long>(crossfade),
+                static_cast<long long>(scenario.expectedCrossfade),
+                wrapStep,
+                maxToneStep,
+                lastSample,
+                stemLast,
+                ok ? "ok" : "FAILED");
+    return ok;
+}
+} // namespace
+
+int main()
+{
+    const int64_t songLength = 48000 * 4;
+    const auto stem = toneStem(songLength);
+
+    const Scenario scenarios[] = {
+        {"region with full pre-roll", 48000, 96000, static_cast<int64_t>(kCrossfade)},
+        {"region with short pre-roll", 100, 24000, 100},
+        {"short region", 48000, 48600, 300},
+        {"whole-song loop", 0, songLength, 0},
+        {"region from the song's start", 0, 24000, 0},
+    };
+
+    bool ok = true;
+    for (const auto& scenario : scenarios)
+    {
+        ok = run(scenario, stem) && ok;
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,727 @@
+// Pipeline replay: recorded or synthesised mic fixtures are fed through
+// audio::PipelineProcessor in fixed-size blocks on this thread alone. Every scenario is
+// checked against tolerances that need no recorded output: the audio stays finite and under
+// a peak, a second run reproduces the first, and the gate is open while the fixture's voice
+// sings and ducked while it rests. The output audio, the per-block metrics and the gate's
+// open/close times are then compared against the golden files under
+// desktop/tests/golden/<inference>/; a scenario without them fails. Run with --update to
+// (re)write the golden files for this inference build after a change that is meant to alter
+// the output.
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <juce_audio_devices/juce_audio_devices.h>
+#include <juce_audio_formats/juce_audio_formats.h>
+#include <juce_events/juce_events.h>
+
+#include "audio/PipelineProcessor.h"
+#include "dsp/ModelStore.h"
+#include "dsp/Resampler.h"
+
+#ifndef TUNETRIX_REPLAY_ROOT
+ #define TUNETRIX_REPLAY_ROOT "."
+#endif
+
+namespace
+{
+using namespace singwithme;
+
+constexpr const char* kScenarioFile = "desktop/tests/replay/scenarios.json";
+#if TUNETRIX_ONNX_RUNTIME
+constexpr const char* kGoldenDir = "desktop/tests/golden/onnx";
+#else
+constexpr const char* kGoldenDir = "desktop/tests/golden/stub";
+#endif
+// Golden audio is stored as 24-bit FLAC this far down, so overs survive the integer format.
+constexpr float kGoldenHeadroom = 0.25f;
+constexpr int kOutputChannels = 2;
+
+// Per-block metrics, one CSV column each after the block's start time.
+constexpr const char* kMetricNames[] = {"input_rms", "output_rms", "vad", "pitch", "confidence", "strength", "gate_db", "pitch_ratio"};
+constexpr size_t kMetricCount = std::size(kMetricNames);
+constexpr float kMetricTolerance[kMetricCount] = {1.0e-4f, 1.0e-4f, 0.02f, 0.02f, 0.02f, 0.02f, 0.5f, 0.01f};
+constexpr size_t kGateDbColumn = 6;
+// A block of the fixture's voice on its own counts as sung above this level and as a rest
+// below the second; blocks in between are not judged.
+constexpr float kSungDb = -40.0f;
+constexpr float kRestDb = -60.0f;
+
+struct Options
+{
+    bool update{false};
+    std::string filter;
+    std::string outputDir;
+    double gateToleranceMs{5.0};
+    float maxAbsError{1.0e-4f};
+};
+
+// Floors and ceilings every run must meet on top of the golden comparison, so a golden file
+// recorded from a broken build cannot pass on its own. The stems mix to well under full scale,
+// so any over is a fault.
+struct Expectations
+{
+    float maxPeak{1.0f};
+    float openWhileSung{0.8f};
+    float duckedWhileResting{0.8f};
+};
+
+struct Scenario
+{
+    std::string name;
+    std::string configPath;
+    int blockSize{128};
+    juce::var mic;
+    Expectations expect;
+};
+
+struct Replay
+{
+    double sampleRate{48000.0};
+    juce::AudioBuffer<float> output;
+    std::vector<double> blockStartMs;
+    std::vector<std::array<float, kMetricCount>> metrics;
+    std::vector<float> voiceDb; // per block, the fixture's voice alone; empty for a recording
+};
+
+struct GateEvent
+{
+    bool open{false};
+    double timeMs{0.0};
+};
+
+// A fixed xorshift generator rather than <random> distributions, whose output differs
+// between standard libraries.
+class NoiseSource
+{
+public:
+    explicit NoiseSource(uint32_t seed) : state_(seed != 0 ? seed : 0x9e3779b9u) {}
+
+    float next()
+    {
+        state_ ^= state_ << 13;
+        state_ ^= state_ >> 17;
+        state_ ^= state_ << 5;
+        return static_cast<float>(state_) / 2147483648.0f - 1.0f;
+    }
+
+private:
+    uint32_t state_;
+};
+
+float dbToGain(double db)
+{
+    return static_cast<float>(std::pow(10.0, db / 20.0));
+}
+
+// Channel 0 of a WAV, resampled to the pipeline rate when the file differs.
+bool readMono(const std::string& path, double sampleRate, std::vector<float>& samples)
+{
+    juce::AudioFormatManager formats;
+    formats.registerBasicFormats();
+    const std::unique_ptr<juce::AudioFormatReader> reader(formats.createReaderFor(juce::File::getCurrentWorkingDirectory().getChildFile(path)));
+    if (reader == nullptr || reader->lengthInSamples <= 0)
+    {
+        return false;
+    }
+
+    const auto length = static_cast<int>(reader->lengthInSamples);
+    juce::AudioBuffer<float> buffer(1, length);
+    reader->read(&buffer, 0, length, 0, true, false);
+    if (std::abs(reader->sampleRate - sampleRate) < 1.0e-6)
+    {
+        samples.assign(buffer.getReadPointer(0), buffer.getReadPointer(0) + length);
+        return true;
+    }
+
+    dsp::Resampler resampler;
+    resampler.prepare(reader->sampleRate, sampleRate, dsp::ResamplerQuality::SincBest, 0);
+    samples.resize(dsp::Resampler::outputLength(static_cast<size_t>(length), reader->sampleRate, sampleRate));
+    resampler.render(buffer.getReadPointer(0), static_cast<size_t>(length), samples.data(), 0, samples.size());
+    return true;
+}
+
+// Either a recording ("path") or a singer built from a stem ("voice") with delayed bleed
+// from another and seeded noise, so fixtures need not be checked in as audio.
+bool buildMic(const juce::var& spec, double sampleRate, size_t length, std::vector<float>& mic, std::string& error)
+{
+    mic.assign(length, 0.0f);
+    const auto addFile = [&](const juce::String& path, double gainDb, double delayMs)
+    {
+        std::vector<float> source;
+        if (!readMono(path.toStdString(), sampleRate, source))
+        {
+            error = "cannot read " + path.toStdString();
+            return false;
+        }
+        const float gain = dbToGain(gainDb);
+        const auto delay = static_cast<size_t>(std::max(0.0, delayMs) * sampleRate / 1000.0);
+        for (size_t i = delay; i < length && i - delay < source.size(); ++i)
+        {
+            mic[i] += gain * source[i - delay];
+        }
+        return true;
+    };
+
+    if (spec.hasProperty("path"))
+    {
+        return addFile(spec["path"].toString(), 0.0, 0.0);
+    }
+    if (spec.hasProperty("voice") && !addFile(spec["voice"].toString(), spec.getProperty("voiceGainDb", 0.0), 0.0))
+    {
+        return false;
+    }
+    if (spec.hasProperty("bleed")
+        && !addFile(spec["bleed"].toString(), spec.getProperty("bleedGainDb", -20.0), spec.getProperty("bleedDelayMs", 0.0)))
+    {
+        return false;
+    }
+    if (spec.hasProperty("noiseDb"))
+    {
+        NoiseSource noise(static_cast<uint32_t>(static_cast<int>(spec.getProperty("seed", 1))));
+        const float gain = dbToGain(spec["noiseDb"]);
+        for (auto& sample : mic)
+        {
+            sample += gain * noise.next();
+        }
+    }
+    return true;
+}
+
+// The "voice" part of a synthesised fixture on its own, at the level it is mixed at.
+bool buildVoice(const juce::var& spec, double sampleRate, size_t length, std::vector<float>& voice, std::string& error)
+{
+    auto* voiceOnly = new juce::DynamicObject();
+    voiceOnly->setProperty("voice", spec["voice"]);
+    voiceOnly->setProperty("voiceGainDb", spec.getProperty("voiceGainDb", 0.0));
+    return buildMic(juce::var(voiceOnly), sampleRate, length, voice, error);
+}
+
+float blockDb(const float* samples, size_t count)
+{
+    double sum = 0.0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        sum += static_cast<double>(samples[i]) * static_cast<double>(samples[i]);
+    }
+    return static_cast<float>(10.0 * std::log10(sum / static_cast<double>(count) + 1.0e-20));
+}
+
+dsp::GateConfig makeGateConfig(const config::GateParams& params)
+{
+    dsp::GateConfig gateConfig;
+    gateConfig.lookAheadMs = params.lookAheadMs;
+    gateConfig.attackMs = params.attackMs;
+    gateConfig.releaseMs = params.releaseMs;
+    gateConfig.holdMs = params.holdMs;
+    gateConfig.thresholdOn = params.thresholdOn;
+    gateConfig.thresholdOff = params.thresholdOff;
+    gateConfig.framesOn = params.framesOn;
+    gateConfig.framesOff = params.framesOff;
+    gateConfig.duckDb = params.duckDb;
+    gateConfig.predictiveOpen = params.predictiveOpen;
+    return gateConfig;
+}
+
+// Everything that could run concurrently is settled before the first block: configure()
+// waits for both stems and the guide analysis, the device rate matches the config so no
+// rate conversion starts, the setlist is empty, and the models run single-threaded.
+bool runScenario(const Scenario& scenario, double seconds, Replay& replay, float& duckDb, std::string& error)
+{
+    config::RuntimeConfig runtimeConfig = config::ConfigLoader{}.loadFromFile(scenario.configPath);
+    runtimeConfig.bufferSamples = scenario.blockSize;
+    runtimeConfig.setlist.songs.clear();
+    duckDb = runtimeConfig.gate.duckDb;
+    replay.sampleRate = runtimeConfig.sampleRate;
+
+    const auto length = static_cast<size_t>(seconds * runtimeConfig.sampleRate);
+    std::vector<float> mic;
+    if (!buildMic(scenario.mic, runtimeConfig.sampleRate, length, mic, error))
+    {
+        return false;
+    }
+    std::vector<float> voice;
+    if (scenario.mic.hasProperty("voice") && !buildVoice(scenario.mic, runtimeConfig.sampleRate, length, voice, error))
+    {
+        return false;
+    }
+
+    Ort::Env& env = dsp::sharedOrtEnvironment();
+    dsp::ConfidenceGate gate;
+    dsp::VadProcessor vad(env);
+    dsp::PitchProcessor pitch(env);
+    calibration::Calibrator calibrator;
+    audio::PipelineProcessor processor;
+
+    gate.configure(static_cast<float>(runtimeConfig.sampleRate), static_cast<size_t>(scenario.blockSize), makeGateConfig(runtimeConfig.gate));
+    vad.loadModel(runtimeConfig.vadModelPath);
+    pitch.loadModel(runtimeConfig.pitchModelPath);
+    processor.setOrtEnvironment(env);
+    processor.configure(runtimeConfig, gate, vad, pitch, calibrator);
+    processor.audioDeviceAboutToStart(nullptr);
+
+    const auto blockSize = static_cast<size_t>(scenario.blockSize);
+    const size_t blocks = length / blockSize;
+    replay.output.setSize(kOutputChannels, static_cast<int>(blocks * blockSize));
+    replay.output.clear();
+    replay.blockStartMs.clear();
+    replay.metrics.clear();
+    replay.voiceDb.clear();
+
+    const juce::AudioIODeviceCallbackContext context{};
+    for (size_t block = 0; block < blocks; ++block)
+    {
+        const size_t start = block * blockSize;
+        const float* inputs[] = {mic.data() + start};
+        float* outputs[kOutputChannels];
+        for (int ch = 0; ch < kOutputChannels; ++ch)
+        {
+            outputs[ch] = replay.output.getWritePointer(ch, static_cast<int>(start));
+        }
+        processor.audioDeviceIOCallbackWithContext(inputs, 1, outputs, kOutputChannels, scenario.blockSize, context);
+
+        const auto m = processor.getMetrics();
+        replay.blockStartMs.push_back(1000.0 * static_cast<double>(start) / runtimeConfig.sampleRate);
+        replay.metrics.push_back({m.inputRms, m.outputRms, m.vad, m.pitch, m.confidence, m.strength, m.gateDb, m.guidePitchRatio});
+        if (!voice.empty())
+        {
+            replay.voiceDb.push_back(blockDb(voice.data() + start, blockSize));
+        }
+    }
+    processor.audioDeviceStopped();
+    return true;
+}
+
+// Open when the gate rises through the midpoint (in dB) between its floor and 0 dB, closed
+// when it falls back through it.
+std::vector<GateEvent> gateEvents(const Replay& replay, float duckDb)
+{
+    const float midpoint = 0.5f * duckDb;
+    std::vector<GateEvent> events;
+    bool open = false;
+    for (size_t i = 0; i < replay.metrics.size(); ++i)
+    {
+        const bool nowOpen = replay.metrics[i][kGateDbColumn] > midpoint;
+        if (nowOpen != open)
+        {
+            events.push_back({nowOpen, replay.blockStartMs[i]});
+            open = nowOpen;
+        }
+    }
+    return events;
+}
+
+bool checkExpectations(const Replay& replay, float duckDb, const Expectations& expect)
+{
+    bool ok = true;
+    float peak = 0.0f;
+    bool finite = true;
+    for (int ch = 0; ch < replay.output.getNumChannels(); ++ch)
+    {
+        const float* samples = replay.output.getReadPointer(ch);
+        for (int i = 0; i < replay.output.getNumSamples(); ++i)
+        {
+            finite = finite && std::isfinite(samples[i]);
+            peak = std::max(peak, std::abs(samples[i]));
+        }
+    }
+    if (!finite || peak > expect.maxPeak)
+    {
+        std::printf("  output: %s, peak %.3g (limit %.3g)\n", finite ? "finite" : "NOT FINITE", static_cast<double>(peak), static_cast<double>(expect.maxPeak));
+        ok = false;
+    }
+
+    if (replay.voiceDb.empty())
+    {
+        return ok;
+    }
+    const float midpoint = 0.5f * duckDb;
+    size_t sung = 0;
+    size_t openWhileSung = 0;
+    size_t resting = 0;
+    size_t duckedWhileResting = 0;
+    for (size_t i = 0; i < replay.voiceDb.size(); ++i)
+    {
+        const bool open = replay.metrics[i][kGateDbColumn] > midpoint;
+        if (replay.voiceDb[i] > kSungDb)
+        {
+            ++sung;
+            openWhileSung += open ? 1 : 0;
+        }
+        else if (replay.voiceDb[i] < kRestDb)
+        {
+            ++resting;
+            duckedWhileResting += open ? 0 : 1;
+        }
+    }
+    const auto share = [](size_t part, size_t whole) { return whole > 0 ? static_cast<float>(part) / static_cast<float>(whole) : 1.0f; };
+    const float open = share(openWhileSung, sung);
+    const float ducked = share(duckedWhileResting, resting);
+    std::printf("  gate: open for %.0f%% of %zu sung blocks (min %.0f%%), ducked for %.0f%% of %zu rests (min %.0f%%)\n",
+                100.0 * static_cast<double>(open), sung, 100.0 * static_cast<double>(expect.openWhileSung),
+                100.0 * static_cast<double>(ducked), resting, 100.0 * static_cast<double>(expect.duckedWhileResting));
+    return ok && open >= expect.openWhileSung && ducked >= expect.duckedWhileResting;
+}
+
+juce::File goldenFile(const std::string& directory, const std::string& name, const char* extension)
+{
+    return juce::File::getCurrentWorkingDirectory().getChildFile(directory).getChildFile(name + extension);
+}
+
+bool writeAudio(const juce::File& file, const juce::AudioBuffer<float>& audio, double sampleRate)
+{
+    file.getParentDirectory().createDirectory();
+    file.deleteFile();
+    auto stream = file.createOutputStream();
+    if (stream == nullptr)
+    {
+        return false;
+    }
+    juce::FlacAudioFormat flac;
+    std::unique_ptr<juce::AudioFormatWriter> writer(
+        flac.createWriterFor(stream.get(), sampleRate, static_cast<unsigned int>(audio.getNumChannels()), 24, {}, 0));
+    if (writer == nullptr)
+    {
+        return false;
+    }
+    stream.release();
+
+    juce::AudioBuffer<float> scaled;
+    scaled.makeCopyOf(audio);
+    scaled.applyGain(kGoldenHeadroom);
+    return writer->writeFromAudioSampleBuffer(scaled, 0, scaled.getNumSamples());
+}
+
+bool readAudio(const juce::File& file, juce::AudioBuffer<float>& audio)
+{
+    juce::FlacAudioFormat flac;
+    const std::unique_ptr<juce::AudioFormatReader> reader(flac.createReaderFor(file.createInputStream().release(), true));
+    if (reader == nullptr)
+    {
+        return false;
+    }
+    audio.setSize(static_cast<int>(reader->numChannels), static_cast<int>(reader->lengthInSamples));
+    reader->read(&audio, 0, audio.getNumSamples(), 0, true, true);
+    audio.applyGain(1.0f / kGoldenHeadroom);
+    return true;
+}
+
+bool writeMetrics(const juce::File& file, const Replay& replay)
+{
+    file.getParentDirectory().createDirectory();
+    juce::String text("time_ms");
+    for (const char* name : kMetricNames)
+    {
+        text << "," << name;
+    }
+    text << "\n";
+    for (size_t i = 0; i < replay.metrics.size(); ++i)
+    {
+        text << juce::String(replay.blockStartMs[i], 3);
+        for (const float value : replay.metrics[i])
+        {
+            text << "," << juce::String(value, 6);
+        }
+        text << "\n";
+    }
+    return file.replaceWithText(text);
+}
+
+bool readMetrics(const juce::File& file, Replay& replay)
+{
+    juce::StringArray lines;
+    file.readLines(lines);
+    lines.removeEmptyStrings();
+    if (lines.isEmpty())
+    {
+        return false;
+    }
+    for (int i = 1; i < lines.size(); ++i)
+    {
+        const auto fields = juce::StringArray::fromTokens(lines[i], ",", "");
+        if (fields.size() != static_cast<int>(kMetricCount) + 1)
+        {
+            return false;
+        }
+        replay.blockStartMs.push_back(fields[0].getDoubleValue());
+        std::array<float, kMetricCount> row{};
+        for (size_t c = 0; c < kMetricCount; ++c)
+        {
+            row[c] = fields[static_cast<int>(c) + 1].getFloatValue();
+        }
+        replay.metrics.push_back(row);
+    }
+    return true;
+}
+
+bool compareAudio(const juce::AudioBuffer<float>& actual, const juce::AudioBuffer<float>& golden, float tolerance, const Scenario& scenario)
+{
+    if (actual.getNumChannels() != golden.getNumChannels() || actual.getNumSamples() != golden.getNumSamples())
+    {
+        std::printf("  audio: shape %dx%d, golden %dx%d\n",
+                    actual.getNumChannels(), actual.getNumSamples(), golden.getNumChannels(), golden.getNumSamples());
+        return false;
+    }
+    float worst = 0.0f;
+    int worstChannel = 0;
+    int worstSample = 0;
+    for (int ch = 0; ch < actual.getNumChannels(); ++ch)
+    {
+        const float* a = actual.getReadPointer(ch);
+        const float* g = golden.getReadPointer(ch);
+        for (int i = 0; i < actual.getNumSamples(); ++i)
+        {
+            const float error = std::abs(a[i] - g[i]);
+            if (error > worst)
+            {
+                worst = error;
+                worstChannel = ch;
+                worstSample = i;
+            }
+        }
+    }
+    const bool ok = worst <= tolerance;
+    std::printf("  audio: max abs error %.3g (limit %.3g) at channel %d, block %d\n",
+                static_cast<double>(worst), static_cast<double>(tolerance), worstChannel, worstSample / scenario.blockSize);
+    return ok;
+}
+
+bool compareMetrics(const Replay& actual, const Replay& golden)
+{
+    if (actual.metrics.size() != golden.metrics.size())
+    {
+        std::printf("  metrics: %zu blocks, golden %zu\n", actual.metrics.size(), golden.metrics.size());
+        return false;
+    }
+    bool ok = true;
+    for (size_t c = 0; c < kMetricCount; ++c)
+    {
+        float worst = 0.0f;
+        size_t worstBlock = 0;
+        for (size_t i = 0; i < actual.metrics.size(); ++i)
+        {
+            const float error = std::abs(actual.metrics[i][c] - golden.metrics[i][c]);
+            if (error > worst)
+            {
+                worst = error;
+                worstBlock = i;
+            }
+        }
+        if (worst > kMetricTolerance[c])
+        {
+            std::printf("  metrics: %s off by %.3g (limit %.3g) at %.1f ms\n",
+                        kMetricNames[c], static_cast<double>(worst), static_cast<double>(kMetricTolerance[c]), actual.blockStartMs[worstBlock]);
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+bool compareGate(const std::vector<GateEvent>& actual, const std::vector<GateEvent>& golden, double toleranceMs)
+{
+    bool ok = actual.size() == golden.size();
+    double worst = 0.0;
+    for (size_t i = 0; i < std::min(actual.size(), golden.size()); ++i)
+    {
+        const double shift = actual[i].timeMs - golden[i].timeMs;
+        if (actual[i].open != golden[i].open || std::abs(shift) > toleranceMs)
+        {
+            std::printf("  gate: %s at %.1f ms, golden %s at %.1f ms (%+.1f ms, limit %.1f)\n",
+                        actual[i].open ? "open" : "close", actual[i].timeMs,
+                        golden[i].open ? "open" : "close", golden[i].timeMs, shift, toleranceMs);
+            ok = false;
+        }
+        worst = std::max(worst, std::abs(shift));
+    }
+    if (actual.size() != golden.size())
+    {
+        std::printf("  gate: %zu transitions, golden %zu\n", actual.size(), golden.size());
+    }
+    std::printf("  gate: %zu transitions, largest shift %.1f ms\n", actual.size(), worst);
+    return ok;
+}
+
+std::vector<Scenario> loadScenarios(double& seconds)
+{
+    std::vector<Scenario> scenarios;
+    const auto manifest = juce::JSON::parse(juce::File::getCurrentWorkingDirectory().getChildFile(kScenarioFile));
+    seconds = manifest.getProperty("seconds", 12.0);
+    if (const auto* list = manifest["scenarios"].getArray())
+    {
+        for (const auto& entry : *list)
+        {
+            Expectations expect;
+            const auto limits = entry["expect"];
+            expect.maxPeak = static_cast<float>(static_cast<double>(limits.getProperty("maxPeak", expect.maxPeak)));
+            expect.openWhileSung = static_cast<float>(static_cast<double>(limits.getProperty("openWhileSung", expect.openWhileSung)));
+            expect.duckedWhileResting = static_cast<float>(static_cast<double>(limits.getProperty("duckedWhileResting", expect.duckedWhileResting)));
+            scenarios.push_back({entry["name"].toString().toStdString(),
+                                 entry["config"].toString().toStdString(),
+                                 static_cast<int>(entry.getProperty("blockSize", 128)),
+                                 entry["mic"],
+                                 expect});
+        }
+    }
+    return scenarios;
+}
+
+void printUsage()
+{
+    std::fprintf(stderr,
+                 "Usage: PipelineReplayTest [--update] [--filter=<substring>] [--gate-ms=<ms>] [--max-abs=<error>]\n"
+                 "                          [--out=<dir>] [--root=<repo>]\n"
+                 "--update rewrites the golden files; --out keeps this run's audio and metrics for diffing.\n");
+}
+
+bool startsWith(const std::string& text, const char* prefix, std::string& rest)
+{
+    const std::string head(prefix);
+    if (text.rfind(head, 0) != 0)
+    {
+        return false;
+    }
+    rest = text.substr(head.size());
+    return true;
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+    Options options;
+    std::string root = TUNETRIX_REPLAY_ROOT;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg(argv[i]);
+        std::string value;
+        if (arg == "--update")
+        {
+            options.update = true;
+        }
+        else if (startsWith(arg, "--filter=", value))
+        {
+            options.filter = value;
+        }
+        else if (startsWith(arg, "--gate-ms=", value))
+        {
+            options.gateToleranceMs = std::atof(value.c_str());
+        }
+        else if (startsWith(arg, "--max-abs=", value))
+        {
+            options.maxAbsError = static_cast<float>(std::atof(value.c_str()));
+        }
+        else if (startsWith(arg, "--out=", value))
+        {
+            options.outputDir = juce::File::getCurrentWorkingDirectory().getChildFile(value).getFullPathName().toStdString();
+        }
+        else if (startsWith(arg, "--root=", value))
+        {
+            root = value;
+        }
+        else
+        {
+            printUsage();
+            return arg == "--help" ? 0 : 2;
+        }
+    }
+
+    // Configs, models, fixtures and golden files are all relative to the repository root.
+    if (!juce::File::getCurrentWorkingDirectory().getChildFile(root).setAsCurrentWorkingDirectory())
+    {
+        std::fprintf(stderr, "Cannot enter %s\n", root.c_str());
+        return 2;
+    }
+    const juce::ScopedJuceInitialiser_GUI juce;
+
+    double seconds = 12.0;
+    const auto scenarios = loadScenarios(seconds);
+    if (scenarios.empty())
+    {
+        std::fprintf(stderr, "No scenarios in %s\n", kScenarioFile);
+        return 2;
+    }
+
+    int failures = 0;
+    for (const auto& scenario : scenarios)
+    {
+        if (!options.filter.empty() && scenario.name.find(options.filter) == std::string::npos)
+        {
+            continue;
+        }
+
+        std::printf("%s (%d-sample blocks, %s)\n", scenario.name.c_str(), scenario.blockSize, scenario.configPath.c_str());
+        Replay replay;
+        float duckDb = -80.0f;
+        std::string error;
+        if (!runScenario(scenario, seconds, replay, duckDb, error))
+        {
+            std::printf("  error: %s\n", error.c_str());
+            ++failures;
+            continue;
+        }
+
+        const auto audioFile = goldenFile(kGoldenDir, scenario.name, ".flac");
+        const auto metricsFile = goldenFile(kGoldenDir, scenario.name, ".csv");
+        if (options.update)
+        {
+            if (!writeAudio(audioFile, replay.output, replay.sampleRate) || !writeMetrics(metricsFile, replay))
+            {
+                std::printf("  error: cannot write %s\n", audioFile.getParentDirectory().getFullPathName().toRawUTF8());
+                ++failures;
+                continue;
+            }
+            std::printf("  updated %s, %zu gate transitions\n", audioFile.getFullPathName().toRawUTF8(), gateEvents(replay, duckDb).size());
+            continue;
+        }
+
+        if (!options.outputDir.empty())
+        {
+            writeAudio(goldenFile(options.outputDir, scenario.name, ".flac"), replay.output, replay.sampleRate);
+            writeMetrics(goldenFile(options.outputDir, scenario.name, ".csv"), replay);
+        }
+
+        bool ok = checkExpectations(replay, duckDb, scenario.expect);
+
+        // Nothing in the replay may depend on timing or leftover state: a second run matches.
+        Replay repeat;
+        if (!runScenario(scenario, seconds, repeat, duckDb, error))
+        {
+            std::printf("  error: %s\n", error.c_str());
+            ++failures;
+            continue;
+        }
+        std::printf("  repeat run:\n");
+        ok = compareAudio(repeat.output, replay.output, options.maxAbsError, scenario) && ok;
+        ok = compareMetrics(repeat, replay) && ok;
+
+        if (!audioFile.existsAsFile() || !metricsFile.existsAsFile())
+        {
+            std::printf("  missing golden files in %s; record them with --update in this inference build\n", kGoldenDir);
+            ok = false;
+        }
+        else
+        {
+            Replay golden;
+            if (!readAudio(audioFile, golden.output) || !readMetrics(metricsFile, golden))
+            {
+                std::printf("  error: cannot read the golden files\n");
+                ++failures;
+                continue;
+            }
+            std::printf("  golden files:\n");
+            ok = compareAudio(replay.output, golden.output, options.maxAbsError, scenario) && ok;
+            ok = compareMetrics(replay, golden) && ok;
+            ok = compareGate(gateEvents(replay, duckDb), gateEvents(golden, duckDb), options.gateToleranceMs) && ok;
+        }
+        std::printf("  %s\n", ok ? "ok" : "FAILED");
+        failures += ok ? 0 : 1;
+    }
+
+    return failures > 0 ? 1 : 0;
+}
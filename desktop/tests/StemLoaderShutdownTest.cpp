@@ -0,0 +1,91 @@
+// StemLoader shutdown with work still queued: a two-thread pool is handed far more
+// resample jobs than it can finish, then shut down. Every future must resolve, the ones
+// cut short to false, and a load queued after shutdown must resolve to false as well.
+
+#include <cmath>
+#include <cstdio>
+#include <exception>
+#include <future>
+#include <vector>
+
+#include <juce_audio_formats/juce_audio_formats.h>
+
+#include "audio/StemLoader.h"
+
+namespace
+{
+using namespace singwithme;
+
+constexpr int kJobs = 32;
+constexpr int kChannels = 2;
+constexpr int kSamples = 1 << 20;
+constexpr double kSourceRate = 44100.0;
+constexpr double kTargetRate = 48000.0;
+
+juce::AudioBuffer<float> makeStem()
+{
+    juce::AudioBuffer<float> buffer(kChannels, kSamples);
+    for (int ch = 0; ch < kChannels; ++ch)
+    {
+        auto* samples = buffer.getWritePointer(ch);
+        for (int i = 0; i < kSamples; ++i)
+        {
+            samples[i] = 0.5f * std::sin(0.0314f * static_cast<float>(i));
+        }
+    }
+    return buffer;
+}
+
+// 1 when the future resolved to true, 0 when to false, -1 when it threw.
+int resolve(std::future<bool>& future)
+{
+    try
+    {
+        return future.get() ? 1 : 0;
+    }
+    catch (const std::exception& e)
+    {
+        std::printf("  future threw: %s\n", e.what());
+        return -1;
+    }
+}
+} // namespace
+
+int main()
+{
+    juce::AudioFormatManager formatManager;
+    audio::StemLoader loader(formatManager, 2);
+    loader.setResamplerQuality(dsp::ResamplerQuality::SincBest);
+
+    std::vector<std::future<bool>> futures;
+    for (int i = 0; i < kJobs; ++i)
+    {
+        futures.push_back(loader.resample(makeStem(), kSourceRate, kTargetRate, nullptr));
+    }
+    loader.shutdown();
+    auto late = loader.resample(makeStem(), kSourceRate, kTargetRate, nullptr);
+
+    int completed = 0;
+    int cancelled = 0;
+    int broken = 0;
+    for (auto& future : futures)
+    {
+        const int result = resolve(future);
+        completed += result > 0 ? 1 : 0;
+        cancelled += result == 0 ? 1 : 0;
+        broken += result < 0 ? 1 : 0;
+    }
+
+    const int lateResult = resolve(late);
+
+    // Two threads cannot finish this many stems before shutdown() runs.
+    const bool ok = broken == 0 && cancelled > 0 && lateResult == 0;
+    std::printf("%d loads: %d completed, %d cancelled, %d broken; after shutdown: %s  %s\n",
+                kJobs,
+                completed,
+                cancelled,
+                broken,
+                lateResult == 0 ? "cancelled" : lateResult > 0 ? "completed" : "broken",
+                ok ? "ok" : "FAILED");
+    return ok ? 0 : 1;
+}
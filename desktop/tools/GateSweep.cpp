@@ -0,0 +1,388 @@
+#include "GateSweep.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <thread>
+
+#include "dsp/Resampler.h"
+
+namespace singwithme::tools
+{
+namespace
+{
+constexpr size_t kVadFrameSamples = 160;   // 10 ms @ 16 kHz, as VadProcessor expects
+constexpr float kOpenDb = -12.0f;          // the gate counts as open once the guide is this loud
+constexpr double kPreRollMs = 100.0;       // opening this early for an entry is not a false open
+constexpr size_t kLeaderCount = 10;
+
+constexpr std::array<ParamRange, kParamCount> kRanges{{
+    {"thresholdOn", 0.2f, 0.95f, 0.05f, 0.01f, false},
+    {"thresholdOff", 0.05f, 0.9f, 0.05f, 0.01f, false},
+    {"framesOn", 1.0f, 10.0f, 1.0f, 1.0f, true},
+    {"framesOff", 1.0f, 30.0f, 2.0f, 1.0f, true},
+    {"attackMs", 1.0f, 100.0f, 8.0f, 1.0f, false},
+    {"releaseMs", 20.0f, 800.0f, 40.0f, 5.0f, false},
+    {"holdMs", 0.0f, 600.0f, 40.0f, 5.0f, false},
+    {"vadWeight", 0.0f, 1.0f, 0.1f, 0.02f, false},
+}};
+
+// The grid covers what decides when the gate flips; time constants start from the base
+// config and are left to the refinement.
+struct GridAxis
+{
+    Param param;
+    std::vector<float> values;
+};
+
+const std::vector<GridAxis>& gridAxes()
+{
+    static const std::vector<GridAxis> axes{
+        {Param::ThresholdOn, {0.5f, 0.6f, 0.7f, 0.8f}},
+        {Param::ThresholdOff, {0.2f, 0.3f, 0.4f, 0.5f}},
+        {Param::FramesOn, {1.0f, 2.0f, 3.0f, 5.0f}},
+        {Param::FramesOff, {3.0f, 6.0f, 10.0f}},
+        {Param::VadWeight, {0.4f, 0.6f, 0.8f}},
+    };
+    return axes;
+}
+
+float& at(ParamVector& params, Param param)
+{
+    return params[static_cast<size_t>(param)];
+}
+
+float at(const ParamVector& params, Param param)
+{
+    return params[static_cast<size_t>(param)];
+}
+
+ParamVector constrain(ParamVector params)
+{
+    for (size_t i = 0; i < kParamCount; ++i)
+    {
+        const auto& range = kRanges[i];
+        params[i] = std::clamp(range.integer ? std::round(params[i]) : params[i], range.min, range.max);
+    }
+    at(params, Param::ThresholdOff) = std::min(at(params, Param::ThresholdOff), at(params, Param::ThresholdOn));
+    return params;
+}
+
+// Runs every point across the worker threads; each worker pulls the next unscored index.
+std::vector<Score> scoreAll(const std::vector<ParamVector>& points,
+                            const std::vector<InferenceTrace>& traces,
+                            const dsp::GateConfig& base,
+                            const SearchSettings& settings)
+{
+    std::vector<Score> scores(points.size());
+    std::atomic<size_t> next{0};
+    const auto worker = [&]
+    {
+        for (size_t i = next.fetch_add(1); i < points.size(); i = next.fetch_add(1))
+        {
+            scores[i] = evaluate(makeCandidate(points[i], base), traces, settings.sampleRate, settings.blockSize, settings.weights);
+        }
+    };
+
+    const unsigned threads = std::max(1u, settings.threads != 0 ? settings.threads : std::thread::hardware_concurrency());
+    std::vector<std::thread> pool;
+    for (unsigned t = 1; t < std::min<size_t>(threads, points.size()); ++t)
+    {
+        pool.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : pool)
+    {
+        thread.join();
+    }
+    return scores;
+}
+} // namespace
+
+InferenceTrace buildTrace(const float* mic,
+                          size_t length,
+                          double sampleRate,
+                          size_t blockSize,
+                          double modelSampleRate,
+                          dsp::VadProcessor& vad,
+                          dsp::PitchProcessor& pitch,
+                          std::vector<std::pair<double, double>> segments)
+{
+    InferenceTrace trace;
+    trace.blockSeconds = static_cast<double>(blockSize) / sampleRate;
+    std::sort(segments.begin(), segments.end());
+    trace.segments = std::move(segments);
+
+    dsp::Resampler decimator;
+    decimator.prepare(sampleRate, modelSampleRate, dsp::ResamplerQuality::SincFast, 0);
+    std::vector<float> decimated(dsp::Resampler::outputLength(length, sampleRate, modelSampleRate));
+    decimator.render(mic, length, decimated.data(), 0, decimated.size());
+
+    vad.resetState();
+    std::vector<float> vadFrames(decimated.size() / kVadFrameSamples);
+    for (size_t f = 0; f < vadFrames.size(); ++f)
+    {
+        vadFrames[f] = vad.processFrame(decimated.data() + f * kVadFrameSamples, kVadFrameSamples);
+    }
+
+    // A block only sees results for frames that were complete by its last sample. Pitch is
+    // streamed block by block, so its sliding windows land where the configured hop puts them.
+    const size_t blocks = length / blockSize;
+    trace.vad.resize(blocks);
+    trace.pitch.resize(blocks);
+    trace.pitchFrameEnd.resize(blocks);
+    trace.voiced.resize(blocks);
+    size_t pitchFed = 0;
+    size_t segment = 0;
+    for (size_t b = 0; b < blocks; ++b)
+    {
+        const size_t produced = std::min(dsp::Resampler::outputLength((b + 1) * blockSize, sampleRate, modelSampleRate), decimated.size());
+        const size_t vadReady = std::min(produced / kVadFrameSamples, vadFrames.size());
+        trace.vad[b] = vadReady > 0 ? vadFrames[vadReady - 1] : 0.0f;
+        // A block feeds fewer model-rate samples than the shortest hop, so at most one
+        // window ends in it.
+        size_t windows = 0;
+        if (produced > pitchFed)
+        {
+            windows = pitch.push(decimated.data() + pitchFed, produced - pitchFed);
+            pitchFed = produced;
+        }
+        trace.pitch[b] = pitch.latestEstimate().confidence;
+        trace.pitchFrameEnd[b] = windows > 0 ? pitch.latestEstimate().endSample : 0;
+
+        const double middle = (static_cast<double>(b) + 0.5) * trace.blockSeconds;
+        while (segment < trace.segments.size() && trace.segments[segment].second <= middle)
+        {
+            ++segment;
+        }
+        trace.voiced[b] = segment < trace.segments.size() && trace.segments[segment].first <= middle ? 1 : 0;
+    }
+    return trace;
+}
+
+const ParamRange& paramRange(Param param)
+{
+    return kRanges[static_cast<size_t>(param)];
+}
+
+Candidate makeCandidate(const ParamVector& params, const dsp::GateConfig& base)
+{
+    Candidate candidate;
+    candidate.gate = base;
+    candidate.gate.thresholdOn = at(params, Param::ThresholdOn);
+    candidate.gate.thresholdOff = std::min(at(params, Param::ThresholdOff), candidate.gate.thresholdOn);
+    candidate.gate.framesOn = static_cast<int>(std::lround(at(params, Param::FramesOn)));
+    candidate.gate.framesOff = static_cast<int>(std::lround(at(params, Param::FramesOff)));
+    candidate.gate.attackMs = at(params, Param::AttackMs);
+    candidate.gate.releaseMs = at(params, Param::ReleaseMs);
+    candidate.gate.holdMs = at(params, Param::HoldMs);
+    candidate.vadWeight = at(params, Param::VadWeight);
+    candidate.pitchWeight = 1.0f - candidate.vadWeight;
+    return candidate;
+}
+
+ParamVector paramsFrom(const dsp::GateConfig& gate, float vadWeight, float pitchWeight)
+{
+    ParamVector params{};
+    at(params, Param::ThresholdOn) = gate.thresholdOn;
+    at(params, Param::ThresholdOff) = gate.thresholdOff;
+    at(params, Param::FramesOn) = static_cast<float>(gate.framesOn);
+    at(params, Param::FramesOff) = static_cast<float>(gate.framesOff);
+    at(params, Param::AttackMs) = gate.attackMs;
+    at(params, Param::ReleaseMs) = gate.releaseMs;
+    at(params, Param::HoldMs) = gate.holdMs;
+    // The search keeps the two weights summing to one, as the defaults do.
+    const float total = vadWeight + pitchWeight;
+    at(params, Param::VadWeight) = total > 0.0f ? vadWeight / total : 0.5f;
+    return constrain(params);
+}
+
+Score evaluate(const Candidate& candidate,
+               const std::vector<InferenceTrace>& traces,
+               float sampleRate,
+               size_t blockSize,
+               const ScoreWeights& weights)
+{
+    Score score;
+    size_t voicedBlocks = 0;
+    size_t mutedBlocks = 0;
+    double latencySumMs = 0.0;
+    std::vector<uint8_t> open;
+
+    for (const auto& trace : traces)
+    {
+        dsp::ConfidenceGate gate;
+        gate.configure(sampleRate, blockSize, candidate.gate);
+        gate.setPitchFrames(true, candidate.vadWeight, candidate.pitchWeight);
+        const size_t blocks = trace.vad.size();
+        open.assign(blocks, 0);
+        for (size_t b = 0; b < blocks; ++b)
+        {
+            const float vad = trace.vad[b];
+            const float pitch = trace.pitch[b];
+            const float confidence = std::clamp(candidate.vadWeight * vad + candidate.pitchWeight * pitch, 0.0f, 1.0f);
+            // As in the pipeline, a window's frame lands before the core's update for the block.
+            if (trace.pitchFrameEnd[b] != 0)
+            {
+                gate.pushPitchFrame(pitch, trace.pitchFrameEnd[b]);
+            }
+            open[b] = gate.update(confidence, vad, pitch) >= kOpenDb ? 1 : 0;
+            voicedBlocks += trace.voiced[b];
+            mutedBlocks += trace.voiced[b] != 0 && open[b] == 0 ? 1 : 0;
+        }
+        score.minutes += static_cast<double>(blocks) * trace.blockSeconds / 60.0;
+
+        // Block b's gain is what the guide reaches by the block's end.
+        const auto blockEnd = [&](size_t b) { return static_cast<double>(b + 1) * trace.blockSeconds; };
+        for (const auto& [start, end] : trace.segments)
+        {
+            const auto first = static_cast<size_t>(std::max(0.0, start / trace.blockSeconds));
+            if (first >= blocks)
+            {
+                continue;
+            }
+            ++score.onsets;
+            if (first > 0 && open[first - 1] != 0)
+            {
+                continue; // still open from the previous phrase: no added latency
+            }
+            // Slow openings cost latency; an entry is only missed if the phrase ends first.
+            bool found = false;
+            for (size_t b = first; b < blocks && blockEnd(b) <= end + trace.blockSeconds; ++b)
+            {
+                if (open[b] != 0)
+                {
+                    latencySumMs += std::max(0.0, blockEnd(b) - start) * 1000.0;
+                    found = true;
+                    break;
+                }
+            }
+            score.missedOnsets += found ? 0 : 1;
+        }
+
+        size_t segment = 0;
+        for (size_t b = 0; b < blocks; ++b)
+        {
+            if (open[b] == 0 || (b > 0 && open[b - 1] != 0))
+            {
+                continue;
+            }
+            const double time = blockEnd(b);
+            while (segment < trace.segments.size() && trace.segments[segment].second < time)
+            {
+                ++segment;
+            }
+            const bool expected = segment < trace.segments.size()
+                                  && trace.segments[segment].first - kPreRollMs / 1000.0 <= time;
+            score.falseOpens += expected ? 0 : 1;
+        }
+    }
+
+    const int detected = score.onsets - score.missedOnsets;
+    score.meanLatencyMs = detected > 0 ? latencySumMs / detected : 0.0;
+    score.mutedVoiceFraction = voicedBlocks > 0 ? static_cast<double>(mutedBlocks) / static_cast<double>(voicedBlocks) : 0.0;
+    const double missRate = score.onsets > 0 ? static_cast<double>(score.missedOnsets) / score.onsets : 0.0;
+    const double falsePerMinute = score.minutes > 0.0 ? score.falseOpens / score.minutes : 0.0;
+    score.cost = weights.missedOnset * missRate + weights.falseOpen * falsePerMinute
+                 + weights.latency * score.meanLatencyMs + weights.mutedVoice * score.mutedVoiceFraction;
+    return score;
+}
+
+SearchResult search(const std::vector<InferenceTrace>& traces,
+                    const dsp::GateConfig& base,
+                    float vadWeight,
+                    float pitchWeight,
+                    const SearchSettings& settings)
+{
+    SearchResult result;
+    const ParamVector start = paramsFrom(base, vadWeight, pitchWeight);
+
+    std::vector<ParamVector> grid{start};
+    for (const auto& axis : gridAxes())
+    {
+        std::vector<ParamVector> expanded;
+        expanded.reserve(grid.size() * axis.values.size());
+        for (const auto& point : grid)
+        {
+            for (const float value : axis.values)
+            {
+                auto next = point;
+                at(next, axis.param) = value;
+                expanded.push_back(next);
+            }
+        }
+        grid = std::move(expanded);
+    }
+    grid.erase(std::remove_if(grid.begin(), grid.end(),
+                              [](const ParamVector& p) { return at(p, Param::ThresholdOff) > at(p, Param::ThresholdOn); }),
+               grid.end());
+    grid.push_back(start);
+
+    const auto gridScores = scoreAll(grid, traces, base, settings);
+    result.evaluations = grid.size();
+    std::vector<size_t> order(grid.size());
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return gridScores[a].cost < gridScores[b].cost; });
+    for (size_t i = 0; i < std::min(kLeaderCount, order.size()); ++i)
+    {
+        result.leaders.emplace_back(grid[order[i]], gridScores[order[i]]);
+    }
+
+    ParamVector current = grid[order.front()];
+    Score currentScore = gridScores[order.front()];
+    std::array<float, kParamCount> steps{};
+    for (size_t i = 0; i < kParamCount; ++i)
+    {
+        steps[i] = kRanges[i].step;
+    }
+
+    for (int round = 0; round < settings.maxRounds; ++round)
+    {
+        std::vector<ParamVector> neighbours;
+        for (size_t i = 0; i < kParamCount; ++i)
+        {
+            if (steps[i] < kRanges[i].minStep)
+            {
+                continue;
+            }
+            for (const float direction : {-1.0f, 1.0f})
+            {
+                auto next = current;
+                next[i] += direction * steps[i];
+                next = constrain(next);
+                if (next != current)
+                {
+                    neighbours.push_back(next);
+                }
+            }
+        }
+        if (neighbours.empty())
+        {
+            break;
+        }
+
+        const auto scores = scoreAll(neighbours, traces, base, settings);
+        result.evaluations += neighbours.size();
+        const auto best = std::min_element(scores.begin(), scores.end(), [](const Score& a, const Score& b) { return a.cost < b.cost; });
+        if (best->cost < currentScore.cost)
+        {
+            current = neighbours[static_cast<size_t>(best - scores.begin())];
+            currentScore = *best;
+        }
+        else
+        {
+            for (auto& step : steps)
+            {
+                step *= 0.5f;
+            }
+        }
+    }
+
+    result.params = current;
+    result.score = currentScore;
+    return result;
+}
+} // namespace singwithme::tools
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "dsp/ConfidenceGate.h"
+#include "dsp/PitchProcessor.h"
+#include "dsp/VadProcessor.h"
+
+namespace singwithme::tools
+{
+// One labelled recording reduced to what the gate sees per audio block: the latest VAD and
+// pitch results the models had produced by the end of that block, at the pitch processor's
+// configured hop, and the end of the pitch window that landed in the block, which the gate
+// takes as a decision frame. Built once per recording,
+// then replayed read-only by every candidate, so inference never runs twice.
+struct InferenceTrace
+{
+    double blockSeconds{128.0 / 48000.0};
+    std::vector<float> vad;
+    std::vector<float> pitch;
+    std::vector<uint64_t> pitchFrameEnd; // 0 where no pitch window ended in the block
+    std::vector<uint8_t> voiced;                     // labelled vocal activity per block
+    std::vector<std::pair<double, double>> segments; // labelled [start, end) in seconds
+};
+
+InferenceTrace buildTrace(const float* mic,
+                          size_t length,
+                          double sampleRate,
+                          size_t blockSize,
+                          double modelSampleRate,
+                          dsp::VadProcessor& vad,
+                          dsp::PitchProcessor& pitch,
+                          std::vector<std::pair<double, double>> segments);
+
+// The tuned parameters, flattened so the search can step any of them the same way.
+enum class Param
+{
+    ThresholdOn,
+    ThresholdOff,
+    FramesOn,
+    FramesOff,
+    AttackMs,
+    ReleaseMs,
+    HoldMs,
+    VadWeight,
+    Count
+};
+
+constexpr size_t kParamCount = static_cast<size_t>(Param::Count);
+using ParamVector = std::array<float, kParamCount>;
+
+struct ParamRange
+{
+    const char* name;
+    float min;
+    float max;
+    float step;    // initial coordinate step; halved whenever a round finds no improvement
+    float minStep; // refinement stops once every step is below this
+    bool integer;
+};
+
+const ParamRange& paramRange(Param param);
+
+struct Candidate
+{
+    dsp::GateConfig gate;
+    float vadWeight{0.6f};
+    float pitchWeight{0.4f};
+};
+
+// Parameters outside the vector (look-ahead, duck depth, predictive open) come from base.
+Candidate makeCandidate(const ParamVector& params, const dsp::GateConfig& base);
+ParamVector paramsFrom(const dsp::GateConfig& gate, float vadWeight, float pitchWeight);
+
+struct ScoreWeights
+{
+    float missedOnset{10.0f}; // per fraction of labelled phrases the gate never opened for
+    float falseOpen{1.0f};    // per false open per minute
+    float latency{0.05f};     // per ms of mean onset latency
+    float mutedVoice{5.0f};   // per fraction of labelled voice left below the open level
+};
+
+struct Score
+{
+    int onsets{0};
+    int missedOnsets{0};
+    int falseOpens{0};
+    double meanLatencyMs{0.0};
+    double mutedVoiceFraction{0.0};
+    double minutes{0.0};
+    double cost{0.0};
+};
+
+Score evaluate(const Candidate& candidate,
+               const std::vector<InferenceTrace>& traces,
+               float sampleRate,
+               size_t blockSize,
+               const ScoreWeights& weights);
+
+struct SearchSettings
+{
+    float sampleRate{48000.0f};
+    size_t blockSize{128};
+    ScoreWeights weights;
+    unsigned threads{0}; // 0 = one per core
+    int maxRounds{40};
+};
+
+struct SearchResult
+{
+    ParamVector params{};
+    Score score;
+    size_t evaluations{0};
+    std::vector<std::pair<ParamVector, Score>> leaders; // best grid points, best first
+};
+
+// Coarse grid over the decision parameters, then coordinate refinement of all of them from
+// the best grid point. Each grid batch and each refinement round is scored in parallel.
+SearchResult search(const std::vector<InferenceTrace>& traces,
+                    const dsp::GateConfig& base,
+                    float vadWeight,
+                    float pitchWeight,
+                    const SearchSettings& settings);
+} // namespace singwithme::tools
@@ -0,0 +1,360 @@
+// Offline gate tuner. Runs the VAD and pitch models once over each labelled recording, then
+// replays the gate for thousands of GateParams/ConfidenceWeights candidates across all cores
+// and writes the best as a config overlay, e.g. configs/desktop/<venue>.json.
+//
+// The dataset is a JSON file listing mic recordings and their vocal-activity labels:
+//   { "recordings": [ { "mic": "venue/take1.wav", "labels": "venue/take1.txt" } ] }
+// Labels are Audacity label tracks (start<TAB>end[<TAB>text] per line, in seconds) or CSV
+// with the same first two columns. Paths are relative to the dataset file.
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <juce_audio_formats/juce_audio_formats.h>
+#include <juce_events/juce_events.h>
+
+#include "GateSweep.h"
+#include "config/RuntimeConfig.h"
+#include "dsp/ModelStore.h"
+#include "dsp/Resampler.h"
+
+#ifndef TUNETRIX_TOOLS_ROOT
+ #define TUNETRIX_TOOLS_ROOT "."
+#endif
+
+namespace
+{
+using namespace singwithme;
+
+struct Recording
+{
+    juce::File mic;
+    juce::File labels;
+};
+
+struct Options
+{
+    std::string dataset;
+    std::string config{"configs/defaults.json"};
+    std::string output;
+    tools::SearchSettings search;
+};
+
+std::vector<std::pair<double, double>> readLabels(const juce::File& file)
+{
+    std::vector<std::pair<double, double>> segments;
+    juce::StringArray lines;
+    file.readLines(lines);
+    for (const auto& line : lines)
+    {
+        const auto fields = juce::StringArray::fromTokens(line.trim(), "\t,", "\"");
+        if (fields.size() < 2 || !fields[0].containsOnly("0123456789.eE+-"))
+        {
+            continue; // blank lines, headers and Audacity's frequency rows
+        }
+        const double start = fields[0].getDoubleValue();
+        const double end = fields[1].getDoubleValue();
+        if (end > start)
+        {
+            segments.emplace_back(start, end);
+        }
+    }
+    return segments;
+}
+
+std::vector<Recording> readDataset(const juce::File& file)
+{
+    std::vector<Recording> recordings;
+    const auto manifest = juce::JSON::parse(file);
+    if (const auto* list = manifest["recordings"].getArray())
+    {
+        for (const auto& entry : *list)
+        {
+            recordings.push_back({file.getParentDirectory().getChildFile(entry["mic"].toString()),
+                                  file.getParentDirectory().getChildFile(entry["labels"].toString())});
+        }
+    }
+    return recordings;
+}
+
+// Channel 0 at the config's device rate.
+bool readMic(const juce::File& file, double sampleRate, std::vector<float>& samples)
+{
+    juce::AudioFormatManager formats;
+    formats.registerBasicFormats();
+    const std::unique_ptr<juce::AudioFormatReader> reader(formats.createReaderFor(file));
+    if (reader == nullptr || reader->lengthInSamples <= 0)
+    {
+        return false;
+    }
+
+    const auto length = static_cast<int>(reader->lengthInSamples);
+    juce::AudioBuffer<float> buffer(1, length);
+    reader->read(&buffer, 0, length, 0, true, false);
+    dsp::Resampler resampler;
+    resampler.prepare(reader->sampleRate, sampleRate, dsp::ResamplerQuality::SincBest, 0);
+    samples.resize(dsp::Resampler::outputLength(static_cast<size_t>(length), reader->sampleRate, sampleRate));
+    resampler.render(buffer.getReadPointer(0), static_cast<size_t>(length), samples.data(), 0, samples.size());
+    return true;
+}
+
+// One model pass per recording, spread across the cores; each worker owns its sessions.
+bool buildTraces(const std::vector<Recording>& recordings,
+                 const config::RuntimeConfig& runtimeConfig,
+                 unsigned threads,
+                 std::vector<tools::InferenceTrace>& traces)
+{
+    Ort::Env& env = dsp::sharedOrtEnvironment();
+    traces.assign(recordings.size(), {});
+    std::atomic<size_t> next{0};
+    std::atomic<bool> failed{false};
+    const auto worker = [&]
+    {
+        try
+        {
+            dsp::VadProcessor vad(env);
+            dsp::PitchProcessor pitch(env);
+            vad.setModelSampleRate(static_cast<int64_t>(runtimeConfig.modelSampleRate));
+            vad.loadModel(runtimeConfig.vadModelPath);
+            pitch.loadModel(runtimeConfig.pitchModelPath);
+            pitch.setHopSamples(runtimeConfig.pitchHopSamples());
+            for (size_t i = next.fetch_add(1); i < recordings.size(); i = next.fetch_add(1))
+            {
+                std::vector<float> mic;
+                if (!readMic(recordings[i].mic, runtimeConfig.sampleRate, mic))
+                {
+                    std::fprintf(stderr, "Cannot read %s\n", recordings[i].mic.getFullPathName().toRawUTF8());
+                    failed = true;
+                    continue;
+                }
+                traces[i] = tools::buildTrace(mic.data(), mic.size(), runtimeConfig.sampleRate,
+                                              static_cast<size_t>(runtimeConfig.bufferSamples), runtimeConfig.modelSampleRate,
+                                              vad, pitch, readLabels(recordings[i].labels));
+            }
+        }
+        catch (const std::exception& error)
+        {
+            std::fprintf(stderr, "Inference failed: %s\n", error.what());
+            failed = true;
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (unsigned t = 1; t < std::min<size_t>(threads, recordings.size()); ++t)
+    {
+        pool.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : pool)
+    {
+        thread.join();
+    }
+    return !failed;
+}
+
+juce::String number(float value, bool integer)
+{
+    return integer ? juce::String(static_cast<int>(std::lround(value))) : juce::String(value, 3).trimCharactersAtEnd("0").trimCharactersAtEnd(".");
+}
+
+// Only the tuned keys; everything else, look-ahead and duck depth included, is inherited.
+bool writeOverlay(const juce::File& file,
+                  const juce::File& baseConfig,
+                  const tools::ParamVector& params)
+{
+    const auto value = [&](tools::Param param)
+    {
+        return number(params[static_cast<size_t>(param)], tools::paramRange(param).integer);
+    };
+    const float vadWeight = params[static_cast<size_t>(tools::Param::VadWeight)];
+
+    juce::String text;
+    text << "{\n"
+         << "  \"extends\": \"" << baseConfig.getRelativePathFrom(file.getParentDirectory()).replaceCharacter('\\', '/') << "\",\n"
+         << "  \"confidenceWeights\": {\n"
+         << "    \"vad\": " << number(vadWeight, false) << ",\n"
+         << "    \"pitch\": " << number(1.0f - vadWeight, false) << "\n"
+         << "  },\n"
+         << "  \"gate\": {\n";
+    const tools::Param keys[] = {tools::Param::AttackMs, tools::Param::ReleaseMs, tools::Param::HoldMs, tools::Param::ThresholdOn,
+                                 tools::Param::ThresholdOff, tools::Param::FramesOn, tools::Param::FramesOff};
+    for (size_t i = 0; i < std::size(keys); ++i)
+    {
+        text << "    \"" << tools::paramRange(keys[i]).name << "\": " << value(keys[i]) << (i + 1 < std::size(keys) ? ",\n" : "\n");
+    }
+    text << "  }\n}\n";
+
+    file.getParentDirectory().createDirectory();
+    return file.replaceWithText(text);
+}
+
+void printScore(const char* label, const tools::Score& score)
+{
+    std::printf("%-8s cost %7.3f  missed %d/%d  false opens %d (%.2f/min)  latency %.1f ms  muted voice %.1f%%\n",
+                label, score.cost, score.missedOnsets, score.onsets, score.falseOpens,
+                score.minutes > 0.0 ? score.falseOpens / score.minutes : 0.0, score.meanLatencyMs, 100.0 * score.mutedVoiceFraction);
+}
+
+void printUsage()
+{
+    std::fprintf(stderr,
+                 "Usage: GateTuner --dataset=<recordings.json> [--config=<base.json>] [--out=<overlay.json>] [--threads=<n>]\n"
+                 "                 [--rounds=<n>] [--miss-weight=<w>] [--false-weight=<w>] [--latency-weight=<w>]\n"
+                 "                 [--muted-weight=<w>] [--root=<repo>]\n"
+                 "Prints the best candidates and writes the winner as an overlay extending --config.\n");
+}
+
+bool startsWith(const std::string& text, const char* prefix, std::string& rest)
+{
+    const std::string head(prefix);
+    if (text.rfind(head, 0) != 0)
+    {
+        return false;
+    }
+    rest = text.substr(head.size());
+    return true;
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+    Options options;
+    std::string root = TUNETRIX_TOOLS_ROOT;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg(argv[i]);
+        std::string value;
+        if (startsWith(arg, "--dataset=", value))
+        {
+            options.dataset = value;
+        }
+        else if (startsWith(arg, "--config=", value))
+        {
+            options.config = value;
+        }
+        else if (startsWith(arg, "--out=", value))
+        {
+            options.output = value;
+        }
+        else if (startsWith(arg, "--threads=", value))
+        {
+            options.search.threads = static_cast<unsigned>(std::max(1, std::atoi(value.c_str())));
+        }
+        else if (startsWith(arg, "--rounds=", value))
+        {
+            options.search.maxRounds = std::max(0, std::atoi(value.c_str()));
+        }
+        else if (startsWith(arg, "--miss-weight=", value))
+        {
+            options.search.weights.missedOnset = static_cast<float>(std::atof(value.c_str()));
+        }
+        else if (startsWith(arg, "--false-weight=", value))
+        {
+            options.search.weights.falseOpen = static_cast<float>(std::atof(value.c_str()));
+        }
+        else if (startsWith(arg, "--latency-weight=", value))
+        {
+            options.search.weights.latency = static_cast<float>(std::atof(value.c_str()));
+        }
+        else if (startsWith(arg, "--muted-weight=", value))
+        {
+            options.search.weights.mutedVoice = static_cast<float>(std::atof(value.c_str()));
+        }
+        else if (startsWith(arg, "--root=", value))
+        {
+            root = value;
+        }
+        else
+        {
+            printUsage();
+            return arg == "--help" ? 0 : 2;
+        }
+    }
+    if (options.dataset.empty())
+    {
+        printUsage();
+        return 2;
+    }
+
+    // Dataset and output paths given on the command line stay relative to where the tool
+    // was started; the base config and its models are found from the repository root.
+    const auto invocation = juce::File::getCurrentWorkingDirectory();
+    const auto datasetFile = invocation.getChildFile(options.dataset);
+    const auto outputFile = options.output.empty() ? juce::File() : invocation.getChildFile(options.output);
+    if (!invocation.getChildFile(root).setAsCurrentWorkingDirectory())
+    {
+        std::fprintf(stderr, "Cannot enter %s\n", root.c_str());
+        return 2;
+    }
+    const juce::ScopedJuceInitialiser_GUI juce;
+
+    const auto baseFile = juce::File::getCurrentWorkingDirectory().getChildFile(options.config);
+    const auto runtimeConfig = config::ConfigLoader{}.loadFromFile(baseFile.getFullPathName().toStdString());
+    options.search.sampleRate = static_cast<float>(runtimeConfig.sampleRate);
+    options.search.blockSize = static_cast<size_t>(runtimeConfig.bufferSamples);
+    const unsigned threads = options.search.threads != 0 ? options.search.threads : std::max(1u, std::thread::hardware_concurrency());
+
+    const auto recordings = readDataset(datasetFile);
+    if (recordings.empty())
+    {
+        std::fprintf(stderr, "No recordings in %s\n", datasetFile.getFullPathName().toRawUTF8());
+        return 2;
+    }
+
+    const auto inferenceStart = juce::Time::getMillisecondCounterHiRes();
+    std::vector<tools::InferenceTrace> traces;
+    if (!buildTraces(recordings, runtimeConfig, threads, traces))
+    {
+        return 1;
+    }
+    const auto searchStart = juce::Time::getMillisecondCounterHiRes();
+
+    dsp::GateConfig base;
+    base.lookAheadMs = runtimeConfig.gate.lookAheadMs;
+    base.attackMs = runtimeConfig.gate.attackMs;
+    base.releaseMs = runtimeConfig.gate.releaseMs;
+    base.holdMs = runtimeConfig.gate.holdMs;
+    base.thresholdOn = runtimeConfig.gate.thresholdOn;
+    base.thresholdOff = runtimeConfig.gate.thresholdOff;
+    base.framesOn = runtimeConfig.gate.framesOn;
+    base.framesOff = runtimeConfig.gate.framesOff;
+    base.duckDb = runtimeConfig.gate.duckDb;
+    base.predictiveOpen = runtimeConfig.gate.predictiveOpen;
+    const auto baseScore = tools::evaluate(tools::makeCandidate(tools::paramsFrom(base, runtimeConfig.weights.vad, runtimeConfig.weights.pitch), base),
+                                           traces, options.search.sampleRate, options.search.blockSize, options.search.weights);
+    const auto result = tools::search(traces, base, runtimeConfig.weights.vad, runtimeConfig.weights.pitch, options.search);
+    const auto end = juce::Time::getMillisecondCounterHiRes();
+
+    std::printf("%zu recordings, inference %.1f s, %zu candidates in %.1f s on %u threads\n",
+                recordings.size(), (searchStart - inferenceStart) / 1000.0, result.evaluations, (end - searchStart) / 1000.0, threads);
+    for (size_t i = 0; i < result.leaders.size(); ++i)
+    {
+        printScore(("grid #" + std::to_string(i + 1)).c_str(), result.leaders[i].second);
+    }
+    printScore("base", baseScore);
+    printScore("tuned", result.score);
+    for (size_t i = 0; i < tools::kParamCount; ++i)
+    {
+        const auto& range = tools::paramRange(static_cast<tools::Param>(i));
+        std::printf("  %-12s %s\n", range.name, number(result.params[i], range.integer).toRawUTF8());
+    }
+
+    if (outputFile != juce::File())
+    {
+        if (!writeOverlay(outputFile, baseFile, result.params))
+        {
+            std::fprintf(stderr, "Cannot write %s\n", outputFile.getFullPathName().toRawUTF8());
+            return 1;
+        }
+        std::printf("Wrote %s\n", outputFile.getFullPathName().toRawUTF8());
+    }
+    return 0;
+}
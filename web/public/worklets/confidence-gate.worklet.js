@@ -1,3 +1,29 @@
+// Ring layout shared with src/audio/workletKernel.ts: an Int32 header
+// [write, read, dropped, recordLength] followed by Float32 records.
+const RING_HEADER_INTS = 4;
+
+class FrameRingWriter {
+  constructor(buffer) {
+    this.header = new Int32Array(buffer, 0, RING_HEADER_INTS);
+    this.recordLength = this.header[3];
+    this.records = new Float32Array(buffer, RING_HEADER_INTS * 4);
+    this.capacity = Math.floor(this.records.length / this.recordLength);
+  }
+
+  // Drops the record rather than overwrite one the reader may be copying.
+  write(tag, payload, length) {
+    const write = Atomics.load(this.header, 0);
+    if (((write - Atomics.load(this.header, 1)) | 0) >= this.capacity) {
+      Atomics.add(this.header, 2, 1);
+      return;
+    }
+    const start = (write % this.capacity) * this.recordLength;
+    this.records[start] = tag;
+    this.records.set(payload.subarray(0, Math.min(length, this.recordLength - 1)), start + 1);
+    Atomics.store(this.header, 0, (write + 1) | 0);
+  }
+}
+
 class ConfidenceGateProcessor extends AudioWorkletProcessor {
   constructor(options) {
     super();
@@ -6,6 +32,18 @@ class ConfidenceGateProcessor extends AudioWorkletProcessor {
     this.currentGain = params.initialGain ?? 0;
     this.targetGain = params.initialGain ?? 0;
     this.smoothing = 0.2;
+    this.kernel = null;
+    this.playing = false;
+
+    if (params.kernel) {
+      try {
+        this.kernel = this.createKernel(params.kernel);
+        this.port.postMessage({ type: "kernel-ready" });
+      } catch (error) {
+        this.kernel = null;
+        this.port.postMessage({ type: "kernel-error", message: String(error?.message ?? error) });
+      }
+    }
 
     this.port.onmessage = (event) => {
       const { data } = event;
@@ -14,11 +52,67 @@ class ConfidenceGateProcessor extends AudioWorkletProcessor {
       } else if (data?.type === "reset" && typeof data.value === "number") {
         this.currentGain = data.value;
         this.targetGain = data.value;
+        if (this.kernel) {
+          this.kernel.exports.tt_reset();
+          this.kernel.vadFrames = 0;
+          this.kernel.pitchFrames = 0;
+        }
+      } else if (data?.type === "params" && this.kernel && data.values) {
+        this.kernel.params.set(data.values.subarray(0, this.kernel.params.length));
+        this.kernel.exports.tt_apply_params(data.reconfigure ? 1 : 0);
+      } else if (data?.type === "transport") {
+        this.playing = Boolean(data.playing);
       }
     };
   }
 
+  // The module is standalone wasm with a fixed heap, so every view created here stays valid.
+  createKernel({ module, vadRing, pitchRing, stateRing, results, paramCount, fieldCount, controlCount }) {
+    const imports = {};
+    for (const entry of WebAssembly.Module.imports(module)) {
+      if (entry.kind !== "function") {
+        throw new Error(`Unexpected kernel import ${entry.module}.${entry.name}`);
+      }
+      imports[entry.module] = imports[entry.module] ?? {};
+      imports[entry.module][entry.name] = () => 0;
+    }
+    const { exports } = new WebAssembly.Instance(module, imports);
+    exports._initialize?.();
+    if (!exports.tt_prepare(sampleRate)) {
+      throw new Error(`Kernel rejected sample rate ${sampleRate}`);
+    }
+
+    const heap = exports.memory.buffer;
+    const block = this.bufferSamples;
+    const vad = new FrameRingWriter(vadRing);
+    const pitch = new FrameRingWriter(pitchRing);
+    return {
+      exports,
+      params: new Float32Array(heap, exports.tt_params(), paramCount),
+      mic: new Float32Array(heap, exports.tt_mic(), block),
+      instrument: new Float32Array(heap, exports.tt_instrument(), block),
+      monitor: new Float32Array(heap, exports.tt_monitor(), block),
+      controls: new Float32Array(heap, exports.tt_controls(), controlCount * block),
+      state: new Float32Array(heap, exports.tt_state(), fieldCount),
+      vadFrame: new Float32Array(heap, exports.tt_vad_frame(), vad.recordLength - 1),
+      pitchFrame: new Float32Array(heap, exports.tt_pitch_frame(), pitch.recordLength - 1),
+      vadRing: vad,
+      pitchRing: pitch,
+      stateRing: new FrameRingWriter(stateRing),
+      resultIndices: new Int32Array(results, 0, 4),
+      resultValues: new Float32Array(results, 16, 4),
+      seenResults: [-1, -1],
+      controlCount,
+      vadFrames: 0,
+      pitchFrames: 0
+    };
+  }
+
   process(inputs, outputs) {
+    if (this.kernel) {
+      return this.processKernel(inputs, outputs);
+    }
+
     const input = inputs[0];
     const output = outputs[0];
     if (!input || !output) return true;
@@ -47,6 +141,61 @@ class ConfidenceGateProcessor extends AudioWorkletProcessor {
 
     return true;
   }
+
+  processKernel(inputs, outputs) {
+    const kernel = this.kernel;
+    const micChannel = inputs[0]?.[0];
+    const n = Math.min(micChannel?.length ?? this.bufferSamples, kernel.mic.length);
+    if (micChannel) {
+      kernel.mic.set(micChannel.subarray(0, n));
+    } else {
+      kernel.mic.fill(0);
+    }
+
+    const instrument = inputs[1] ?? [];
+    if (instrument.length > 1) {
+      const left = instrument[0];
+      const right = instrument[1];
+      for (let i = 0; i < n; i += 1) {
+        kernel.instrument[i] = 0.5 * (left[i] + right[i]);
+      }
+    } else if (instrument.length === 1) {
+      kernel.instrument.set(instrument[0].subarray(0, n));
+    } else {
+      kernel.instrument.fill(0);
+    }
+
+    for (let kind = 0; kind < 2; kind += 1) {
+      const index = Atomics.load(kernel.resultIndices, kind);
+      if (index !== kernel.seenResults[kind]) {
+        kernel.seenResults[kind] = index;
+        kernel.exports.tt_model_result(kind, kernel.resultValues[kind], index);
+      }
+    }
+
+    const ready = kernel.exports.tt_process(n, this.playing ? 1 : 0);
+
+    const monitor = kernel.monitor.subarray(0, n);
+    for (const channel of outputs[0] ?? []) {
+      channel.set(monitor);
+    }
+    const controls = outputs[1] ?? [];
+    const block = kernel.mic.length;
+    for (let c = 0; c < Math.min(controls.length, kernel.controlCount); c += 1) {
+      controls[c].set(kernel.controls.subarray(c * block, c * block + n));
+    }
+
+    if (ready & 1) {
+      kernel.vadRing.write(kernel.vadFrames, kernel.vadFrame, kernel.vadFrame.length);
+      kernel.vadFrames += 1;
+    }
+    if (ready & 2) {
+      kernel.pitchRing.write(kernel.pitchFrames, kernel.pitchFrame, kernel.pitchFrame.length);
+      kernel.pitchFrames += 1;
+    }
+    kernel.stateRing.write(n, kernel.state, kernel.state.length);
+    return true;
+  }
 }
 
 registerProcessor("confidence-gate-processor", ConfidenceGateProcessor);
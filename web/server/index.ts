@@ -86,6 +86,14 @@ if (fulfillmentPath && !fs.existsSync(fulfillmentPath)) {
   console.warn(`Fulfillment file not found at ${fulfillmentPath}. Download endpoint will error until it is provided.`);
 }
 
+// Cross-origin isolation, so the audio worklet and the page can share memory
+// (SharedArrayBuffer) instead of posting every block.
+app.use((_req, res, next) => {
+  res.setHeader("Cross-Origin-Opener-Policy", "same-origin");
+  res.setHeader("Cross-Origin-Embedder-Policy", "require-corp");
+  next();
+});
+
 app.use(express.json());
 
 const storage = multer.diskStorage({
@@ -34,6 +34,16 @@ export class Calibrator {
     }
   }
 
+  // For callers that only see each block's peak, such as the worklet kernel's state ring.
+  processPeak(peak: number, sampleCount: number) {
+    if (!this.active) return;
+    this.maxAmplitude = Math.max(this.maxAmplitude, Math.abs(peak));
+    this.processed += sampleCount;
+    if (this.isComplete()) {
+      this.active = false;
+    }
+  }
+
   isComplete() {
     return this.processed >= this.sampleRate * this.targetDuration;
   }
@@ -5,6 +5,17 @@ import { resolveAssetUrl } from "@utils/assetPaths";
 import { ConfidenceGate, GateConfig, dbToLinear } from "./confidenceGate";
 import { Calibrator } from "./calibrator";
 import { TelemetryLog } from "./telemetry";
+import {
+  FrameRingReader,
+  KERNEL_CONTROLS,
+  KERNEL_PARAMS,
+  KERNEL_WASM_URL,
+  KernelField,
+  KernelParams,
+  ModelResultChannel,
+  createFrameRing,
+  supportsSharedKernel
+} from "./workletKernel";
 
 const AUDIO_WORKLET_URL = resolveAssetUrl("/worklets/confidence-gate.worklet.js") ?? "/worklets/confidence-gate.worklet.js";
 const SAMPLE_RATE_TARGET = 16000;
@@ -13,6 +24,13 @@ const VAD_FRAME_TARGET = 224; // 14 ms @ 16 kHz (minimum window for Silero VAD)
 const PITCH_FRAME_SOURCE = 3072; // 64 ms @ 48 kHz
 const PITCH_FRAME_TARGET = 1024; // 64 ms @ 16 kHz
 const MAX_QUEUE_LENGTH = 32;
+const KERNEL_URL = resolveAssetUrl(KERNEL_WASM_URL) ?? KERNEL_WASM_URL;
+const KERNEL_DRAIN_MS = 10;
+// Ring depths: ~220 ms of VAD frames, ~510 ms of pitch frames, ~340 ms of block state.
+const KERNEL_VAD_RING_FRAMES = 16;
+const KERNEL_PITCH_RING_FRAMES = 8;
+const KERNEL_STATE_RING_BLOCKS = 128;
+const MANUAL_MODES: ManualMode[] = ["auto", "always_on", "always_off"];
 
 const CREPE_CENTS_MAPPING = new Float32Array(360);
 for (let i = 0; i < CREPE_CENTS_MAPPING.length; i += 1) {
@@ -65,6 +83,21 @@ interface MediaConfig {
   envelopeReleaseMod: number;
 }
 
+// Main-thread end of the worklet kernel: the rings it fills, the channel carrying model
+// results back, and the splitter fanning its control output out to the guide chain.
+interface KernelBridge {
+  vadRing: FrameRingReader;
+  pitchRing: FrameRingReader;
+  stateRing: FrameRingReader;
+  results: ModelResultChannel;
+  vadRecord: Float32Array;
+  pitchRecord: Float32Array;
+  stateRecord: Float32Array;
+  vadFrame: Float32Array;
+  pitchFrame: Float32Array;
+  splitter: ChannelSplitterNode | null;
+}
+
 interface EngineConfig {
   sampleRate: number;
   bufferSamples: number;
@@ -239,6 +272,10 @@ class AudioEngine {
   private resumeListener: ((event: Event) => void) | null = null;
   private readonly resumeEvents = ["pointerdown", "touchstart", "keydown"];
   private pitchAnalysisInProgress = false;
+  private kernel: KernelBridge | null = null;
+  private kernelTimer: number | null = null;
+  private kernelInferenceBusy = false;
+  private reverbTailSeconds = 0.32;
 
   async initialise() {
     if (this.initialised) return;
@@ -328,12 +365,14 @@ class AudioEngine {
 
     this.streamSource = this.audioContext.createMediaStreamSource(stream);
 
+    const kernelOptions = await this.prepareKernel();
     this.workletNode = new AudioWorkletNode(this.audioContext, "confidence-gate-processor", {
-      numberOfInputs: 1,
-      numberOfOutputs: 1,
-      outputChannelCount: [2],
+      numberOfInputs: kernelOptions ? 2 : 1,
+      numberOfOutputs: kernelOptions ? 2 : 1,
+      outputChannelCount: kernelOptions ? [2, KERNEL_CONTROLS] : [2],
       processorOptions: {
-        bufferSamples: this.config.bufferSamples
+        bufferSamples: this.config.bufferSamples,
+        kernel: kernelOptions ?? undefined
       }
     });
 
@@ -342,9 +381,20 @@ class AudioEngine {
       if (data?.type === "block" && data.payload) {
         const buffer = data.payload as ArrayBuffer;
         this.enqueueBlock(new Float32Array(buffer));
+      } else if (data?.type === "kernel-error") {
+        // eslint-disable-next-line no-console
+        console.warn(`Worklet kernel unavailable, falling back to main-thread processing: ${data.message}`);
+        this.disableKernel();
       }
     };
 
+    if (this.kernel) {
+      this.kernel.splitter = this.audioContext.createChannelSplitter(KERNEL_CONTROLS);
+      this.workletNode.connect(this.kernel.splitter, 1);
+      this.syncKernel(true);
+      this.kernelTimer = window.setInterval(() => this.drainKernel(), KERNEL_DRAIN_MS);
+    }
+
     this.vocalBusNode?.disconnect();
     this.vocalBusNode = this.audioContext.createGain();
     this.vocalBusNode.gain.value = 1;
@@ -355,7 +405,7 @@ class AudioEngine {
     this.micGainNode?.disconnect();
     this.micGainNode = this.audioContext.createGain();
     this.micGainNode.gain.value = this.micMonitorLinear;
-    this.workletNode.connect(this.micGainNode);
+    this.workletNode.connect(this.micGainNode, 0);
     this.micGainNode.connect(this.vocalBusNode);
 
     if (this.workletNode) {
@@ -363,6 +413,201 @@ class AudioEngine {
     }
   }
 
+  // Compiles the DSP kernel for the worklet and allocates the rings it shares with this
+  // thread. Returns null, leaving the postMessage path in place, when the page is not
+  // cross-origin isolated or the module is missing.
+  private async prepareKernel() {
+    if (!supportsSharedKernel()) {
+      return null;
+    }
+    let module: WebAssembly.Module;
+    try {
+      const response = await fetch(KERNEL_URL);
+      if (!response.ok) {
+        return null;
+      }
+      module = await WebAssembly.compile(await response.arrayBuffer());
+    } catch (error) {
+      // eslint-disable-next-line no-console
+      console.warn("Worklet kernel failed to load, using main-thread processing", error);
+      return null;
+    }
+
+    const vadRing = createFrameRing(KERNEL_VAD_RING_FRAMES, VAD_FRAME_TARGET + 1);
+    const pitchRing = createFrameRing(KERNEL_PITCH_RING_FRAMES, PITCH_FRAME_TARGET + 1);
+    const stateRing = createFrameRing(KERNEL_STATE_RING_BLOCKS, KernelField.Count + 1);
+    const results = new ModelResultChannel();
+    this.kernel = {
+      vadRing: new FrameRingReader(vadRing),
+      pitchRing: new FrameRingReader(pitchRing),
+      stateRing: new FrameRingReader(stateRing),
+      results,
+      vadRecord: new Float32Array(VAD_FRAME_TARGET + 1),
+      pitchRecord: new Float32Array(PITCH_FRAME_TARGET + 1),
+      stateRecord: new Float32Array(KernelField.Count + 1),
+      vadFrame: new Float32Array(VAD_FRAME_TARGET),
+      pitchFrame: new Float32Array(PITCH_FRAME_TARGET),
+      splitter: null
+    };
+    return {
+      module,
+      vadRing,
+      pitchRing,
+      stateRing,
+      results: results.buffer,
+      paramCount: KERNEL_PARAMS.length,
+      fieldCount: KernelField.Count,
+      controlCount: KERNEL_CONTROLS
+    };
+  }
+
+  private disableKernel() {
+    if (this.kernelTimer !== null) {
+      window.clearInterval(this.kernelTimer);
+      this.kernelTimer = null;
+    }
+    this.kernel?.splitter?.disconnect();
+    this.kernel = null;
+    this.applyGuideProcessing();
+  }
+
+  private kernelParams() {
+    const gate = this.config.gate;
+    const weights = this.config.confidenceWeights;
+    const params: KernelParams = {
+      lookAheadMs: gate.lookAheadMs,
+      attackMs: gate.attackMs,
+      releaseMs: gate.releaseMs,
+      holdMs: gate.holdMs,
+      thresholdOn: gate.thresholdOn,
+      thresholdOff: gate.thresholdOff,
+      framesOn: gate.framesOn,
+      framesOff: gate.framesOff,
+      duckDb: gate.duckDb,
+      vadWeight: weights.vad,
+      pitchWeight: weights.pitch,
+      envelopeHoldMs: this.envelopeHoldMs,
+      envelopeReleaseMs: this.envelopeReleaseMs,
+      envelopeReleaseMod: this.envelopeReleaseMod,
+      reverbTailMix: this.reverbTailMix,
+      reverbTailSeconds: this.reverbTailSeconds,
+      noiseFloor: this.noiseFloorAmplitude,
+      leakCompensation: this.playbackLeakComp,
+      leakAdaptRate: this.crowdCancelAdaptRate,
+      leakRecoveryRate: this.crowdCancelRecoveryRate,
+      leakClamp: this.crowdCancelClamp,
+      timbreStrength: this.timbreMatchStrength,
+      instrumentGain: this.instrumentBaseGain,
+      manualMode: Math.max(0, MANUAL_MODES.indexOf(useAppStore.getState().manualMode))
+    };
+    return Float32Array.from(KERNEL_PARAMS, (name) => params[name]);
+  }
+
+  // Settings reach the kernel as one message per change; reconfigure also restarts the gate.
+  private syncKernel(reconfigure = false) {
+    if (!this.kernel || !this.workletNode) {
+      return;
+    }
+    this.workletNode.port.postMessage({ type: "params", values: this.kernelParams(), reconfigure });
+  }
+
+  private connectKernelControls() {
+    const splitter = this.kernel?.splitter;
+    if (!splitter) {
+      return;
+    }
+    const targets = [
+      this.guideDryGainNode?.gain,
+      this.guideReverbInputNode?.gain,
+      this.guideReverbMixNode?.gain,
+      this.guideGainNode?.gain,
+      this.guideLowShelfNode?.gain,
+      this.guideHighShelfNode?.gain
+    ];
+    targets.forEach((param, channel) => {
+      if (param) {
+        // The control signal adds to the intrinsic value, so that has to sit at zero.
+        param.cancelScheduledValues(0);
+        param.value = 0;
+        splitter.connect(param, channel);
+      }
+    });
+  }
+
+  // Everything the worklet produced since the last tick: per-block state for meters,
+  // telemetry and calibration, then the newest model frames for inference.
+  private drainKernel() {
+    const kernel = this.kernel;
+    if (!kernel) {
+      return;
+    }
+    const store = useAppStore.getState();
+    const record = kernel.stateRecord;
+    let updated = false;
+    while (kernel.stateRing.read(record)) {
+      updated = true;
+      const state = record.subarray(1);
+      if (this.calibrating) {
+        this.calibrator.processPeak(state[KernelField.MicPeak], record[0]);
+        this.completeCalibrationIfDone();
+      }
+      this.telemetry.record({
+        timestamp: performance.now(),
+        vad: state[KernelField.Vad],
+        pitch: state[KernelField.Pitch],
+        confidence: state[KernelField.Confidence],
+        gainDb: state[KernelField.GainDb]
+      });
+    }
+
+    if (updated) {
+      const state = record.subarray(1);
+      this.lastConfidence = state[KernelField.Confidence];
+      this.lastGateDb = state[KernelField.GainDb];
+      this.currentGain = dbToLinear(this.lastGateDb);
+      this.currentGuideMix = state[KernelField.GuideMix];
+      this.currentTailMix = state[KernelField.TailMix];
+      this.timbreTilt = state[KernelField.Tilt];
+      const inputMeter = clamp(state[KernelField.Peak] * 1.1, 0, 1);
+      const outputMeter = clamp(this.currentGuideMix + this.currentTailMix * 0.5, 0, 1);
+      store.setLevels(inputMeter, outputMeter);
+      store.setConfidence(this.lastConfidence);
+    }
+
+    if (!this.kernelInferenceBusy) {
+      void this.runKernelModels(kernel);
+    }
+  }
+
+  // Inference stays on this thread with onnxruntime-web. Only the newest frame of each kind
+  // is run; until its result lands the kernel uses its own heuristics.
+  private async runKernelModels(kernel: KernelBridge) {
+    this.kernelInferenceBusy = true;
+    try {
+      if (kernel.vadRing.readLatest(kernel.vadRecord) && this.vadSession && !this.vadFailed) {
+        kernel.vadFrame.set(kernel.vadRecord.subarray(1));
+        await this.evaluateVad(kernel.vadFrame);
+        if (!this.vadFailed) {
+          kernel.results.post(0, this.lastVad, kernel.vadRecord[0]);
+        }
+      }
+      if (kernel.pitchRing.readLatest(kernel.pitchRecord)) {
+        kernel.pitchFrame.set(kernel.pitchRecord.subarray(1));
+        const result = await this.inferPitch(kernel.pitchFrame);
+        if (result) {
+          this.lastPitch = clamp(result.confidence, 0, 1);
+          this.lastPitchHz = result.frequency;
+          kernel.results.post(1, this.lastPitch, kernel.pitchRecord[0]);
+        }
+      }
+    } catch (error) {
+      // eslint-disable-next-line no-console
+      console.error("Worklet kernel inference failed", error);
+    } finally {
+      this.kernelInferenceBusy = false;
+    }
+  }
+
   private async loadModels() {
     this.vadSession = await ort.InferenceSession.create(this.config.models.vad, {
       executionProviders: ["wasm"],
@@ -612,6 +857,7 @@ class AudioEngine {
 
   private updateReverbCoefficients(tailSeconds: number) {
     const seconds = Math.max(0.05, tailSeconds);
+    this.reverbTailSeconds = seconds;
     const sampleRate = this.config.sampleRate;
     const feedback = Math.exp(-1 / (sampleRate * seconds));
     this.reverbFeedback = Math.min(feedback, 0.85);
@@ -649,6 +895,13 @@ class AudioEngine {
     if (this.guidePreGainNode) {
       this.guidePreGainNode.gain.setTargetAtTime(this.guideBaseGain, now, 0.01);
     }
+    if (this.guideReverbFeedbackNode) {
+      this.guideReverbFeedbackNode.gain.setTargetAtTime(this.reverbFeedback, now, 0.05);
+    }
+    // With the worklet kernel running, its control output drives the rest per sample.
+    if (this.kernel) {
+      return;
+    }
     if (this.guideDryGainNode) {
       this.guideDryGainNode.gain.setTargetAtTime(dryGain, now, 0.01);
     }
@@ -658,9 +911,6 @@ class AudioEngine {
     if (this.guideReverbMixNode) {
       this.guideReverbMixNode.gain.setTargetAtTime(this.currentTailMix, now, 0.02);
     }
-    if (this.guideReverbFeedbackNode) {
-      this.guideReverbFeedbackNode.gain.setTargetAtTime(this.reverbFeedback, now, 0.05);
-    }
     if (this.guideGainNode) {
       const boost = 1 + this.currentGuideMix * GUIDE_BOOST_HEADROOM;
       this.guideGainNode.gain.setTargetAtTime(boost, now, 0.02);
@@ -681,6 +931,7 @@ class AudioEngine {
 
   private applyNoiseFloor(amplitude: number) {
     this.noiseFloorAmplitude = clamp(amplitude, 0, 0.6);
+    this.syncKernel();
   }
 
   private applyMicMonitorGain(_: number) {
@@ -695,6 +946,7 @@ class AudioEngine {
     this.crowdCancelAdaptRate = 0.0001 + clamped * 0.0004;
     this.crowdCancelRecoveryRate = 0.00005 + (1 - clamped) * 0.00025;
     this.crowdCancelClamp = 0.6 + clamped * 0.4;
+    this.syncKernel();
   }
 
   private applyReverbStrength(strength: number) {
@@ -704,11 +956,13 @@ class AudioEngine {
     this.reverbTailMix = mix;
     this.updateReverbCoefficients(seconds);
     this.applyGuideProcessing();
+    this.syncKernel();
   }
 
   private applyTimbreStrength(strength: number) {
     const clamped = clamp(strength, 0, 1);
     this.timbreMatchStrength = 0.2 + clamped * 0.8;
+    this.syncKernel();
   }
 
   private applyPhraseSmoothness(strength: number) {
@@ -717,6 +971,7 @@ class AudioEngine {
     this.envelopeReleaseMs = 220 + clamped * 160;
     this.envelopeReleaseMod = 0.25 + clamped * 0.4;
     this.updateTimingCoefficients();
+    this.syncKernel();
   }
 
   private buildGuideChain(source: AudioNode, destination: AudioNode) {
@@ -777,6 +1032,7 @@ class AudioEngine {
 
     this.guideSumNode.connect(this.guideGainNode);
     this.guideGainNode.connect(destination);
+    this.connectKernelControls();
     if (source instanceof AudioBufferSourceNode) {
       this.guideSourceNode = source;
     }
@@ -785,6 +1041,7 @@ class AudioEngine {
   }
 
   private teardownGuideChain() {
+    this.kernel?.splitter?.disconnect();
     const nodes: Array<AudioNode | null> = [
       this.guideLowShelfNode,
       this.guideHighShelfNode,
@@ -921,6 +1178,10 @@ class AudioEngine {
       this.instrumentGainNode = this.audioContext.createGain();
       this.instrumentGainNode.gain.value = this.instrumentBaseGain;
       this.instrumentSource.connect(this.instrumentGainNode).connect(this.audioContext.destination);
+      if (this.kernel && this.workletNode) {
+        // The kernel's leak canceller hears the backing track through its second input.
+        this.instrumentSource.connect(this.workletNode, 0, 1);
+      }
       this.instrumentSource.start(0, normalizedInstrumentOffset);
     }
 
@@ -972,6 +1233,7 @@ class AudioEngine {
 
   private setPlaybackState(state: PlaybackState) {
     useAppStore.getState().setPlaybackState(state);
+    this.workletNode?.port.postMessage({ type: "transport", playing: state === "playing" });
   }
 
   private get currentPlaybackState() {
@@ -1059,7 +1321,10 @@ class AudioEngine {
 
     this.manualModeUnsub = useAppStore.subscribe(
       (state) => state.manualMode,
-      (mode: ManualMode) => this.gate.setManualMode(mode)
+      (mode: ManualMode) => {
+        this.gate.setManualMode(mode);
+        this.syncKernel();
+      }
     );
 
     this.calibrationStageUnsub = useAppStore.subscribe(
@@ -1229,13 +1494,7 @@ class AudioEngine {
 
     if (this.calibrating) {
       this.calibrator.process(block);
-      if (this.calibrator.isComplete()) {
-        this.calibrating = false;
-        const result = this.calibrator.result();
-        this.calibrator.store();
-        store.setCalibrationResult(result);
-        store.setCalibrationStage("complete");
-      }
+      this.completeCalibrationIfDone();
     }
 
     const vadJobs: Float32Array[] = [];
@@ -1534,6 +1793,18 @@ class AudioEngine {
     }
   }
 
+  private completeCalibrationIfDone() {
+    if (!this.calibrator.isComplete()) {
+      return;
+    }
+    const store = useAppStore.getState();
+    this.calibrating = false;
+    const result = this.calibrator.result();
+    this.calibrator.store();
+    store.setCalibrationResult(result);
+    store.setCalibrationStage("complete");
+  }
+
   private startCalibration() {
     this.calibrator.start(this.config.sampleRate, 10);
     this.calibrating = true;
@@ -1563,6 +1834,7 @@ class AudioEngine {
     this.clearResumeListener();
 
     this.stop();
+    this.disableKernel();
     this.workletNode?.disconnect();
     this.micGainNode?.disconnect();
     this.streamSource?.disconnect();
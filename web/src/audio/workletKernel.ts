@@ -0,0 +1,130 @@
+// Shared-memory plumbing between the AudioEngine and the wasm kernel running inside
+// confidence-gate.worklet.js. The worklet writes model frames and per-block state into
+// single-producer/single-consumer rings; the main thread answers with model results through
+// a small control block. Nothing crosses postMessage per block.
+
+// Orders mirror the Param and Field enums in wasm/WorkletKernel.cpp.
+export const KERNEL_PARAMS = [
+  "lookAheadMs",
+  "attackMs",
+  "releaseMs",
+  "holdMs",
+  "thresholdOn",
+  "thresholdOff",
+  "framesOn",
+  "framesOff",
+  "duckDb",
+  "vadWeight",
+  "pitchWeight",
+  "envelopeHoldMs",
+  "envelopeReleaseMs",
+  "envelopeReleaseMod",
+  "reverbTailMix",
+  "reverbTailSeconds",
+  "noiseFloor",
+  "leakCompensation",
+  "leakAdaptRate",
+  "leakRecoveryRate",
+  "leakClamp",
+  "timbreStrength",
+  "instrumentGain",
+  "manualMode"
+] as const;
+
+export type KernelParams = Record<(typeof KERNEL_PARAMS)[number], number>;
+
+export const KernelField = {
+  Vad: 0,
+  Pitch: 1,
+  Confidence: 2,
+  GainDb: 3,
+  Peak: 4,
+  MicPeak: 5,
+  Rms: 6,
+  GuideMix: 7,
+  TailMix: 8,
+  Tilt: 9,
+  VadFrameIndex: 10,
+  PitchFrameIndex: 11,
+  Count: 12
+} as const;
+
+// Control outputs, one channel each on the worklet's second output.
+export const KERNEL_CONTROLS = 6;
+
+export const KERNEL_WASM_URL = "/worklets/tunetrix-dsp.wasm";
+
+const HEADER_INTS = 4; // write, read, dropped, record length
+const HEADER_BYTES = HEADER_INTS * Int32Array.BYTES_PER_ELEMENT;
+
+export function createFrameRing(capacity: number, recordLength: number) {
+  const buffer = new SharedArrayBuffer(HEADER_BYTES + capacity * recordLength * Float32Array.BYTES_PER_ELEMENT);
+  new Int32Array(buffer, 0, HEADER_INTS)[3] = recordLength;
+  return buffer;
+}
+
+// Reader side of a ring written by the worklet. Each record is [tag, ...payload]; the tag is
+// the frame index for model frames and the block length for state records.
+export class FrameRingReader {
+  readonly recordLength: number;
+  private readonly header: Int32Array;
+  private readonly records: Float32Array;
+  private readonly capacity: number;
+
+  constructor(buffer: SharedArrayBuffer) {
+    this.header = new Int32Array(buffer, 0, HEADER_INTS);
+    this.recordLength = this.header[3];
+    this.records = new Float32Array(buffer, HEADER_BYTES);
+    this.capacity = Math.floor(this.records.length / this.recordLength);
+  }
+
+  available() {
+    return (Atomics.load(this.header, 0) - Atomics.load(this.header, 1)) | 0;
+  }
+
+  dropped() {
+    return Atomics.load(this.header, 2);
+  }
+
+  read(target: Float32Array) {
+    const read = Atomics.load(this.header, 1);
+    if (read === Atomics.load(this.header, 0)) {
+      return false;
+    }
+    const start = (read % this.capacity) * this.recordLength;
+    target.set(this.records.subarray(start, start + this.recordLength));
+    Atomics.store(this.header, 1, (read + 1) | 0);
+    return true;
+  }
+
+  // Reads only the newest record, discarding any backlog.
+  readLatest(target: Float32Array) {
+    const pending = this.available();
+    if (pending <= 0) {
+      return false;
+    }
+    Atomics.add(this.header, 1, pending - 1);
+    return this.read(target);
+  }
+}
+
+// Model results for the kernel: values first, then the frame index they answer, so the
+// worklet never pairs an index with a stale value.
+export class ModelResultChannel {
+  readonly buffer = new SharedArrayBuffer(4 * Int32Array.BYTES_PER_ELEMENT + 4 * Float32Array.BYTES_PER_ELEMENT);
+  private readonly indices = new Int32Array(this.buffer, 0, 4);
+  private readonly values = new Float32Array(this.buffer, 4 * Int32Array.BYTES_PER_ELEMENT, 4);
+
+  constructor() {
+    this.indices.fill(-1);
+  }
+
+  post(kind: 0 | 1, value: number, frameIndex: number) {
+    this.values[kind] = value;
+    Atomics.store(this.indices, kind, frameIndex);
+  }
+}
+
+export function supportsSharedKernel() {
+  return typeof SharedArrayBuffer !== "undefined" && globalThis.crossOriginIsolated === true;
+}
@@ -13,7 +13,12 @@ export default defineConfig({
     }
   },
   server: {
-    port: 5173
+    port: 5173,
+    // Matches server/index.ts: the worklet kernel needs SharedArrayBuffer.
+    headers: {
+      "Cross-Origin-Opener-Policy": "same-origin",
+      "Cross-Origin-Embedder-Policy": "require-corp"
+    }
   },
   build: {
     outDir: "dist",
@@ -0,0 +1,469 @@
+// The confidence-gate worklet's DSP, built with Emscripten from the desktop sources:
+// leak-compensated detection, the 48 -> 16 kHz decimator feeding the models, the heuristic
+// VAD and pitch that stand in whenever ONNX results are late, dsp::ConfidenceGate and
+// dsp::GuideEnvelope. The worklet copies each render quantum into the buffers exported
+// below, calls tt_process() and copies the results out; nothing here allocates after
+// tt_prepare().
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "dsp/ConfidenceGate.h"
+#include "dsp/GuideEnvelope.h"
+#include "dsp/PitchProcessor.h"
+#include "dsp/Resampler.h"
+#include "dsp/Simd.h"
+#include "dsp/VadProcessor.h"
+
+#ifdef __EMSCRIPTEN__
+ #include <emscripten/emscripten.h>
+ #define TUNETRIX_EXPORT extern "C" EMSCRIPTEN_KEEPALIVE
+#else
+ #define TUNETRIX_EXPORT extern "C"
+#endif
+
+namespace singwithme::web
+{
+// Mirrored by KERNEL_PARAMS and KERNEL_FIELDS in src/audio/workletKernel.ts; keep the orders
+// in step.
+enum Param
+{
+    LookAheadMs,
+    AttackMs,
+    ReleaseMs,
+    HoldMs,
+    ThresholdOn,
+    ThresholdOff,
+    FramesOn,
+    FramesOff,
+    DuckDb,
+    VadWeight,
+    PitchWeight,
+    EnvelopeHoldMs,
+    EnvelopeReleaseMs,
+    EnvelopeReleaseMod,
+    ReverbTailMix,
+    ReverbTailSeconds,
+    NoiseFloor,
+    LeakCompensation,
+    LeakAdaptRate,
+    LeakRecoveryRate,
+    LeakClamp,
+    TimbreStrength,
+    InstrumentGain,
+    ManualMode,
+    kParams
+};
+
+enum Control
+{
+    GuideDry,
+    ReverbSend,
+    ReverbReturn,
+    GuideBoost,
+    LowShelfDb,
+    HighShelfDb,
+    kControls
+};
+
+enum Field
+{
+    Vad,
+    Pitch,
+    Confidence,
+    GainDb,
+    Peak,
+    MicPeak,
+    Rms,
+    GuideMix,
+    TailMix,
+    Tilt,
+    VadFrameIndex,
+    PitchFrameIndex,
+    kFields
+};
+
+enum Ready
+{
+    VadFrameReady = 1,
+    PitchFrameReady = 2
+};
+
+namespace
+{
+// Web Audio's render quantum.
+constexpr size_t kMaxBlock = 128;
+constexpr double kModelRate = 16000.0;
+constexpr size_t kVadFrame = 224;
+constexpr size_t kPitchFrame = 1024;
+// ONNX results older than this many frames give way to the heuristics (~110 / ~190 ms).
+constexpr int64_t kMaxVadLag = 8;
+constexpr int64_t kMaxPitchLag = 3;
+
+constexpr float kLeakThreshold = 1.0e-4f;
+constexpr float kVocalStrengthRise = 0.08f;
+constexpr float kVocalStrengthFall = 0.02f;
+constexpr float kVocalStrengthScale = 12.0f;
+constexpr float kTimbreLowpassMs = 24.0f;
+constexpr float kTiltSmoothing = 0.05f;
+constexpr float kEnergySilenceFloor = 0.0005f; // ~-66 dB
+constexpr float kEnergyFullScale = 0.02f;      // ~-34 dB
+constexpr float kConfidenceSmoothing = 0.185f;
+constexpr float kMonitorSmoothing = 0.2f;
+constexpr float kGuideBoostHeadroom = 0.8f;
+// The time constants the main thread used with setTargetAtTime, one per control.
+constexpr std::array<float, kControls> kControlMs{10.0f, 10.0f, 20.0f, 20.0f, 50.0f, 50.0f};
+
+float onePole(float ms, double sampleRate)
+{
+    return static_cast<float>(1.0 - std::exp(-1000.0 / (sampleRate * std::max(ms, 1.0e-3f))));
+}
+
+// A result answers a frame the kernel has produced and is recent enough to trust. Indices
+// from before a reset land ahead of the count and are ignored.
+bool fresh(int64_t frames, int64_t resultFrame, int64_t maxLag)
+{
+    return resultFrame >= 0 && resultFrame < frames && frames - resultFrame <= maxLag;
+}
+
+float dbToLinear(float db)
+{
+    return std::pow(10.0f, db / 20.0f);
+}
+
+Ort::Env modelEnv;
+} // namespace
+
+class WorkletKernel
+{
+public:
+    bool prepare(double sampleRate)
+    {
+        if (sampleRate <= 0.0)
+        {
+            return false;
+        }
+        sampleRate_ = sampleRate;
+        mic_.assign(kMaxBlock, 0.0f);
+        instrument_.assign(kMaxBlock, 0.0f);
+        monitor_.assign(kMaxBlock, 0.0f);
+        controls_.assign(kControls * kMaxBlock, 0.0f);
+        decimated_.assign(kMaxBlock, 0.0f);
+        vadFrame_.assign(kVadFrame, 0.0f);
+        pitchFrame_.assign(kPitchFrame, 0.0f);
+        decimator_.prepare(sampleRate, kModelRate, dsp::ResamplerQuality::SincFast, kMaxBlock);
+        vad_.setModelSampleRate(static_cast<int64_t>(kModelRate));
+        lowpass_ = onePole(kTimbreLowpassMs, sampleRate);
+        for (size_t c = 0; c < kControls; ++c)
+        {
+            controlStep_[c] = onePole(kControlMs[c], sampleRate);
+        }
+        applyParams(true);
+        reset();
+        return true;
+    }
+
+    void applyParams(bool reconfigureGate)
+    {
+        const dsp::GateConfig gate{params_[LookAheadMs],
+                                   params_[AttackMs],
+                                   params_[ReleaseMs],
+                                   params_[HoldMs],
+                                   params_[ThresholdOn],
+                                   params_[ThresholdOff],
+                                   static_cast<int>(params_[FramesOn]),
+                                   static_cast<int>(params_[FramesOff]),
+                                   params_[DuckDb],
+                                   false};
+        if (reconfigureGate)
+        {
+            gate_.configure(static_cast<float>(sampleRate_), kMaxBlock, gate);
+        }
+        else
+        {
+            gate_.setThresholds(gate.thresholdOn, gate.thresholdOff);
+        }
+        gate_.setManualMode(static_cast<dsp::ManualMode>(std::clamp(static_cast<int>(params_[ManualMode]), 0, 2)));
+
+        const dsp::GuideEnvelopeConfig envelope{params_[EnvelopeHoldMs],
+                                                params_[EnvelopeReleaseMs],
+                                                params_[EnvelopeReleaseMod],
+                                                params_[ReverbTailMix],
+                                                params_[ReverbTailSeconds],
+                                                params_[DuckDb],
+                                                params_[NoiseFloor]};
+        if (reconfigureGate)
+        {
+            envelope_.configure(sampleRate_, envelope);
+        }
+        else
+        {
+            envelope_.setConfig(envelope);
+        }
+    }
+
+    void reset()
+    {
+        decimator_.reset();
+        vad_.resetState();
+        vadFill_ = 0;
+        pitchFill_ = 0;
+        vadFrames_ = 0;
+        pitchFrames_ = 0;
+        vadResultFrame_ = -1;
+        pitchResultFrame_ = -1;
+        vadHeuristic_ = 0.0f;
+        pitchHeuristic_ = 0.0f;
+        leak_ = params_[LeakCompensation];
+        vocalStrength_ = 0.0f;
+        brightnessLow_ = 0.0f;
+        brightnessHigh_ = 0.0f;
+        tilt_ = 0.0f;
+        confidence_ = 0.0f;
+        monitorGain_ = dbToLinear(params_[DuckDb]);
+        controlState_.fill(0.0f);
+        controlState_[GuideBoost] = 1.0f;
+        envelope_.reset();
+        state_.fill(0.0f);
+    }
+
+    void modelResult(int kind, float value, int64_t frameIndex)
+    {
+        if (kind == 0)
+        {
+            modelVad_ = value;
+            vadResultFrame_ = frameIndex;
+        }
+        else
+        {
+            modelPitch_ = value;
+            pitchResultFrame_ = frameIndex;
+        }
+    }
+
+    int process(size_t numSamples, bool playing)
+    {
+        const size_t n = std::min(numSamples, kMaxBlock);
+        if (n == 0)
+        {
+            return 0;
+        }
+
+        float peak = 0.0f;
+        float micPeak = 0.0f;
+        const float instrumentGain = params_[InstrumentGain];
+        const float timbreStrength = params_[TimbreStrength];
+        for (size_t i = 0; i < n; ++i)
+        {
+            // Take out the share of the backing track the mic picks up, so the gate hears
+            // the singer rather than the PA.
+            const float instrument = playing ? instrument_[i] * instrumentGain : 0.0f;
+            micPeak = std::max(micPeak, std::abs(mic_[i]));
+            float detection = mic_[i];
+            if (playing && std::abs(instrument) > kLeakThreshold)
+            {
+                detection -= instrument * leak_;
+                leak_ = std::clamp(leak_ + params_[LeakAdaptRate] * instrument * detection, 0.0f, params_[LeakClamp]);
+            }
+            else
+            {
+                leak_ += params_[LeakRecoveryRate] * (params_[LeakCompensation] - leak_);
+            }
+            const float level = std::abs(std::clamp(detection, -1.0f, 1.0f));
+            peak = std::max(peak, level);
+
+            const float strength = std::min(1.0f, std::max(0.0f, level - params_[NoiseFloor]) * kVocalStrengthScale);
+            vocalStrength_ += (strength > vocalStrength_ ? kVocalStrengthRise : kVocalStrengthFall) * (strength - vocalStrength_);
+            vocalStrength_ = std::clamp(vocalStrength_, 0.0f, 1.0f);
+
+            brightnessLow_ += lowpass_ * (level - brightnessLow_);
+            brightnessHigh_ += 0.5f * lowpass_ * (std::abs(detection - brightnessLow_) - brightnessHigh_);
+            const float tiltTarget = std::clamp((brightnessHigh_ - brightnessLow_) * timbreStrength, -timbreStrength, timbreStrength);
+            tilt_ = std::clamp(tilt_ + kTiltSmoothing * (tiltTarget - tilt_), -1.0f, 1.0f);
+        }
+        const float rms = std::sqrt(dsp::simd::sumOfSquares(mic_.data(), n) / static_cast<float>(n));
+
+        const int ready = decimate(n);
+        const float vad = fresh(vadFrames_, vadResultFrame_, kMaxVadLag) ? modelVad_ : vadHeuristic_;
+        float pitch = fresh(pitchFrames_, pitchResultFrame_, kMaxPitchLag) ? modelPitch_ : pitchHeuristic_;
+
+        // Confidence as the main thread used to blend it: the models, scaled by how far the
+        // block is above silence, with the level alone able to carry most of the way.
+        const float energy = std::clamp((rms - kEnergySilenceFloor) / (kEnergyFullScale - kEnergySilenceFloor), 0.0f, 1.0f);
+        if (energy <= 0.01f)
+        {
+            pitch = 0.0f;
+        }
+        else if (energy < 0.2f)
+        {
+            pitch *= energy;
+        }
+        const float vadComponent = vad * energy;
+        const float combined = std::max({params_[VadWeight] * vadComponent + params_[PitchWeight] * pitch * energy,
+                                         vadComponent,
+                                         std::pow(energy, 0.55f) * 0.85f});
+        confidence_ = std::clamp(confidence_ + kConfidenceSmoothing * (std::clamp(combined, 0.0f, 1.0f) - confidence_), 0.0f, 1.0f);
+
+        const float gainDb = gate_.update(confidence_, vad, pitch);
+        const auto levels = envelope_.update(n, peak, gainDb, confidence_, vocalStrength_, playing);
+
+        std::array<float, kControls> targets{};
+        targets[GuideDry] = levels.guideMix * (1.0f - levels.tailMix);
+        targets[ReverbSend] = levels.guideMix;
+        targets[ReverbReturn] = levels.tailMix;
+        targets[GuideBoost] = 1.0f + levels.guideMix * kGuideBoostHeadroom;
+        targets[LowShelfDb] = 20.0f * std::log10(std::clamp(1.0f - tilt_, 0.2f, 2.0f));
+        targets[HighShelfDb] = 20.0f * std::log10(std::clamp(1.0f + tilt_, 0.2f, 2.5f));
+        for (size_t c = 0; c < kControls; ++c)
+        {
+            float* out = controls_.data() + c * kMaxBlock;
+            float value = controlState_[c];
+            for (size_t i = 0; i < n; ++i)
+            {
+                value += controlStep_[c] * (targets[c] - value);
+                out[i] = value;
+            }
+            controlState_[c] = value;
+        }
+
+        const float monitorTarget = dbToLinear(gainDb);
+        for (size_t i = 0; i < n; ++i)
+        {
+            monitorGain_ += kMonitorSmoothing * (monitorTarget - monitorGain_);
+            monitor_[i] = mic_[i] * monitorGain_;
+        }
+
+        state_[Vad] = vad;
+        state_[Pitch] = pitch;
+        state_[Confidence] = confidence_;
+        state_[GainDb] = gainDb;
+        state_[Peak] = peak;
+        state_[MicPeak] = micPeak;
+        state_[Rms] = rms;
+        state_[GuideMix] = levels.guideMix;
+        state_[TailMix] = levels.tailMix;
+        state_[Tilt] = tilt_;
+        state_[VadFrameIndex] = static_cast<float>(vadFrames_ - 1);
+        state_[PitchFrameIndex] = static_cast<float>(pitchFrames_ - 1);
+        return ready;
+    }
+
+    float* params() { return params_.data(); }
+    float* mic() { return mic_.data(); }
+    float* instrument() { return instrument_.data(); }
+    float* monitor() { return monitor_.data(); }
+    float* controls() { return controls_.data(); }
+    float* state() { return state_.data(); }
+    float* vadFrame() { return vadFrame_.data(); }
+    float* pitchFrame() { return pitchFrame_.data(); }
+
+private:
+    // Feeds the model-rate stream into both frame accumulators. A render quantum yields
+    // fewer samples than either frame, so each completes at most once per call.
+    int decimate(size_t n)
+    {
+        const size_t produced = decimator_.process(mic_.data(), n, decimated_.data(), decimated_.size());
+        int ready = 0;
+        for (size_t offset = 0; offset < produced;)
+        {
+            const size_t take = std::min(produced - offset, kVadFrame - vadFill_);
+            std::copy_n(decimated_.data() + offset, take, vadAccumulator_.data() + vadFill_);
+            vadFill_ += take;
+            offset += take;
+            if (vadFill_ == kVadFrame)
+            {
+                std::copy(vadAccumulator_.begin(), vadAccumulator_.end(), vadFrame_.begin());
+                vadHeuristic_ = vad_.processFrame(vadFrame_.data(), kVadFrame);
+                vadFill_ = 0;
+                ++vadFrames_;
+                ready |= VadFrameReady;
+            }
+        }
+        for (size_t offset = 0; offset < produced;)
+        {
+            const size_t take = std::min(produced - offset, kPitchFrame - pitchFill_);
+            std::copy_n(decimated_.data() + offset, take, pitchAccumulator_.data() + pitchFill_);
+            pitchFill_ += take;
+            offset += take;
+            if (pitchFill_ == kPitchFrame)
+            {
+                std::copy(pitchAccumulator_.begin(), pitchAccumulator_.end(), pitchFrame_.begin());
+                pitchHeuristic_ = pitch_.processHop(pitchFrame_.data(), kPitchFrame);
+                pitchFill_ = 0;
+                ++pitchFrames_;
+                ready |= PitchFrameReady;
+            }
+        }
+        return ready;
+    }
+
+    double sampleRate_{48000.0};
+    std::array<float, kParams> params_{10.0f, 20.0f, 180.0f, 150.0f, 0.7f, 0.4f, 3.0f, 6.0f, -18.0f, 0.6f, 0.4f,
+                                       70.0f, 236.0f, 0.29f, 0.02f, 0.32f, 0.22f, 0.6f, 0.0005f, 0.00005f, 1.0f,
+                                       1.0f, 1.0f, 0.0f};
+    std::vector<float> mic_;
+    std::vector<float> instrument_;
+    std::vector<float> monitor_;
+    std::vector<float> controls_;
+    std::vector<float> decimated_;
+    std::vector<float> vadFrame_;
+    std::vector<float> pitchFrame_;
+    std::array<float, kVadFrame> vadAccumulator_{};
+    std::array<float, kPitchFrame> pitchAccumulator_{};
+    std::array<float, kFields> state_{};
+    std::array<float, kControls> controlState_{};
+    std::array<float, kControls> controlStep_{};
+
+    dsp::Resampler decimator_;
+    dsp::VadProcessor vad_{modelEnv};
+    dsp::PitchProcessor pitch_{modelEnv};
+    dsp::ConfidenceGate gate_;
+    dsp::GuideEnvelope envelope_;
+
+    size_t vadFill_{0};
+    size_t pitchFill_{0};
+    int64_t vadFrames_{0};
+    int64_t pitchFrames_{0};
+    int64_t vadResultFrame_{-1};
+    int64_t pitchResultFrame_{-1};
+    float modelVad_{0.0f};
+    float modelPitch_{0.0f};
+    float vadHeuristic_{0.0f};
+    float pitchHeuristic_{0.0f};
+    float leak_{0.6f};
+    float vocalStrength_{0.0f};
+    float brightnessLow_{0.0f};
+    float brightnessHigh_{0.0f};
+    float tilt_{0.0f};
+    float lowpass_{0.0f};
+    float confidence_{0.0f};
+    float monitorGain_{0.0f};
+};
+
+namespace
+{
+WorkletKernel kernel;
+} // namespace
+} // namespace singwithme::web
+
+using singwithme::web::kernel;
+
+TUNETRIX_EXPORT int tt_prepare(float sampleRate) { return kernel.prepare(sampleRate) ? 1 : 0; }
+// After writing tt_params(); a gate reconfigure also restarts its envelope.
+TUNETRIX_EXPORT void tt_apply_params(int reconfigureGate) { kernel.applyParams(reconfigureGate != 0); }
+TUNETRIX_EXPORT void tt_reset() { kernel.reset(); }
+TUNETRIX_EXPORT void tt_model_result(int kind, float value, int frameIndex) { kernel.modelResult(kind, value, frameIndex); }
+TUNETRIX_EXPORT int tt_process(int numSamples, int playing) { return kernel.process(static_cast<size_t>(std::max(0, numSamples)), playing != 0); }
+
+TUNETRIX_EXPORT float* tt_params() { return kernel.params(); }
+TUNETRIX_EXPORT float* tt_mic() { return kernel.mic(); }
+TUNETRIX_EXPORT float* tt_instrument() { return kernel.instrument(); }
+TUNETRIX_EXPORT float* tt_monitor() { return kernel.monitor(); }
+TUNETRIX_EXPORT float* tt_controls() { return kernel.controls(); }
+TUNETRIX_EXPORT float* tt_state() { return kernel.state(); }
+TUNETRIX_EXPORT float* tt_vad_frame() { return kernel.vadFrame(); }
+TUNETRIX_EXPORT float* tt_pitch_frame() { return kernel.pitchFrame(); }